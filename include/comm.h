@@ -22,14 +22,22 @@
 #define __MOSIX_COMM_
 
 #include <unistd.h>
+#include <sys/uio.h>
 
 #define COMM_BINARY            (1)
-#define COMM_MAX_INPROGRESS    (200) 
+#define COMM_MAX_INPROGRESS    (200)   /* First size of the tables, they grow */
+#define COMM_MAX_EVENTS        (256)   /* Ready sockets handled in one round */
 #define COMM_MAX_LISTEN        (5)
 #define MAX_MSG_SIZE           (1024*1024)
 #define CLOSE_WAIT_TIME        (1000000)
 #define COMM_ADMIN_WAIT        (1)
 #define COMM_CONNECT_WAIT      (1)
+#define COMM_POOL_IDLE_TIMEOUT (10)    /* Seconds a kept connection may idle */
+#define COMM_UDP_MAX_SIZE      (65000) /* Largest datagram, with the header */
+#define COMM_BUF_CLASSES       (6)     /* Buffer sizes 1K, 4K, ... 1M */
+#define COMM_BUF_MIN_SIZE      (1024)
+#define COMM_BUF_KEEP          (16)    /* Free buffers kept of each size */
+#define COMM_COMPRESS_MIN_SIZE (1024)  /* Smaller messages are not compressed */
 
 /****************************************************************************
  * header and header handling functions
@@ -39,10 +47,48 @@ typedef struct comm_hdr {
 	int size;
 } comm_hdr_t ;
 
+/*
+ * Set in the type of a compressed message. Its data is the size of the
+ * message before compression (an int) followed by the zlib stream. Given
+ * in the type to the send functions it asks for compression, which is done
+ * if the message is large enough and gets smaller; the receiver must
+ * understand it. comm removes it from the messages it receives.
+ */
+#define COMM_HDR_COMPRESSED    (0x40000000)
+
+
+/****************************************************************************
+ * How comm_wait waits for the sockets. With epoll only the ready sockets
+ * are visited, select is kept as a fallback (fds below FD_SETSIZE only).
+ ***************************************************************************/
+#define COMM_BACKEND_SELECT    (0)
+#define COMM_BACKEND_EPOLL     (1)
+
+/* Events of a watched fd */
+#define COMM_EV_READ           (0x1)
+#define COMM_EV_WRITE          (0x2)
+#define COMM_EV_CLOSE          (0x4)   /* Closed by the other side or error */
 
 /******************************************************************************
  * msx_comm and related interface functions 
  *****************************************************************************/
+struct _msx_comm_hndl;
+struct comm_inprogress_recv;
+
+/* Called by comm_dispatch for a watched fd which is ready */
+typedef void (*comm_fd_func_t)(struct _msx_comm_hndl *comm, int fd,
+			       int events, void *arg);
+
+/* Called by comm_dispatch once a send is over, res as comm_finish_send() */
+typedef void (*comm_sent_func_t)(struct _msx_comm_hndl *comm, int res,
+				 char *ip, void *arg);
+
+/* Called by comm_dispatch with a message fully received, as comm_recv() */
+typedef void (*comm_recvd_func_t)(struct _msx_comm_hndl *comm,
+				  struct comm_inprogress_recv *msg, void *arg);
+
+/* Called once a scatter/gather send is over (sent, failed or dropped) */
+typedef void (*comm_send_done_func_t)(void *arg);
 
 /*
  * Used to hold messages that should be asynchronously delivered
@@ -55,6 +101,15 @@ typedef struct comm_inprogress_send {
     void        *data;
     char        ip[COMM_IP_VER];
     int         mv2recv; 
+    int         pooled;        /* COMM_POOL_NEW or COMM_POOL_REUSED */
+
+    // Scatter/gather send. The iovec belongs to the caller and is valid
+    // until done is called. data is not used.
+    struct iovec          *iov;
+    int                    iovcnt;
+    comm_hdr_t             hdr;
+    comm_send_done_func_t  done;
+    void                  *done_arg;
       
 } comm_inprogress_send_t;
 
@@ -69,6 +124,7 @@ typedef struct comm_inprogress_recv{
     int         curr_size;
     void        *data;
     char        ip[COMM_IP_VER];
+    int         keep;          /* Kept open for more messages */
 } comm_inprogress_recv_t;
 
 /*
@@ -82,6 +138,56 @@ typedef struct comm_send_close{
     struct timeval time;
 } comm_send_close_t ;
 
+/*
+ * A connection kept open to another host, so the next messages sent to it
+ * do not need a new connection. While busy a send is in progress on it.
+ */
+#define COMM_POOL_NEW          (1)
+#define COMM_POOL_REUSED       (2)
+
+typedef struct comm_pool_ent{
+    int             sock;
+    char            ip[COMM_IP_VER];
+    unsigned short  port;
+    int             busy;
+    struct timeval  used;
+} comm_pool_ent_t;
+
+/* Messages sent and received, by transport */
+typedef struct comm_stats{
+    unsigned long   tcp_sent;
+    unsigned long   tcp_recvd;
+    unsigned long   udp_sent;
+    unsigned long   udp_recvd;
+    unsigned long   udp_fallback;  /* Could not go as a datagram, sent by tcp */
+    unsigned long   udp_bad;       /* Received datagrams which were dropped */
+    unsigned long   buf_hit;       /* Buffers taken from the pools */
+    unsigned long   buf_miss;      /* Buffers allocated */
+    unsigned long   zip_sent;      /* Messages sent compressed */
+    unsigned long   zip_recvd;
+    unsigned long   zip_saved;     /* Bytes not sent thanks to compression */
+} comm_stats_t;
+
+/*
+ * A watched fd, indexed by the fd. For the sockets of comm pos is their
+ * place in the table of their kind. gen tells a ready event of a closed
+ * fd from one of a new fd with the same number.
+ */
+typedef struct comm_fd_ent{
+    comm_fd_func_t  func;
+    void           *arg;
+    int             events;
+    int             pos;
+    unsigned int    gen;
+} comm_fd_ent_t;
+
+/* A ready fd found by comm_wait */
+typedef struct comm_ready{
+    int             fd;
+    int             events;
+    unsigned int    gen;
+} comm_ready_t;
+
 /*
  * The msx_comm data structure
  */
@@ -91,17 +197,53 @@ typedef struct _msx_comm_hndl{
     int             comm_timeout; /* time out in seconds */
     int             comm_maxfd;
       
-    comm_inprogress_send_t comm_inpr_send[COMM_MAX_INPROGRESS];
+    comm_inprogress_send_t *comm_inpr_send;
     int             comm_inpr_send_next;
+    int             comm_inpr_send_size;
 
-    comm_send_close_t  comm_close[COMM_MAX_INPROGRESS];
+    comm_send_close_t  *comm_close;
     int                comm_close_next;
+    int                comm_close_size;
     
-    comm_inprogress_recv_t comm_inpr_recv[COMM_MAX_INPROGRESS];
+    comm_inprogress_recv_t *comm_inpr_recv;
     int             comm_inpr_recv_next;
+    int             comm_inpr_recv_size;
+
+    // Connections kept open to other hosts, least recently used first out
+    comm_pool_ent_t   *comm_pool;
+    int                comm_pool_next;
+    int                comm_pool_max;
+    int                comm_pool_idle;   /* seconds */
+
+    // Small messages sent as datagrams, see comm_set_udp
+    int                comm_udp_sock;
+    int                comm_udp_max;
+    char              *comm_udp_buff;
+
+    // Free buffers of each size class, see comm_buf_get
+    void              *comm_bufs[COMM_BUF_CLASSES][COMM_BUF_KEEP];
+    int                comm_bufs_num[COMM_BUF_CLASSES];
+
+    // Messages asking for it are compressed from this size, see comm_hdr_t
+    int                comm_compress_min;
+
+    comm_stats_t       comm_stats;
 
     // The time for the next admin op
     struct timeval  next_admin;
+
+    // The watched fds and the ready ones
+    int             comm_backend;
+    int             comm_epfd;
+    comm_fd_ent_t  *comm_fds;
+    int             comm_fds_size;
+    comm_ready_t   *comm_ready;
+    int             comm_num_ready;
+
+    // Told about the sends and receives done by comm_dispatch
+    comm_sent_func_t   comm_sent_func;
+    comm_recvd_func_t  comm_recvd_func;
+    void              *comm_func_arg;
     
 } msx_comm_t;
 
@@ -111,6 +253,71 @@ typedef struct _msx_comm_hndl{
  * socket.
  ***************************************************************************/
 msx_comm_t  *comm_init( unsigned short *ports, int timeout );
+msx_comm_t  *comm_init_backend( unsigned short *ports, int timeout,
+				int backend );
+int          comm_get_backend( msx_comm_t *comm );
+
+/*
+ * Event loop interface. comm_wait waits up to timeout_ms (-1 for ever)
+ * for the watched fds and returns the number found ready, or -1 (errno is
+ * kept). comm_dispatch then calls their callbacks: the sockets of comm are
+ * handled inside and reported to the functions given to comm_set_handlers.
+ * comm_poll does both.
+ */
+void comm_set_handlers( msx_comm_t *comm, comm_sent_func_t sent,
+			comm_recvd_func_t recvd, void *arg );
+int  comm_watch_fd( msx_comm_t *comm, int fd, int events,
+		    comm_fd_func_t func, void *arg );
+/* Only when fd is still watched with func, its number may be reused */
+int  comm_unwatch_fd( msx_comm_t *comm, int fd, comm_fd_func_t func );
+int  comm_wait( msx_comm_t *comm, int timeout_ms );
+int  comm_dispatch( msx_comm_t *comm );
+int  comm_poll( msx_comm_t *comm, int timeout_ms );
+
+/*
+ * Keep up to max connections to other hosts open after a send (not for
+ * mv2recv sends) and send the next messages to the same host and port on
+ * them. A connection idle for idle seconds is closed, and the least
+ * recently used idle one makes room for a new host. A send failing on a
+ * kept connection is retried once on a new one. Should be called before
+ * sending, 0 (the default) means a connection per message.
+ */
+int  comm_set_pool( msx_comm_t *comm, int max, int idle );
+
+/*
+ * Keep receiving on sock (of a message given by comm_recv), so the sender
+ * can send its next messages on it. Returns 0 if sock should be closed.
+ */
+int  comm_recv_next( msx_comm_t *comm, int sock, char *ip );
+
+/*
+ * Send the messages (not mv2recv ones) of up to max bytes, with the
+ * header, as UDP datagrams to the port they are sent to, larger ones by
+ * tcp. Datagrams arriving on port are given to the recvd handler with sock
+ * -1. A lost datagram is not noticed, so it fits messages which are sent
+ * again anyway. 0 stops it.
+ */
+int  comm_set_udp( msx_comm_t *comm, unsigned short port, int max );
+void comm_get_stats( msx_comm_t *comm, comm_stats_t *stats );
+
+/*
+ * Message buffers, kept by comm in pools of a few sizes so the messages do
+ * not need malloc and new pages. The data of a received message is such a
+ * buffer, and should be given back with comm_buf_put instead of free.
+ */
+void *comm_buf_get( msx_comm_t *comm, int size );
+void  comm_buf_put( msx_comm_t *comm, void *buf );
+
+/*
+ * Compression of the messages sent with COMM_HDR_COMPRESSED in their type,
+ * from min bytes (COMM_COMPRESS_MIN_SIZE by default). The uncompress
+ * functions are for the clients reading a reply without comm:
+ * comm_uncompressed_size gives the size of the data (-1 if it is bad) and
+ * comm_uncompress fills dst with it.
+ */
+void comm_set_compress( msx_comm_t *comm, int min );
+int  comm_uncompressed_size( void *data, int size );
+int  comm_uncompress( void *dst, int dst_size, void *data, int size );
 
 /* Used to remove sockets that are not active */
 void comm_admin( msx_comm_t *comm, int tflg );
@@ -135,6 +342,19 @@ int  comm_send( msx_comm_t *comm, char *ip, unsigned short port,
 int  comm_send_on_socket( msx_comm_t *comm, int sock,
 			  void *buff, int type, int size, int mv2recv );
 
+/*
+ * Same as comm_send and comm_send_on_socket but the message is given as an
+ * iovec which is sent as is, without copying it. done(done_arg) is called
+ * exactly once when the iovec is no longer needed, also on failure.
+ */
+int  comm_send_iov( msx_comm_t *comm, char *ip, unsigned short port,
+		    struct iovec *iov, int iovcnt, int type, int mv2recv,
+		    comm_send_done_func_t done, void *done_arg );
+int  comm_send_iov_on_socket( msx_comm_t *comm, int sock,
+			      struct iovec *iov, int iovcnt, int type,
+			      int mv2recv, comm_send_done_func_t done,
+			      void *done_arg );
+
 /* conntinue sending a message on one of the sockets */ 
 int comm_finish_send( msx_comm_t *comm, fd_set *finished, char *ip);
 
@@ -159,6 +379,7 @@ int comm_recv_hdr( comm_hdr_t *hdr, int sock );
 
 int comm_connect_client( char* rserver, unsigned short portnum );
 
+/* The status, in at most size bytes of buff. Long socket lists are cut */
 void comm_print_status(msx_comm_t *comm, char *buff, int size);
 
 #endif /* __MOSIX_COMM_H */
@@ -27,6 +27,7 @@
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
 
 /****************************************************************************
  * Constants and macros 
@@ -60,6 +61,7 @@
 #define INFOD_MSG_TYPE_GLOBAL    (0x08)
 #define MSG_TYPE_STR             (0x10)
 #define INFOD_MSG_TYPE_INFO_PULL (0x20)
+#define INFOD_MSG_TYPE_INFO_DELTA (0x40)
 
 #define  XML_ROOT_TAG        "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
 #define  MEM_UNIT_SIZE       (4096)
@@ -99,11 +101,30 @@ char *infoStatusToStr(int status);
 
 /**************************************
  * The pull information message format
+ *
+ * A digest pull lists the age (in milliseconds, when the pull was sent)
+ * of every entry the puller holds. The answer is a window of the entries
+ * the responder holds newer. A pull without a digest (or from an older
+ * infod) is answered with the responder window.
  **************************************/ 
+#define INFO_PULL_WINDOW        (99)
+#define INFO_PULL_DIGEST        (100)
+#define INFO_DIGEST_NO_AGE      (0xffffffff)
+
+typedef struct info_digest_ent {
+	struct in_addr  IP;
+	unsigned int    age;        // msec
+} info_digest_ent_t;
+
 typedef struct info_pull_msg {
-	int         param;
+	int                 param;  // INFO_PULL_WINDOW / INFO_PULL_DIGEST
+	unsigned int        num;    // digest entries
+	info_digest_ent_t   ents[0];
 } info_pull_msg_t;
 
+#define INFO_PULL_MSG_SZ        (sizeof(info_pull_msg_t))
+#define INFO_DIGEST_ENT_SZ      (sizeof(info_digest_ent_t))
+
 
 /**************************************
  * Client requests messages
@@ -143,7 +164,11 @@ typedef struct infod_stats {
 	double           avgload;        /* the maximal age                 */
 	double           avgage;        /* the average age of the info     */
 	double           maxage;
-	double           unused[5];
+	double           heapsize;      /* bytes held for node info records */
+	double           heapused;      /* bytes used by node info records  */
+	double           agep50;        /* median age of the info           */
+	double           agep95;        /* 95th percentile age of the info  */
+	double           unused[1];
 } infod_stats_t;
 
 #define      NODE_SZ       (sizeof(node_t))
@@ -212,6 +237,12 @@ typedef struct _infolib_msg {
 	char args[0];
 } infolib_msg_t;
 
+/*
+ * A request without args may carry an int of flags as its args. An infod
+ * which does not know them ignores them.
+ */
+#define INFOLIB_FLAG_COMPRESS  (0x1)   /* The reply may be compressed */
+
 /* The args variable in 'infolib_msg_t' may char* or one of the following */ 
 typedef struct cont_pes_args {
 	node_t pe;
@@ -0,0 +1,85 @@
+/*============================================================================
+  gossimon - Gossip based resource usage monitoring for Linux clusters
+  Copyright 2003-2010 Amnon Barak
+
+  Distributed under the OSI-approved BSD License (the "License");
+  see accompanying file Copyright.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+============================================================================*/
+
+
+/*****************************************************************************
+ *    File: info_shm.h. Shared memory export of the information vector
+ *****************************************************************************/
+
+#ifndef _INFO_SHM_H
+#define _INFO_SHM_H
+
+#include <sys/time.h>
+#include <info.h>
+
+/*
+  The infod writes the whole vector (in the idata_t layout of an
+  INFOLIB_ALL reply) to a file in /dev/shm once every time step. Local
+  clients map it read only. The data is protected by a sequence counter
+  which is odd while the data is being written: a reader reads the counter,
+  reads the data in place and reads the counter again, and retries if it
+  changed. The writer never waits for readers.
+
+  When the vector grows beyond the segment, the writer creates a bigger
+  one in its place (rename) and marks the old one stale, readers of the old
+  one attach again on their next read.
+*/
+
+#define INFO_SHM_MAGIC        (0x67736d31)
+#define INFO_SHM_DEF_PATH     "/dev/shm/gossimon-infod"
+
+typedef struct info_shm_hdr {
+	unsigned int          magic;
+	unsigned int          version;   // MSX_INFOD_INFO_VER
+	volatile unsigned int seq;       // Odd while being written
+	volatile int          stale;     // Replaced by a bigger segment
+	int                   capacity;  // Size of the data area
+	volatile int          data_sz;
+	struct timeval        time;      // The ages are relative to this time
+	char                  data[0];   // idata_t
+} info_shm_hdr_t;
+
+#define INFO_SHM_HDR_SZ       (sizeof(info_shm_hdr_t))
+
+typedef struct info_shm *info_shm_t;
+
+/****************************************************************************
+ * Writer (infod). Begin returns the data area to fill with size bytes,
+ * growing the segment if needed, end publishes it.
+ ***************************************************************************/
+info_shm_t    info_shm_create( const char *path, int size );
+void          info_shm_destroy( info_shm_t shm );
+void*         info_shm_write_begin( info_shm_t shm, int size );
+void          info_shm_write_end( info_shm_t shm, int size );
+
+/****************************************************************************
+ * Readers (see infolib.h)
+ ***************************************************************************/
+info_shm_t    infolib_shm_attach( const char *path );
+void          infolib_shm_detach( info_shm_t shm );
+
+/* Zero copy read: the data returned by begin may be used only once retry
+   returned 0 for the same seq, and only until the next begin */
+idata_t*      infolib_shm_read_begin( info_shm_t shm, unsigned int *seq );
+int           infolib_shm_read_retry( info_shm_t shm, unsigned int seq );
+
+/* A private (malloced) copy of the data, NULL if no consistent copy */
+idata_t*      infolib_shm_all( info_shm_t shm );
+
+/* The time the data was written, ages in it are relative to it */
+int           infolib_shm_time( info_shm_t shm, struct timeval *tv );
+
+#endif
+
+/***************************************************************************
+                                E O F
+****************************************************************************/
@@ -61,6 +61,10 @@ char* infolib_info_description( char *server, unsigned short portnum);
 /* get the load information of all of the machines from server */ 
 idata_t* infolib_window( char *server, unsigned short portnum );
 
+/* Local clients can read the vector exported by infod (--shm) without
+   a request, see info_shm.h for infolib_shm_attach() and friends */
+#include <info_shm.h>
+
 #endif
 				
 /***************************************************************************
@@ -42,6 +42,8 @@
 #define  XML_TAG_AVGLOAD          "avgload"
 #define  XML_TAG_AVGAGE           "avgage"
 #define  XML_TAG_MAXAGE           "maxage"
+#define  XML_TAG_AGEP50           "agep50"
+#define  XML_TAG_AGEP95           "agep95"
 
 
 #define XML_INFO_ITEM_IDENT_STR  "\t\t"
@@ -180,6 +180,17 @@ infodctl_get_max_sock() {
 	return -1;
 }
 
+/*****************************************************************************
+ * Returning the sockfd we are currently waiting on (-1 if none). listening
+ * is set if it is the main socket, so an accept() should be called when it
+ * is ready.
+ *****************************************************************************/
+int
+infodctl_get_fd( int *listening ) {
+	*listening = (ctl_status == CTL_WAIT_FOR_NEW);
+	return infodctl_get_max_sock();
+}
+
 /*****************************************************************************
  * Checking if ctl_sockfd is on the rfds we got from the select. If true,
  * an accept() can be called on the socket
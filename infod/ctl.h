@@ -61,6 +61,7 @@ int infodctl_reset();
 /* Add the relevant file descriptors to the read fd's of select() */
 int infodctl_get_fdset( fd_set *rfds );
 int infodctl_get_max_sock();
+int infodctl_get_fd( int *listening );
 
 /* Determines if one of the ready fd's is of the contorl channel  */
 int infodctl_is_new_connection( fd_set *rfds );
@@ -56,8 +56,12 @@ int gossipAlgoRegular_step(ivec_t vec, void *gossip_data,
 		return 0;
 
 	/* prepare the message */
-	ga->msgData = infoVecGetWindow( vec, &(ga->msgLen), full_flg);
-	ga->msgType = INFOD_MSG_TYPE_INFO;
+	ga->msgData   = NULL;
+	ga->msgHandle = infoVecGetWindowIov( vec, full_flg, &(ga->msgIov),
+					     &(ga->msgIovCnt), &(ga->msgLen));
+	if( !ga->msgHandle )
+		return 0;
+	ga->msgType = infoVecWindowMsgType( vec );
 	ga->keepConn = 0;
 	return 1;
 }
@@ -69,18 +73,26 @@ int gossipAlgoMinDead_init(void **gossipData) {
 }
 
 
-int prepRandomNodePush(ivec_t vec, struct gossipAction *ga, int onlyAlive)
+int prepWindowPush(ivec_t vec, struct gossipAction *ga)
 {
-	if( infoVecRandomNode( vec, onlyAlive, &(ga->randIP)) == 0) 
-		return 0;
-
 	/* prepare the message */
-	ga->msgData = infoVecGetWindow( vec, &(ga->msgLen), 1);
-	ga->msgType = INFOD_MSG_TYPE_INFO;
+	ga->msgData   = NULL;
+	ga->msgHandle = infoVecGetWindowIov( vec, 1, &(ga->msgIov),
+					     &(ga->msgIovCnt), &(ga->msgLen));
+	if( !ga->msgHandle )
+		return 0;
+	ga->msgType = infoVecWindowMsgType( vec );
 	ga->keepConn = 0;
 	return 1;
 }
 
+int prepRandomNodePush(ivec_t vec, struct gossipAction *ga, int onlyAlive)
+{
+	if( infoVecRandomNode( vec, onlyAlive, &(ga->randIP)) == 0) 
+		return 0;
+	return prepWindowPush(vec, ga);
+}
+
 int gossipAlgoMinDead_step(ivec_t vec, void *gossip_data,
 			   struct gossipAction *ga)
 {
@@ -112,19 +124,25 @@ int gossipAlgoPushPull_init(void **gossipData) {
 }
 
 
-info_pull_msg_t pullBuff;
-
+/*
+ * Pull from the oldest nodes, as many as the fan-out. Each of them sends
+ * back what it has newer than our digest
+ */
 int prepOldestNodePull(ivec_t vec, struct gossipAction *ga)
 {
-	if( infoVecOldestNode( vec, &(ga->randIP)) == 0) 
+	int k = ga->maxPeers;
+
+	if( k < 1 || k > INFOD_MAX_FANOUT )
+		k = 1;
+	if( ( ga->numPeers = infoVecOldestNodes( vec, ga->peers, k )) == 0 )
 		return 0;
+	ga->randIP = ga->peers[0];
 
-	/* currently using a dummy message buffer */
-	pullBuff.param = 99;
-	
-	/* prepare the message */
-	ga->msgData  = &pullBuff;
-	ga->msgLen   = sizeof(info_pull_msg_t);
+	/* prepare the message, the digest of our vector so only the
+	   entries we miss are sent back */
+	ga->msgHandle = NULL;
+	if( !( ga->msgData = infoVecGetDigest( vec, &(ga->msgLen) )))
+		return 0;
 	ga->msgType  = INFOD_MSG_TYPE_INFO_PULL;
 	ga->keepConn = 1;
 	return 1;
@@ -159,8 +177,8 @@ int gossipAlgoPushPull_step(ivec_t vec, void *gossip_data,
 	{
 		if(pull_cycle) {
 			res = prepOldestNodePull(vec, ga);
-			debug_lb( INFOD_DEBUG, "~~~~ PULL from oldest --> %s\n",
-				  inet_ntoa(ga->randIP));
+			debug_lb( INFOD_DEBUG, "~~~~ PULL from oldest --> %s (%d)\n",
+				  inet_ntoa(ga->randIP), ga->numPeers);
 		}
 		else {
 			res = prepRandomNodePush(vec, ga, only_alive);
@@ -179,6 +197,56 @@ int gossipAlgoPushPull_step(ivec_t vec, void *gossip_data,
 }
 
 
+/*
+ * Topology aware gossip. Most messages go to nodes in the mapper cluster of
+ * the local node and only some cross to the other clusters. Unless a ratio
+ * is given, a cluster sends about INFOD_TOPO_REMOTE_MSGS remote messages
+ * each step whatever its size, so an entry crosses to another cluster in a
+ * few steps and spreads there as in a single cluster. The windows carry
+ * the remote entries as any other.
+ */
+static double topoRemoteRatio = -1.0;
+
+int gossipAlgoTopo_init(void **gossipData) {
+	*gossipData = NULL;
+	topoRemoteRatio = globOpts.opt_gossipRemoteRatio;
+	return 1;
+}
+
+int gossipAlgoTopo_step(ivec_t vec, void *gossip_data,
+			struct gossipAction *ga)
+{
+	int    num_alive, local, remote;
+	int    param = INFOD_SEND_TO_ANY_CYCLE;
+	double ratio = topoRemoteRatio;
+	
+	// Once in a while a node which may be dead, as in mindead
+	if( ( num_alive = infoVecNumAlive( vec )) > param )
+		param = num_alive;
+	if( ( rand() % param ) == 0 )
+		return prepRandomNodePush(vec, ga, 0);
+
+	local  = infoVecNumAliveInCluster( vec, 1 );
+	remote = infoVecNumAliveInCluster( vec, 0 );
+	if( ratio < 0 ) {
+		ratio = (double)INFOD_TOPO_REMOTE_MSGS / ( local + 1 );
+		if( ratio > 0.5 )
+			ratio = 0.5;
+	}
+	if( remote == 0 )
+		ratio = 0.0;
+	else if( local == 0 )
+		ratio = 1.0;
+
+	remote = ( rand() / ( RAND_MAX + 1.0 )) < ratio;
+	if( !infoVecRandomClusterNode( vec, !remote, &(ga->randIP) ))
+		return prepRandomNodePush(vec, ga, 1);
+	debug_lb( INFOD_DEBUG, "~~~~ PUSH to %s --> %s\n",
+		  remote ? "remote" : "local", inet_ntoa(ga->randIP));
+	return prepWindowPush(vec, ga);
+}
+
+
 // All the possible gossip algorithms in use
 struct infodGossipAlgo infodGossipAlgo[] =
 {
@@ -194,6 +262,10 @@ struct infodGossipAlgo infodGossipAlgo[] =
 	  gossipAlgoPushPull_init,
 	  gossipAlgoPushPull_step,
 	},
+	{ "topo",
+	  gossipAlgoTopo_init,
+	  gossipAlgoTopo_step,
+	},
 	{ NULL, NULL, NULL },
 };
 	  
@@ -0,0 +1,286 @@
+/*============================================================================
+  gossimon - Gossip based resource usage monitoring for Linux clusters
+  Copyright 2003-2010 Amnon Barak
+
+  Distributed under the OSI-approved BSD License (the "License");
+  see accompanying file Copyright.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+============================================================================*/
+
+
+/******************************************************************************
+ *
+ * File: infoArena.c. Size class arena for the vector info records
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <infoArena.h>
+
+/* Each block starts with this header. cls is -1 for large blocks */
+typedef union arena_blk {
+	struct {
+		int        cls;
+		int        size;   // Requested size
+		int        cap;    // Data capacity of a large block
+		int        refs;   // Owner + pins, the block is freed at 0
+	} h;
+	long long          align[2];
+} arena_blk_t;
+
+#define BLK_HDR_SZ          (sizeof(arena_blk_t))
+#define BLK_OF(ptr)         ((arena_blk_t *)((char *)(ptr) - BLK_HDR_SZ))
+#define BLK_DATA(blk)       ((void *)((char *)(blk) + BLK_HDR_SZ))
+#define CLASS_SZ(c)         (1 << (INFO_ARENA_MIN_SHIFT + (c)))
+
+/* Free blocks are linked through their data area */
+typedef struct arena_free {
+	struct arena_free *next;
+} arena_free_t;
+
+typedef struct arena_slab {
+	struct arena_slab *next;
+	long long          align;
+} arena_slab_t;
+
+struct info_arena {
+	arena_free_t       *freeList[ INFO_ARENA_CLASSES ];
+	arena_slab_t       *slabs;
+	info_arena_stats_t  stats;
+	int                 pins;       // Outstanding info_arena_ref() calls
+	int                 destroyed;  // Destroy was called while pinned
+};
+
+/****************************************************************************
+ * The class of a block with size bytes of data, -1 if it is too big for
+ * any class
+ ***************************************************************************/
+static int
+arena_class( int size ) {
+	int c;
+	int total = size + BLK_HDR_SZ;
+
+	for( c = 0 ; c < INFO_ARENA_CLASSES ; c++ )
+		if( CLASS_SZ(c) >= total )
+			return c;
+	return -1;
+}
+
+/****************************************************************************
+ * Add a new slab for class c and put all its blocks on the free list
+ ***************************************************************************/
+static int
+arena_grow( info_arena_t arena, int c ) {
+	arena_slab_t *slab;
+	char         *ptr;
+	int           i, num;
+
+	if( !(slab = malloc( sizeof(arena_slab_t) + INFO_ARENA_SLAB_SZ )))
+		return 0;
+	slab->next = arena->slabs;
+	arena->slabs = slab;
+	arena->stats.slabs++;
+	arena->stats.reserved += sizeof(arena_slab_t) + INFO_ARENA_SLAB_SZ;
+
+	num = INFO_ARENA_SLAB_SZ / CLASS_SZ(c);
+	ptr = (char *)(slab + 1);
+	for( i = 0 ; i < num ; i++, ptr += CLASS_SZ(c) ) {
+		arena_blk_t  *blk = (arena_blk_t *)ptr;
+		arena_free_t *f   = BLK_DATA(blk);
+
+		blk->h.cls  = c;
+		blk->h.size = 0;
+		f->next = arena->freeList[c];
+		arena->freeList[c] = f;
+	}
+	return 1;
+}
+
+info_arena_t
+info_arena_create( void ) {
+	info_arena_t arena;
+
+	if( !(arena = malloc( sizeof(struct info_arena) )))
+		return NULL;
+	bzero( arena, sizeof(struct info_arena) );
+	return arena;
+}
+
+static void
+arena_release( info_arena_t arena ) {
+	arena_slab_t *slab, *next;
+
+	for( slab = arena->slabs ; slab ; slab = next ) {
+		next = slab->next;
+		free( slab );
+	}
+	free( arena );
+}
+
+void
+info_arena_destroy( info_arena_t arena ) {
+	if( !arena )
+		return;
+	// Pinned blocks are still in use (e.g. by a send in progress), the
+	// last unpin releases the arena
+	if( arena->pins > 0 ) {
+		arena->destroyed = 1;
+		return;
+	}
+	arena_release( arena );
+}
+
+void *
+info_arena_alloc( info_arena_t arena, int size ) {
+	arena_blk_t  *blk;
+	int           c;
+
+	if( !arena || size < 0 )
+		return NULL;
+
+	c = arena_class( size );
+	if( c == -1 ) {
+		if( !(blk = malloc( BLK_HDR_SZ + size )))
+			return NULL;
+		blk->h.cls = -1;
+		blk->h.cap = size;
+		arena->stats.largeBlocks++;
+		arena->stats.reserved += BLK_HDR_SZ + size;
+		arena->stats.used     += BLK_HDR_SZ + size;
+	}
+	else {
+		arena_free_t *f;
+
+		if( arena->freeList[c] )
+			arena->stats.reused++;
+		else if( !arena_grow( arena, c ))
+			return NULL;
+
+		f = arena->freeList[c];
+		arena->freeList[c] = f->next;
+		blk = BLK_OF(f);
+		arena->stats.used += CLASS_SZ(c);
+	}
+	blk->h.size = size;
+	blk->h.refs = 1;
+	arena->stats.requested += size;
+	arena->stats.liveBlocks++;
+	return BLK_DATA(blk);
+}
+
+/****************************************************************************
+ * Drop one reference of the block, returning it when none are left
+ ***************************************************************************/
+static void
+arena_put( info_arena_t arena, void *ptr ) {
+	arena_blk_t  *blk = BLK_OF(ptr);
+
+	if( --blk->h.refs > 0 )
+		return;
+
+	arena->stats.requested -= blk->h.size;
+	arena->stats.liveBlocks--;
+
+	if( blk->h.cls == -1 ) {
+		arena->stats.largeBlocks--;
+		arena->stats.reserved -= BLK_HDR_SZ + blk->h.cap;
+		arena->stats.used     -= BLK_HDR_SZ + blk->h.cap;
+		free( blk );
+	}
+	else {
+		arena_free_t *f = ptr;
+
+		arena->stats.used -= CLASS_SZ(blk->h.cls);
+		blk->h.size = 0;
+		f->next = arena->freeList[ blk->h.cls ];
+		arena->freeList[ blk->h.cls ] = f;
+	}
+}
+
+void
+info_arena_free( info_arena_t arena, void *ptr ) {
+	if( !arena || !ptr )
+		return;
+	arena_put( arena, ptr );
+}
+
+void
+info_arena_ref( info_arena_t arena, void *ptr ) {
+	if( !arena || !ptr )
+		return;
+	BLK_OF(ptr)->h.refs++;
+	arena->pins++;
+}
+
+void
+info_arena_unref( info_arena_t arena, void *ptr ) {
+	if( !arena || !ptr )
+		return;
+	arena_put( arena, ptr );
+	if( --arena->pins == 0 && arena->destroyed )
+		arena_release( arena );
+}
+
+int
+info_arena_is_shared( void *ptr ) {
+	return BLK_OF(ptr)->h.refs > 1;
+}
+
+int
+info_arena_block_size( void *ptr ) {
+	arena_blk_t  *blk = BLK_OF(ptr);
+
+	if( blk->h.cls == -1 )
+		return blk->h.cap;
+	return CLASS_SZ(blk->h.cls) - BLK_HDR_SZ;
+}
+
+void *
+info_arena_resize( info_arena_t arena, void *ptr, int size ) {
+	arena_blk_t  *blk;
+	void         *newPtr;
+	int           capacity, copy;
+
+	if( !ptr )
+		return info_arena_alloc( arena, size );
+
+	blk = BLK_OF(ptr);
+	capacity = info_arena_block_size( ptr );
+
+	// Keeping the block if it fits and is at most one class too big (a
+	// large block at most twice too big), so shrinking records give their
+	// space back without moving on every small change. A pinned block is
+	// never changed in place.
+	if( blk->h.refs == 1 && size <= capacity &&
+	    ( blk->h.cls != -1 ? arena_class( size ) >= blk->h.cls - 1 :
+	      size * 2 > capacity ) ) {
+		arena->stats.requested += size - blk->h.size;
+		blk->h.size = size;
+		return ptr;
+	}
+
+	if( !(newPtr = info_arena_alloc( arena, size )))
+		return NULL;
+	copy = ( size < capacity ) ? size : capacity;
+	memcpy( newPtr, ptr, copy );
+	info_arena_free( arena, ptr );
+	return newPtr;
+}
+
+void
+info_arena_get_stats( info_arena_t arena, info_arena_stats_t *st ) {
+	if( !arena || !st )
+		return;
+	*st = arena->stats;
+}
+
+/****************************************************************************
+ *                                 E O F
+ ***************************************************************************/
@@ -0,0 +1,95 @@
+/*============================================================================
+  gossimon - Gossip based resource usage monitoring for Linux clusters
+  Copyright 2003-2010 Amnon Barak
+
+  Distributed under the OSI-approved BSD License (the "License");
+  see accompanying file Copyright.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+============================================================================*/
+
+
+/******************************************************************************
+ *
+ * File: infoArena.h. Size class arena for the vector info records
+ *
+ *****************************************************************************/
+
+#ifndef __INFOD_INFO_ARENA__
+#define __INFOD_INFO_ARENA__
+
+/*
+  The info records of the vector (node_info_t + vlen data) change size as
+  the nodes send bigger or smaller payloads. Instead of a malloc/realloc per
+  record the arena keeps blocks in power of 2 size classes, carved from big
+  slabs. Freed blocks go back to a free list of their class and are reused
+  by the next record of that class. Records bigger than the largest class
+  are allocated directly.
+
+  A block can be pinned (info_arena_ref) while someone else reads it, e.g. a
+  message being sent straight from the records. The owner's free and resize
+  then leave the pinned copy alone, it is returned by the last unref.
+*/
+
+#define INFO_ARENA_MIN_SHIFT     (6)     // Smallest class 64 bytes
+#define INFO_ARENA_MAX_SHIFT     (15)    // Largest class 32K
+#define INFO_ARENA_CLASSES       (INFO_ARENA_MAX_SHIFT - INFO_ARENA_MIN_SHIFT + 1)
+#define INFO_ARENA_SLAB_SZ       (65536)
+
+typedef struct info_arena *info_arena_t;
+
+typedef struct info_arena_stats {
+	unsigned long    reserved;    // Bytes taken from the system
+	unsigned long    used;        // Bytes held by live blocks
+	unsigned long    requested;   // Bytes asked for by live blocks
+	unsigned int     liveBlocks;
+	unsigned int     slabs;
+	unsigned int     largeBlocks; // Blocks bigger than the largest class
+	unsigned long    reused;      // Allocations served from a free list
+} info_arena_stats_t;
+
+info_arena_t info_arena_create(void);
+void         info_arena_destroy(info_arena_t arena);
+
+/****************************************************************************
+ * Allocate a block of at least size bytes. Returns NULL on error.
+ ***************************************************************************/
+void        *info_arena_alloc(info_arena_t arena, int size);
+
+/****************************************************************************
+ * Return a block to the arena (drops the owner reference)
+ ***************************************************************************/
+void         info_arena_free(info_arena_t arena, void *ptr);
+
+/****************************************************************************
+ * Pin/unpin a block. A pinned block (and the arena) stay valid until the
+ * matching unref, even if the owner frees it or destroys the arena.
+ ***************************************************************************/
+void         info_arena_ref(info_arena_t arena, void *ptr);
+void         info_arena_unref(info_arena_t arena, void *ptr);
+int          info_arena_is_shared(void *ptr);
+
+/****************************************************************************
+ * Make ptr hold size bytes. The block is kept if it is big enough and at
+ * most one class too big (and not pinned), else a block of the right
+ * class is taken, the
+ * start of the old block (up to size bytes) is copied to it and the old one
+ * is returned to its free list. On error NULL is returned and ptr is still
+ * valid (as realloc).
+ ***************************************************************************/
+void        *info_arena_resize(info_arena_t arena, void *ptr, int size);
+
+/****************************************************************************
+ * Number of usable bytes in the block
+ ***************************************************************************/
+int          info_arena_block_size(void *ptr);
+
+void         info_arena_get_stats(info_arena_t arena, info_arena_stats_t *st);
+
+#endif /* __INFOD_INFO_ARENA__ */
+
+/****************************************************************************
+ *                                 E O F
+ ***************************************************************************/
@@ -47,6 +47,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <unistd.h>
 #include <ctype.h>
 #include <string.h>
@@ -61,6 +66,7 @@
 
 //#include <infod.h>
 #include <info.h>
+#include <info_reader.h>
 #include <msx_error.h>
 #include <msx_debug.h>
 
@@ -82,12 +88,38 @@ static int calcWinSizeUptoAge( ivec_t vec );
 static void infoVecDoWinSizeMeasure(ivec_t vec, int currWinSize);
 static void ivec_print_win( ivec_t vec );
 static void ivec_kill_entry(ivec_t vec, ivec_entry_t *entry, unsigned int cause);
+static void ivec_rumor_add( ivec_t vec, int index );
+static void ivec_snap_free_all( ivec_t vec );
+static void ivec_cols_update( ivec_t vec, int index );
+static int  ivec_update_entry_at( ivec_t vec, node_info_t* update, int size,
+				  unsigned int priority, unsigned int version,
+				  struct timeval *now, int index );
+static void ivec_cols_free( ivec_t vec );
+static int  ivec_stats_set_max_heaps( ivec_t vec, int maxMask );
 
 //static int
 //compare( const void* a, const void* b){
 //	return( *((node_t*)(a)) - *((node_t*)(b)));
 //}
 
+/*
+ * The clock of all the vectors, gettimeofday() unless set (simulations)
+ */
+static ivec_clock_func_t ivec_clock = NULL;
+
+void
+infoVecSetClock( ivec_clock_func_t func ) {
+	ivec_clock = func;
+}
+
+static inline void
+ivec_gettime( struct timeval *now ) {
+	if( ivec_clock )
+		ivec_clock( now );
+	else
+		gettimeofday( now, NULL );
+}
+
 static int
 compare_ips( const void* a, const void* b){
 	struct in_addr *A, *B;
@@ -108,6 +140,12 @@ compute_age( struct timeval *time, struct timeval *cur ) {
 	return (a * MILLI) + b;
 }
 
+/* The expiry wheel tick of a time */
+static inline twheel_tick_t
+ivec_expire_tick( struct timeval *time ) {
+	return ( (twheel_tick_t)time->tv_sec * MILLI + time->tv_usec ) / EXPIRE_TICK;
+}
+
 void network_order(struct in_addr *ip) {
 	ip->s_addr = htonl(ip->s_addr);
 }
@@ -183,9 +221,10 @@ ivec_age2time( node_info_t *node, struct timeval *cur ) {
  * Init a single vector entry
  ***************************************************************************/
 static int
-ivec_init_entry( ivec_entry_t *entry, node_t pe, char *name, struct in_addr *ip )
+ivec_init_entry( ivec_t vec, ivec_entry_t *entry, node_t pe, char *name,
+		 struct in_addr *ip )
 {
-	if( !( entry->info = (node_info_t*) malloc( NHDR_SZ ))) {
+	if( !( entry->info = (node_info_t*) info_arena_alloc( vec->arena, NHDR_SZ ))) {
 		debug_lr( VEC_DEBUG, "Error: malloc, vec entry \n" );
 		return 0;
 	}
@@ -204,7 +243,7 @@ ivec_init_entry( ivec_entry_t *entry, node_t pe, char *name, struct in_addr *ip
         entry->info->hdr.external_status = EXTERNAL_STAT_NO_INFO;
         
 	//memcpy( entry->info->hdr.ip, ip, COMM_IP_VER );
-	gettimeofday (&(entry->info->hdr.time), NULL);
+	ivec_gettime( &(entry->info->hdr.time) );
 
 	return 1;
 }
@@ -299,7 +338,7 @@ infoVecInitEntries( ivec_t vec, mapper_t map) {
                 }
 
 		debug_ly( VEC_DEBUG, "Got name %s\n", name);
-		if(!ivec_init_entry( &(vec->vec[i]), PE, name, &ipaddr_norder ))
+		if(!ivec_init_entry( vec, &(vec->vec[i]), PE, name, &ipaddr_norder ))
                         goto exit_with_free;
 
 		//if( [i] == vec->local_pe )
@@ -368,6 +407,59 @@ infoVecInitContIps( ivec_t vec ) {
 	return 1;
 }
 
+/****************************************************************************
+ * The IP index hash function. Fibonacci hashing takes the high bits of the
+ * product so consecutive addresses are spread over the whole table.
+ ***************************************************************************/
+static inline unsigned int
+ip_hash_slot( ip_hash_t *hash, unsigned int ip_horder ) {
+	return (unsigned int)((ip_horder * 2654435761U) >> (32 - hash->bits));
+}
+
+/****************************************************************************
+ * Init the IP index. Must be called after the entries are set
+ ***************************************************************************/
+static int
+infoVecInitIPHash( ivec_t vec ) {
+
+	ip_hash_t *hash = &vec->ipHash;
+	int i;
+	
+	// Keeping the load factor at most 1/2 so probe sequences stay short
+	hash->bits = 1;
+	while( (1U << hash->bits) < (unsigned int)(2 * vec->vsize) )
+		hash->bits++;
+	hash->size = 1U << hash->bits;
+	
+	if( !(hash->data = (ip_hash_ent_t*) malloc( hash->size * IP_HASH_ENTRY_SIZE ))) {
+		debug_lr( VEC_DEBUG, "Error: malloc, ip hash\n" );
+		return 0;
+	}
+	for( i = 0 ; i < (int)hash->size ; i++ ) {
+		hash->data[i].ip    = 0;
+		hash->data[i].index = -1;
+	}
+
+	for( i = 0 ; i < vec->vsize ; i++ ) {
+		struct in_addr ip = vec->vec[i].info->hdr.IP;
+		unsigned int   slot;
+		
+		host_order(&ip);
+		slot = ip_hash_slot( hash, ip.s_addr );
+		while( hash->data[slot].index != -1 ) {
+			if( hash->data[slot].ip == ip.s_addr ) {
+				debug_lr( VEC_DEBUG, "Error: duplicate ip %s in vector\n",
+					  inet_host_ntoa(ip));
+				return 0;
+			}
+			slot = (slot + 1) & (hash->size - 1);
+		}
+		hash->data[slot].ip    = ip.s_addr;
+		hash->data[slot].index = i;
+	}
+	return 1;
+}
+
 /****************************************************************************
  * Init the window. Note that the actual window size is win_size - 1, since
  * we always save an entry to the local node.
@@ -406,16 +498,113 @@ static int infoVecInitWin( ivec_t vec, int winType, int winTypeParam )
 	for(int i=0 ; i < vec->win.size ; i++)
 		vec->win.data[i].index = -1;
 	
-	if( !(vec->win.aux = (int*) malloc( vec->win.size * sizeof(int)))){
+	if( !(vec->win.aux = (iheap_node_t*) malloc( vec->win.size * sizeof(iheap_node_t)))){
 		debug_lr( VEC_DEBUG, "Error: malloc, win aux\n" );
 		return 0;
 	}
-	bzero( vec->win.aux, vec->win.size * sizeof(int));
 
+	if( !iheap_init( &vec->win.heap, WIN_HEAP_ARITY, vec->win.size, vec->vsize )) {
+		debug_lr( VEC_DEBUG, "Error: init, win heap\n" );
+		return 0;
+	}
 	return 1;
 }
 	
 
+/****************************************************************************
+ * Move the window to a bigger heap, keeping its entries
+ ***************************************************************************/
+static int
+ivec_win_grow( ivec_t vec, int size ) {
+
+	info_win_entry_t  *data = NULL;
+	iheap_node_t      *aux  = NULL;
+	iheap_t            heap;
+	int                i, n;
+
+	if( !(data = (info_win_entry_t*) malloc( size * INFO_WIN_ENTRY_SIZE )) ||
+	    !(aux = (iheap_node_t*) malloc( size * sizeof(iheap_node_t))) ||
+	    !iheap_init( &heap, WIN_HEAP_ARITY, size, vec->vsize )) {
+		debug_lr( VEC_DEBUG, "Error: malloc, growing win\n" );
+		free( data );
+		free( aux );
+		return 0;
+	}
+	bzero( data, size * INFO_WIN_ENTRY_SIZE );
+	for( i = 0 ; i < size ; i++ )
+		data[i].index = -1;
+	
+	n = iheap_sorted_desc( &vec->win.heap, vec->win.aux );
+	for( i = 0 ; i < n ; i++ )
+		iheap_insert( &heap, vec->win.aux[i].id, vec->win.aux[i].key,
+			      vec->win.aux[i].subkey );
+
+	free( vec->win.data );
+	free( vec->win.aux );
+	iheap_free( &vec->win.heap );
+	vec->win.data = data;
+	vec->win.aux  = aux;
+	vec->win.heap = heap;
+	vec->win.size = size;
+	return 1;
+}
+
+/****************************************************************************
+ * Change the window parameter (as given to infoVecInit) of the current
+ * window type. A fixed window which grows beyond the room it was given
+ * is moved to a bigger heap, it never shrinks so going back is cheap.
+ ***************************************************************************/
+int
+infoVecSetWinParam( ivec_t vec, int winTypeParam ) {
+
+	if( !vec || winTypeParam < 1 ) {
+		debug_lr( VEC_DEBUG, "Error: args, infoVecSetWinParam\n" );
+		return 0;
+	}
+	if( vec->win.type == INFOVEC_WIN_FIXED ) {
+		if( 2 * winTypeParam - 1 > vec->win.size &&
+		    !ivec_win_grow( vec, 2 * winTypeParam - 1 ))
+			return 0;
+		vec->win.fixWinSize = winTypeParam - 1;
+	}
+	else
+		vec->win.uptoAge = winTypeParam * 1000;
+	return 1;
+}
+
+int
+infoVecGetWinParam( ivec_t vec ) {
+
+	if( !vec )
+		return -1;
+	if( vec->win.type == INFOVEC_WIN_FIXED )
+		return vec->win.fixWinSize + 1;
+	return vec->win.uptoAge / 1000;
+}
+
+/****************************************************************************
+ * Mark the entries which are in the mapper cluster of the local node
+ ***************************************************************************/
+static int
+infoVecInitCluster( ivec_t vec, mapper_t map ) {
+
+	int localId, id;
+
+	if( !(vec->inCluster = (unsigned char*) calloc( vec->vsize, 1 ))) {
+		debug_lr( VEC_DEBUG, "Error: malloc, cluster\n" );
+		return 0;
+	}
+	if( !mapper_node2cluster_id( map, vec->vec[ vec->localIndex ].info->hdr.pe,
+				     &localId ))
+		return 0;
+	for( int i = 0 ; i < vec->vsize ; i++ )
+		if( mapper_node2cluster_id( map, vec->vec[ i ].info->hdr.pe, &id ) &&
+		    id == localId )
+			vec->inCluster[ i ] = 1;
+	vec->numAliveClusterPeers = 0;
+	return 1;
+}
+
 /****************************************************************************
  * Compute the signature from the description
  ***************************************************************************/
@@ -451,6 +640,7 @@ infoVecInit( mapper_t map,
 {
 	ivec_t   vec = NULL;
 	int      node_num = 0;
+	struct timeval now;
 
         mlog_registerModule("vec", "Information Vector Management", "vec");
 
@@ -479,6 +669,63 @@ infoVecInit( mapper_t map,
 	}
 	bzero( vec->vec, vec->vsize * VENTRY_SZ );
 
+	/* The entries versions for delta windows */
+	if( !(vec->delta = (ivec_delta_t*) malloc( vec->vsize * sizeof(ivec_delta_t) ))) {
+		debug_lr( VEC_DEBUG, "Error: malloc, info vector versions\n" );
+		goto exit_with_free;
+	}
+	bzero( vec->delta, vec->vsize * sizeof(ivec_delta_t) );
+
+	/* The alive entries, for selecting random peers */
+	if( !(vec->alivePeers = (int*) malloc( vec->vsize * sizeof(int) )) ||
+	    !(vec->alivePos = (int*) malloc( vec->vsize * sizeof(int) ))) {
+		debug_lr( VEC_DEBUG, "Error: malloc, alive entries\n" );
+		goto exit_with_free;
+	}
+	memset( vec->alivePos, -1, vec->vsize * sizeof(int) );
+	vec->numAlivePeers = 0;
+	if( !iheap_init( &vec->oldest, WIN_HEAP_ARITY, vec->vsize, vec->vsize )) {
+		debug_lr( VEC_DEBUG, "Error: oldest entries heap\n" );
+		goto exit_with_free;
+	}
+	if( !(vec->stats.ent = (ivec_ent_stats_t*)
+	      malloc( vec->vsize * sizeof(ivec_ent_stats_t) ))) {
+		debug_lr( VEC_DEBUG, "Error: malloc, entries statistics\n" );
+		goto exit_with_free;
+	}
+	bzero( vec->stats.ent, vec->vsize * sizeof(ivec_ent_stats_t) );
+	vec->stats.width = IVEC_AGE_MIN_WIDTH * 10;
+
+	/* Updates of a remote window, applied together */
+	if( !(vec->batch = (ivec_update_t*)
+	      malloc( vec->vsize * sizeof(ivec_update_t) ))) {
+		debug_lr( VEC_DEBUG, "Error: malloc, update batch\n" );
+		goto exit_with_free;
+	}
+
+	/* The digest pull message and the ages of a peer digest */
+	if( !(vec->digest = (info_pull_msg_t*)
+	      malloc( INFO_PULL_MSG_SZ + vec->vsize * INFO_DIGEST_ENT_SZ )) ||
+	    !(vec->digestAge = (unsigned int*)
+	      malloc( vec->vsize * sizeof(unsigned int) ))) {
+		debug_lr( VEC_DEBUG, "Error: malloc, digest\n" );
+		goto exit_with_free;
+	}
+
+	/* The expiry timers of the alive entries */
+	ivec_gettime( &now ) ;
+	if( !twheel_init( &vec->expireWheel, vec->vsize,
+			  ivec_expire_tick( &now ))) {
+		debug_lr( VEC_DEBUG, "Error: expiry wheel\n" );
+		goto exit_with_free;
+	}
+
+	/* The arena which holds the info records of the entries */
+	if( !(vec->arena = info_arena_create())) {
+		debug_lr( VEC_DEBUG, "Error: info arena\n" );
+		goto exit_with_free;
+	}
+
 	/* Init all the vector entries */
 	if( !(vec->contIPs.size = infoVecInitEntries( vec, map))) {
 		debug_lr(VEC_DEBUG, "Error in infoVecInitEntries\n");
@@ -487,18 +734,23 @@ infoVecInit( mapper_t map,
 	/* Init the continous mapping */
 	if( !( infoVecInitContIps( vec )))
 		goto exit_with_free;
+
+	/* Init the IP index */
+	if( !( infoVecInitIPHash( vec )))
+		goto exit_with_free;
 	
 	/* Init the window */
 	if( !( infoVecInitWin( vec, winType, winTypeParam )))
 		goto exit_with_free;
 	
 	vec->max_age = max_age; 
-	gettimeofday( &vec->init_time, NULL ) ;
+	ivec_gettime( &vec->init_time ) ;
 
 	vec->prev_time = vec->init_time;
 	
 	bzero(&vec->lastDeadIP, sizeof(struct in_addr));
 	vec->numAlive    = 0;
+	vec->numRumors   = 0;
 
 	vec->localPrio = 0;
 	// This is based on the assumption that an important message will
@@ -517,6 +769,10 @@ infoVecInit( mapper_t map,
 		debug_lr(VEC_DEBUG, "Error map contain my ip but vector dont\n");
 		goto exit_with_free;
 	}
+	/* The entries in the cluster of the local node */
+	if( !infoVecInitCluster( vec, map ))
+		goto exit_with_free;
+	
 	/* Compute the signature */
 	infoVecComputeSignature( vec, description );
 	
@@ -542,10 +798,10 @@ infoVecInit( mapper_t map,
  * Free a single vector entry
  ***************************************************************************/
 static void
-infoVecFreeEntry( ivec_entry_t *entry ) {
+infoVecFreeEntry( ivec_t vec, ivec_entry_t *entry ) {
 	if( !entry )
 		return;
-	free( entry->info ) ;
+	info_arena_free( vec->arena, entry->info ) ;
 }
 
 /****************************************************************************
@@ -560,17 +816,46 @@ infoVecFree( ivec_t vec ) {
 	if( vec->contIPs.data )
 		free( vec->contIPs.data );
 	
+	if( vec->ipHash.data )
+		free( vec->ipHash.data );
+	
 	if( vec->vec ) {
 		int i = 0;
 		for( i = 0; i < vec->vsize ; i++ )
-			infoVecFreeEntry( &(vec->vec[i]));
+			infoVecFreeEntry( vec, &(vec->vec[i]));
                 free(vec->vec);
         }
+        ivec_snap_free_all(vec);
+        ivec_cols_free(vec);
+        info_arena_destroy(vec->arena);
+
+        if(vec->delta)
+                free(vec->delta);
+        if(vec->alivePeers)
+                free(vec->alivePeers);
+        if(vec->alivePos)
+                free(vec->alivePos);
+        if(vec->inCluster)
+                free(vec->inCluster);
+        if(vec->deltaBuff)
+                free(vec->deltaBuff);
 
         if(vec->win.data) {
                 free(vec->win.data);
                 free(vec->win.aux);
         }
+        iheap_free(&vec->win.heap);
+        twheel_free(&vec->expireWheel);
+        iheap_free(&vec->oldest);
+        ivec_stats_set_max_heaps(vec, 0);
+        if(vec->stats.ent)
+                free(vec->stats.ent);
+        if(vec->batch)
+                free(vec->batch);
+        if(vec->digest)
+                free(vec->digest);
+        if(vec->digestAge)
+                free(vec->digestAge);
         
 	if( vec->msg_buff_size )
 		free( vec->msg_buff );
@@ -579,41 +864,26 @@ infoVecFree( ivec_t vec ) {
 }
 
 /****************************************************************************
- * Find a node in the vector
+ * Find a node in the vector. Uses the IP index so the cost does not depend
+ * on the number of continuous parts in the map.
  ***************************************************************************/
 ivec_entry_t*
 infoVecFindByIP( ivec_t vec, struct in_addr *ip, int *index ) {
 
-	int i = 0;
-	static int last_ind = 0;
-	ivec_entry_t *entry = NULL;
+	ip_hash_t     *hash = &vec->ipHash;
+	unsigned int   slot;
 	struct in_addr ip_horder;
 	
 	ip_horder = *ip;
 	host_order(&ip_horder);
 	
-	/* maybe the requests are serial */
-	if( last_ind < (vec->vsize - 1)) {
-		
-		entry = &(vec->vec[last_ind+1]);
-		if( ip_horder.s_addr == entry->info->hdr.IP.s_addr ) {
-			last_ind++;
-			*index = last_ind;
-			return entry;
-		}
-	}
-    
-	for( i = 0 ; i < vec->contIPs.size ; i++ ) {
-		if( ( ip_horder.s_addr >= vec->contIPs.data[i].ip.s_addr ) &&
-		    ( ip_horder.s_addr <= ( vec->contIPs.data[i].ip.s_addr +
-			      vec->contIPs.data[i].size - 1 ))) {
-			int pos = vec->contIPs.data[i].index +
-				(ip_horder.s_addr - vec->contIPs.data[i].ip.s_addr ) ;
-			last_ind = pos;
-			entry = &(vec->vec[pos]);
-			*index = pos;
-			return entry;
+	slot = ip_hash_slot( hash, ip_horder.s_addr );
+	while( hash->data[slot].index != -1 ) {
+		if( hash->data[slot].ip == ip_horder.s_addr ) {
+			*index = hash->data[slot].index;
+			return &(vec->vec[*index]);
 		}
+		slot = (slot + 1) & (hash->size - 1);
 	}
 
 	*index = -1;
@@ -621,34 +891,14 @@ infoVecFindByIP( ivec_t vec, struct in_addr *ip, int *index ) {
 }
 
 /****************************************************************************
- * Compares the priority of two entries in the vector used for sorting the
- * win entries. Assumes that the time field of each entry is the age and
- * not the time.
- * Returns -1 if the first entry should come before the second
- *          0 if entries equals
-            1 if second entry should come before the first 
- * window.
+ * The secondary window key. Among entries with the same priority the newer
+ * information comes first
  ***************************************************************************/
-static int
-ivec_win_cmp( ivec_t vec, info_win_entry_t *firstWinEnt, info_win_entry_t *secondWinEnt )
+static inline unsigned long long
+ivec_win_time_key( ivec_t vec, int index )
 {
-	if( firstWinEnt->priority > secondWinEnt->priority )
-		return -1;
-	if( firstWinEnt->priority < secondWinEnt->priority )
-		return 1;
-	
-	if( firstWinEnt->priority == secondWinEnt->priority )
-	{
-		ivec_entry_t *firstVecEnt  = &(vec->vec[ firstWinEnt->index ]);
-		ivec_entry_t *secondVecEnt = &(vec->vec[ secondWinEnt->index ]);
-		
-		if( timercmp( &(firstVecEnt->info->hdr.time),
-			      &(secondVecEnt->info->hdr.time), > ))
-			return -1;
-		else
-			return 1;
-	}
-	return 0;
+	struct timeval *t = &(vec->vec[ index ].info->hdr.time);
+	return (unsigned long long)t->tv_sec * MILLI + t->tv_usec;
 }
 
 /****************************************************************************
@@ -659,66 +909,398 @@ ivec_win_cmp( ivec_t vec, info_win_entry_t *firstWinEnt, info_win_entry_t *secon
 static int
 ivec_update_win( ivec_t vec, info_win_entry_t *entry ) {
 	
-	int i = 0, j = 0;
-
+	iheap_t            *heap = &vec->win.heap;
+	iheap_node_t       *node = NULL;
+	unsigned long long  timeKey;
+	
 	/* The local infod is not part of the window. */
 	if( vec->localIndex == entry->index)
 		return 0;
-	// Checking if the entry is already part of the window
-	for( i = 0 ; i < vec->win.size ; i++ ) {
-		// We reached an empty place 
-		if(vec->win.data[ i ].index == -1)
-			break;
-		if(vec->win.data[ i ].index == entry->index)
-			break;
-	}
-	// If the entry is not part of the window taking the place of the last
-	if( i == vec->win.size )
-		i = vec->win.size - 1;
 
+	timeKey = ivec_win_time_key( vec, entry->index );
+	
 	/*
-	 * In any case, test that the new entry has higher priority.
-	 * If it was not found in the window, compare it to the
-	 * window entry with the lowest priority. If it was found in the
-	 * window, check that the window priority is not bigger than the
-	 * update priority.
+	 * If the entry is already part of the window it only moves according
+	 * to its new time. A high priority it already has is kept so it can
+	 * decay properly (one step for each window sent)
 	 */
-	if(vec->win.data[ i ].index != -1)
-	{
-		if( (ivec_win_cmp( vec, &(vec->win.data[ i ]), entry )) != 1 )
+	if( (node = iheap_get( heap, entry->index ))) {
+		if( node->key > 0 )
+			entry->priority = node->key;
+		return iheap_update( heap, entry->index, entry->priority, timeKey );
+	}
+	
+	/*
+	 * If the window is full the new entry must have a higher priority than
+	 * the lowest priority window entry, which it then replaces.
+	 */
+	if( iheap_is_full( heap )) {
+		node = iheap_get_min( heap );
+		if( node->key > (heap_key_t)entry->priority ||
+		    ( node->key == (heap_key_t)entry->priority && node->subkey > timeKey ))
 			return 0;
+		iheap_extract_min( heap, NULL );
 	}
-	// The following is for alowing the high priority to decay properly
-	if(vec->win.data[i].index == entry->index)
-	{
-		if(vec->win.data[i].priority > 0)
-			entry->priority = vec->win.data[i].priority;
+	return iheap_insert( heap, entry->index, entry->priority, timeKey );
+}
+
+/****************************************************************************
+ * Rebuild the window snapshot (win.data) in priority order from the heap
+ ***************************************************************************/
+static void
+ivec_win_sort( ivec_t vec ) {
+
+	int i, n;
+
+	n = iheap_sorted_desc( &vec->win.heap, vec->win.aux );
+	for( i = 0 ; i < n ; i++ ) {
+		vec->win.data[ i ].index    = vec->win.aux[ i ].id;
+		vec->win.data[ i ].priority = vec->win.aux[ i ].key;
+	}
+	if( n < vec->win.size )
+		vec->win.data[ n ].index = -1;
+}
+
+/****************************************************************************
+ * Decrease the priority of the i'th entry of the window snapshot by one, as
+ * part of the priority decay of sent entries
+ ***************************************************************************/
+static void
+ivec_win_decay( ivec_t vec, int i ) {
+
+	info_win_entry_t *entry = &(vec->win.data[ i ]);
+	iheap_node_t     *node;
+
+	if( entry->priority <= 0 )
+		return;
+	entry->priority--;
+	if( (node = iheap_get( &vec->win.heap, entry->index )))
+		iheap_update( &vec->win.heap, entry->index,
+			      entry->priority, node->subkey );
+}
+
+/****************************************************************************
+ * Delta windows helpers. The data of a record (after the header) is cut to
+ * at most IVEC_DELTA_CHUNKS chunks, the chunk size depends only on the data
+ * size so both sides agree on it.
+ ***************************************************************************/
+static int
+ivec_delta_chunk( int dataSize ) {
+
+	int chunk = ( dataSize + IVEC_DELTA_CHUNKS - 1 ) / IVEC_DELTA_CHUNKS;
+
+	chunk = ( chunk + 7 ) & ~7;
+	return ( chunk < IVEC_DELTA_MIN_CHUNK ) ? IVEC_DELTA_MIN_CHUNK : chunk;
+}
+
+/* The chunks which differ between two data areas of the same size */
+static unsigned long long
+ivec_delta_diff( char *old, char *new, int dataSize ) {
+
+	unsigned long long mask = 0;
+	int                chunk = ivec_delta_chunk( dataSize );
+	int                c, off;
+
+	for( c = 0, off = 0 ; off < dataSize ; c++, off += chunk ) {
+		int len = ( dataSize - off < chunk ) ? dataSize - off : chunk;
+		if( memcmp( old + off, new + off, len ) != 0 )
+			mask |= 1ULL << c;
+	}
+	return mask;
+}
+
+/* Forget the history, the entry is at version (0 if not known) */
+static void
+ivec_delta_reset( ivec_delta_t *d, unsigned int version ) {
+	d->version  = version;
+	d->histFrom = version;
+	d->histLen  = 0;
+}
+
+/* The entry moved to version, changing the chunks in mask */
+static void
+ivec_delta_push( ivec_delta_t *d, unsigned int version,
+		 unsigned long long mask ) {
+
+	if( d->histLen == IVEC_DELTA_HIST ) {
+		d->histFrom = d->histVer[ 0 ];
+		memmove( d->histVer, d->histVer + 1,
+			 ( IVEC_DELTA_HIST - 1 ) * sizeof(unsigned int));
+		memmove( d->histMask, d->histMask + 1,
+			 ( IVEC_DELTA_HIST - 1 ) * sizeof(unsigned long long));
+		d->histLen--;
+	}
+	d->histVer[ d->histLen ]  = version;
+	d->histMask[ d->histLen ] = mask;
+	d->histLen++;
+	d->version = version;
+}
+
+/****************************************************************************
+ * Make sure the entry's record is not pinned by a window being sent (or a
+ * snapshot) before its data is changed in place. A pinned record is left
+ * to the reader and the entry gets its own copy.
+ ***************************************************************************/
+static int
+ivec_own_entry( ivec_t vec, ivec_entry_t *entry ) {
+
+	node_info_t *info;
+
+	if( !info_arena_is_shared( entry->info ))
+		return 1;
+
+	if( !( info = info_arena_alloc( vec->arena, entry->info->hdr.fsize ))) {
+		debug_lr( VEC_DEBUG, "Error: info arena alloc\n" );
+		return 0;
 	}
-	vec->win.data[ i ] = *entry;
+	memcpy( info, entry->info, entry->info->hdr.fsize );
+	info_arena_free( vec->arena, entry->info );
+	entry->info = info;
+	return 1;
+}
+
+/****************************************************************************
+ * Running statistics of the alive entries
+ ***************************************************************************/
+static inline long long
+ivec_time_usec( struct timeval *t ) {
+	return (long long)t->tv_sec * MILLI + t->tv_usec;
+}
+
+/* Fold the buckets older than newBase into it */
+static void
+ivec_hist_advance( ivec_stats_t *st, long long newBase ) {
+	int       *h = st->hist;
+	int        fold = 0;
+	long long  b;
 	
-	// Perform parital sort to float the new window entry to its right place
-	// Since the priority must be bigger we float to the start. The only
-	for( j = i-1 ; j >= 0 ; j-- ) {
-		if( ( ivec_win_cmp( vec, &(vec->win.data[ j ]),
-				    &(vec->win.data[ j + 1]) )) == 1 ) {
-		
-			info_win_entry_t  tmp = vec->win.data[ j ];
-			vec->win.data[ j ] = vec->win.data[ j + 1 ];
-			vec->win.data[ j + 1 ] = tmp;
+	if( newBase - st->base >= IVEC_AGE_BUCKETS ) {
+		for( b = 0 ; b < IVEC_AGE_BUCKETS ; b++ )
+			fold += h[ b ];
+		bzero( h, sizeof(st->hist) );
+	}
+	else {
+		for( b = st->base ; b < newBase ; b++ ) {
+			fold += h[ b % IVEC_AGE_BUCKETS ];
+			h[ b % IVEC_AGE_BUCKETS ] = 0;
 		}
-		else
+	}
+	h[ newBase % IVEC_AGE_BUCKETS ] += fold;
+	st->base = newBase;
+}
+
+static void
+ivec_hist_add( ivec_stats_t *st, long long time ) {
+	long long b = time / st->width;
+
+	// The first time sets the window, the newest time moves it
+	if( st->num == 0 ) {
+		bzero( st->hist, sizeof(st->hist) );
+		st->base = b - IVEC_AGE_BUCKETS + 1;
+	}
+	else if( b >= st->base + IVEC_AGE_BUCKETS )
+		ivec_hist_advance( st, b - IVEC_AGE_BUCKETS + 1 );
+
+	if( b < st->base )
+		b = st->base;
+	st->hist[ b % IVEC_AGE_BUCKETS ]++;
+}
+
+static void
+ivec_hist_remove( ivec_stats_t *st, long long time ) {
+	long long b = time / st->width;
+
+	if( b < st->base )
+		b = st->base;
+	st->hist[ b % IVEC_AGE_BUCKETS ]--;
+}
+
+/*
+ * The heap key of a value, the largest value having the smallest key. The
+ * bits of a double are made to compare as unsigned numbers first.
+ */
+static unsigned long long
+ivec_max_key( double val ) {
+	unsigned long long bits;
+
+	memcpy( &bits, &val, sizeof(bits) );
+	bits = ( bits >> 63 ) ? ~bits : ( bits | ( 1ULL << 63 ));
+	return ~bits;
+}
+
+static void
+ivec_stats_add( ivec_t vec, int index ) {
+	ivec_stats_t     *st = &vec->stats;
+	ivec_ent_stats_t *e  = &st->ent[ index ];
+	node_info_t      *info = vec->vec[ index ].info;
+	int               v;
+
+	if( e->counted )
+		return;
+	e->counted = 1;
+	e->time = ivec_time_usec( &info->hdr.time );
+	ivec_hist_add( st, e->time );
+	st->num++;
+	st->timeSum += e->time - ivec_time_usec( &vec->init_time );
+
+	if( !st->sumFunc )
+		return;
+	bzero( e->vals, sizeof(e->vals) );
+	st->sumFunc( info, e->vals );
+	for( v = 0 ; v < st->numVals ; v++ ) {
+		st->sums[ v ] += e->vals[ v ];
+		if( st->maxMask & ( 1 << v ))
+			iheap_insert( &st->maxHeap[ v ], index, 0,
+				      ivec_max_key( e->vals[ v ] ));
+	}
+}
+
+static void
+ivec_stats_remove( ivec_t vec, int index ) {
+	ivec_stats_t     *st = &vec->stats;
+	ivec_ent_stats_t *e  = &st->ent[ index ];
+	int               v;
+
+	if( !e->counted )
+		return;
+	e->counted = 0;
+	ivec_hist_remove( st, e->time );
+	st->num--;
+	st->timeSum -= e->time - ivec_time_usec( &vec->init_time );
+	
+	for( v = 0 ; v < st->numVals ; v++ ) {
+		st->sums[ v ] -= e->vals[ v ];
+		if( st->maxMask & ( 1 << v ))
+			iheap_delete( &st->maxHeap[ v ], index );
+	}
+}
+
+/* Count all the alive entries again (new bucket width or sum function) */
+static void
+ivec_stats_rebuild( ivec_t vec ) {
+	ivec_stats_t *st = &vec->stats;
+	int           i, v;
+
+	for( i = 0 ; i < vec->vsize ; i++ )
+		st->ent[ i ].counted = 0;
+	st->num = 0;
+	st->timeSum = 0;
+	bzero( st->sums, sizeof(st->sums) );
+	for( v = 0 ; v < IVEC_SUM_VALS ; v++ )
+		if( st->maxMask & ( 1 << v ))
+			iheap_reset( &st->maxHeap[ v ] );
+	st->rebuilds++;
+	for( i = 0 ; i < vec->vsize ; i++ )
+		if( vec->vec[ i ].isdead == 0 )
+			ivec_stats_add( vec, i );
+}
+
+/* The age (in seconds) at quantile q, from the newest bucket down */
+static double
+ivec_hist_age( ivec_t vec, struct timeval *cur, double q ) {
+	ivec_stats_t *st = &vec->stats;
+	long long     b, top = st->base + IVEC_AGE_BUCKETS - 1;
+	int           need, seen = 0;
+	double        age;
+
+	if( st->num == 0 )
+		return 0.0;
+	need = (int)ceil( q * st->num );
+	if( need < 1 )
+		need = 1;
+	
+	for( b = top ; b > st->base ; b-- ) {
+		seen += st->hist[ b % IVEC_AGE_BUCKETS ];
+		if( seen >= need )
 			break;
 	}
-	return 1;
+	// The middle of the bucket
+	age = (double)( ivec_time_usec( cur ) - b * st->width - st->width / 2 );
+	return ( age > 0 ) ? age / (double)MILLI : 0.0;
+}
+
+/* Fit the bucket width to the ages, at most a rebuild per call */
+static void
+ivec_hist_fit( ivec_t vec, struct timeval *cur ) {
+	ivec_stats_t *st = &vec->stats;
+	double        p95;
+
+	if( st->num == 0 )
+		return;
+	
+	// More than 5% older than the window
+	if( st->hist[ st->base % IVEC_AGE_BUCKETS ] * 20 > st->num ) {
+		st->width *= 2;
+		ivec_stats_rebuild( vec );
+		return;
+	}
+	// All the ages fit in an 1/8 of the window
+	p95 = ivec_hist_age( vec, cur, 0.95 ) * MILLI;
+	if( st->width > IVEC_AGE_MIN_WIDTH &&
+	    p95 < (double)st->width * IVEC_AGE_BUCKETS / 8 ) {
+		st->width /= 2;
+		ivec_stats_rebuild( vec );
+	}
 }
 
 /****************************************************************************
- *
+ * The alive peers array. Entries are added when they come alive and removed
+ * (by moving the last one to their place) when they die, so a random alive
+ * peer is a single lookup. The local entry is never in it. The same peers
+ * are kept in a heap by the time of their information, oldest first.
  ***************************************************************************/
 static void
-ivec_reset_entry( ivec_entry_t *entry, struct timeval *curTime ) {
+ivec_alive_add( ivec_t vec, int index ) {
+	if( index == vec->localIndex || vec->alivePos[ index ] != -1 )
+		return;
+	vec->alivePos[ index ] = vec->numAlivePeers;
+	vec->alivePeers[ vec->numAlivePeers++ ] = index;
+	vec->numAliveClusterPeers += vec->inCluster[ index ];
+}
+
+static void
+ivec_alive_remove( ivec_t vec, int index ) {
+	int pos = vec->alivePos[ index ];
+	int last;
+	
+	iheap_delete( &vec->oldest, index );
+	if( pos == -1 )
+		return;
+	last = vec->alivePeers[ --vec->numAlivePeers ];
+	vec->alivePeers[ pos ] = last;
+	vec->alivePos[ last ] = pos;
+	vec->alivePos[ index ] = -1;
+	vec->numAliveClusterPeers -= vec->inCluster[ index ];
+}
+
+/* Keep the alive peer in the oldest heap at the time of its information */
+static void
+ivec_alive_touch( ivec_t vec, int index ) {
+	struct timeval *t = &(vec->vec[ index ].info->hdr.time);
+	
+	if( vec->alivePos[ index ] == -1 )
+		return;
+	if( !iheap_update( &vec->oldest, index, t->tv_sec, t->tv_usec ))
+		iheap_insert( &vec->oldest, index, t->tv_sec, t->tv_usec );
+}
 
-	unsigned int del_size = entry->info->hdr.fsize - NHDR_SZ;
+/****************************************************************************
+ *
+ ***************************************************************************/
+static void
+ivec_reset_entry( ivec_t vec, ivec_entry_t *entry, struct timeval *curTime ) {
+
+	unsigned int del_size = 0;
+
+	// A pinned record keeps its data, it is still being sent or read
+	if( ivec_own_entry( vec, entry ))
+		del_size = entry->info->hdr.fsize - NHDR_SZ;
+	// The data is gone, deltas can not be applied to it
+	ivec_delta_reset( &vec->delta[ entry - vec->vec ], 0 );
+	twheel_cancel( &vec->expireWheel, entry - vec->vec );
+	ivec_alive_remove( vec, entry - vec->vec );
+	ivec_stats_remove( vec, entry - vec->vec );
+	vec->generation++;
 			
 	entry->isdead            = 1;
 	entry->info->hdr.status  = INFOD_DEAD_VEC_RESET;
@@ -729,6 +1311,7 @@ ivec_reset_entry( ivec_entry_t *entry, struct timeval *curTime ) {
 	/* empty all the fields */
 	if( del_size != 0 )
 		bzero( entry->info->data, del_size );
+	ivec_cols_update( vec, entry - vec->vec );
 }
 
 /****************************************************************************
@@ -742,56 +1325,83 @@ ivec_reset( ivec_t vec ) {
 	struct timeval  currTime;
 	
 	/* Reset all the vector entries */
-	gettimeofday( &currTime, NULL );
+	ivec_gettime( &currTime );
 	for( i = 0; i < vec->vsize; i++ )
-		ivec_reset_entry( &( vec->vec[ i ]), &currTime );
+		ivec_reset_entry( vec, &( vec->vec[ i ]), &currTime );
 	
-	vec->numAlive = 0;
+	vec->numAlive  = 0;
+	vec->numRumors = 0;
+	twheel_reset( &vec->expireWheel, ivec_expire_tick( &currTime ));
+	iheap_reset( &vec->oldest );
 	
 	/* Reset all the window entries */
-	bzero( vec->win.data, vec->win.size * INFO_WIN_ENTRY_SIZE );
-	bzero( vec->win.aux, vec->win.size * sizeof(int));
+	iheap_reset( &vec->win.heap );
+	vec->win.data[ 0 ].index = -1;
 }
 
 /****************************************************************************
- * Update a single vector entry
+ * Take the current time for updates. Test that the time is moving forwared.
+ * If local time was updated it might move backword (it did happend once),
+ * the vector is then reset and 0 returned.
  ***************************************************************************/
-int
-infoVecUpdate( ivec_t vec, node_info_t* update, int size,
-	       unsigned int priority  )
+static int
+ivec_update_time( ivec_t vec, struct timeval *curr_time ) {
+
+	ivec_gettime( curr_time );
+
+	if( timercmp( curr_time, &(vec->prev_time), < )) {
+		debug_lr( WIN_DEBUG, "Problem with time: got time in the past"
+			  " Curr ( %u, %u), Prev( %u, %u )\n",
+			  curr_time->tv_sec, curr_time->tv_usec,
+			  vec->prev_time.tv_sec, vec->prev_time.tv_usec );
+
+		ivec_reset( vec );
+		vec->prev_time = *curr_time;
+		return 0;
+	}
+	vec->prev_time = *curr_time;
+	return 1;
+}
+
+/****************************************************************************
+ * Update a single vector entry. version is the version of the update as
+ * given by its node, 0 if not known. The local entry gets the next version.
+ ***************************************************************************/
+static int
+ivec_update_entry( ivec_t vec, node_info_t* update, int size,
+		   unsigned int priority, unsigned int version )
 {
-	ivec_entry_t *entry = NULL;
 	struct timeval  curr_time;
 	
       	if( !vec || !update || size <= 0  ) {
 		debug_lr(  VEC_DEBUG, "Error: args, vec update %d\n", size );
 		return 0;
 	}
+	if( !ivec_update_time( vec, &curr_time ))
+		return 0;
+	return ivec_update_entry_at( vec, update, size, priority, version,
+				     &curr_time, -1 );
+}
 
+/****************************************************************************
+ * Update an entry given the current time, and its index if already known
+ * (-1 if not)
+ ***************************************************************************/
+static int
+ivec_update_entry_at( ivec_t vec, node_info_t* update, int size,
+		      unsigned int priority, unsigned int version,
+		      struct timeval *now, int index )
+{
+	ivec_entry_t *entry = NULL;
+	struct timeval  curr_time = *now;
+	unsigned int    prevStatus;
+	
 	if( update->hdr.fsize > size ) {
 		debug_lr(  VEC_DEBUG, "Error: size too big %d %d buffer is not big enough\n",
 			   update->hdr.fsize, size);
 		return 0;
 	}
 
-	gettimeofday( &curr_time, NULL );
-
-	/* Test that the time is moving forwared. If local time was updated it
-	   might move backword (it did happend once)
-	*/
-	if( timercmp( &curr_time, &(vec->prev_time), < )) {
-		debug_lr( WIN_DEBUG, "Problem with time: got time in the past"
-			  " Curr ( %u, %u), Prev( %u, %u )\n",
-			  curr_time.tv_sec, curr_time.tv_usec,
-			  vec->prev_time.tv_sec, vec->prev_time.tv_usec );
-
-		ivec_reset( vec );
-		vec->prev_time = curr_time;
-		return 0;
-	}
-	vec->prev_time = curr_time;
-	
-	
 	if( timercmp( &(curr_time), &( update->hdr.time ), < )) {
 		debug_lg( WIN_DEBUG, "Information from the future!? Pe (%d) "
 			  "Cur ( %u, %u ) Age ( %u, %u )\n",
@@ -817,8 +1427,9 @@ infoVecUpdate( ivec_t vec, node_info_t* update, int size,
 	}
 
 	/* Find the entry in the vector */
-	int index;
-	if( !(entry = infoVecFindByIP( vec, &update->hdr.IP, &index ))) {
+	if( index >= 0 )
+		entry = &vec->vec[ index ];
+	else if( !(entry = infoVecFindByIP( vec, &update->hdr.IP, &index ))) {
 		debug_ly( VEC_DEBUG, "Failed updating  %s. No such IP\n",
 			  inet_ntoa(update->hdr.IP) );
 	 	return 0;
@@ -842,17 +1453,44 @@ infoVecUpdate( ivec_t vec, node_info_t* update, int size,
 		// automatically.
 		if(index == vec->localIndex && priority > 0)
 			vec->localPrio = priority;
+
+		/* Keep the version and which chunks changed for delta windows */
+		{
+			ivec_delta_t *d = &vec->delta[ index ];
+
+			if( index == vec->localIndex )
+				version = ( d->version + 1 ) ? d->version + 1 : 1;
+			
+			if( version && d->version && version > d->version &&
+			    entry->info->hdr.fsize == update->hdr.fsize )
+				ivec_delta_push( d, version,
+						 ivec_delta_diff( entry->info->data, update->data,
+								  update->hdr.fsize - NHDR_SZ ));
+			else
+				ivec_delta_reset( d, version );
+		}
 		
-		/* realloc mem if required  */
-		if( entry->info->hdr.fsize < update->hdr.fsize ) {
-			if( !( entry->info = realloc( entry->info,
-						      update->hdr.fsize ))) {
-				debug_lr( VEC_DEBUG, "Error: realloc\n" );
+		/* Fit the record to the new size. The arena keeps the block
+		   unless it is too small or much too big, or is pinned by a
+		   window being sent */
+		if( entry->info->hdr.fsize != update->hdr.fsize ||
+		    info_arena_is_shared( entry->info )) {
+			node_info_t *info;
+			
+			if( !( info = info_arena_resize( vec->arena, entry->info,
+							 update->hdr.fsize ))) {
+				debug_lr( VEC_DEBUG, "Error: info arena resize\n" );
 				return 0;
 			}
+			entry->info = info;
 			entry->info->hdr.fsize = update->hdr.fsize;	
 		}
 
+		// Taken out of the totals with what it added, and back in
+		// below if it is still alive
+		ivec_stats_remove( vec, index );
+		prevStatus = entry->info->hdr.status;
+		
 		// Coping the data 
 		memcpy( entry->info->data, update->data, update->hdr.fsize - NODE_HEADER_SIZE);
 		// Taking only the necessary fields from the header
@@ -873,7 +1511,11 @@ infoVecUpdate( ivec_t vec, node_info_t* update, int size,
 		{
 			entry->isdead = 0;
 			vec->numAlive++;
+			ivec_alive_add( vec, index );
 			entry->info->hdr.cause = INFOD_ALIVE;
+			// Not when the entry is first known
+			if( !( prevStatus & ( INFOD_DEAD_INIT | INFOD_DEAD_VEC_RESET )))
+				ivec_rumor_add( vec, index );
 		}
 		/*
 		 * Entry was alive and now is dead
@@ -885,6 +1527,23 @@ infoVecUpdate( ivec_t vec, node_info_t* update, int size,
 			
 		}
 
+		/* Alive entries expire max_age after the time of their
+		   information */
+		if( entry->isdead )
+			twheel_cancel( &vec->expireWheel, index );
+		else {
+			struct timeval expire = entry->info->hdr.time;
+
+			expire.tv_sec  += vec->max_age / MILLI;
+			expire.tv_usec += vec->max_age % MILLI;
+			twheel_schedule( &vec->expireWheel, index,
+					 ivec_expire_tick( &expire ) + 1 );
+		}
+		ivec_alive_touch( vec, index );
+		if( !entry->isdead )
+			ivec_stats_add( vec, index );
+		ivec_cols_update( vec, index );
+
 		/* update the window */
 		//dummy.pe       = update->hdr.pe;
 		//dummy.size     = size;
@@ -892,6 +1551,7 @@ infoVecUpdate( ivec_t vec, node_info_t* update, int size,
 		dummy.priority = priority;
 		
 		ivec_update_win( vec, &dummy );
+		vec->generation++;
 		return 1;
 	}
 	
@@ -900,6 +1560,73 @@ infoVecUpdate( ivec_t vec, node_info_t* update, int size,
 
 	return 0;
 }
+
+int
+infoVecUpdate( ivec_t vec, node_info_t* update, int size,
+	       unsigned int priority  )
+{
+	return ivec_update_entry( vec, update, size, priority, 0 );
+}
+
+/****************************************************************************
+ * Update several entries with one time for all. The indices are all found
+ * before any record is touched.
+ ***************************************************************************/
+int
+infoVecUpdateBatch( ivec_t vec, ivec_update_t *ups, int num )
+{
+	struct timeval  curr_time;
+	int             i, updated = 0;
+
+	if( !vec || !ups || num < 0 ) {
+		debug_lr( VEC_DEBUG, "Error: args, vec update batch\n" );
+		return 0;
+	}
+	if( !ivec_update_time( vec, &curr_time ))
+		return 0;
+
+	for( i = 0 ; i < num ; i++ ) {
+		if( !ups[ i ].info || ups[ i ].size <= 0 ||
+		    !infoVecFindByIP( vec, &ups[ i ].info->hdr.IP, &ups[ i ].index ))
+			ups[ i ].index = -1;
+	}
+	for( i = 0 ; i < num ; i++ ) {
+		if( ups[ i ].index < 0 )
+			continue;
+		if( ivec_update_entry_at( vec, ups[ i ].info, ups[ i ].size,
+					  ups[ i ].priority, ups[ i ].version,
+					  &curr_time, ups[ i ].index ))
+			updated++;
+	}
+	return updated;
+}
+
+/*
+ * Start (or restart) the rumor of the death or the revival of an entry.
+ * When all the places are taken the rumor sent the most gives its place.
+ */
+static void
+ivec_rumor_add( ivec_t vec, int index ) {
+
+	ivec_rumor_t *r = NULL;
+	int           i;
+
+	for( i = 0 ; i < vec->numRumors && !r ; i++ )
+		if( vec->rumors[ i ].index == index )
+			r = &vec->rumors[ i ];
+	if( !r && vec->numRumors < IVEC_RUMOR_MAX )
+		r = &vec->rumors[ vec->numRumors++ ];
+	else if( !r ) {
+		r = &vec->rumors[ 0 ];
+		for( i = 1 ; i < vec->numRumors ; i++ )
+			if( vec->rumors[ i ].left < r->left )
+				r = &vec->rumors[ i ];
+	}
+	r->index  = index;
+	r->isdead = vec->vec[ index ].isdead;
+	r->left   = vec->deadStartPrio > 0 ? vec->deadStartPrio : 1;
+}
+
 /*
  * Performing a kill on an entry. This will be called from the infoVecPunish and
  * by the infoVecUpdate.
@@ -920,16 +1647,24 @@ void ivec_kill_entry(ivec_t vec, ivec_entry_t *entry, unsigned int cause)
 	vec->numAlive--;
 	entry->isdead = 1;
 	entry->info->hdr.cause = cause;
+	// Every node ages the entry out by itself, no need to tell
+	if( cause != INFOD_DEAD_AGE )
+		ivec_rumor_add( vec, entry - vec->vec );
+	twheel_cancel( &vec->expireWheel, entry - vec->vec );
+	ivec_alive_remove( vec, entry - vec->vec );
+	ivec_stats_remove( vec, entry - vec->vec );
+	if( vec->numCols )
+		vec->colAlive[ entry - vec->vec ] = 0;
 
 	// The place to add this death measure
 	
-	// No room left so cycling
+	// No room left so cycling, the oldest death goes
 	if(dm->size >= maxSize) {
 		
-		memcpy(&dm->ips[1], dm->ips, (dm->size-1)*sizeof(struct in_addr));
-		memcpy(&dm->deathPropagationTime[1],
-		       dm->deathPropagationTime,
-		       (dm->size-1)*sizeof(float));
+		memmove(dm->ips, &dm->ips[1], (dm->size-1)*sizeof(struct in_addr));
+		memmove(dm->deathPropagationTime,
+			&dm->deathPropagationTime[1],
+			(dm->size-1)*sizeof(float));
                 dm->size--;
         }
 
@@ -938,7 +1673,7 @@ void ivec_kill_entry(ivec_t vec, ivec_entry_t *entry, unsigned int cause)
 
 	// Keeping the details of the newly dead node
 	dm->ips[pos] = entry->info->hdr.IP;
-	gettimeofday(&currTime, NULL);
+	ivec_gettime( &currTime );
 	dm->deathPropagationTime[pos] = (float)compute_age( &(entry->info->hdr.time), &currTime )/MILLI;
 }
 /* /\**************************************************************************** */
@@ -988,15 +1723,20 @@ infoVecPunish( ivec_t vec, struct in_addr *ip, unsigned int cause )
 	// dead
 	if( entry->isdead == 0  ) {
 		info_win_entry_t dummy;
-		unsigned int del_size = entry->info->hdr.fsize - NHDR_SZ;
+		unsigned int del_size = 0;
 
-		gettimeofday( &(entry->info->hdr.time), NULL );
+		if( ivec_own_entry( vec, entry ))
+			del_size = entry->info->hdr.fsize - NHDR_SZ;
+		ivec_delta_reset( &vec->delta[ index ], 0 );
+
+		ivec_gettime( &(entry->info->hdr.time) );
 		entry->info->hdr.status = cause ;
 		ivec_kill_entry(vec, entry, cause);
 
 		/* empty all the fields */
 		if( del_size != 0 )
 			bzero( entry->info->data, del_size );
+		ivec_cols_update( vec, index );
 
 		vec->lastDeadIP = *ip;
 
@@ -1016,14 +1756,46 @@ infoVecPunish( ivec_t vec, struct in_addr *ip, unsigned int cause )
 		dummy.priority = vec->deadStartPrio;
 		ivec_update_win( vec, &dummy );
 	}
-	else {
+	else if( ivec_own_entry( vec, entry )) {
 		if( cause != INFOD_DEAD_AGE )
 			entry->info->hdr.status = cause ;
 			entry->info->hdr.cause = cause;
 	}
+	vec->generation++;
 	return 1;
 }
 
+/****************************************************************************
+ * Punish the entries which are older than max_age. The wheel holds every
+ * alive entry at the tick its information gets too old, so only those
+ * entries are visited.
+ ***************************************************************************/
+static void
+ivec_expire_entry( int index, void *arg )
+{
+	ivec_t          vec = (ivec_t) arg;
+	struct in_addr  ip;
+
+	if( vec->vec[ index ].isdead )
+		return;
+	ip = vec->vec[ index ].info->hdr.IP;
+	infoVecPunish( vec, &ip, INFOD_DEAD_AGE );
+}
+
+int
+infoVecExpire( ivec_t vec )
+{
+	struct timeval now;
+	
+	if( !vec ) {
+		debug_lr( VEC_DEBUG, "Error: args, infoVecExpire\n" );
+		return 0;
+	}
+	ivec_gettime( &now );
+	return twheel_advance( &vec->expireWheel, ivec_expire_tick( &now ),
+			       ivec_expire_entry, vec );
+}
+
 static 
 int ivec_calc_replay_size( ivec_entry_t** ivecptr, int size ) {
 	int rep_size = 0, i = 0;
@@ -1074,7 +1846,7 @@ infoVecPackQueryReplay( ivec_entry_t** ivecptr, int size, char *buff, int *buffS
 	/* points to the data area of the reply  */
 	base_ptr = ((void*)(rep->data));
 	cur_len = 0;
-	gettimeofday( &curtime, NULL );
+	ivec_gettime( &curtime );
 	
 	/* Arrange the reply in the sent buffer */       
 	for( i = 0 ; i < size ; i++  )
@@ -1126,8 +1898,6 @@ ivec_entry_t**
 infoVecGetAllEntries( ivec_t vec ) {
 
 	ivec_entry_t **ret = NULL;
-	struct timeval curtime ;
-	unsigned long age = 0;
 	int i = 0;
       
 	if( !vec ) {
@@ -1141,14 +1911,8 @@ infoVecGetAllEntries( ivec_t vec ) {
 		return NULL;
 	}
       
-	gettimeofday( &curtime, NULL );
-	for( i = 0 ; i < vec->vsize ; i++ ) {
-		age = compute_age( &(vec->vec[i].info->hdr.time), &curtime );
-		if( age > vec->max_age )
-			infoVecPunish( vec, &vec->vec[i].info->hdr.IP,
-				       INFOD_DEAD_AGE);
+	for( i = 0 ; i < vec->vsize ; i++ )
 		ret[i] = &(vec->vec[i]);
-	}
 
 	return ret;
 }
@@ -1166,7 +1930,8 @@ infoVecGetWindowEntries( ivec_t vec, int *winSize )
 	}
 
 	// Calculating the size of window
-	gettimeofday( &vec->currTime, NULL );
+	ivec_gettime( &vec->currTime );
+	ivec_win_sort( vec );
 	vec->win.calcWinSizeFunc( vec );
 	if( !(ret = (ivec_entry_t**) malloc( (vec->win.sendSize + 1) *
 					     sizeof(ivec_entry_t*)))) {
@@ -1193,9 +1958,7 @@ infoVecGetWindowEntries( ivec_t vec, int *winSize )
 ivec_entry_t**
 infoVecGetEntriesByIP( ivec_t vec, struct in_addr* ips, int size ) {
 
-	struct timeval curtime;
 	ivec_entry_t **ret = NULL;
-	unsigned long age = 0;
 	int i = 0, index = -1;
 	
       
@@ -1211,18 +1974,9 @@ infoVecGetEntriesByIP( ivec_t vec, struct in_addr* ips, int size ) {
 
 	/* initialize the return vector */
 	bzero( ret, size * sizeof(ivec_entry_t*) );
-	gettimeofday( &curtime, NULL );
 	
-	for( i = 0 ; i < size; i++ ) {
-		ivec_entry_t *cur = infoVecFindByIP( vec, &ips[i], &index );
-		if( !cur )
-			continue;
-		
-		age = compute_age( &(cur->info->hdr.time), &curtime );
-		if( age > vec->max_age )
-			infoVecPunish(vec, &cur->info->hdr.IP, INFOD_DEAD_AGE );
-		ret[i] = cur;
-	}
+	for( i = 0 ; i < size; i++ )
+		ret[i] = infoVecFindByIP( vec, &ips[i], &index );
 	return ret;
 }
 
@@ -1233,8 +1987,6 @@ ivec_entry_t**
 infoVecGetContIPEntries( ivec_t vec, struct in_addr *baseIP, int size ) {
 
 	ivec_entry_t     **ret = NULL;
-	struct timeval     curtime;
-	unsigned long      age = 0;
 	int                i = 0, index = -1;
 
 	if( !vec || ( size <= 0 )) {
@@ -1249,7 +2001,6 @@ infoVecGetContIPEntries( ivec_t vec, struct in_addr *baseIP, int size ) {
 
 	/* initialize the return vector */
 	bzero( ret, size*sizeof(ivec_entry_t*));
-	gettimeofday( &curtime, NULL ) ;
 
 	struct in_addr tmpIP = *baseIP;
 	for( i = 0 ; i <size ; i++ ) {
@@ -1258,12 +2009,6 @@ infoVecGetContIPEntries( ivec_t vec, struct in_addr *baseIP, int size ) {
 		// Incrementing the ip to the next one
 		ipInc(&tmpIP);
 
-		if( !cur )
-			continue;
-		
-		age = compute_age( &(cur->info->hdr.time), &curtime );
-		if( age > vec->max_age )
-			infoVecPunish( vec, &cur->info->hdr.IP, INFOD_DEAD_AGE );
 		ret[i] = cur;
 	}
 	return ret;
@@ -1296,7 +2041,7 @@ infoVecGetEntriesByAge( ivec_t vec, unsigned long max_age, int* size ) {
 	}
 
 	bzero( ret, vec->vsize * sizeof(ivec_entry_t*));
-	gettimeofday( &curtime, NULL );
+	ivec_gettime( &curtime );
 
 	/* get the nodes with info up to the given age */
 	for( i = 0, j = 0 ; i < vec->vsize ; i++ ) {
@@ -1308,8 +2053,6 @@ infoVecGetEntriesByAge( ivec_t vec, unsigned long max_age, int* size ) {
 		age = compute_age( &(cur->info->hdr.time), &curtime );
 		if( age < max_age )
 			ret[ j++ ] = cur;
-		else if( age > vec->max_age )
-			infoVecPunish( vec, &cur->info->hdr.IP, INFOD_DEAD_AGE );
 	}
 
 	*size = j ;
@@ -1318,201 +2061,1220 @@ infoVecGetEntriesByAge( ivec_t vec, unsigned long max_age, int* size ) {
 
 
 /****************************************************************************
- * The window is supposed to always be sorted (using the win_cmp func).
- * When the window is requested, infoVec need to decide how much entries
- * participates in the window. In case of fixed window the maximal size is
- * known but the actuall size can be somaller, for example due to dead nodes.
+ * Snapshots
  ***************************************************************************/
-static int calcWinSizeFixed( ivec_t vec )
-{
-	int           i = 0;
-	
-	//bzero( vec->win.aux, vec->win.size * sizeof(int));
-	
-	/* perfrom bubble sort, begin by copying to the aux  */
-	for( i = 0; i < vec->win.fixWinSize ; i++ ) {
-		
-		// Unused window entry contain -1 in thier index field
-		if( vec->win.data[ i ].index == -1 )
-			break;
-		
-		//vec->win.aux[ i ] = i;
+static void
+ivec_snap_free( ivec_snap_t snap ) {
+	int i;
+
+	for( i = 0 ; i < snap->vsize ; i++ )
+		info_arena_unref( snap->arena, snap->vec[ i ].info );
+	free( snap->vec );
+	free( snap );
+}
+
+/* Free the retired snapshots only the vector holds. Readers get only the
+   published snapshot, so nobody can take a retired one again */
+static void
+ivec_snap_reclaim( ivec_t vec ) {
+	ivec_snap_t *prev = &vec->retired;
+	ivec_snap_t  snap;
+
+	while(( snap = *prev )) {
+		if( snap->refs == 1 ) {
+			*prev = snap->next;
+			ivec_snap_free( snap );
+		}
+		else
+			prev = &snap->next;
 	}
+}
 
-	vec->win.sendSize = i;
+/* Drop the vector's references, the last reader frees what is left */
+static void
+ivec_snap_free_all( ivec_t vec ) {
+	ivec_snap_t snap, next;
 
-	return 1;
+	if( vec->snap )
+		infoVecSnapshotRelease( vec->snap );
+	for( snap = vec->retired ; snap ; snap = next ) {
+		next = snap->next;
+		infoVecSnapshotRelease( snap );
+	}
+	vec->snap = NULL;
+	vec->retired = NULL;
 }
 
-/* Selecting the number of entries which will compose the new window requested.
- * This is done by taking all the window entry which are upto vec->win.uptoAge.
- * The maximal size is the vec->win.win_size;
- * 
-*/
-static int calcWinSizeUptoAge( ivec_t vec )
-{
-	int           i = 0;
-	
-	for( i = 0; i < vec->win.size ; i++ ) {
-		int   index =  vec->win.data[ i ].index;
-		unsigned long entAge;
-		int   prio;
-		
-		if( index == -1 )
-			break;
+int
+infoVecPublish( ivec_t vec ) {
+	ivec_snap_t snap;
+	int         i;
 
-		// Check that the age of the entry is still alowable
-		entAge = compute_age(&vec->vec[index].info->hdr.time, &vec->currTime);
-		prio   = vec->win.data[i].priority;
+	if( !vec ) {
+		debug_lr( VEC_DEBUG, "Error: args, infoVecPublish\n" );
+		return 0;
+	}
+	ivec_snap_reclaim( vec );
+	if( vec->snap && vec->snap->generation == vec->generation )
+		return 1;
 
-		// We break the window only if the prio is 0 (which is assumed
-		// to be the normal prio. And the age is too old.
-		if(prio == 0 && entAge > (vec->win.uptoAge)) {
-			// We decrement i by one since the current entry is not
-			// up to the requested age
-			// A big bug because i is the index of the firts old entry which is
-			// also the number of good entries.
-			//i--;
-			break;
+	if( !(snap = malloc( sizeof(struct ivec_snapshot) ))) {
+		debug_lr( VEC_DEBUG, "Error: malloc, snapshot\n" );
+		return 0;
+	}
+	if( !(snap->vec = malloc( vec->vsize * VENTRY_SZ ))) {
+		debug_lr( VEC_DEBUG, "Error: malloc, snapshot entries\n" );
+		free( snap );
+		return 0;
+	}
+	memcpy( snap->vec, vec->vec, vec->vsize * VENTRY_SZ );
+	for( i = 0 ; i < vec->vsize ; i++ )
+		info_arena_ref( vec->arena, snap->vec[ i ].info );
+	snap->vsize      = vec->vsize;
+	snap->arena      = vec->arena;
+	snap->generation = vec->generation;
+	snap->refs       = 1;
+
+	// The previous one is retired, or freed if nobody reads it
+	if( vec->snap ) {
+		if( vec->snap->refs == 1 )
+			ivec_snap_free( vec->snap );
+		else {
+			vec->snap->next = vec->retired;
+			vec->retired = vec->snap;
 		}
 	}
-	
-	vec->win.sendSize = i;
-	// We assume this will be called ever
+	snap->next = NULL;
+	vec->snap = snap;
 	return 1;
 }
 
-inline int addEntToBuff(ivec_t vec, 
-			info_msg_entry_t *msgEnt, int size,
-			int index, int sizeFlag, unsigned int *prio)
-{
-	ivec_entry_t      *vecEnt = NULL;
-	int                nodeInfoSize=0;
-	
-	vecEnt = &(vec->vec[ index ]);
+ivec_snap_t
+infoVecSnapshotAcquire( ivec_t vec ) {
+	if( !vec ) {
+		debug_lr( VEC_DEBUG, "Error: args, infoVecSnapshotAcquire\n" );
+		return NULL;
+	}
+	if( !vec->snap && !infoVecPublish( vec ))
+		return NULL;
+	vec->snap->refs++;
+	return vec->snap;
+}
 
-	if( sizeFlag )
-		nodeInfoSize = vecEnt->info->hdr.fsize;
-	else
-		nodeInfoSize = vecEnt->info->hdr.psize;
+void
+infoVecSnapshotRelease( ivec_snap_t snap ) {
+	if( !snap )
+		return;
+	// Reaching 0 means the vector is gone
+	if( --snap->refs == 0 )
+		ivec_snap_free( snap );
+}
 
-	// Checking that there is ehough space in the 
-	if(nodeInfoSize > size) {
-		mlog_bn_dr("vec", "Error remaining space in message in not big enough %d < %d\n", size, nodeInfoSize);	
-		return 0;
-	}
+unsigned long
+infoVecSnapshotGeneration( ivec_snap_t snap ) {
+	return snap ? snap->generation : 0;
+}
 
-	msgEnt->size     = INFO_MSG_ENTRY_SIZE + nodeInfoSize;
-	msgEnt->priority = *prio; 
-	
-	memcpy( msgEnt->data, vecEnt->info, nodeInfoSize );
-	ivec_time2age( msgEnt->data, &vec->currTime );
-	return 1;
+int
+infoVecSnapshotSize( ivec_snap_t snap ) {
+	return snap ? snap->vsize : -1;
 }
 
 /****************************************************************************
- * Get information message (the window to be sent to another daemon)
- * The buffer returned is a static buffer which will be used again next
- * time this function is called.
+ * Return all the snapshot enteries (as infoVecGetAllEntries)
  ***************************************************************************/
-void*
-infoVecGetWindow( ivec_t vec, int *size, int size_flag  ) {
+ivec_entry_t**
+infoVecSnapshotGetAllEntries( ivec_snap_t snap ) {
 
-	unsigned int       total = 0;
-	unsigned int       remaining_space;
-	info_msg_t        *msg  = NULL;
-	info_msg_entry_t  *entryPtr = NULL;
-	void              *data = NULL;
-	//int               *aux = NULL;
-	
-	if( !vec || !size ) {
-		debug_lr( VEC_DEBUG, "Error: args, infoVecGetWindow\n" );
+	ivec_entry_t **ret = NULL;
+	int i = 0;
+      
+	if( !snap ) {
+		debug_lr( VEC_DEBUG, "Error: args, infoVecSnapshotGetAllEntries\n");
 		return NULL;
 	}
 
-	bzero( vec->msg_buff, vec->msg_buff_size );
-	msg        = vec->msg_buff;
-	data       = msg->data;
-	entryPtr   = msg->data;
+	if( !(ret = (ivec_entry_t**) malloc( snap->vsize *
+					     sizeof(ivec_entry_t*)))) {
+		debug_lr( VEC_DEBUG, "Error: malloc, infoVecSnapshotGetAllEntries\n");
+		return NULL;
+	}
+      
+	for( i = 0 ; i < snap->vsize ; i++ )
+		ret[i] = &(snap->vec[i]);
 
-	ivec_print_win( vec );
-	gettimeofday( &vec->currTime, NULL );
-	
-	/* Add the local entry */
-	remaining_space = vec->msg_buff_size - 4096;
-	addEntToBuff(vec, entryPtr, remaining_space, vec->localIndex, size_flag, &vec->localPrio);
-	// Decreasing the priority by one as part of the priority decay
-	if( vec->localPrio > 0 )
-		vec->localPrio--;
-	
-	// Advancing past the first entry
-	total     += entryPtr->size ;
-	remaining_space -= entryPtr->size;
-	entryPtr   = data + total;
+	return ret;
+}
 
-	vec->win.calcWinSizeFunc( vec );
-	//aux = vec->win.aux;
-	
-	// The starting value is one since the local entry is always young enough/should be
-	// in the out going window
-	int nodesInWindow = 1;
-	/* Add the other window entries */
-	for(int i = 0 ; i < vec->win.sendSize; i++, nodesInWindow++ ) {
-		int res;
-		// End of aux reached
-		//if( aux[ i ] == - 1 )
-		//break;
-		// End of window reached
-		//if( vec->win.data[ aux[ i ]].index == -1 )
-		//break;
-
-		// Another sanity check
-		//if( vec->win.data[ aux[ i ]].index < 0 ||
-		//  vec->win.data[ aux[ i ]].index >= vec->vsize )
-		//return NULL;
-		
-		res = addEntToBuff(vec, entryPtr, remaining_space, vec->win.data[i].index, size_flag,
-		         	     (unsigned int *)&(vec->win.data[i].priority));
-		
-		if(!res) {
-			mlog_bn_dr("vec", "Error adding entry to window message (not enough space) skipping ..\n");
-			break;			
-		}	
-		// Deacreasing the priority by one for each window sent
-		if( vec->win.data[ i ].priority > 0 )
-			vec->win.data[ i ].priority--;
-				
-		total    += entryPtr->size;
-		remaining_space -= entryPtr->size;
-		entryPtr  = data + total;
-	}
 
-	total             += INFO_MSG_SIZE;
-	msg->signature     = vec->signature;
-	msg->num           = nodesInWindow;
-	msg->tsize         = total;
-	*size              = msg->tsize;
+/****************************************************************************
+ * Column store
+ ***************************************************************************/
+static int
+ivec_col_wanted( var_t *var ) {
+	if( strcmp( var->class_type, VLEN_TAG ) == 0 ||
+	    strcmp( var->class_type, EXTERNAL_TAG ) == 0 ||
+	    strcmp( var->type, "string" ) == 0 )
+		return 0;
+	return var->size == 1 || var->size == 2 ||
+		var->size == 4 || var->size == 8;
+}
 
-	debug_ly( WIN_DEBUG, "Getting Window Window: sendSize %d winSize %d \n",
-		  vec->win.sendSize, nodesInWindow);
+static void
+ivec_cols_update( ivec_t vec, int index ) {
+	ivec_entry_t  *entry = &vec->vec[ index ];
+	ivec_column_t *col;
+	int            dataSize = entry->info->hdr.fsize - NHDR_SZ;
+	int            i;
 
-	// Adding the measurment of the window size
-	infoVecDoWinSizeMeasure(vec, nodesInWindow);
+	if( !vec->numCols )
+		return;
 
-	return vec->msg_buff;
+	vec->colAlive[ index ] = !entry->isdead;
+	for( i = 0 ; i < vec->numCols ; i++ ) {
+		col = &vec->cols[ i ];
+		if( col->offset + col->size <= dataSize )
+			memcpy( col->data + index * col->size,
+				entry->info->data + col->offset, col->size );
+		else
+			bzero( col->data + index * col->size, col->size );
+	}
+}
+
+static void
+ivec_cols_free( ivec_t vec ) {
+	int i;
+
+	for( i = 0 ; i < vec->numCols ; i++ )
+		free( vec->cols[ i ].data );
+	if( vec->cols )
+		free( vec->cols );
+	if( vec->colAlive )
+		free( vec->colAlive );
+	vec->cols = NULL;
+	vec->colAlive = NULL;
+	vec->numCols = 0;
 }
 
-/****************************************************************************
- * Handle an info message from another infod
- ***************************************************************************/
 int
-infoVecUseRemoteWindow( ivec_t vec, void *buff, int size ) {
-	
-	info_msg_t           *msg = (info_msg_t*)buff;
-	info_msg_entry_t     *ptr  = NULL;
-	void                 *data = NULL;
+infoVecSetColumns( ivec_t vec, struct variable_map *mapping ) {
+	ivec_column_t *col;
+	int            i, num = 0;
+
+	if( !vec ) {
+		debug_lr( VEC_DEBUG, "Error: args, infoVecSetColumns\n" );
+		return 0;
+	}
+	ivec_cols_free( vec );
+	if( !mapping )
+		return 1;
+
+	for( i = 0 ; i < mapping->num ; i++ )
+		if( ivec_col_wanted( &mapping->vars[ i ] ))
+			num++;
+	if( num == 0 )
+		return 1;
+
+	if( !( vec->cols = calloc( num, sizeof(ivec_column_t) )) ||
+	    !( vec->colAlive = calloc( vec->vsize, 1 ))) {
+		debug_lr( VEC_DEBUG, "Error: malloc, columns\n" );
+		goto exit_with_free;
+	}
+	for( i = 0 ; i < mapping->num ; i++ ) {
+		var_t *var = &mapping->vars[ i ];
+
+		if( !ivec_col_wanted( var ))
+			continue;
+		col = &vec->cols[ vec->numCols ];
+		strncpy( col->name, var->name, IVEC_COL_NAME_SZ - 1 );
+		col->offset = var->offset;
+		col->size   = var->size;
+		if( !( col->data = calloc( vec->vsize, col->size ))) {
+			debug_lr( VEC_DEBUG, "Error: malloc, column %s\n",
+				  var->name );
+			goto exit_with_free;
+		}
+		vec->numCols++;
+	}
+
+	for( i = 0 ; i < vec->vsize ; i++ )
+		ivec_cols_update( vec, i );
+	return 1;
+
+ exit_with_free:
+	ivec_cols_free( vec );
+	return 0;
+}
+
+void*
+infoVecGetColumn( ivec_t vec, const char *name, int *itemSize ) {
+	int i;
+
+	if( !vec || !name )
+		return NULL;
+	for( i = 0 ; i < vec->numCols ; i++ ) {
+		if( strcmp( vec->cols[ i ].name, name ) == 0 ) {
+			if( itemSize )
+				*itemSize = vec->cols[ i ].size;
+			return vec->cols[ i ].data;
+		}
+	}
+	return NULL;
+}
+
+unsigned char*
+infoVecGetAliveColumn( ivec_t vec ) {
+	return vec ? vec->colAlive : NULL;
+}
+
+/****************************************************************************
+ * Checkpoint
+ ***************************************************************************/
+#define IVEC_CKPT_REC_SZ(fsize) \
+	(( sizeof(ivec_ckpt_rec_t) + (fsize) + IVEC_CKPT_ALIGN - 1 ) & \
+	 ~( IVEC_CKPT_ALIGN - 1 ))
+
+static int
+ivec_ckpt_wanted( ivec_t vec, int i ) {
+	// The local entry is filled by the provider right away
+	return !vec->vec[ i ].isdead && vec->vec[ i ].info &&
+		i != vec->localIndex;
+}
+
+int
+infoVecCheckpoint( ivec_t vec, const char *path ) {
+	ivec_ckpt_hdr_t *hdr = MAP_FAILED;
+	ivec_ckpt_rec_t *rec;
+	char            *tmpPath = NULL;
+	size_t           size = sizeof(ivec_ckpt_hdr_t);
+	int              i, fd = -1, res = 0;
+
+	if( !vec || !path ) {
+		debug_lr( VEC_DEBUG, "Error: args, infoVecCheckpoint\n" );
+		return 0;
+	}
+
+	for( i = 0 ; i < vec->vsize ; i++ )
+		if( ivec_ckpt_wanted( vec, i ))
+			size += IVEC_CKPT_REC_SZ( vec->vec[ i ].info->hdr.fsize );
+
+	if( !( tmpPath = malloc( strlen( path ) + 5 ))) {
+		debug_lr( VEC_DEBUG, "Error: malloc, checkpoint\n" );
+		return 0;
+	}
+	sprintf( tmpPath, "%s.tmp", path );
+	if( ( fd = open( tmpPath, O_RDWR | O_CREAT | O_TRUNC, 0644 )) == -1 ||
+	    ftruncate( fd, size ) == -1 ) {
+		debug_lr( VEC_DEBUG, "Error: creating checkpoint %s: %s\n",
+			  tmpPath, strerror( errno ));
+		goto exit_with_free;
+	}
+	hdr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+	if( hdr == MAP_FAILED ) {
+		debug_lr( VEC_DEBUG, "Error: mmap checkpoint: %s\n",
+			  strerror( errno ));
+		goto exit_with_free;
+	}
+
+	hdr->magic     = IVEC_CKPT_MAGIC;
+	hdr->infoVer   = MSX_INFOD_INFO_VER;
+	hdr->signature = vec->signature;
+	hdr->num       = 0;
+	hdr->size      = size;
+	ivec_gettime( &hdr->time );
+
+	rec = (ivec_ckpt_rec_t *)( hdr + 1 );
+	for( i = 0 ; i < vec->vsize ; i++ ) {
+		node_info_t *info = vec->vec[ i ].info;
+
+		if( !ivec_ckpt_wanted( vec, i ))
+			continue;
+		rec->version = vec->delta ? vec->delta[ i ].version : 0;
+		rec->size    = IVEC_CKPT_REC_SZ( info->hdr.fsize );
+		memcpy( rec->info, info, info->hdr.fsize );
+		hdr->num++;
+		rec = (ivec_ckpt_rec_t *)( (char *)rec + rec->size );
+	}
+
+	// The file replaces the previous checkpoint only when complete
+	if( msync( hdr, size, MS_SYNC ) == -1 ||
+	    rename( tmpPath, path ) == -1 ) {
+		debug_lr( VEC_DEBUG, "Error: writing checkpoint %s: %s\n",
+			  path, strerror( errno ));
+		goto exit_with_free;
+	}
+	res = 1;
+
+ exit_with_free:
+	if( hdr != MAP_FAILED )
+		munmap( hdr, size );
+	if( fd != -1 )
+		close( fd );
+	if( !res && fd != -1 )
+		unlink( tmpPath );
+	free( tmpPath );
+	return res;
+}
+
+int
+infoVecRestore( ivec_t vec, const char *path ) {
+	ivec_ckpt_hdr_t *hdr = MAP_FAILED;
+	ivec_ckpt_rec_t *rec;
+	ivec_entry_t    *entry;
+	struct stat      st;
+	char            *end;
+	int              i, index, fd, num = -1;
+
+	if( !vec || !path ) {
+		debug_lr( VEC_DEBUG, "Error: args, infoVecRestore\n" );
+		return -1;
+	}
+	if( ( fd = open( path, O_RDONLY )) == -1 )
+		return -1;
+	if( fstat( fd, &st ) == -1 ||
+	    st.st_size < (off_t) sizeof(ivec_ckpt_hdr_t) )
+		goto exit_with_free;
+	hdr = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	if( hdr == MAP_FAILED )
+		goto exit_with_free;
+
+	if( hdr->magic != IVEC_CKPT_MAGIC ||
+	    hdr->infoVer != MSX_INFOD_INFO_VER ||
+	    hdr->size != st.st_size ) {
+		debug_lr( VEC_DEBUG, "Error: %s is not a vector checkpoint\n",
+			  path );
+		goto exit_with_free;
+	}
+	if( hdr->signature != vec->signature ) {
+		debug_ly( VEC_DEBUG, "Checkpoint %s is of another description\n",
+			  path );
+		goto exit_with_free;
+	}
+
+	num = 0;
+	end = (char *)hdr + hdr->size;
+	rec = (ivec_ckpt_rec_t *)( hdr + 1 );
+	for( i = 0 ; i < hdr->num ; i++ ) {
+		if( end - (char *)rec < (int)( sizeof(ivec_ckpt_rec_t) + NHDR_SZ ) ||
+		    rec->size < (int)( sizeof(ivec_ckpt_rec_t) + NHDR_SZ ) ||
+		    rec->size > end - (char *)rec ||
+		    rec->info->hdr.fsize < (int) NHDR_SZ ||
+		    rec->info->hdr.fsize > rec->size ||
+		    rec->size < (int) IVEC_CKPT_REC_SZ( rec->info->hdr.fsize )) {
+			debug_lr( VEC_DEBUG, "Error: corrupted checkpoint %s\n",
+				  path );
+			break;
+		}
+		// Entries not heard of since the init are older than anything
+		if( ( entry = infoVecFindByIP( vec, &rec->info->hdr.IP, &index )) &&
+		    entry->isdead &&
+		    entry->info->hdr.status == INFOD_DEAD_INIT )
+			timerclear( &entry->info->hdr.time );
+		
+		// Too old or unknown entries are just not taken
+		if( rec->info->hdr.IP.s_addr != vec->localIP.s_addr &&
+		    ivec_update_entry( vec, rec->info, rec->info->hdr.fsize,
+				       0, rec->version ))
+			num++;
+		rec = (ivec_ckpt_rec_t *)( (char *)rec + rec->size );
+	}
+	debug_lg( VEC_DEBUG, "Restored %d of %d entries from %s\n",
+		  num, hdr->num, path );
+
+ exit_with_free:
+	if( hdr != MAP_FAILED )
+		munmap( hdr, st.st_size );
+	close( fd );
+	return num;
+}
+
+
+/****************************************************************************
+ * The window is supposed to always be sorted (using the win_cmp func).
+ * When the window is requested, infoVec need to decide how much entries
+ * participates in the window. In case of fixed window the maximal size is
+ * known but the actuall size can be somaller, for example due to dead nodes.
+ ***************************************************************************/
+static int calcWinSizeFixed( ivec_t vec )
+{
+	int           i = 0;
+	
+	//bzero( vec->win.aux, vec->win.size * sizeof(int));
+	
+	/* perfrom bubble sort, begin by copying to the aux  */
+	for( i = 0; i < vec->win.fixWinSize ; i++ ) {
+		
+		// Unused window entry contain -1 in thier index field
+		if( vec->win.data[ i ].index == -1 )
+			break;
+		
+		//vec->win.aux[ i ] = i;
+	}
+
+	vec->win.sendSize = i;
+
+	return 1;
+}
+
+/* Selecting the number of entries which will compose the new window requested.
+ * This is done by taking all the window entry which are upto vec->win.uptoAge.
+ * The maximal size is the vec->win.win_size;
+ * 
+*/
+static int calcWinSizeUptoAge( ivec_t vec )
+{
+	int           i = 0;
+	
+	for( i = 0; i < vec->win.size ; i++ ) {
+		int   index =  vec->win.data[ i ].index;
+		unsigned long entAge;
+		int   prio;
+		
+		if( index == -1 )
+			break;
+
+		// Check that the age of the entry is still alowable
+		entAge = compute_age(&vec->vec[index].info->hdr.time, &vec->currTime);
+		prio   = vec->win.data[i].priority;
+
+		// We break the window only if the prio is 0 (which is assumed
+		// to be the normal prio. And the age is too old.
+		if(prio == 0 && entAge > (vec->win.uptoAge)) {
+			// We decrement i by one since the current entry is not
+			// up to the requested age
+			// A big bug because i is the index of the firts old entry which is
+			// also the number of good entries.
+			//i--;
+			break;
+		}
+	}
+	
+	vec->win.sendSize = i;
+	// We assume this will be called ever
+	return 1;
+}
+
+/****************************************************************************
+ * The number of bytes of the entry's record that go into a window
+ ***************************************************************************/
+static int
+ivec_ent_send_size( ivec_t vec, int index, int sizeFlag ) {
+
+	node_info_t *info = vec->vec[ index ].info;
+
+	return sizeFlag ? info->hdr.fsize : info->hdr.psize;
+}
+
+/****************************************************************************
+ * Walk over the entries that go into the next window: the local entry
+ * first and then the window entries chosen by calcWinSizeFunc, giving each
+ * to addFunc and decaying the priorities of the ones sent. Both the copied
+ * and the scatter/gather windows are built by this walk. Returns the number
+ * of entries added or -1 on error.
+ ***************************************************************************/
+typedef int (*ivec_add_ent_func_t)( ivec_t vec, int index, int nodeInfoSize,
+				    unsigned int prio, void *arg );
+
+static int
+ivec_walk_window( ivec_t vec, int sizeFlag, int space,
+		  ivec_add_ent_func_t addFunc, void *arg )
+{
+	int nodeInfoSize;
+	int nodesInWindow = 0;
+
+	ivec_win_sort( vec );
+	ivec_print_win( vec );
+	ivec_gettime( &vec->currTime );
+	
+	/* Add the local entry */
+	nodeInfoSize = ivec_ent_send_size( vec, vec->localIndex, sizeFlag );
+	if( INFO_MSG_ENTRY_SIZE + nodeInfoSize > space ||
+	    !addFunc( vec, vec->localIndex, nodeInfoSize, vec->localPrio, arg )) {
+		mlog_bn_dr("vec", "Error adding the local entry to window message\n");
+		return -1;
+	}
+	space -= INFO_MSG_ENTRY_SIZE + nodeInfoSize;
+	nodesInWindow++;
+	
+	// Decreasing the priority by one as part of the priority decay
+	if( vec->localPrio > 0 )
+		vec->localPrio--;
+
+	vec->win.calcWinSizeFunc( vec );
+	
+	/* Add the other window entries */
+	for( int i = 0 ; i < vec->win.sendSize && i < vec->win.size ; i++ ) {
+		int index = vec->win.data[i].index;
+		
+		nodeInfoSize = ivec_ent_send_size( vec, index, sizeFlag );
+		if( INFO_MSG_ENTRY_SIZE + nodeInfoSize > space ) {
+			mlog_bn_dr("vec", "Error remaining space in message in not big enough %d < %d\n", space, nodeInfoSize);
+			break;
+		}
+		if( !addFunc( vec, index, nodeInfoSize,
+			      vec->win.data[i].priority, arg )) {
+			mlog_bn_dr("vec", "Error adding entry to window message skipping ..\n");
+			break;			
+		}
+		space -= INFO_MSG_ENTRY_SIZE + nodeInfoSize;
+		nodesInWindow++;
+		
+		// Deacreasing the priority by one for each window sent
+		ivec_win_decay( vec, i );
+	}
+
+	debug_ly( WIN_DEBUG, "Getting Window Window: sendSize %d winSize %d \n",
+		  vec->win.sendSize, nodesInWindow);
+
+	// Adding the measurment of the window size
+	infoVecDoWinSizeMeasure(vec, nodesInWindow);
+	return nodesInWindow;
+}
+
+/*
+ * Copy the entry to the message buffer. arg points to the position of the
+ * next entry in the buffer.
+ */
+static int
+addEntToBuff( ivec_t vec, int index, int nodeInfoSize,
+	      unsigned int prio, void *arg )
+{
+	char             **pos    = (char **)arg;
+	info_msg_entry_t  *msgEnt = (info_msg_entry_t *)*pos;
+
+	msgEnt->size     = INFO_MSG_ENTRY_SIZE + nodeInfoSize;
+	msgEnt->priority = prio; 
+	
+	memcpy( msgEnt->data, vec->vec[ index ].info, nodeInfoSize );
+	ivec_time2age( msgEnt->data, &vec->currTime );
+
+	*pos += msgEnt->size;
+	return 1;
+}
+
+/****************************************************************************
+ * Get information message (the window to be sent to another daemon)
+ * The buffer returned is a static buffer which will be used again next
+ * time this function is called.
+ ***************************************************************************/
+void*
+infoVecGetWindow( ivec_t vec, int *size, int size_flag  ) {
+
+	info_msg_t        *msg  = NULL;
+	char              *pos  = NULL;
+	int                num;
+	
+	if( !vec || !size ) {
+		debug_lr( VEC_DEBUG, "Error: args, infoVecGetWindow\n" );
+		return NULL;
+	}
+
+	// Every byte sent is written below, so the buffer is not cleared
+	msg = vec->msg_buff;
+	pos = (char *)msg->data;
+
+	num = ivec_walk_window( vec, size_flag, vec->msg_buff_size - 4096,
+				addEntToBuff, &pos );
+	if( num < 0 )
+		return NULL;
+
+	msg->signature     = vec->signature;
+	msg->num           = num;
+	msg->tsize         = pos - (char *)msg;
+	*size              = msg->tsize;
+
+	return vec->msg_buff;
+}
+
+/*
+ * Add a chunk to the window iovec, merging it with the previous one when
+ * they are adjacent in memory.
+ */
+static void
+ivec_iov_add( ivec_win_iov_t *w, void *base, int len ) {
+
+	if( w->iovcnt > 0 ) {
+		struct iovec *last = &w->iov[ w->iovcnt - 1 ];
+
+		if( (char *)last->iov_base + last->iov_len == base ) {
+			last->iov_len += len;
+			return;
+		}
+	}
+	w->iov[ w->iovcnt ].iov_base = base;
+	w->iov[ w->iovcnt ].iov_len  = len;
+	w->iovcnt++;
+}
+
+/*
+ * Add an entry to a scatter/gather window. The entry prefix and the age
+ * converted header are written to the handle, the payload is referenced
+ * in place and its record is pinned until the send is done.
+ */
+static int
+addEntToIov( ivec_t vec, int index, int nodeInfoSize,
+	     unsigned int prio, void *arg )
+{
+	ivec_win_iov_t    *w      = (ivec_win_iov_t *)arg;
+	node_info_t       *info   = vec->vec[ index ].info;
+	info_msg_entry_t  *msgEnt = (info_msg_entry_t *)w->hdrPos;
+	int                hdrLen;
+
+	if( w->numRecs == w->maxRecs )
+		return 0;
+	
+	hdrLen = ( nodeInfoSize < NHDR_SZ ) ? nodeInfoSize : NHDR_SZ;
+	
+	msgEnt->size     = INFO_MSG_ENTRY_SIZE + nodeInfoSize;
+	msgEnt->priority = prio;
+	memcpy( msgEnt->data, info, NHDR_SZ );
+	ivec_time2age( msgEnt->data, &vec->currTime );
+
+	ivec_iov_add( w, msgEnt, INFO_MSG_ENTRY_SIZE + hdrLen );
+	w->hdrPos += INFO_MSG_ENTRY_SIZE + NHDR_SZ;
+
+	if( nodeInfoSize > NHDR_SZ ) {
+		info_arena_ref( w->arena, info );
+		w->recs[ w->numRecs++ ] = info;
+		ivec_iov_add( w, info->data, nodeInfoSize - NHDR_SZ );
+	}
+	return 1;
+}
+
+/*
+ * Add an entry to a delta window. The entry goes as a delta if the history
+ * covers enough versions and the changed chunks are less than half of the
+ * data, else it goes full. The chunks are referenced in the record.
+ */
+static int
+addEntToDeltaIov( ivec_t vec, int index, int nodeInfoSize,
+		  unsigned int prio, void *arg )
+{
+	ivec_win_iov_t      *w      = (ivec_win_iov_t *)arg;
+	node_info_t         *info   = vec->vec[ index ].info;
+	ivec_delta_t        *d      = &vec->delta[ index ];
+	info_delta_entry_t  *msgEnt = (info_delta_entry_t *)w->hdrPos;
+	int                  dataSize, chunk, carried = 0, full = 1;
+	unsigned long long   mask = 0;
+
+	if( w->numRecs == w->maxRecs )
+		return 0;
+	
+	// Delta windows always carry the full records
+	nodeInfoSize = info->hdr.fsize;
+	dataSize     = nodeInfoSize - NHDR_SZ;
+	chunk        = ivec_delta_chunk( dataSize );
+	
+	// A mask of 0 is a refresh which did not change the data, only the
+	// header goes
+	if( !w->deltaFull && d->version && d->histLen > 0 ) {
+		for( int i = 0 ; i < d->histLen ; i++ )
+			mask |= d->histMask[ i ];
+		full = ( __builtin_popcountll( mask ) * chunk * 2 >= dataSize );
+	}
+	if( full )
+		mask = 0;
+	msgEnt->base = full ? 0 : d->histFrom;
+
+	msgEnt->priority = prio;
+	msgEnt->version  = d->version;
+	msgEnt->mask     = mask;
+	memcpy( msgEnt->data, info, NHDR_SZ );
+	ivec_time2age( msgEnt->data, &vec->currTime );
+	ivec_iov_add( w, msgEnt, INFO_DELTA_ENTRY_SIZE + NHDR_SZ );
+	w->hdrPos += INFO_DELTA_ENTRY_SIZE + NHDR_SZ;
+
+	if( dataSize > 0 && ( full || mask )) {
+		info_arena_ref( w->arena, info );
+		w->recs[ w->numRecs++ ] = info;
+	}
+	
+	if( full ) {
+		if( dataSize > 0 )
+			ivec_iov_add( w, info->data, dataSize );
+		carried = dataSize;
+	}
+	else {
+		for( int c = 0 ; c < IVEC_DELTA_CHUNKS && c * chunk < dataSize ; c++ ) {
+			int len;
+			
+			if( !( mask & ( 1ULL << c )))
+				continue;
+			len = ( dataSize - c * chunk < chunk ) ? dataSize - c * chunk : chunk;
+			ivec_iov_add( w, info->data + c * chunk, len );
+			carried += len;
+		}
+	}
+	msgEnt->size = INFO_DELTA_ENTRY_SIZE + NHDR_SZ + carried;
+	return 1;
+}
+
+/*
+ * Allocate a scatter/gather window of up to maxEnts entries, each taking up
+ * to maxIov chunks and entHdr + NHDR_SZ bytes of headers. The first chunk
+ * is the message header of msgHdr bytes. Room for the rumors section is
+ * kept after the entries.
+ */
+static ivec_win_iov_t *
+ivec_win_iov_new( ivec_t vec, int maxEnts, int maxIov, int entHdr, int msgHdr ) {
+
+	ivec_win_iov_t    *w;
+	size_t             len;
+	int                numIov;
+	
+	numIov = maxIov * maxEnts + 1 + 2 * IVEC_RUMOR_MAX + 1;
+	len = sizeof(ivec_win_iov_t) +
+		numIov * sizeof(struct iovec) +
+		( maxEnts + IVEC_RUMOR_MAX ) * sizeof(node_info_t *) +
+		msgHdr + maxEnts * ( entHdr + NHDR_SZ ) +
+		INFO_RUMOR_MSG_SIZE +
+		IVEC_RUMOR_MAX * ( INFO_MSG_ENTRY_SIZE + NHDR_SZ );
+	
+	if( !( w = malloc( len ))) {
+		debug_lr( VEC_DEBUG, "Error: malloc, window iov\n" );
+		return NULL;
+	}
+	w->arena   = vec->arena;
+	w->iov     = (struct iovec *)( w + 1 );
+	w->iovcnt  = 0;
+	w->recs    = (node_info_t **)( w->iov + numIov );
+	w->numRecs = 0;
+	w->maxRecs = maxEnts;
+	w->hdrBuff = (char *)( w->recs + maxEnts + IVEC_RUMOR_MAX );
+	w->hdrPos  = w->hdrBuff + msgHdr;
+	w->refs    = 1;
+	ivec_iov_add( w, w->hdrBuff, msgHdr );
+	return w;
+}
+
+/*
+ * Add the rumors section after the entries of a scatter/gather window. A
+ * rumor goes in the next windows until its budget is spent, and is dropped
+ * once its entry died or revived again.
+ */
+static void
+ivec_win_iov_rumors( ivec_t vec, ivec_win_iov_t *w ) {
+
+	info_rumor_msg_t  *rmsg;
+	int                i, space = IVEC_RUMOR_MAX_BYTES;
+
+	for( i = 0 ; i < vec->numRumors ; ) {
+		ivec_rumor_t *r = &vec->rumors[ i ];
+		
+		if( vec->vec[ r->index ].isdead != r->isdead )
+			*r = vec->rumors[ --vec->numRumors ];
+		else
+			i++;
+	}
+	if( !vec->numRumors )
+		return;
+
+	rmsg = (info_rumor_msg_t *)w->hdrPos;
+	rmsg->magic = INFO_MSG_RUMOR_MAGIC;
+	rmsg->num   = 0;
+	rmsg->size  = INFO_RUMOR_MSG_SIZE;
+	ivec_iov_add( w, rmsg, INFO_RUMOR_MSG_SIZE );
+	w->hdrPos  += INFO_RUMOR_MSG_SIZE;
+	w->maxRecs += IVEC_RUMOR_MAX;
+	
+	for( i = 0 ; i < vec->numRumors ; ) {
+		ivec_rumor_t *r    = &vec->rumors[ i ];
+		int           size = vec->vec[ r->index ].info->hdr.fsize;
+
+		if( INFO_MSG_ENTRY_SIZE + size > space ||
+		    !addEntToIov( vec, r->index, size, 0, w )) {
+			i++;
+			continue;
+		}
+		rmsg->num++;
+		rmsg->size += INFO_MSG_ENTRY_SIZE + size;
+		space      -= INFO_MSG_ENTRY_SIZE + size;
+		if( --r->left <= 0 )
+			*r = vec->rumors[ --vec->numRumors ];
+		else
+			i++;
+	}
+}
+
+/*
+ * Fill the message header of a scatter/gather window and return it
+ */
+static void *
+ivec_win_iov_done( ivec_t vec, ivec_win_iov_t *w, int num,
+		   struct iovec **iov, int *iovcnt, int *size )
+{
+	info_msg_t *msg = (info_msg_t *)w->hdrBuff;
+	
+	ivec_win_iov_rumors( vec, w );
+	msg->signature = vec->signature;
+	msg->num       = num;
+	msg->tsize     = 0;
+	for( int i = 0 ; i < w->iovcnt ; i++ )
+		msg->tsize += w->iov[ i ].iov_len;
+
+	*iov    = w->iov;
+	*iovcnt = w->iovcnt;
+	*size   = msg->tsize;
+	return w;
+}
+
+/****************************************************************************
+ * Get the window message as a scatter/gather list. Same message as
+ * infoVecGetWindow but the entries payload is not copied, the iovec points
+ * to the vector records. Returns a handle which holds the iovec and must be
+ * given to infoVecWindowIovDone() once the message was sent (or dropped).
+ * When delta windows are on the message is a delta window (of full
+ * records, size_flag is ignored).
+ ***************************************************************************/
+void*
+infoVecGetWindowIov( ivec_t vec, int size_flag, struct iovec **iov,
+		     int *iovcnt, int *size )
+{
+	ivec_win_iov_t    *w = NULL;
+	int                maxEnts, maxIov, entHdr, msgHdr, num;
+	
+	if( !vec || !iov || !iovcnt || !size ) {
+		debug_lr( VEC_DEBUG, "Error: args, infoVecGetWindowIov\n" );
+		return NULL;
+	}
+
+	// The local entry and the window. Each entry adds a header and the
+	// payload, a delta entry at most one chunk for every two of the mask
+	maxEnts = vec->win.size + 1;
+	maxIov  = vec->deltaWin ? 1 + IVEC_DELTA_CHUNKS / 2 : 2;
+	entHdr  = vec->deltaWin ? INFO_DELTA_ENTRY_SIZE : INFO_MSG_ENTRY_SIZE;
+	msgHdr  = vec->deltaWin ? INFO_DELTA_MSG_SIZE : INFO_MSG_SIZE;
+	if( !( w = ivec_win_iov_new( vec, maxEnts, maxIov, entHdr, msgHdr )))
+		return NULL;
+
+	if( vec->deltaWin ) {
+		info_delta_msg_t *dmsg = (info_delta_msg_t *)w->hdrBuff;
+
+		dmsg->magic  = INFO_MSG_DELTA_MAGIC;
+		dmsg->flags  = 0;
+		w->deltaFull = ( vec->deltaWinNum++ % IVEC_DELTA_FULL_EVERY ) == 0;
+		num = ivec_walk_window( vec, 1, vec->msg_buff_size - 4096,
+					addEntToDeltaIov, w );
+	}
+	else
+		num = ivec_walk_window( vec, size_flag, vec->msg_buff_size - 4096,
+					addEntToIov, w );
+	if( num < 0 ) {
+		infoVecWindowIovDone( w );
+		return NULL;
+	}
+	return ivec_win_iov_done( vec, w, num, iov, iovcnt, size );
+}
+
+/****************************************************************************
+ * Take one more reference on a window returned by infoVecGetWindowIov(), so
+ * the same message can be given to several sends. Each reference is
+ * released by infoVecWindowIovDone().
+ ***************************************************************************/
+void
+infoVecWindowIovRef( void *handle ) {
+
+	ivec_win_iov_t *w = (ivec_win_iov_t *)handle;
+
+	if( w )
+		w->refs++;
+}
+
+/****************************************************************************
+ * Release a window returned by infoVecGetWindowIov(). The window is freed
+ * with its last reference. May be called after the vector was freed.
+ ***************************************************************************/
+void
+infoVecWindowIovDone( void *handle ) {
+
+	ivec_win_iov_t *w = (ivec_win_iov_t *)handle;
+
+	if( !w || --w->refs > 0 )
+		return;
+	for( int i = 0 ; i < w->numRecs ; i++ )
+		info_arena_unref( w->arena, w->recs[ i ] );
+	free( w );
+}
+
+/****************************************************************************
+ * Turn delta windows on/off for infoVecGetWindowIov()
+ ***************************************************************************/
+void
+infoVecSetDeltaWindows( ivec_t vec, int on ) {
+	if( !vec )
+		return;
+	vec->deltaWin    = on;
+	vec->deltaWinNum = 0;
+}
+
+/****************************************************************************
+ * The message type to send the windows of infoVecGetWindowIov() with
+ ***************************************************************************/
+int
+infoVecWindowMsgType( ivec_t vec ) {
+	return ( vec && vec->deltaWin ) ? INFOD_MSG_TYPE_INFO_DELTA :
+		INFOD_MSG_TYPE_INFO;
+}
+
+/****************************************************************************
+ * Digest pulls. The digest gives the age of every entry we hold (not the
+ * ones never heard of), the local entry with age 0 so it is never sent
+ * back. Ages and not times are compared, so the clocks of the two nodes
+ * do not matter. The buffer returned is reused by the next call.
+ ***************************************************************************/
+void*
+infoVecGetDigest( ivec_t vec, int *size ) {
+
+	info_pull_msg_t   *msg;
+	struct timeval     now;
+	unsigned long      age;
+	int                i;
+
+	if( !vec || !size ) {
+		debug_lr( VEC_DEBUG, "Error: args, infoVecGetDigest\n" );
+		return NULL;
+	}
+	ivec_gettime( &now );
+	
+	msg = vec->digest;
+	msg->param = INFO_PULL_DIGEST;
+	msg->num   = 0;
+	for( i = 0 ; i < vec->vsize ; i++ ) {
+		node_info_t *info = vec->vec[ i ].info;
+		
+		if( info->hdr.status & INFOD_DEAD_INIT )
+			continue;
+		age = ( i == vec->localIndex ) ? 0 :
+			compute_age( &info->hdr.time, &now ) / 1000;
+		msg->ents[ msg->num ].IP  = info->hdr.IP;
+		msg->ents[ msg->num ].age = ( age < INFO_DIGEST_NO_AGE ) ?
+			age : INFO_DIGEST_NO_AGE - 1;
+		msg->num++;
+	}
+	*size = INFO_PULL_MSG_SZ + msg->num * INFO_DIGEST_ENT_SZ;
+	return msg;
+}
+
+/*
+ * Add to the answer the alive entries newer than in the digest, starting
+ * where the last answer was cut so big vectors are covered in a few pulls.
+ */
+static int
+ivec_walk_digest( ivec_t vec, info_pull_msg_t *msg, int space,
+		  ivec_win_iov_t *w )
+{
+	int            index, size, num = 0;
+	unsigned long  age;
+	
+	for( int i = 0 ; i < vec->vsize ; i++ )
+		vec->digestAge[ i ] = INFO_DIGEST_NO_AGE;
+	for( unsigned int j = 0 ; j < msg->num ; j++ )
+		if( infoVecFindByIP( vec, &msg->ents[ j ].IP, &index ))
+			vec->digestAge[ index ] = msg->ents[ j ].age;
+
+	ivec_gettime( &vec->currTime );
+	if( vec->digestPos >= vec->vsize )
+		vec->digestPos = 0;
+	
+	for( int k = 0 ; k < vec->vsize ; k++ ) {
+		int           i     = ( vec->digestPos + k ) % vec->vsize;
+		ivec_entry_t *entry = &vec->vec[ i ];
+		
+		if( entry->isdead )
+			continue;
+		age = compute_age( &entry->info->hdr.time, &vec->currTime ) / 1000;
+		if( vec->digestAge[ i ] != INFO_DIGEST_NO_AGE &&
+		    age >= vec->digestAge[ i ] )
+			continue;
+
+		size = entry->info->hdr.fsize;
+		if( INFO_MSG_ENTRY_SIZE + size > space ) {
+			vec->digestPos = i;
+			break;
+		}
+		if( !addEntToIov( vec, i, size, 0, w ))
+			break;
+		space -= INFO_MSG_ENTRY_SIZE + size;
+		num++;
+	}
+	return num;
+}
+
+/****************************************************************************
+ * The answer to a digest pull of size bytes, as a scatter/gather window
+ * (of INFOD_MSG_TYPE_INFO) with only the entries newer than in the digest.
+ * Released as the windows of infoVecGetWindowIov().
+ ***************************************************************************/
+void*
+infoVecGetDigestAnswerIov( ivec_t vec, void *digest, int digestSize,
+			   struct iovec **iov, int *iovcnt, int *size )
+{
+	info_pull_msg_t   *msg = (info_pull_msg_t *)digest;
+	ivec_win_iov_t    *w;
+	int                num;
+	
+	if( !vec || !msg || !iov || !iovcnt || !size ||
+	    digestSize < (int)INFO_PULL_MSG_SZ ) {
+		debug_lr( VEC_DEBUG, "Error: args, infoVecGetDigestAnswerIov\n" );
+		return NULL;
+	}
+	if( msg->param != INFO_PULL_DIGEST ||
+	    msg->num > ( digestSize - INFO_PULL_MSG_SZ ) / INFO_DIGEST_ENT_SZ ) {
+		debug_lr( VEC_DEBUG, "Error: bad digest pull message\n" );
+		return NULL;
+	}
+
+	if( !( w = ivec_win_iov_new( vec, vec->vsize, 2, INFO_MSG_ENTRY_SIZE,
+				     INFO_MSG_SIZE )))
+		return NULL;
+	num = ivec_walk_digest( vec, msg, vec->msg_buff_size - 4096, w );
+	debug_ly( WIN_DEBUG, "Digest answer: %d entries to %d in digest\n",
+		  num, msg->num );
+	return ivec_win_iov_done( vec, w, num, iov, iovcnt, size );
+}
+
+/*
+ * Rebuild the full record of a delta entry in vec->deltaBuff, on top of
+ * the record held in the vector. Returns NULL if the entry can not be
+ * applied (the version held is not covered by the delta).
+ */
+static node_info_t *
+ivec_apply_delta( ivec_t vec, info_delta_entry_t *ent ) {
+
+	ivec_entry_t   *entry;
+	ivec_delta_t   *d;
+	node_info_t    *rec;
+	char           *src;
+	int             index, fsize, dataSize, chunk, c;
+	
+	if( !( entry = infoVecFindByIP( vec, &ent->data->hdr.IP, &index )))
+		return NULL;
+	d = &vec->delta[ index ];
+	fsize = ent->data->hdr.fsize;
+	
+	if( !d->version || d->version < ent->base ||
+	    d->version >= ent->version || entry->info->hdr.fsize != fsize ) {
+		debug_lb( VEC_DEBUG, "Skipping delta of %s: have %u need %u..%u\n",
+			  inet_ntoa( ent->data->hdr.IP ), d->version,
+			  ent->base, ent->version );
+		return NULL;
+	}
+
+	if( vec->deltaBuffSize < fsize ) {
+		char *buff;
+		if( !( buff = realloc( vec->deltaBuff, fsize ))) {
+			debug_lr( VEC_DEBUG, "Error: malloc, delta buffer\n" );
+			return NULL;
+		}
+		vec->deltaBuff     = buff;
+		vec->deltaBuffSize = fsize;
+	}
+	rec = (node_info_t *)vec->deltaBuff;
+	memcpy( rec, entry->info, fsize );
+	memcpy( &rec->hdr, &ent->data->hdr, NHDR_SZ );
+
+	dataSize = fsize - NHDR_SZ;
+	chunk    = ivec_delta_chunk( dataSize );
+	src      = ent->data->data;
+	for( c = 0 ; c < IVEC_DELTA_CHUNKS && c * chunk < dataSize ; c++ ) {
+		int len;
+		
+		if( !( ent->mask & ( 1ULL << c )))
+			continue;
+		len = ( dataSize - c * chunk < chunk ) ? dataSize - c * chunk : chunk;
+		if( src + len > (char *)ent + ent->size ) {
+			debug_lr( VEC_DEBUG, "Error: delta entry too short\n" );
+			return NULL;
+		}
+		memcpy( rec->data + c * chunk, src, len );
+		src += len;
+	}
+	return rec;
+}
+
+/*
+ * Handle the rumors section which may follow the entries of a window
+ */
+static void
+ivec_use_rumors( ivec_t vec, char *buff, int len, struct timeval *curtime ) {
+
+	info_rumor_msg_t   *rmsg = (info_rumor_msg_t *)buff;
+	info_msg_entry_t   *ptr;
+	unsigned int        i, curlen = INFO_RUMOR_MSG_SIZE;
+
+	if( len < (int)INFO_RUMOR_MSG_SIZE || rmsg->magic != INFO_MSG_RUMOR_MAGIC )
+		return;
+	if( rmsg->size > (unsigned int)len ) {
+		debug_lr( VEC_DEBUG, "Error: bad rumors section\n" );
+		return;
+	}
+	for( i = 0 ; i < rmsg->num ; i++, curlen += ptr->size ) {
+		ptr = (info_msg_entry_t *)( buff + curlen );
+		if( curlen + INFO_MSG_ENTRY_SIZE + NHDR_SZ > rmsg->size ||
+		    ptr->size < (int)( INFO_MSG_ENTRY_SIZE + NHDR_SZ ) ||
+		    curlen + ptr->size > rmsg->size ) {
+			debug_lr( VEC_DEBUG, "Error: bad rumor entry\n" );
+			return;
+		}
+		if( ipEqual( &ptr->data->hdr.IP, &vec->localIP ))
+			continue;
+		ivec_age2time( ptr->data, curtime );
+		ivec_update_entry( vec, ptr->data, ptr->size - INFO_MSG_ENTRY_SIZE,
+				   ptr->priority, 0 );
+	}
+}
+
+/*
+ * Handle a delta window, full entries are used as is and deltas are
+ * applied on top of the record the vector holds.
+ */
+static int
+ivec_use_delta_window( ivec_t vec, info_delta_msg_t *msg, int size ) {
+	
+	info_delta_entry_t   *ent;
+	struct timeval        curtime;
+	unsigned int          i, curlen = INFO_DELTA_MSG_SIZE;
+
+	ivec_gettime( &curtime );
+	
+	for( i = 0; i < msg->num ; i++, curlen += ent->size ) {
+		node_info_t *rec;
+		
+		ent = (info_delta_entry_t *)((char *)msg + curlen);
+		if( ent->size < (int)( INFO_DELTA_ENTRY_SIZE + NHDR_SZ ) ||
+		    (int)( curlen + ent->size ) > size ) {
+			debug_lr( VEC_DEBUG, "Error: bad delta window entry\n" );
+			return 0;
+		}
+		// Skeeping the entry if it belong to local node
+		if( ipEqual( &ent->data->hdr.IP, &vec->localIP ))
+			continue;
+
+		ivec_age2time( ent->data, &curtime );
+		if( !ent->base ) 
+			ivec_update_entry( vec, ent->data, ent->size - INFO_DELTA_ENTRY_SIZE,
+					   ent->priority, ent->version );
+		else if(( rec = ivec_apply_delta( vec, ent )))
+			ivec_update_entry( vec, rec, rec->hdr.fsize,
+					   ent->priority, ent->version );
+	}
+	ivec_use_rumors( vec, (char *)msg + curlen, size - (int)curlen, &curtime );
+	return 1;
+}
+
+/****************************************************************************
+ * Handle an info message from another infod. Both regular and delta
+ * windows are accepted.
+ ***************************************************************************/
+int
+infoVecUseRemoteWindow( ivec_t vec, void *buff, int size ) {
+	
+	info_msg_t           *msg = (info_msg_t*)buff;
+	info_msg_entry_t     *ptr  = NULL;
+	void                 *data = NULL;
 	struct timeval        curtime;
 	unsigned int          i = 0,  curlen = 0;
+	int                   batchNum = 0;
 	
 	if( !vec || !buff || ( size < INFO_MSG_SIZE ) ) {
 		debug_lr( VEC_DEBUG, "Error: args, handle_msg\n" );
@@ -1523,7 +3285,11 @@ infoVecUseRemoteWindow( ivec_t vec, void *buff, int size ) {
 		return 0;
 	}
 	
-	gettimeofday( &curtime, NULL );
+	if( size >= INFO_DELTA_MSG_SIZE &&
+	    ((info_delta_msg_t *)msg)->magic == INFO_MSG_DELTA_MAGIC )
+		return ivec_use_delta_window( vec, (info_delta_msg_t *)msg, size );
+	
+	ivec_gettime( &curtime );
 
 		
 	data = msg->data;
@@ -1532,7 +3298,8 @@ infoVecUseRemoteWindow( ivec_t vec, void *buff, int size ) {
 	
 	for( i = 0; i < msg->num ; i++ )
 	{
-		int info_sz = 0;
+		ivec_update_t *up;
+		
 		ptr = data + curlen;
 		// Skeeping the entry if it belong to local node
 		if (ipEqual(&ptr->data->hdr.IP, &vec->localIP)) {
@@ -1540,8 +3307,6 @@ infoVecUseRemoteWindow( ivec_t vec, void *buff, int size ) {
 			continue;
 		}
 		
-		info_sz = ptr->size - INFO_MSG_ENTRY_SIZE;
-
 		// Moving the time of the new information from age to creation time
 		ivec_age2time( ptr->data, &curtime );
 		debug_ly( WIN_DEBUG, "Win Entry: IP (%s) st(%d) Time( %d, %d )\n",
@@ -1549,10 +3314,22 @@ infoVecUseRemoteWindow( ivec_t vec, void *buff, int size ) {
 			  ptr->data->hdr.status,
 			  ptr->data->hdr.time.tv_sec,
 			  ptr->data->hdr.time.tv_usec );
-		// Updating the vector and the window
-		infoVecUpdate( vec, ptr->data, info_sz, ptr->priority );
+
+		// Updating the vector and the window, a batch at a time
+		up = &vec->batch[ batchNum++ ];
+		up->info     = ptr->data;
+		up->size     = ptr->size - INFO_MSG_ENTRY_SIZE;
+		up->priority = ptr->priority;
+		up->version  = 0;
+		if( batchNum == vec->vsize ) {
+			infoVecUpdateBatch( vec, vec->batch, batchNum );
+			batchNum = 0;
+		}
 		curlen += ptr->size;
 	}
+	infoVecUpdateBatch( vec, vec->batch, batchNum );
+	ivec_use_rumors( vec, (char *)data + curlen,
+			 size - (int)INFO_MSG_SIZE - (int)curlen, &curtime );
 	return 1;
 }
 
@@ -1583,47 +3360,11 @@ ivec_get_any_rand( ivec_t vec ) {
 static int
 ivec_get_rand_active( ivec_t vec )
 {
-
-	int rand_node = 0, num = 0, i = 0;
-	int live_nodes = vec->numAlive;
-      
-
-	// If the local node is alive we does not take it into account
-	if(vec->vec[vec->localIndex].isdead == 0)
-		live_nodes--;
-	
 	// No live nodes or only the local node is alive
-	if( live_nodes <= 0 ) {
-		return -1;
-	}
-
-	// An easy case
-	if( vec->numAlive == vec->vsize )
-		return ivec_get_any_rand( vec );
-	
-	// Both dead nodes and live nodes exists
-	rand_node = (int)( rand() % live_nodes);
-	for( i = 0; i < vec->vsize ; i++ ) {
-		if( ( vec->vec[i].isdead == 0 ) &&
-		    ( !ipEqual(&(vec->vec[i].info->hdr.IP), &(vec->localIP) ) ))
-		{
-			if( num == rand_node )
-				break;
-			num++;
-		}
-	}
-	if( i == vec->vsize ) {
-		debug_lr( VEC_DEBUG, "Error: rand node %d %d\n",
-			  rand_node, num );
+	if( vec->numAlivePeers <= 0 )
 		return -1;
-	}
 
-	struct in_addr ip;
-	indexToIp(vec, rand_node, &ip);
-	//debug_ly(INFOD_DEBUG, "+++++++++++++++++> randomizing from    ACTIVE        %d  %s\n",
-	//rand_node, inet_ntoa(ip));
-		
-	return i;
+	return vec->alivePeers[ rand() % vec->numAlivePeers ];
 }
 
 /****************************************************************************
@@ -1666,47 +3407,108 @@ infoVecRandomNode( ivec_t vec, int onlyAlive, struct in_addr *ip ) {
 	debug_ly(INFOD_DEBUG, "%%%%%%%%%%%%%%%  Random node   %s\n", inet_ntoa(*ip));
 	return 1;
 }
+/****************************************************************************
+ * Get a random alive node inside (inCluster == 1) or outside (0) the mapper
+ * cluster of the local node. Picks from all the alive peers until one is
+ * on the right side, and falls back to a scan when that side is small.
+ ***************************************************************************/
+#define IVEC_CLUSTER_RAND_TRIES     (16)
+
+int
+infoVecRandomClusterNode( ivec_t vec, int inCluster, struct in_addr *ip ) {
+
+	int i, index, start;
+
+	if( !vec || !ip ) {
+		debug_lr( VEC_DEBUG, "Error: args, infoVecRandomClusterNode\n" );
+		return 0;
+	}
+	inCluster = inCluster ? 1 : 0;
+	if( infoVecNumAliveInCluster( vec, inCluster ) <= 0 )
+		return 0;
+
+	for( i = 0 ; i < IVEC_CLUSTER_RAND_TRIES ; i++ ) {
+		index = vec->alivePeers[ rand() % vec->numAlivePeers ];
+		if( vec->inCluster[ index ] == inCluster )
+			goto found;
+	}
+	start = rand() % vec->numAlivePeers;
+	for( i = 0 ; i < vec->numAlivePeers ; i++ ) {
+		index = vec->alivePeers[ ( start + i ) % vec->numAlivePeers ];
+		if( vec->inCluster[ index ] == inCluster )
+			goto found;
+	}
+	return 0;
+
+ found:
+	indexToIp( vec, index, ip );
+	return 1;
+}
+
+/****************************************************************************
+ * The number of alive nodes (other than the local one) inside/outside the
+ * cluster of the local node
+ ***************************************************************************/
+int
+infoVecNumAliveInCluster( ivec_t vec, int inCluster ) {
+
+	if( !vec )
+		return 0;
+	return inCluster ? vec->numAliveClusterPeers :
+		vec->numAlivePeers - vec->numAliveClusterPeers;
+}
+
 /****************************************************************************
  * Getting the oldest alive node, for the pull query
  ***************************************************************************/
 int
 infoVecOldestNode( ivec_t vec, struct in_addr *ip ) {
 
-	unsigned int    i = 0, oldestIndex = -1;
-	unsigned long   age = 0;
-	unsigned long   oldestAge = 0;
-	double          oldestAgeF;
+	iheap_node_t   *oldest;
 	struct timeval  cur;
-	int             res = 0;
+	double          oldestAgeF;
 	
 	if( !vec ) {
 		debug_lr( VEC_DEBUG, "Error: args, stats\n" );
 		return 0;
 	}
 	
-	gettimeofday( &cur, NULL );
+	if( !( oldest = iheap_get_min( &vec->oldest )))
+		return 0;
+
+	ivec_gettime( &cur );
+	oldestAgeF = (double)compute_age( &(vec->vec[ oldest->id ].info->hdr.time),
+					  &cur ) / (double)MILLI;
+	indexToIp(vec, oldest->id, ip);
+	debug_ly(INFOD_DEBUG, "%%%%%%%%%%%%%%%  Oldest node:   %s (%.3f)\n",
+		 inet_ntoa(*ip), oldestAgeF);
+	return 1;
+}
+
+/****************************************************************************
+ * Getting the k oldest alive nodes, oldest first. Returns their number
+ ***************************************************************************/
+int
+infoVecOldestNodes( ivec_t vec, struct in_addr *ips, int k ) {
+
+	iheap_node_t   *nodes;
+	int             i, n;
 	
-	for( i = 0; i < vec->vsize ; i++ ) {
-		if( vec->vec[i].isdead == 0 ) {
-			
-			age = compute_age( &(vec->vec[i].info->hdr.time),
-					   &cur );
-			if(age > oldestAge && i != vec->localIndex)
-			{
-				oldestAge = age;
-				oldestIndex = i;
-			}
-		}
+	if( !vec || !ips || k <= 0 ) {
+		debug_lr( VEC_DEBUG, "Error: args, infoVecOldestNodes\n" );
+		return 0;
 	}
-	oldestAgeF = (double)oldestAge/(double)MILLI;
 
-	if(oldestIndex != -1) {
-		res = 1;
-		indexToIp(vec, oldestIndex, ip);
-		debug_ly(INFOD_DEBUG, "%%%%%%%%%%%%%%%  Oldest node:   %s (%.3f)\n",
-			 inet_ntoa(*ip), oldestAgeF);
+	if( !(nodes = malloc( k * sizeof(iheap_node_t)))) {
+		debug_lr( VEC_DEBUG, "Error: malloc, infoVecOldestNodes\n" );
+		return 0;
 	}
-	return res;
+	if( ( n = iheap_smallest( &vec->oldest, nodes, k )) < 0 )
+		n = 0;
+	for( i = 0 ; i < n ; i++ )
+		indexToIp( vec, nodes[i].id, &ips[i] );
+	free( nodes );
+	return n;
 }
 
 /****************************************************************************
@@ -1715,42 +3517,135 @@ infoVecOldestNode( ivec_t vec, struct in_addr *ip ) {
 int
 infoVecStats( ivec_t vec, infod_stats_t *stats ) {
 	
-	unsigned int    i = 0, num = 0;
-	unsigned long   age = 0;
-	double          ageF;
-	double          ageSum = 0.0;
+	ivec_stats_t   *st;
+	iheap_node_t   *oldest;
 	struct timeval  cur;
+	long long       oldestTime = -1;
+	double          ageNow;
+	info_arena_stats_t arenaStats;
 	
 	if( !vec || !stats ) {
 		debug_lr( VEC_DEBUG, "Error: args, stats\n" );
 		return 0;
 	}
+	st = &vec->stats;
 	
 	stats->total_num  = vec->vsize;
 	stats->num_alive  = vec->numAlive;
 	stats->maxage = 0.0;
-	gettimeofday( &cur, NULL );
-	
-	for( i = 0; i < vec->vsize ; i++ ) {
-		if( vec->vec[i].isdead == 0 ) {
-			
-			age = compute_age( &(vec->vec[i].info->hdr.time),
-					   &cur );
-			// Summing the ages in a double since we dont want to
-			// get an overflow as we did in 256 cluster
-			ageF = (double)age/(double)MILLI;
-			if(ageF > stats->maxage)
-				stats->maxage = ageF;
-			ageSum += ageF;
-			num++;
+	stats->avgage = 0.0;
+	stats->agep50 = 0.0;
+	stats->agep95 = 0.0;
+	ivec_gettime( &cur );
+
+	if( st->num > 0 ) {
+		// The times are summed relative to init_time
+		ageNow = (double)( ivec_time_usec( &cur ) -
+				   ivec_time_usec( &vec->init_time ));
+		stats->avgage = ( ageNow - (double)st->timeSum / st->num ) / MILLI;
+
+		// The oldest is the oldest peer or the local entry
+		if(( oldest = iheap_get_min( &vec->oldest )))
+			oldestTime = st->ent[ oldest->id ].time;
+		if( st->ent[ vec->localIndex ].counted &&
+		    ( oldestTime == -1 ||
+		      st->ent[ vec->localIndex ].time < oldestTime ))
+			oldestTime = st->ent[ vec->localIndex ].time;
+		if( oldestTime != -1 )
+			stats->maxage = (double)( ivec_time_usec( &cur ) - oldestTime ) / MILLI;
+
+		ivec_hist_fit( vec, &cur );
+		stats->agep50 = ivec_hist_age( vec, &cur, 0.50 );
+		stats->agep95 = ivec_hist_age( vec, &cur, 0.95 );
+	}
+
+	info_arena_get_stats( vec->arena, &arenaStats );
+	stats->heapsize = (double)arenaStats.reserved;
+	stats->heapused = (double)arenaStats.used;
+	return 1;
+}
+
+/****************************************************************************
+ * Provider totals
+ ***************************************************************************/
+/* Keep a heap for each value of the mask, and only for them */
+static int
+ivec_stats_set_max_heaps( ivec_t vec, int maxMask ) {
+	ivec_stats_t *st = &vec->stats;
+	int           v;
+
+	for( v = 0 ; v < IVEC_SUM_VALS ; v++ ) {
+		int had = st->maxMask & ( 1 << v ), want = maxMask & ( 1 << v );
+
+		if( had && !want ) {
+			iheap_free( &st->maxHeap[ v ] );
+			st->maxMask &= ~( 1 << v );
+		}
+		else if( want && !had ) {
+			if( !iheap_init( &st->maxHeap[ v ], WIN_HEAP_ARITY,
+					 vec->vsize, vec->vsize )) {
+				debug_lr( VEC_DEBUG, "Error: maximum heap\n" );
+				return 0;
+			}
+			st->maxMask |= ( 1 << v );
 		}
 	}
+	return 1;
+}
 
-	//fprintf(stderr, "Max age %.1f\n", stats->maxage);
-	stats->avgage = (double)ageSum/(double)num;
+int
+infoVecSetSumFunc( ivec_t vec, ivec_sum_func_t func, int numVals,
+		   int maxMask ) {
+	if( !vec || numVals < 0 || numVals > IVEC_SUM_VALS ) {
+		debug_lr( VEC_DEBUG, "Error: args, infoVecSetSumFunc\n" );
+		return 0;
+	}
+	if( !func )
+		numVals = maxMask = 0;
+	maxMask &= ( 1 << numVals ) - 1;
+	// Already counted with this function
+	if( vec->stats.sumFunc == func && vec->stats.numVals == numVals &&
+	    vec->stats.maxMask == maxMask )
+		return 1;
+	
+	vec->stats.sumFunc = func;
+	vec->stats.numVals = numVals;
+	if( !ivec_stats_set_max_heaps( vec, maxMask )) {
+		ivec_stats_set_max_heaps( vec, 0 );
+		vec->stats.sumFunc = NULL;
+		vec->stats.numVals = 0;
+		ivec_stats_rebuild( vec );
+		return 0;
+	}
+	ivec_stats_rebuild( vec );
 	return 1;
 }
 
+int
+infoVecGetSums( ivec_t vec, double *sums, double *maxs ) {
+	ivec_stats_t *st;
+	iheap_node_t *top;
+	int           v;
+	
+	if( !vec ) {
+		debug_lr( VEC_DEBUG, "Error: args, infoVecGetSums\n" );
+		return 0;
+	}
+	st = &vec->stats;
+
+	if( sums )
+		memcpy( sums, st->sums, st->numVals * sizeof(double) );
+	if( maxs ) {
+		for( v = 0 ; v < st->numVals ; v++ ) {
+			maxs[ v ] = 0;
+			if( ( st->maxMask & ( 1 << v )) &&
+			    ( top = iheap_get_min( &st->maxHeap[ v ] )))
+				maxs[ v ] = st->ent[ top->id ].vals[ v ];
+		}
+	}
+	return st->num;
+}
+
 /****************************************************************************
  * Access functions
  ***************************************************************************/
@@ -1787,14 +3682,10 @@ infoVecNumDead( ivec_t vec ){
 int
 infoVecGetWinSize( ivec_t vec ) {
 
-	int i = 0;
 	if( !vec )
 		return -1;
 	
-	for( i = 0 ; i < vec->win.size ; i++ )
-		if( vec->win.data[i].index == -1 )
-			break;
-	return i;
+	return iheap_size( &vec->win.heap );
 }
 
 /****************************************************************************
@@ -1823,7 +3714,7 @@ ivec_print_vec( ivec_t vec ) {
 	int i = 0;
 	struct timeval cur;
 
-	gettimeofday( &cur, NULL );
+	ivec_gettime( &cur );
 	debug_ly( VEC_DEBUG, "\n========= Vector ==========\n\n" );
 	
 	for( i = 0 ; i < vec->vsize ; i++ )
@@ -1856,7 +3747,7 @@ ivec_print_by_age( ivec_t vec)
 	int *indexArr;
 	struct timeval cur;
 
-	gettimeofday( &cur, NULL );
+	ivec_gettime( &cur );
 
         if(alive <= 0) {
                 debug_lr( VEC_DEBUG, "\n======= Vector doe not conatian alive nodes ========\n\n" );
@@ -1918,7 +3809,7 @@ ivec_print_win( ivec_t vec ) {
 	ivec_entry_t *entry = NULL;
 	struct timeval cur;
 
-	gettimeofday( &cur, NULL );
+	ivec_gettime( &cur );
 	debug_ly( WIN_DEBUG, "\n========= Window  ==========\n\n" );
 	
 	for( i = 0 ; i < vec->win.size; i++ ) {
@@ -1968,6 +3859,7 @@ infoVecPrint( FILE *f, ivec_t vec, int flag ) {
 		    infoVecPrintContIPs( vec );
 		    break;
 	    case 2:
+		    ivec_win_sort( vec );
 		    ivec_print_win( vec );
 		    break;
 	    case 3:
@@ -2052,7 +3944,7 @@ void infoVecSetEntriesUptoageMeasure(ivec_t vec, int samples, float *ageArr, int
           vec->entriesUptoageMeasure.im_ageArr[i] = ageArr[i];
           vec->entriesUptoageMeasure.im_entriesUpto[i] = 0.0;
      }
-     printf("Setting upto size %d\n", vec->entriesUptoageMeasure.im_size);
+     debug_lg(VEC_DEBUG, "Setting upto size %d\n", vec->entriesUptoageMeasure.im_size);
 }
 
 void infoVecGetEntriesUptoageMeasure(ivec_t vec, ivec_entries_uptoage_measure_t *m) {
@@ -2073,7 +3965,7 @@ void infoVecDoEntriesUptoageMeasure(ivec_t vec) {
           return;
      
      // Obtaining the current number of entries upto a given age
-     gettimeofday( &cur, NULL );
+     ivec_gettime( &cur );
      memset(entriesArr, 0, sizeof(int) * INFOVEC_ENTRIES_UPTO_SIZE);
      for(int v = 0; v < vec->vsize ; v++ ) {
           if( vec->vec[v].isdead) continue;
@@ -25,6 +25,7 @@
 #define _MOSIX_INFO_VEC
 
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <info.h>
 #include <Mapper.h>
 
@@ -62,6 +63,11 @@ ivec_t infoVecInit( mapper_t map,
                     int resolvHosts
                     );
 
+/* The clock all the vectors take the current time from, gettimeofday()
+   when NULL (a virtual clock for simulations) */
+typedef void (*ivec_clock_func_t)( struct timeval *now );
+void infoVecSetClock( ivec_clock_func_t func );
+
 /* free the ivec_t data structure */
 void infoVecFree( ivec_t vec );
 
@@ -73,9 +79,26 @@ ivec_entry_t* infoVecFindByIP( ivec_t vec, struct in_addr *ip, int *index);
 int infoVecUpdate( ivec_t vec, node_info_t* update, int size,
 		 unsigned int priority );
 
+/* update several entries at once (e.g. a whole remote window). index is
+   set by the function, -1 for entries not in the vector. Returns the
+   number of entries updated */
+typedef struct ivec_update {
+	node_info_t   *info;
+	int            size;
+	unsigned int   priority;
+	unsigned int   version;     // 0 if not known
+	int            index;
+} ivec_update_t;
+
+int infoVecUpdateBatch( ivec_t vec, ivec_update_t *ups, int num );
+
 /* punish a node - that did not accept a connection */
 int infoVecPunish( ivec_t vec, struct in_addr *ip, unsigned int cause ) ;
 
+/* punish the nodes whose information is older than max_age. Called
+   periodically, the queries below do not check the age of the entries */
+int infoVecExpire( ivec_t vec );
+
 char *
 infoVecPackQueryReplay( ivec_entry_t** ivecptr, int size, char *buff, int *buffSize);
 
@@ -99,6 +122,27 @@ infoVecGetEntriesByAge( ivec_t vec, unsigned long max_age, int* size );
 /* Prepare a window message to be sent to another infod */
 void*    infoVecGetWindow( ivec_t vec, int *size, int size_flag  );
 
+/* The same message as a scatter/gather list pointing to the vector records.
+   Returns a handle to pass to infoVecWindowIovDone() when the send is over.
+   infoVecWindowIovRef() shares the message with one more send */
+void*    infoVecGetWindowIov( ivec_t vec, int size_flag, struct iovec **iov,
+			      int *iovcnt, int *size );
+void     infoVecWindowIovRef( void *handle );
+void     infoVecWindowIovDone( void *handle );
+
+/* Send windows as deltas against the versions the receivers hold. The
+   message type of the windows is given by infoVecWindowMsgType() */
+void     infoVecSetDeltaWindows( ivec_t vec, int on );
+int      infoVecWindowMsgType( ivec_t vec );
+
+/* Digest pulls: the pull message with the ages of our entries (a buffer
+   reused by the next call), and the answer to one, a window of
+   INFOD_MSG_TYPE_INFO with the entries newer than in the digest, released
+   with infoVecWindowIovDone() */
+void*    infoVecGetDigest( ivec_t vec, int *size );
+void*    infoVecGetDigestAnswerIov( ivec_t vec, void *digest, int digestSize,
+				    struct iovec **iov, int *iovcnt, int *size );
+
 /* Handle an information message from another infod */
 int      infoVecUseRemoteWindow( ivec_t vec, void *buff, int size );
 
@@ -114,10 +158,58 @@ int      infoVecUseRemoteWindow( ivec_t vec, void *buff, int size );
 int   infoVecRandomNode( ivec_t vec, int only_alive, struct in_addr *ip );
 
 /*
- * Get the oldest alive node
+ * Get a random alive node inside (inCluster == 1) or outside (0) the mapper
+ * cluster of the local node, and the number of alive nodes there
+ */
+int   infoVecRandomClusterNode( ivec_t vec, int inCluster, struct in_addr *ip );
+int   infoVecNumAliveInCluster( ivec_t vec, int inCluster );
+
+/*
+ * Get the oldest alive node, or the k oldest ones (oldest first)
  */
 int   infoVecOldestNode( ivec_t vec, struct in_addr *ip );
+int   infoVecOldestNodes( ivec_t vec, struct in_addr *ips, int k );
+
+
+/*
+ * Snapshots of the entries for serving clients. infoVecPublish (called
+ * once a time step) copies the entries into a new generation if the
+ * vector changed. A snapshot is never changed and its records stay valid
+ * until released, so a reply can be built from it while the vector goes
+ * on updating. The snapshots are not thread safe: publish, acquire and
+ * release must all be called from the thread which updates the vector.
+ */
+typedef struct ivec_snapshot *ivec_snap_t;
 
+int            infoVecPublish( ivec_t vec );
+ivec_snap_t    infoVecSnapshotAcquire( ivec_t vec );
+void           infoVecSnapshotRelease( ivec_snap_t snap );
+unsigned long  infoVecSnapshotGeneration( ivec_snap_t snap );
+int            infoVecSnapshotSize( ivec_snap_t snap );
+ivec_entry_t** infoVecSnapshotGetAllEntries( ivec_snap_t snap );
+
+/*
+ * Checkpoint of the alive entries (written to a temporary file and renamed
+ * in place) and restoring it at startup. The entries keep their original
+ * times, so they age and expire as if infod never stopped. Restore returns
+ * the number of entries restored, -1 if the file is missing or does not
+ * match the vector description.
+ */
+int            infoVecCheckpoint( ivec_t vec, const char *path );
+int            infoVecRestore( ivec_t vec, const char *path );
+
+/*
+ * Column store of the fixed size items (base and extra, not strings) of
+ * the description, as returned by create_info_mapping(). Each column is an
+ * array of vsize items of the item type, indexed as infoVecGetVec(), and
+ * is kept up to date by the updates. The alive column holds 1 for the
+ * alive entries. Setting a NULL mapping drops the columns.
+ */
+struct variable_map;
+
+int            infoVecSetColumns( ivec_t vec, struct variable_map *mapping );
+void*          infoVecGetColumn( ivec_t vec, const char *name, int *itemSize );
+unsigned char* infoVecGetAliveColumn( ivec_t vec );
 
 /* Access funcs */
 ivec_entry_t*     infoVecGetVec( ivec_t vec ) ;
@@ -125,8 +217,25 @@ int               infoVecGetSize( ivec_t vec );
 int               infoVecNumAlive( ivec_t vec );
 int               infoVecNumDead( ivec_t vec );
 int               infoVecStats( ivec_t vec, infod_stats_t *stats );
+
+/*
+ * Provider totals. func gives the values an alive entry adds (at most 4),
+ * the vector keeps their sums as entries change and die, and the maximums
+ * of the values in maxMask (bit v for value v, the others are given as 0).
+ * Setting the same function again costs nothing.
+ * infoVecGetSums returns the number of alive entries.
+ */
+typedef void      (*ivec_sum_func_t)( node_info_t *info, double *vals );
+int               infoVecSetSumFunc( ivec_t vec, ivec_sum_func_t func,
+				     int numVals, int maxMask );
+int               infoVecGetSums( ivec_t vec, double *sums, double *maxs );
 int               infoVecGetWinSize( ivec_t vec );
 
+/* The window parameter as given to infoVecInit (the size of a fixed window
+   or the age in milliseconds of an upto age one), may be changed anytime */
+int               infoVecSetWinParam( ivec_t vec, int winTypeParam );
+int               infoVecGetWinParam( ivec_t vec );
+
 /****************************************************************************
  * Statistics & measurments structure
  ****************************************************************************/
@@ -20,10 +20,17 @@
 #ifndef _MOSIX_INFO_VEC_INTERNAL
 #define _MOSIX_INFO_VEC_INTERNAL
 
+#include <sys/uio.h>
+
+#include <prioHeap.h>
+#include <infoArena.h>
+#include <timeWheel.h>
 
 #define INITIAL_VEC_SIZE (32)
 #define IPV              (4)
 #define MSG_BUFF_SZ      (262144)
+#define WIN_HEAP_ARITY   (4)
+#define EXPIRE_TICK      (10000)  // Expiry resolution, micro seconds
 		
 
 /****************************************************************************
@@ -46,13 +53,18 @@ typedef struct info_win_entry {
    Uptoage */
 typedef int    (*calc_win_size_func_t)    (ivec_t vec);
 
-/* The window */ 
+/* The window. The entries are kept in an indexed heap with the lowest
+   priority (and oldest) entry at the root, so replacing it or updating an
+   entry already in the window is O(log size). data is a snapshot of the
+   heap in priority order which is rebuilt by ivec_win_sort() whenever the
+   window is walked (sending, querying) and is terminated by index -1 */ 
 typedef struct info_win {
      int               size;
+     iheap_t           heap;
      info_win_entry_t *data;
      int               type; // Fix or upto-age
 	
-     int              *aux;
+     iheap_node_t     *aux;        // Scratch space for sorting the heap
      int               sendSize;   // The number of entries to send. 
      int               fixWinSize; // Size of fixed window
      int               uptoAge;    // Maximal age to send.
@@ -84,6 +96,94 @@ typedef struct info_msg {
 	
 } info_msg_t ;
 
+/****************************************************************************
+ * Delta windows. Each entry has a version, given by the node the entry
+ * belongs to, and a short history of which chunks of its data changed in
+ * the last versions. A delta entry carries only the chunks changed since
+ * base. A receiver holding any version in [base, version) can rebuild the
+ * full record from it, others skip the entry and wait for a full one.
+ ***************************************************************************/
+#define IVEC_DELTA_CHUNKS       (64)   // Chunks per record, bits in the mask
+#define IVEC_DELTA_MIN_CHUNK    (16)
+#define IVEC_DELTA_HIST         (8)    // Change masks kept per entry
+#define IVEC_DELTA_FULL_EVERY   (16)   // Every n-th delta window is all full
+
+#define INFO_MSG_DELTA_MAGIC    (-0x0de17a) // Never a valid entry size
+
+typedef struct ivec_delta {
+     unsigned int        version;      // 0 when not known
+     unsigned int        histFrom;     // The history covers (histFrom, version]
+     int                 histLen;
+     unsigned int        histVer[ IVEC_DELTA_HIST ];
+     unsigned long long  histMask[ IVEC_DELTA_HIST ];
+} ivec_delta_t;
+
+/* An entry in a delta window. base is 0 for a full entry, a delta with an
+   empty mask is only the header (the data did not change) */
+typedef struct info_delta_entry {
+     int                 size;
+     int                 priority;
+     unsigned int        version;
+     unsigned int        base;
+     unsigned long long  mask;         // The chunks following the header
+     node_info_t         data[0];
+} info_delta_entry_t;
+
+/* A delta window. magic is where the first entry size of a regular window
+   would be */
+typedef struct info_delta_msg {
+     unsigned long       signature;
+     unsigned int        num;
+     unsigned int        tsize;
+     int                 magic;
+     unsigned int        flags;
+     info_delta_entry_t  data[0];
+} info_delta_msg_t;
+
+/****************************************************************************
+ * Rumors. A death or a revival is sent, besides the window, in a section
+ * of its own after the entries of the next windows (pushes and pull
+ * answers) sent, about log(n) of them, so it does not wait in the window
+ * with the other entries. Nodes learning it that way pass it on. The
+ * entries of the section are as in a regular window, infods which do not
+ * know the section ignore it.
+ ***************************************************************************/
+#define IVEC_RUMOR_MAX          (32)    // Rumors held and sent at once
+#define IVEC_RUMOR_MAX_BYTES    (16384) // Room for them in a window
+
+#define INFO_MSG_RUMOR_MAGIC    (-0x0a1e27)
+
+typedef struct ivec_rumor {
+     int                 index;
+     int                 isdead;       // Dropped once the entry changes
+     int                 left;         // Windows to be sent in
+} ivec_rumor_t;
+
+typedef struct info_rumor_msg {
+     int                 magic;
+     unsigned int        num;
+     unsigned int        size;         // The section, this header included
+     info_msg_entry_t    data[0];
+} info_rumor_msg_t;
+
+/*
+ * A window message built as a scatter/gather list (infoVecGetWindowIov).
+ * One allocation holds the iovec, the pinned records and the buffer with
+ * the message header and the entries prefix and header copies.
+ */
+typedef struct ivec_win_iov {
+     info_arena_t      arena;
+     struct iovec     *iov;
+     int               iovcnt;
+     node_info_t     **recs;       // Records pinned by the iovec
+     int               numRecs;
+     int               maxRecs;
+     char             *hdrBuff;
+     char             *hdrPos;     // Next free byte in hdrBuff
+     int               deltaFull;  // Delta window with only full entries
+     int               refs;       // Sends still holding the window
+} ivec_win_iov_t;
+
 /****************************************************************************
  * Continuous mapping
  ***************************************************************************/
@@ -100,6 +200,111 @@ typedef struct cont_vec {
      int                 size;
 } cont_vec_ips_t;
 
+/****************************************************************************
+ * IP index. Open addressing (linear probing) hash from a host order IP to
+ * the entry index in the vector. Built once when the vector is created and
+ * kept at most half full so lookups are O(1) regardless of how fragmented
+ * the map is.
+ ***************************************************************************/
+typedef struct ip_hash_ent {
+     unsigned int        ip;     // In host order
+     int                 index;  // The index in the vector. -1 is an empty slot
+} ip_hash_ent_t;
+
+typedef struct ip_hash {
+     ip_hash_ent_t      *data;
+     unsigned int        size;   // Number of slots, always a power of 2
+     unsigned int        bits;   // log2(size)
+} ip_hash_t;
+
+
+/****************************************************************************
+ * Running statistics of the alive entries, updated when an entry changes or
+ * dies so a stats request does not scan the vector. Each counted entry
+ * keeps what it added, so it can be taken out exactly.
+ *
+ * The ages come from a histogram of the information times: a sliding
+ * window of buckets whose newest bucket holds the newest time. Older times
+ * are counted in the oldest bucket. The bucket width doubles when too many
+ * entries end up there and halves when the ages use a small part of the
+ * window.
+ ***************************************************************************/
+#define IVEC_AGE_BUCKETS        (128)
+#define IVEC_AGE_MIN_WIDTH      (EXPIRE_TICK)
+#define IVEC_SUM_VALS           (4)
+#define IVEC_COL_NAME_SZ        (32)
+
+typedef struct ivec_ent_stats {
+     int                 counted;
+     long long           time;         // usec
+     double              vals[ IVEC_SUM_VALS ];
+} ivec_ent_stats_t;
+
+typedef struct ivec_stats {
+     ivec_ent_stats_t   *ent;
+     int                 num;
+     long long           timeSum;      // usec since init_time
+     
+     long long           width;        // usec per bucket
+     long long           base;         // The oldest bucket
+     int                 hist[ IVEC_AGE_BUCKETS ];
+
+     ivec_sum_func_t     sumFunc;
+     int                 numVals;
+     int                 maxMask;      // Values whose maximum is kept
+     double              sums[ IVEC_SUM_VALS ];
+     iheap_t             maxHeap[ IVEC_SUM_VALS ]; // Largest value first
+     unsigned long       rebuilds;     // Times all the entries were counted
+} ivec_stats_t;
+
+/****************************************************************************
+ * Column store. The fixed size items of the description, each in an array
+ * indexed as the vector, so scans over an item do not touch the records.
+ ***************************************************************************/
+typedef struct ivec_column {
+     char                name[ IVEC_COL_NAME_SZ ];
+     int                 offset;       // In the node info data
+     int                 size;         // Of an item
+     char               *data;         // vsize items
+} ivec_column_t;
+
+/****************************************************************************
+ * Checkpoint file. A header followed by records of the alive entries, each
+ * a record header and the node info padded to IVEC_CKPT_ALIGN
+ ***************************************************************************/
+#define IVEC_CKPT_MAGIC         (0x69766331)
+#define IVEC_CKPT_ALIGN         (8)
+
+typedef struct ivec_ckpt_hdr {
+     unsigned int        magic;
+     unsigned int        infoVer;      // MSX_INFOD_INFO_VER
+     unsigned long       signature;    // Of the info description
+     int                 num;
+     int                 size;         // Of the whole file
+     struct timeval      time;
+} ivec_ckpt_hdr_t;
+
+typedef struct ivec_ckpt_rec {
+     unsigned int        version;      // For delta windows
+     int                 size;         // Of the record, with the padding
+     node_info_t         info[0];
+} ivec_ckpt_rec_t;
+
+/****************************************************************************
+ * Snapshots. A copy of the entries whose records are pinned in the arena,
+ * so the vector can go on updating (copying a record before changing it)
+ * while the snapshot is read. refs holds one reference for the vector and
+ * one for every reader. Like the arena references it is not atomic, the
+ * snapshot is used by the thread which updates the vector only.
+ ***************************************************************************/
+struct ivec_snapshot {
+     unsigned long         generation;
+     int                   refs;
+     int                   vsize;
+     ivec_entry_t         *vec;
+     info_arena_t          arena;
+     struct ivec_snapshot *next;       // In the vector retired list
+};
 
 /****************************************************************************
  * Vector
@@ -111,9 +316,42 @@ struct ivec {
      struct in_addr      localIP;
      ivec_entry_t       *vec;
      int                 vsize;
+     info_arena_t        arena;         /* holds the info records  */
 
      info_win_t          win;           /* the window              */
      cont_vec_ips_t      contIPs;       /* To speed up searches    */
+     ip_hash_t           ipHash;        /* IP -> index lookup      */
+     twheel_t            expireWheel;   /* alive entries by expiry */
+     int                *alivePeers;    /* indices of alive entries,
+					   other than the local one */
+     int                *alivePos;      /* index -> place in alivePeers,
+					   -1 if not there */
+     int                 numAlivePeers;
+     unsigned char      *inCluster;     /* 1 for the entries in the
+					   local mapper cluster    */
+     int                 numAliveClusterPeers;
+     iheap_t             oldest;        /* alive peers by the time
+					   of their information    */
+     ivec_stats_t        stats;         /* alive entries totals    */
+     ivec_update_t      *batch;         /* remote window updates   */
+     ivec_rumor_t        rumors[ IVEC_RUMOR_MAX ]; /* recent deaths
+					   and revivals to send    */
+     int                 numRumors;
+     info_pull_msg_t    *digest;        /* our digest pull message */
+     unsigned int       *digestAge;     /* ages in a peer digest   */
+     int                 digestPos;     /* where the last answer
+					   was cut                 */
+     ivec_column_t      *cols;          /* fixed items by column   */
+     int                 numCols;
+     unsigned char      *colAlive;      /* 1 for alive entries     */
+     unsigned long       generation;    /* entries changes         */
+     ivec_snap_t         snap;          /* the published snapshot  */
+     ivec_snap_t         retired;       /* older ones still read   */
+     ivec_delta_t       *delta;         /* versions, per entry     */
+     int                 deltaWin;      /* send delta windows      */
+     unsigned int        deltaWinNum;   /* delta windows built     */
+     char               *deltaBuff;     /* scratch to apply deltas */
+     int                 deltaBuffSize;
 
      unsigned long       max_age;       /* maximal age of an entry */
      struct timeval      init_time;     /* intitiation time        */
@@ -142,9 +380,13 @@ struct ivec {
 #define  INFO_WIN_ENTRY_SIZE     (sizeof(info_win_entry_t))
 #define  INFO_WIN_SZ             (sizeof(info_win_t))
 #define  CONT_IP_ENTRY_SIZE      (sizeof(cont_vec_ips_ent_t))
+#define  IP_HASH_ENTRY_SIZE      (sizeof(ip_hash_ent_t))
 #define  INFO_VEC_SIZE           (sizeof(struct ivec))
 #define  INFO_MSG_ENTRY_SIZE     (sizeof(info_msg_entry_t))
 #define  INFO_MSG_SIZE           (sizeof(info_msg_t))
+#define  INFO_DELTA_ENTRY_SIZE   (sizeof(info_delta_entry_t))
+#define  INFO_DELTA_MSG_SIZE     (sizeof(info_delta_msg_t))
+#define  INFO_RUMOR_MSG_SIZE     (sizeof(info_rumor_msg_t))
 
 
 #endif
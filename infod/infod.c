@@ -62,6 +62,7 @@
 #include <info.h>
 #include <info_reader.h>
 #include <info_iter.h>
+#include <info_shm.h>
 
 #include <infoVec.h>
 #include <infod.h>
@@ -106,7 +107,8 @@ void infod_periodic_admin();
 
 int    read_local_info();
 int    infod_reply_client( ivec_entry_t** ivecptr, int size,
-			   comm_inprogress_recv_t* comm_msg );
+			   comm_inprogress_recv_t* comm_msg, int compress );
+int    infod_export_shm();
 
 /****************************************************************************
  * Message handling functions
@@ -134,13 +136,12 @@ node_t* infod_names2pes( char *names, mapper_t map,  int *size );
 int     infod_pes2names( char *buff );
 char   *get_infod_uptime_str();
 
-int prepare_select_data(fd_set *rfds, fd_set *wfds, fd_set *efds, int *max_sock);
 int handle_sighup();
 int handle_select_error();
 
-int handle_kcomm_event(fd_set *rfds, fd_set *wfds, fd_set *efds);
-int handle_ctl_event(fd_set *rfds, fd_set *wfds, fd_set *efds);
-int handle_comm_event(fd_set *rfds, fd_set *wfds, fd_set *efds);
+void watch_local_fds();
+void kcomm_ready( msx_comm_t *comm, int fd, int events, void *arg );
+void ctl_ready( msx_comm_t *comm, int fd, int events, void *arg );
 
 
 
@@ -166,11 +167,10 @@ inline int  unblock_sigalarm();
  *  Communication functinos
  ***************************************************************************/
 int doGossipStep();
-int receive_info( fd_set *set, comm_inprogress_recv_t* comm_msg );
-int send_inpr_info( fd_set *set, struct in_addr *ip );
+void infod_comm_sent( msx_comm_t *comm, int res, char *ip, void *arg );
+void infod_comm_recvd( msx_comm_t *comm, comm_inprogress_recv_t* comm_msg,
+		       void *arg );
 
-int comm_finish_send_mosix( msx_comm_t *comm, mapper_t map,
-			    fd_set *set, struct in_addr *ip);
 int comm_send_mosix( msx_comm_t *comm, struct in_addr *ip, unsigned short port,
 		     void *buff, int type, int size, int mv2recv);
 
@@ -193,6 +193,7 @@ infod_cmdline_t globOpts;
 mapper_t        glob_msxmap    = NULL;       
 msx_comm_t     *glob_msxcomm = NULL;
 ivec_t          glob_vec     = NULL;
+info_shm_t      glob_shm     = NULL;
 
 struct in_addr  glob_IP;
 unsigned int    glob_timeSteps = 0;
@@ -257,9 +258,6 @@ main( int argc, char** argv ) {
 
 	// Main loop
 	while(1) {
-                
-	     fd_set rfds, wfds, efds;
-	     int max_sock;
 	     
 	     block_sigalarm();
 	     
@@ -267,15 +265,11 @@ main( int argc, char** argv ) {
 	     if(glob_infodExit)
 		  infod_exit();
 	     
-	     prepare_select_data(&rfds, &wfds, &efds, &max_sock);
+	     watch_local_fds();
 	     unblock_sigalarm();
 	     errno = 0;
 	     
-	     int timeStep = globOpts.opt_timeStep;
-	     struct timeval timeout;
-	     timeout.tv_sec = timeStep / 1000;
-	     timeout.tv_usec = (timeStep % 1000) * 1000;
-	     res = select( max_sock + 1, &rfds, &wfds, &efds, &timeout );
+	     res = comm_wait( glob_msxcomm, globOpts.opt_timeStep );
 	     
 	     // Handling a SIGHUP received 
 	     if( glob_got_sighup ) {
@@ -289,13 +283,16 @@ main( int argc, char** argv ) {
 		  continue;
 	     }
 
-	     if( handle_kcomm_event(&rfds, &wfds, &efds) ||
-		 handle_ctl_event(&rfds, &wfds, &efds)   ||
-		 handle_comm_event(&rfds, &wfds, &efds)) {
+	     // The time step runs from infod_periodic_admin, nothing sends
+	     // from a signal handler. The block only guards against a future
+	     // SIGALRM driven step changing the comm tables and the buffer
+	     // pools under dispatch and admin
+	     block_sigalarm();
+	     if( comm_dispatch( glob_msxcomm ) > 0 )
 		  debug_lb(INFOD_DEBUG, "handled event\n");
-	     }
-	     
 	     comm_admin( glob_msxcomm, 1 );
+	     unblock_sigalarm();
+	     
 	     kcomm_periodic_admin( glob_vec );
 	     infod_periodic_admin();
 	}
@@ -304,38 +301,34 @@ main( int argc, char** argv ) {
 	return 0;
 }
 
-int prepare_select_data(fd_set *rfds, fd_set *wfds, fd_set *efds, int *max_sock) {
-     
-     FD_ZERO( rfds );
-     FD_ZERO( wfds );
-     FD_ZERO( efds );
-     
-     /*
-      * The infod is not supposed to be listening  in quiet mode
-      * or when there is no valid, initialized map object
-      */
-     if( !glob_quiet_mode && glob_msxmap )
-	  comm_get_listening_fdset( glob_msxcomm, rfds );
-     
-     comm_get_listening_fdset( glob_msxcomm, rfds );
-     comm_get_inprogress_recv_fdset( glob_msxcomm, rfds );
-     infodctl_get_fdset( rfds );
-     kcomm_get_fdset( rfds, wfds, efds );
-		
-     /* Initializing the wfds: inprogress send sockets. */
-     comm_get_inprogress_send_fdset( glob_msxcomm, wfds );
-
-     /* Initializeing the efds: the sockets that should be close */
-     comm_get_close_fdset( glob_msxcomm, efds );
-     
-     /* compute the minimum file descriptor */ 
-     *max_sock = comm_get_max_sock( glob_msxcomm );
-     int res = infodctl_get_max_sock();
-     if( res > *max_sock )
-	  *max_sock = res;
-     *max_sock = kcomm_get_max_sock(*max_sock);
+/*****************************************************************************
+ * Watch the ctl and kcomm sockets with the comm object. The socket each one
+ * waits on changes as connections are accepted and closed, so this is done
+ * before every wait. The sockets of msx_comm are watched by comm itself.
+ ****************************************************************************/
+void watch_local_fds() {
+     static int ctl_fd = -1, kcomm_fd = -1;
+     int        fd, listening, sending, events;
      
-     return 1;
+     fd = infodctl_get_fd( &listening );
+     if( ctl_fd != -1 && ctl_fd != fd )
+	  comm_unwatch_fd( glob_msxcomm, ctl_fd, ctl_ready );
+     if( fd != -1 )
+	  comm_watch_fd( glob_msxcomm, fd, COMM_EV_READ, ctl_ready, NULL );
+     ctl_fd = fd;
+
+     fd = kcomm_get_fd( &listening, &sending );
+     if( kcomm_fd != -1 && kcomm_fd != fd )
+	  comm_unwatch_fd( glob_msxcomm, kcomm_fd, kcomm_ready );
+     if( fd != -1 ) {
+	  events = COMM_EV_READ;
+	  if( !listening )
+	       events |= COMM_EV_CLOSE;
+	  if( sending )
+	       events |= COMM_EV_WRITE;
+	  comm_watch_fd( glob_msxcomm, fd, events, kcomm_ready, NULL );
+     }
+     kcomm_fd = fd;
 }
 
 int handle_sighup() {
@@ -356,25 +349,32 @@ int handle_sighup() {
 
 int handle_select_error() {
      if( (errno != EINTR) && (errno != EINPROGRESS)) {
+	  // As in the main loop, a guard for a signal driven time step
+	  block_sigalarm();
 	  comm_admin( glob_msxcomm, 0 );
+	  unblock_sigalarm();
 	  infod_log( LOG_ERR, "Error: in select()\n" );
      }
      kcomm_periodic_admin( glob_vec );
      return 1;
 }
 
-int handle_kcomm_event(fd_set *rfds, fd_set *wfds, fd_set *efds)
+void kcomm_ready( msx_comm_t *comm, int fd, int events, void *arg )
 {
-     int res;
+     int listening, sending, res;
+     
+     // An earlier event of this round may have replaced the socket
+     if( kcomm_get_fd( &listening, &sending ) != fd )
+	  return;
      
-     if( kcomm_is_new_connection( rfds )) {
+     if( listening ) {
 	  if( !kcomm_setup_connection() ) {
 	       infod_log( LOG_ERR, "Error: setup new kcomm connection\n");
 	  }
      }
      
      /* a new request has arrived */
-     else if( kcomm_is_req_arrived( rfds )) {
+     else if( events & COMM_EV_READ ) {
 	  if( !kcomm_is_auth() ) {
 	       debug_lg( KCOMM_DEBUG, "Getting kcomm auth\n");
 	       if(!kcomm_recv_auth())
@@ -411,33 +411,33 @@ int handle_kcomm_event(fd_set *rfds, fd_set *wfds, fd_set *efds)
 	  }
      }
      
-     else if( kcomm_is_ready_to_send( wfds )) {
+     else if( events & COMM_EV_WRITE ) {
 	  if(!kcomm_finish_send()) {
 	       //debug_lr( KCOMM_DEBUG,
 	       //  "Error: kcomm finish send\n");
 	  }
      }
      
-     else if(kcomm_exception( efds ) ) {
+     else if( events & COMM_EV_CLOSE ) {
 	  // debug_lr( KCOMM_DEBUG, "Kcomm got exception\n");
 	  kcomm_reset();
      }
-     else {
-	  return 0;
-     }
-     
-     return 1;
 }
-int handle_ctl_event(fd_set *rfds, fd_set *wfds, fd_set *efds)
+
+void ctl_ready( msx_comm_t *comm, int fd, int events, void *arg )
 {
+     int listening;
+     
+     if( infodctl_get_fd( &listening ) != fd )
+	  return;
      
-     if( infodctl_is_new_connection( rfds )) {
+     if( listening ) {
 	  debug_lg( CTL_DEBUG, "New CTL connection\n" );
 	  infodctl_setup_connection();
      }
      
      /* A ctl request has arrived */
-     else if( infodctl_req_arrived( rfds )) {
+     else {
 	  infodctl_action_t action;
 	  
 	  debug_ly( CTL_DEBUG, "CTL request arrived\n");
@@ -447,54 +447,6 @@ int handle_ctl_event(fd_set *rfds, fd_set *wfds, fd_set *efds)
 	  else
 	       do_ctl_action( &action );
      }
-     else {
-	  return 0;
-     }
-     return 1;
-}
-
-int handle_comm_event(fd_set *rfds, fd_set *wfds, fd_set *efds)
-{
-     int            res;
-     struct in_addr ip;
-
-     /* maybe we've got a new connection pending */
-     if( comm_is_new_connection( glob_msxcomm, rfds )){
-	  debug_ly( INFOD_DEBUG, "Setting up new connection\n");
-	  res = comm_setup_connection( glob_msxcomm, rfds,(char *) &ip );
-	  
-	  if( res == -1 )
-	       debug_lr( INFOD_DEBUG,
-			 "Error: setting new connection\n");
-     }
-     
-     /* maybe one of the write fd's is ready */ 
-     else if( comm_inprogress_send_active( glob_msxcomm, wfds )){
-	  debug_lg( INFOD_DEBUG, "Sending inprogress information\n");
-	  send_inpr_info( wfds, &ip );
-     }
-     
-     /* maybe one of the read fd's is ready */
-     else if( comm_inprogress_recv_active( glob_msxcomm, rfds )){
-	  comm_inprogress_recv_t comm_msg;
-	  bzero( &comm_msg, sizeof( comm_inprogress_recv_t ));
-	  
-	  debug_lg( INFOD_DEBUG, "Receiving inprogress information\n");
-	  
-	  if ( ( res = receive_info( rfds, &comm_msg ) ) == 1 )
-	       handle_msg( glob_msxcomm, glob_msxmap,
-			   &comm_msg );
-     }
-     
-     /* one of the exception fd's is ready */ 
-     else if( !(comm_close_on_socket( glob_msxcomm, efds ))) {
-	  //debug_lr( INFOD_DEBUG, "Error, out of select. Why???\n" );
-     }
-     else {
-	  return 0;
-     }
-     
-     return 1;
 }
 		 
 
@@ -590,8 +542,10 @@ comm_setup() {
     
 	/* initiate the msx_comm_t object */
 	for( i = 0 ; i <= MSX_INFOD_DEF_BIND_GIVEUP; i++) {
-	     if(( glob_msxcomm = comm_init( ports,
-					    MSX_INFOD_DEF_COMM_TIMEOUT ))) {
+	     if(( glob_msxcomm = comm_init_backend(
+			  ports, MSX_INFOD_DEF_COMM_TIMEOUT,
+			  globOpts.opt_commSelect ? COMM_BACKEND_SELECT :
+			  COMM_BACKEND_EPOLL ))) {
 		  break;
 	     }
 	     else {
@@ -604,7 +558,19 @@ comm_setup() {
 	if( i > MSX_INFOD_DEF_BIND_GIVEUP )
              infod_critical_error( "Error: Initiating communicator, can not bind to port\n");
         
-	infod_log(LOG_INFO, "Initiated communication\n" );
+	comm_set_handlers( glob_msxcomm, infod_comm_sent, infod_comm_recvd, NULL );
+	if( globOpts.opt_connPool &&
+	    !comm_set_pool( glob_msxcomm, globOpts.opt_connPool,
+			    COMM_POOL_IDLE_TIMEOUT ))
+		infod_log( LOG_ERR, "Error: keeping connections to peers\n" );
+	if( globOpts.opt_udpMax &&
+	    !comm_set_udp( glob_msxcomm, glob_infod_port, globOpts.opt_udpMax ))
+		infod_log( LOG_ERR, "Error: setting udp, windows go by tcp\n" );
+	if( globOpts.opt_compressMin )
+		comm_set_compress( glob_msxcomm, globOpts.opt_compressMin );
+	infod_log(LOG_INFO, "Initiated communication (%s)\n",
+		  comm_get_backend( glob_msxcomm ) == COMM_BACKEND_EPOLL ?
+		  "epoll" : "select" );
 
 	/* Initilazing kcomm  */
 	if(!( global_kcomm_buffer = malloc( KCOMM_BUFF_SIZE )))
@@ -820,22 +786,25 @@ int autoCalcWindowSize(int n) {
      if(globOpts.opt_desiredAvgAge) {
           debug_lg(INFOD_DEBUG, "Auto calc window: n: %d, desired avgage %.3f\n",
                    n, globOpts.opt_desiredAvgAge);
-          w = calcWinsizeGivenAv(n, globOpts.opt_desiredAvgAge);
+          w = calcWinsizeGivenAvFanout(n, globOpts.opt_desiredAvgAge,
+                                       globOpts.opt_gossipFanout);
      }
      else if(globOpts.opt_desiredAvgMax) {
           debug_lg(INFOD_DEBUG,
 		   "Auto calc window: n: %d, desired avgmax %.3f\n",
                    n, globOpts.opt_desiredAvgMax);
-          w = calcWinsizeGivenMax(n, globOpts.opt_desiredAvgMax);
+          w = calcWinsizeGivenMaxFanout(n, globOpts.opt_desiredAvgMax,
+                                        globOpts.opt_gossipFanout);
      }
      else if(globOpts.opt_desiredUptoAge) {
 	     debug_lg(INFOD_DEBUG,
 		      "Auto calc window: n: %d, entries %d age %.3f\n",
 		      n, globOpts.opt_desiredUptoEntries,
 		      globOpts.opt_desiredUptoAge);
-          w= calcWinsizeGivenUptoageEntries(n,
-                                            globOpts.opt_desiredUptoAge,
-                                            globOpts.opt_desiredUptoEntries);
+          w= calcWinsizeGivenUptoageEntriesFanout(n,
+                                                  globOpts.opt_desiredUptoAge,
+                                                  globOpts.opt_desiredUptoEntries,
+                                                  globOpts.opt_gossipFanout);
      }
      
      if(w > 0) {
@@ -856,6 +825,104 @@ int autoCalcWindowSize(int n) {
      return 0;
 }
 
+/*****************************************************************************
+ * Adaptive window. Every MSX_INFOD_WIN_ADAPT_STEPS time steps the model
+ * window (as autoCalcWindowSize but for the number of alive nodes) is
+ * scaled by a correction which follows how far the ages measured over
+ * those steps are from the target. The window is capped by what a window
+ * message can carry, given the sizes of the windows sent.
+ ****************************************************************************/
+#define WIN_ADAPT_GAIN       (0.5)
+#define WIN_ADAPT_MIN_CORR   (0.25)
+#define WIN_ADAPT_MAX_CORR   (4.0)
+
+static double winAdaptCorr   = 1.0;
+static double winAdaptMsgLen = 0.0;   // Average window message (bytes)
+
+void infod_adapt_window_msg(int len) {
+     if(winAdaptMsgLen == 0.0)
+          winAdaptMsgLen = len;
+     else
+          winAdaptMsgLen = 0.9 * winAdaptMsgLen + 0.1 * len;
+}
+
+void infod_adapt_window() {
+     static int     steps = 0;
+     static double  ageSum = 0.0, maxSum = 0.0;
+     infod_stats_t  stats;
+     double         measured, target, ratio;
+     int            n, w, w0 = 0, curr, maxW;
+
+     infoVecStats(glob_vec, &stats);
+     ageSum += stats.avgage;
+     maxSum += stats.maxage;
+     if(++steps < MSX_INFOD_WIN_ADAPT_STEPS)
+          return;
+
+     n = infoVecNumAlive(glob_vec);
+     if(globOpts.opt_desiredAvgAge) {
+          measured = ageSum / steps;
+          target = globOpts.opt_desiredAvgAge;
+          w0 = calcWinsizeGivenAvFanout(n, target, globOpts.opt_gossipFanout);
+     }
+     else if(globOpts.opt_desiredAvgMax) {
+          measured = maxSum / steps;
+          target = globOpts.opt_desiredAvgMax;
+          w0 = calcWinsizeGivenMaxFanout(n, target, globOpts.opt_gossipFanout);
+     }
+     else {
+          ivec_entry_t **ents;
+          int            num = 0;
+          
+          // Too few fresh entries is as an age too high
+          ents = infoVecGetEntriesByAge(glob_vec,
+                                        (unsigned long)(globOpts.opt_desiredUptoAge + 0.5),
+                                        &num);
+          free(ents);
+          measured = globOpts.opt_desiredUptoEntries;
+          target = num > 0 ? num : 1;
+          w0 = calcWinsizeGivenUptoageEntriesFanout(n, globOpts.opt_desiredUptoAge,
+                                                    globOpts.opt_desiredUptoEntries,
+                                                    globOpts.opt_gossipFanout);
+     }
+     steps = 0;
+     ageSum = maxSum = 0.0;
+     // The model has no answer for tiny clusters
+     if(n < 2 || w0 <= 0)
+          return;
+
+     ratio = measured / target;
+     if(ratio > 2.0) ratio = 2.0;
+     if(ratio < 0.5) ratio = 0.5;
+     winAdaptCorr *= 1.0 + WIN_ADAPT_GAIN * (ratio - 1.0);
+     if(winAdaptCorr < WIN_ADAPT_MIN_CORR) winAdaptCorr = WIN_ADAPT_MIN_CORR;
+     if(winAdaptCorr > WIN_ADAPT_MAX_CORR) winAdaptCorr = WIN_ADAPT_MAX_CORR;
+
+     w = (int)(w0 * winAdaptCorr + 0.5);
+     if(w > n) w = n;
+     if(w < 1) w = 1;
+
+     // Bigger windows would be cut when sent, so the correction does not
+     // go on growing after them
+     curr = infoVecGetWinParam(glob_vec);
+     if(winAdaptMsgLen > 0.0) {
+          maxW = (int)(MSX_INFOD_WIN_MAX_BYTES /
+                       (winAdaptMsgLen / (curr < n ? curr : n)));
+          if(maxW >= 1 && w > maxW) {
+               w = maxW;
+               winAdaptCorr = (double)w / w0;
+          }
+     }
+
+     debug_lg(INFOD_DEBUG, "Adapt window: n %d age %.3f target %.3f "
+              "model %d corr %.3f msg %.0f -> %d\n", n, measured, target,
+              w0, winAdaptCorr, winAdaptMsgLen, w);
+     if(w != curr && infoVecSetWinParam(glob_vec, w)) {
+          globOpts.opt_winParam = w;
+          infod_log(LOG_INFO, "Window size adapted to %d (n=%d)\n", w, n);
+     }
+}
+
 /*****************************************************************************
  * Initiate all the data structures
  ****************************************************************************/
@@ -913,14 +980,33 @@ info_setup() {
 				       glob_local_desc,
                                        1)))
 		infod_critical_error( "Error: Initiating infovec\n" );
+	infoVecSetDeltaWindows( glob_vec, globOpts.opt_deltaWin );
+	if( !infoVecSetColumns( glob_vec, glob_mapping ))
+		debug_lr( INFOD_DEBUG, "Failed setting the vector columns\n" );
 	
-	infod_log(LOG_INFO, "Initiated info vector\n" );
+	infod_log(LOG_INFO, "Initiated info vector%s\n",
+		  globOpts.opt_deltaWin ? " (delta windows)" : "" );
+
+	/* Local clients are not served if the export fails */
+	if( globOpts.opt_shmPath &&
+	    !( glob_shm = info_shm_create( globOpts.opt_shmPath,
+					   global_buffer_size )))
+		infod_log(LOG_ERR, "Failed exporting the vector to %s\n",
+			  globOpts.opt_shmPath );
 	
 	/* update the vector */
 	//infoVecUpdate( glob_vec, glob_local_info, glob_local_info_size, 0 ); 
 
 	/* Setting the local node as dead until the mosixd connect to infod */
 	infoVecPunish( glob_vec, &globOpts.opt_myIP, INFOD_DEAD_PROVIDER ) ;
+
+	/* Starting from what we knew before a restart */
+	if( globOpts.opt_ckptPath ) {
+		int num = infoVecRestore( glob_vec, globOpts.opt_ckptPath );
+		if( num >= 0 )
+			infod_log(LOG_INFO, "Restored %d entries from %s\n",
+				  num, globOpts.opt_ckptPath );
+	}
 		
 	return 1;
 }
@@ -951,6 +1037,14 @@ info_stop() {
 		glob_mapping = NULL;
 	}
 
+	if( glob_shm ) {
+		info_shm_destroy( glob_shm );
+		glob_shm = NULL;
+	}
+
+	if( glob_vec && globOpts.opt_ckptPath )
+		infoVecCheckpoint( glob_vec, globOpts.opt_ckptPath );
+
 	/* clear the vector */
 	if(glob_vec)
              infoVecFree( glob_vec ) ;
@@ -1106,60 +1200,129 @@ read_local_info() {
 	return priority;
 }
 
+/*****************************************************************************
+ * Pick the peers (besides the one of the gossip algorithm, peers[0]) a
+ * window is sent to with a fan-out. Distinct alive nodes, fewer when not
+ * found after a few tries. Returns the number of peers.
+ ****************************************************************************/
+static int
+gossip_fanout_peers( struct in_addr *peers, int fanout ) {
+
+	int num = 1, tries = 4 * fanout;
+	
+	while( num < fanout && tries-- > 0 ) {
+		struct in_addr ip;
+		int            i;
+		
+		if( !infoVecRandomNode( glob_vec, 1, &ip ))
+			break;
+		for( i = 0 ; i < num ; i++ )
+			if( peers[ i ].s_addr == ip.s_addr )
+				break;
+		if( i == num )
+			peers[ num++ ] = ip;
+	}
+	return num;
+}
+
 /*****************************************************************************
  * Doing a step of the selected gossip algorithm. This might be sending our
  * window (push), or might be rquesting other node to send us its window (pull)
+ * With a fan-out the window is sent to several peers, all the sends sharing
+ * the one message.
  *
  * FIXME  Is blocking and unblocking if SIGALRM needed?
  ****************************************************************************/
 int doGossipStep() {
-	int    res = 0;
+	int    res = 0, i, numPeers = 1;
         struct gossipAction ga;
+	struct in_addr peers[ INFOD_MAX_FANOUT ];
 	
+	bzero( &ga, sizeof(ga) );
+	ga.maxPeers = globOpts.opt_gossipFanout;
 	// Calling the gossip algorithm step function
 	res = (*globOpts.opt_gossipAlgo->stepFunc)(glob_vec, glob_gossip_data, &ga);
 	// Not doing anything if error or no where to send/ask
 	if(!res)
 		return 0;
 
-	// Performing the gossip step action
+	// The step picked its peers (a pull from the oldest nodes), else
+	// the window goes to random ones
+	if( ga.numPeers > 0 ) {
+		numPeers = ga.numPeers;
+		memcpy( peers, ga.peers, numPeers * sizeof(struct in_addr) );
+	}
+	else {
+		peers[0] = ga.randIP;
+		if( ga.msgHandle && globOpts.opt_gossipFanout > 1 )
+			numPeers = gossip_fanout_peers( peers,
+							globOpts.opt_gossipFanout );
+	}
+
+	// Performing the gossip step action. A window built in place is
+	// released by comm once it was sent, every send holds a reference
+	// (taken before any send, as a failed send releases it at once)
 	block_sigalarm();
-	if( ( res = comm_send_mosix( glob_msxcomm, &(ga.randIP),
-				     glob_infod_port, ga.msgData,
-				     ga.msgType, ga.msgLen, ga.keepConn )) == 1 )
-		debug_lb( INFOD_DEBUG,
-			  "Success, init send to random node %s\n", inet_ntoa(ga.randIP));
-	else{
-		debug_lr( INFOD_DEBUG, "Failure, init send to random node\n" );
-		infoVecPunish( glob_vec, &(ga.randIP), INFOD_DEAD_CONNECT ) ;
+	if( ga.msgHandle && globOpts.opt_winAdapt )
+		infod_adapt_window_msg( ga.msgLen );
+	for( i = 1 ; i < numPeers ; i++ )
+		infoVecWindowIovRef( ga.msgHandle );
+	if( ga.msgHandle && globOpts.opt_compressMin )
+		ga.msgType |= COMM_HDR_COMPRESSED;
+	for( i = 0 ; i < numPeers ; i++ ) {
+		if( ga.msgHandle )
+			res = comm_send_iov( glob_msxcomm, (char *)&(peers[i]),
+					     glob_infod_port, ga.msgIov,
+					     ga.msgIovCnt, ga.msgType, ga.keepConn,
+					     infoVecWindowIovDone, ga.msgHandle );
+		else
+			res = comm_send_mosix( glob_msxcomm, &(peers[i]),
+					       glob_infod_port, ga.msgData,
+					       ga.msgType, ga.msgLen, ga.keepConn );
+		if( res == 1 )
+			debug_lb( INFOD_DEBUG,
+				  "Success, init send to random node %s\n",
+				  inet_ntoa(peers[i]));
+		else{
+			debug_lr( INFOD_DEBUG, "Failure, init send to random node\n" );
+			infoVecPunish( glob_vec, &(peers[i]), INFOD_DEAD_CONNECT ) ;
+		}
 	}
 	unblock_sigalarm();
 	return 1;
 }
 
 /*****************************************************************************
- * Continue sending information stored in comm - in send_inprogress
+ * Called by comm when a send in progress was continued, res is the result
+ * of comm_finish_send(). Runs with SIGALRM blocked (from the main loop).
  ****************************************************************************/
-int
-send_inpr_info( fd_set *set, struct in_addr *ip ){
+void
+infod_comm_sent( msx_comm_t *comm, int res, char *ip, void *arg ){
 
-	int res = 0;
+	struct in_addr ipaddr;
+	mnode_t        pe;
+
+	/* Only nodes of the map are punished */
+	memcpy( &ipaddr.s_addr, ip, sizeof(in_addr_t) );
+	if( !mapper_addr2node( glob_msxmap, &ipaddr, &pe )) {
+		debug_lr( INFOD_DEBUG, "Error: IP not in map. "
+			  "%u.%u.%u.%u\n",
+			  (unsigned char)ip[0], (unsigned char)ip[1],
+			  (unsigned char)ip[2], (unsigned char)ip[3]);
+		res = 0;
+	}
 	
-	block_sigalarm();
-    
-	res = comm_finish_send_mosix( glob_msxcomm, glob_msxmap, set, ip );
-      
 	if( res == -1 ) {
 		debug_lr( INFOD_DEBUG, "Error: Failed sending data to %s\n",
-			  inet_ntoa(*ip) );
-		infoVecPunish( glob_vec, ip, INFOD_DEAD_CONNECT );
+			  inet_ntoa(ipaddr) );
+		infoVecPunish( glob_vec, &ipaddr, INFOD_DEAD_CONNECT );
 	}
     	else if( res == 0 ) 
 		debug_lb( INFOD_DEBUG, "Message only partially send\n");
 	
 	else
 		debug_lg( INFOD_DEBUG, "Finished sending the message %s.\n",
-			  inet_ntoa(*ip));
+			  inet_ntoa(ipaddr));
 
 	// Send if finished so we measure the time it took
 	if(globOpts.opt_measureSendTime &&
@@ -1184,25 +1347,17 @@ send_inpr_info( fd_set *set, struct in_addr *ip ){
 		runTimeInfo.sentMsgs++;
 		runTimeInfo.sentMsgsSamples++;
 	}
-	unblock_sigalarm();
-	
-	return res ;
 }
      
 /*****************************************************************************
- * Receive information sent to this node
+ * Called by comm when a message was received
  ****************************************************************************/
-int
-receive_info( fd_set *set, comm_inprogress_recv_t* comm_msg ){
+void
+infod_comm_recvd( msx_comm_t *comm, comm_inprogress_recv_t* comm_msg,
+		  void *arg ){
 
-	int res;
-      
-	/* There should be data available for reading */ 
-	block_sigalarm();
-	res = comm_recv( glob_msxcomm, set, comm_msg ); 
-	unblock_sigalarm();
-      
-	return res ;
+	debug_lg( INFOD_DEBUG, "Receiving inprogress information\n");
+	handle_msg( comm, glob_msxmap, comm_msg );
 }
 
 /*****************************************************************************
@@ -1221,16 +1376,32 @@ handle_msg( msx_comm_t *comm, mapper_t map,
 
 	type = comm_msg->hdr.type;  
 
+	/* A datagram has no socket to answer on, only windows come this way */
+	if( comm_msg->sock < 0 && type != INFOD_MSG_TYPE_INFO &&
+	    type != INFOD_MSG_TYPE_INFO_DELTA ) {
+             debug_lr( INFOD_DEBUG, "Error: datagram of type %d\n", type );
+             comm_buf_put( comm, comm_msg->data );
+             comm_msg->data = NULL;
+             return;
+	}
+
 	/* Information dissemination messages */ 
 	switch (type) {
 	    case INFOD_MSG_TYPE_INFO:
+	    case INFOD_MSG_TYPE_INFO_DELTA:
                  runTimeInfo.desiminationNum++;
 //#ifdef INFOD2
                  runTimeInfo.infoMsgs++;
 //#endif
                  handle_info( comm, map, comm_msg ) ;
-                 shutdown( comm_msg->sock, SHUT_RDWR );
-                 close( comm_msg->sock );
+                 // A sender keeping the connection sends its next windows
+                 // on it
+                 if( comm_msg->sock >= 0 &&
+                     ( !globOpts.opt_connPool ||
+                       !comm_recv_next( comm, comm_msg->sock, comm_msg->ip ))) {
+                      shutdown( comm_msg->sock, SHUT_RDWR );
+                      close( comm_msg->sock );
+                 }
                  break;
 	    case INFOD_MSG_TYPE_INFO_PULL:
                  if(!handle_info_pull( comm, map, comm_msg )) {
@@ -1262,7 +1433,7 @@ handle_msg( msx_comm_t *comm, mapper_t map,
                  close( comm_msg->sock );
 	}
 	
-	free( comm_msg->data );	
+	comm_buf_put( comm, comm_msg->data );
 	comm_msg->data = NULL;
 }
 
@@ -1322,15 +1493,33 @@ handle_info_pull(  msx_comm_t *comm, mapper_t map,
 	pullMsg = (info_pull_msg_t *)comm_msg->data;
 	debug_lb( INFOD_DEBUG, "Got valid PULL from -----> %d param (%d)\n",
 		  pe, pullMsg->param) ;
-	// Preparing a window to send back on the socket
-	ga.msgData = infoVecGetWindow( glob_vec, &(ga.msgLen), 1);
-	ga.msgType = INFOD_MSG_TYPE_INFO;
+	// Preparing the entries the puller misses, or our window if the
+	// pull has no digest, to send back on the socket
+	if( comm_msg->hdr.size >= (int)INFO_PULL_MSG_SZ &&
+	    pullMsg->param == INFO_PULL_DIGEST ) {
+		ga.msgHandle = infoVecGetDigestAnswerIov(
+			glob_vec, pullMsg, comm_msg->hdr.size, &(ga.msgIov),
+			&(ga.msgIovCnt), &(ga.msgLen));
+		ga.msgType = INFOD_MSG_TYPE_INFO;
+	}
+	else {
+		ga.msgHandle = infoVecGetWindowIov( glob_vec, 1, &(ga.msgIov),
+						    &(ga.msgIovCnt), &(ga.msgLen));
+		ga.msgType = infoVecWindowMsgType( glob_vec );
+	}
+	if( !ga.msgHandle ) {
+		debug_lr( INFOD_DEBUG, "Failed preparing pull answer\n" );
+		return 0;
+	}
 	ga.keepConn = 0;
+	if( globOpts.opt_compressMin )
+		ga.msgType |= COMM_HDR_COMPRESSED;
 	
 	// Sending the window back to the pulling node
-	res = comm_send_on_socket( glob_msxcomm, comm_msg->sock,
-				   (char*)(ga.msgData), ga.msgType,
-				   ga.msgLen, ga.keepConn);
+	res = comm_send_iov_on_socket( glob_msxcomm, comm_msg->sock,
+				       ga.msgIov, ga.msgIovCnt, ga.msgType,
+				       ga.keepConn, infoVecWindowIovDone,
+				       ga.msgHandle );
 	if( !res ) {
 		debug_lr( INFOD_DEBUG, "Failed sending pull answer\n" );
 		return 0;
@@ -1350,6 +1539,7 @@ handle_client_request(  msx_comm_t *comm, mapper_t map,
 
 	/* will hold the answer from the information vector */
 	ivec_entry_t **vecptr = NULL ;
+	ivec_snap_t      snap = NULL;
 	infod_stats_t    stats;
 	
 	/* used to hold the arguments of the requets */ 
@@ -1358,18 +1548,25 @@ handle_client_request(  msx_comm_t *comm, mapper_t map,
 //	char             *names = NULL;
 //	node_t           *pes   = NULL;
 //	unsigned long    age    = 0;
-	int size = 0, ret = -1;
+	int size = 0, ret = -1, flags = 0;
 
 	//msgargs = ((infolib_msg_t*)(comm_msg->data))->args;
 	request =((infolib_msg_t*)(comm_msg->data))->request; 
+	// Flags of a request without args, from newer clients
+	if( comm_msg->hdr.size >= (int)(sizeof(infolib_msg_t) + sizeof(int)))
+		memcpy( &flags, ((infolib_msg_t*)(comm_msg->data))->args,
+			sizeof(int) );
 
 	debug_lb( INFOD_DEBUG, "The Request is %d\n", request ) ;
 	/* Hanlde the request */
 	switch( request ) {
 
 	    case INFOLIB_ALL:
-		    vecptr = infoVecGetAllEntries( glob_vec );
-		    size   = infoVecGetSize( glob_vec );
+		    // Answered from the last published snapshot
+		    if( !(snap = infoVecSnapshotAcquire( glob_vec )))
+			    return -1;
+		    vecptr = infoVecSnapshotGetAllEntries( snap );
+		    size   = infoVecSnapshotSize( snap );
 		    break;
 	    case INFOLIB_WINDOW:
 		    vecptr = infoVecGetWindowEntries( glob_vec, &size );
@@ -1460,13 +1657,17 @@ handle_client_request(  msx_comm_t *comm, mapper_t map,
 		    return -1;
 	}
 
-	if( vecptr == NULL )
+	if( vecptr == NULL ) {
+		infoVecSnapshotRelease( snap );
 		return -1;
+	}
 
-	ret = infod_reply_client( vecptr, size, comm_msg );
+	ret = infod_reply_client( vecptr, size, comm_msg,
+				  flags & INFOLIB_FLAG_COMPRESS );
 
 	if( vecptr )
 		free( vecptr );
+	infoVecSnapshotRelease( snap );
 	return ret;
 }
 
@@ -1492,7 +1693,7 @@ infod_reply_size( ivec_entry_t** ivecptr, int size ) {
  ***************************************************************************/
 int
 infod_reply_client( ivec_entry_t** ivecptr, int size,
-		    comm_inprogress_recv_t* comm_msg )
+		    comm_inprogress_recv_t* comm_msg, int compress )
 {
 	idata_t    *rep      = NULL;
 	void       *rep_buff = NULL;
@@ -1509,8 +1710,10 @@ infod_reply_client( ivec_entry_t** ivecptr, int size,
 	/* Finally, send the reply */
 	rep = (info_replay_t *) rep_buff;
 
+	// Compressed only for clients which asked for it
         ret = comm_send_on_socket( glob_msxcomm, comm_msg->sock, rep,
-				   comm_msg->hdr.type,
+				   comm_msg->hdr.type |
+				   ( compress ? COMM_HDR_COMPRESSED : 0 ),
 				   rep->total_sz ,0 );
     
 
@@ -1530,6 +1733,48 @@ infod_reply_client( ivec_entry_t** ivecptr, int size,
 	return ret;
 }
 
+/****************************************************************************
+ * Write the published snapshot to the shared memory export, in the layout
+ * of an INFOLIB_ALL reply. Done every step since the reply holds ages.
+ ***************************************************************************/
+int
+infod_export_shm() {
+	ivec_snap_t     snap;
+	ivec_entry_t  **vecptr = NULL;
+	void           *buff, *rep;
+	int             size, rep_size, tmpSize, ret = 0;
+
+	if( !(snap = infoVecSnapshotAcquire( glob_vec )))
+		return 0;
+	size = infoVecSnapshotSize( snap );
+	if( !(vecptr = infoVecSnapshotGetAllEntries( snap )))
+		goto done;
+
+	rep_size = infod_reply_size( vecptr, size );
+	if( !(buff = info_shm_write_begin( glob_shm, rep_size ))) {
+		debug_lr( INFOD_DEBUG, "Failed growing the shm export\n" );
+		goto done;
+	}
+	// The data area is large enough, the reply is packed in place
+	tmpSize = rep_size + 1;
+	rep = infoVecPackQueryReplay( vecptr, size, buff, &tmpSize );
+	if( rep != buff ) {
+		debug_lr( INFOD_DEBUG, "Error packing the shm export\n" );
+		if( rep )
+			free( rep );
+		info_shm_write_end( glob_shm, 0 );
+		goto done;
+	}
+	info_shm_write_end( glob_shm, rep_size );
+	ret = 1;
+
+ done:
+	if( vecptr )
+		free( vecptr );
+	infoVecSnapshotRelease( snap );
+	return ret;
+}
+
 /*****************************************************************************
  * Translate names to pes 
  ****************************************************************************/
@@ -1780,7 +2025,7 @@ ctl_get_status( infodctl_action_t *action ) {
 	char sbuff[MAX_STATS_STR_LEN];
         char *ptr = sbuff;
         char tmp[100];
-	ptr += sprintf( sbuff,
+	snprintf( sbuff, sizeof(sbuff),
                         "Infod status:\n"
                         "PID         %d\n"
                         "IP          %s\n"
@@ -1822,47 +2067,57 @@ ctl_get_status( infodctl_action_t *action ) {
                         globOpts.opt_maxAge,
                         runTimeInfo.desiminationNum,
                         runTimeInfo.reqNum);
-        // Adding comm statistics
-        comm_print_status(glob_msxcomm, ptr, 2048);
+        // Adding comm statistics, in the room left
+        ptr += strlen( ptr );
+        comm_print_status(glob_msxcomm, ptr, sizeof(sbuff) - (ptr - sbuff));
+
+        {
+		infod_stats_t stats;
+		if(infoVecStats(glob_vec, &stats)) {
+			snprintf(tmp, sizeof(tmp), "Info heap   %.0f (used %.0f)\n",
+				stats.heapsize, stats.heapused);
+			strncat(sbuff, tmp, sizeof(sbuff) - strlen(sbuff) - 1);
+		}
+        }
 
         if(globOpts.opt_measureAvgAge) {
 		ivec_age_measure_t im;
 		infoVecGetAgeMeasure(glob_vec, &im);
-		sprintf(tmp, "Avg Age     %.4f (samples %d max %d)\n",
+		snprintf(tmp, sizeof(tmp), "Avg Age     %.4f (samples %d max %d)\n",
 			im.im_avgAge, im.im_sampleNum, im.im_maxSamples);
-		strcat(sbuff, tmp);
-		sprintf(tmp, "Avg Max Age %.4f (samples %d max %d)\n",
+		strncat(sbuff, tmp, sizeof(sbuff) - strlen(sbuff) - 1);
+		snprintf(tmp, sizeof(tmp), "Avg Max Age %.4f (samples %d max %d)\n",
 			im.im_avgMaxAge, im.im_sampleNum, im.im_maxSamples);
-		strcat(sbuff, tmp);
-		sprintf(tmp, "Max Max Age %.4f (samples %d max %d)\n",
+		strncat(sbuff, tmp, sizeof(sbuff) - strlen(sbuff) - 1);
+		snprintf(tmp, sizeof(tmp), "Max Max Age %.4f (samples %d max %d)\n",
 			im.im_maxMaxAge, im.im_sampleNum, im.im_maxSamples);
-		strcat(sbuff, tmp);
+		strncat(sbuff, tmp, sizeof(sbuff) - strlen(sbuff) - 1);
 		
 	}
         if(globOpts.opt_measureEntriesUptoage) {
              ivec_entries_uptoage_measure_t im;
              infoVecGetEntriesUptoageMeasure(glob_vec, &im);
              for(int i=0 ; i<im.im_size ; i++) {
-                  sprintf(tmp, "Entries Uptoage %.4f age %.4f (samples %d max %d)\n",
+                  snprintf(tmp, sizeof(tmp), "Entries Uptoage %.4f age %.4f (samples %d max %d)\n",
                           im.im_entriesUpto[i], im.im_ageArr[i],
                           im.im_sampleNum, im.im_maxSamples);
-                  strcat(sbuff, tmp);
+                  strncat(sbuff, tmp, sizeof(sbuff) - strlen(sbuff) - 1);
              }
         }
 	if(globOpts.opt_measureWinSize)
 	{
 		ivec_win_size_measure_t im;
 		infoVecGetWinSizeMeasure(glob_vec, &im);
-		sprintf(tmp, "Avg WinSize %.4f (samples %d max %d)\n",
+		snprintf(tmp, sizeof(tmp), "Avg WinSize %.4f (samples %d max %d)\n",
 			im.im_avgWinSize, im.im_sampleNum, im.im_maxSamples);
-		strcat(sbuff, tmp);
+		strncat(sbuff, tmp, sizeof(sbuff) - strlen(sbuff) - 1);
 	}
 	if(globOpts.opt_measureInfoMsgsPerSec)
 	{
-		sprintf(tmp, "Info Per Sec    %.4f (samples %d max %d)\n",
+		snprintf(tmp, sizeof(tmp), "Info Per Sec    %.4f (samples %d max %d)\n",
 			runTimeInfo.infoMsgsPerSec,
 			runTimeInfo.infoMsgsSamples, runTimeInfo.infoMsgsMaxSamples); 
-		strcat(sbuff, tmp);
+		strncat(sbuff, tmp, sizeof(sbuff) - strlen(sbuff) - 1);
 	}
 	if(globOpts.opt_measureSendTime)
 	{
@@ -1877,12 +2132,12 @@ ctl_get_status( infodctl_action_t *action ) {
 		// first measurment into account (prevTime is not correct)
 		avgTimeUnit = runTimeInfo.totalTime / (runTimeInfo.timeSteps -1);
 
-		sprintf(tmp,
+		snprintf(tmp, sizeof(tmp),
 			"Avg Send Time   %.4f (samples %d max %d)\n"
 			"Avg time unit   %.4f\n",
 			sendTime, runTimeInfo.sentMsgsSamples, runTimeInfo.sentMsgsMaxSamples,
 			avgTimeUnit);
-		strcat(sbuff, tmp);
+		strncat(sbuff, tmp, sizeof(sbuff) - strlen(sbuff) - 1);
 	}
 	
 	infodctl_reply(sbuff, strlen(sbuff) + 1);
@@ -2258,10 +2513,22 @@ void doTimeStep()
 	} else {
 		infoVecPunish( glob_vec, &globOpts.opt_myIP, INFOD_DEAD_PROVIDER );
 	}
+	/* punish the entries which got too old, before they are gossiped */
+	infoVecExpire( glob_vec );
+
 	/* send information only if we are not in quiet mode */
 	if( !glob_quiet_mode )
 		doGossipStep();
 
+	/* retune the window as the cluster changes */
+	if( globOpts.opt_winAdapt && globOpts.opt_winAutoCalc )
+		infod_adapt_window();
+
+	/* client queries read the vector as it is at the end of the step */
+	infoVecPublish( glob_vec );
+	if( glob_shm )
+		infod_export_shm();
+
 	if (globOpts.opt_measureAvgAge) {
 		debug_ly( INFOD_DEBUG, "measure value = %d\n",
 			  globOpts.opt_measureAvgAge ) ;
@@ -2432,37 +2699,6 @@ comm_send_mosix( msx_comm_t *comm, struct in_addr *ip, unsigned short port,
 	return comm_send(comm, (char *)ip, port, buff, type, size, mv2recv );
 }
 
-int comm_finish_send_mosix( msx_comm_t *comm, mapper_t map,
-			fd_set *set, struct in_addr *IP)
-{
-	struct in_addr ipaddr;
-	char ip[COMM_IP_VER];
-	int res, pe;
-	
-	bzero( ip, COMM_IP_VER*sizeof(char));
-    
-	if( !comm ){
-		debug_lr( INFOD_DEBUG, "Error: args, comm_finish_s_mosix\n");
-		return -1;
-	}
-
-	/* calling the regular finish send routine */
-	res = comm_finish_send( comm, set, ip );
-      
-	/* converting ip to mosix number */
-	memcpy(&ipaddr.s_addr, ip, sizeof(in_addr_t)); 
-	
-	if( !mapper_addr2node( map, &ipaddr, (mnode_t *) &pe )) {
-		debug_lr( INFOD_DEBUG, "Error: IP not in map. "
-			  "%u.%u.%u.%u\n",
-			  (unsigned char)ip[0], (unsigned char)ip[1],
-			  (unsigned char)ip[2], (unsigned char)ip[3]);
-		res = 0;
-	}
-	*IP = ipaddr;
-      	return res;
-}
-
 /****************************************************************************
  * Utility functions
  ***************************************************************************/
@@ -2555,6 +2791,7 @@ void infod_periodic_admin()
      
      static unsigned int prevMapReloadTimeStep = 0;
      static unsigned int prevPeriodicAdminTimeStep = 0;
+     static unsigned int prevCheckpointTimeStep = 0;
      
      static time_t prevMTime = 0;
      
@@ -2608,6 +2845,15 @@ void infod_periodic_admin()
           }
      }
 
+     // Checkpoint of the vector
+     p = ((glob_timeSteps - prevCheckpointTimeStep)* timeStepMilli)/1000;
+     if(globOpts.opt_ckptPath && glob_vec && p >= MSX_INFOD_CHECKPOINT_TIME) {
+          prevCheckpointTimeStep = glob_timeSteps;
+          if(!infoVecCheckpoint(glob_vec, globOpts.opt_ckptPath))
+               debug_lr(INFOD_DEBUG, "Error writing checkpoint %s\n",
+                        globOpts.opt_ckptPath);
+     }
+
      // MAP reload 
      p = ((glob_timeSteps - prevMapReloadTimeStep)* timeStepMilli)/1000;
      if(p >= MSX_INFOD_RELOAD_MAP_TIME) {
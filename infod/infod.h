@@ -76,6 +76,7 @@
 #define MSX_INFOD_RELOAD_MAP_TIME     (60)     // seconds to reload map file
 #define MSX_INFOD_PERIODIC_ADMIN_TIME (10)     // seconds to performs various
                                                // admin tasks
+#define MSX_INFOD_CHECKPOINT_TIME     (10)     // seconds between checkpoints
 
 //---- Gossip ----
 #define INFOD_DEF_TIME_STEP           (500)    // Default time step in milli-seconds
@@ -84,6 +85,14 @@
 #define INFOD_DEF_WIN_PARAM           (8)
 #define INFOD_DEF_GINFOD_PARAM        (32)
 #define INFOD_SEND_TO_ANY_CYCLE       (5)
+#define INFOD_TOPO_REMOTE_MSGS        (2)      // remote messages a cluster
+                                               // sends each step (topo)
+#define INFOD_MAX_FANOUT              (16)     // peers a window is sent to
+                                               // each step
+#define MSX_INFOD_WIN_ADAPT_STEPS     (10)     // time steps between window
+                                               // adaptations
+#define MSX_INFOD_WIN_MAX_BYTES       (256*1024 - 4096) // what a window
+                                               // message can carry
 
 // Gossip Algo
 #include <infoVec.h>
@@ -95,6 +104,16 @@ struct gossipAction {
      int              msgLen;
      void            *msgData;
      int              keepConn;
+     // A window built in place (infoVecGetWindowIov) is sent from msgIov
+     // instead of msgData. msgHandle is released when the send is over.
+     struct iovec    *msgIov;
+     int              msgIovCnt;
+     void            *msgHandle;
+     // A step may pick its peers itself, up to maxPeers (the fan-out,
+     // set by the caller). numPeers > 0 means peers is used, not randIP
+     int              maxPeers;
+     int              numPeers;
+     struct in_addr   peers[ INFOD_MAX_FANOUT ];
 };
 
 /* Function for the selected gossip protocole */
@@ -127,6 +146,12 @@ typedef struct __infod_cmdline {
      int             opt_myPE;
      int             opt_infodPort;
      char *          opt_confFile;
+     char *          opt_shmPath;
+     char *          opt_ckptPath;
+     int             opt_commSelect;          // select instead of epoll
+     int             opt_connPool;            // connections kept to peers
+     int             opt_udpMax;              // largest window sent by udp
+     int             opt_compressMin;         // smallest window compressed
 	
      // Provider
      int             opt_providerType;
@@ -148,6 +173,8 @@ typedef struct __infod_cmdline {
      unsigned int    opt_timeStep;
      struct infodGossipAlgo  *opt_gossipAlgo;
      int             opt_gossipDistance;
+     double          opt_gossipRemoteRatio;   // topo, < 0 from cluster size
+     int             opt_gossipFanout;        // peers to send the window to
      int             opt_maxAge;
      int             opt_winType;
      int             opt_winParam;
@@ -157,6 +184,8 @@ typedef struct __infod_cmdline {
      double          opt_desiredAvgMax;
      int             opt_desiredUptoEntries;
      double          opt_desiredUptoAge;
+     int             opt_winAdapt;
+     int             opt_deltaWin;
      
      // Measurments
      int             opt_measureAvgAge;
@@ -167,6 +196,8 @@ typedef struct __infod_cmdline {
 	
 } infod_cmdline_t;
 
+extern infod_cmdline_t globOpts;
+
 
 struct infod_runtime_info {
      /* Infod uptime handling */
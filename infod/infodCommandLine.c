@@ -20,9 +20,12 @@
 #include <parse_helper.h>
 #include <msx_error.h>
 #include <msx_debug.h>
+#include <info.h>
+#include <comm.h>
 #include <infoVec.h>
 #include <infod.h>
 #include <easy_args.h>
+#include <info_shm.h>
 #include <Mapper.h>
 #include <ConfFileReader.h>
 #include <ModuleLogger.h>
@@ -85,6 +88,50 @@ int set_my_ip( void *void_char ){
 }
 int set_port( void *void_int)      { OPTS->opt_infodPort = 1; return 0;}
 
+int set_shm( void *void_str ){
+     OPTS->opt_shmPath = strdup((char*)void_str );
+     return 0;
+}
+
+int set_checkpoint( void *void_str ){
+     OPTS->opt_ckptPath = strdup((char*)void_str );
+     return 0;
+}
+
+int set_comm_select( void *void_int) { OPTS->opt_commSelect = 1; return 0;}
+
+int set_conn_pool( void *void_int ){
+     int n = *((int *)void_int);
+     if( n < 0 ) {
+          fprintf(stderr, "--conn-pool should be 0 or more\n");
+          return 1;
+     }
+     OPTS->opt_connPool = n;
+     return 0;
+}
+
+int set_udp( void *void_int ){
+     int n = *((int *)void_int);
+     if( n < 0 || n > COMM_UDP_MAX_SIZE ) {
+          fprintf(stderr, "--udp should be between 0 and %d\n",
+                  COMM_UDP_MAX_SIZE);
+          return 1;
+     }
+     OPTS->opt_udpMax = n;
+     return 0;
+}
+
+int set_compress( void *void_int ){
+     int n = *((int *)void_int);
+     if( n < 0 || n > MAX_MSG_SIZE ) {
+          fprintf(stderr, "--compress should be between 0 and %d\n",
+                  MAX_MSG_SIZE);
+          return 1;
+     }
+     OPTS->opt_compressMin = n;
+     return 0;
+}
+
 
 // Provider
 int set_provider( void *void_str ){
@@ -256,6 +303,39 @@ int set_uptoentries(void *void_str ){
      return 0;
 }
 
+int set_remote_ratio( void *void_double ){
+     double r = *((double *)void_double);
+
+     if(r < 0.0 || r > 1.0) {
+          fprintf(stderr, "--remote-ratio should be between 0 and 1\n");
+          return 1;
+     }
+     OPTS->opt_gossipRemoteRatio = r;
+     return 0;
+}
+
+int set_fanout( void *void_int ){
+     int k = *((int *)void_int);
+
+     if(k < 1 || k > INFOD_MAX_FANOUT) {
+          fprintf(stderr, "--fanout should be between 1 and %d\n",
+                  INFOD_MAX_FANOUT);
+          return 1;
+     }
+     OPTS->opt_gossipFanout = k;
+     return 0;
+}
+
+int set_win_adapt( void *void_int ){
+     OPTS->opt_winAdapt = 1;
+     return 0;
+}
+
+int set_delta_win( void *void_int ){
+     OPTS->opt_deltaWin = 1;
+     return 0;
+}
+
 int show_copyright(void *void_str) {
      printf("infod version " GOSSIMON_VERSION_STR "\n" GOSSIMON_COPYRIGHT_STR "\n\n");
      exit(0);
@@ -316,9 +396,14 @@ int usage(void *void_str)
           "-------------------------------------\n"
           "--timestep=<mili-seconds>   The time step to use for sending gossip\n"
           "                            information to other nodes.\n"
-          "--gossip-algo=<reg,mindead,pushpull>\n"
+          "--gossip-algo=<reg,mindead,pushpull,topo>\n"
           "                            Type of random node selection when selecting\n"
           "                            the next node to send information to.\n"
+          "--remote-ratio=r            The part of the messages the topo gossip\n"
+          "                            algorithm sends out of the local cluster\n"
+          "                            (default: by the cluster size)\n"
+          "--fanout=k                  Send the window to k peers every time step\n"
+          "                            (default: 1)\n"
 //              "     --gossip-dist=<c|g>         Level of gossip to use [c,g]\n"
 //              "     --vectype=[0,1]             \n"
 //              "     --vectype-param=n           \n" 
@@ -338,6 +423,12 @@ int usage(void *void_str)
           "--upto-entries ENT,AGE      The window size is calculated in such a way that\n"
           "                            the vector will contain ENT entries with age upto\n"
           "                            age AGE\n"
+          "--win-adapt                 Keep tuning the window size (of --avgage,\n"
+          "                            --avgmax or --upto-entries) as nodes join and\n"
+          "                            leave, by the measured ages\n"
+          "--delta-win                 Send only the parts of the entries that changed\n"
+          "                            since a version the receiver holds. All the\n"
+          "                            nodes of the cluster should use this option\n"
 //              "     --global-info               \n"
           "\n"
           "General parameters:\n"
@@ -348,6 +439,21 @@ int usage(void *void_str)
           "                            not the first returend by resolving of the\n"
           "                            local host name\n"
           "--port=n                    Alternative port number to use\n"  
+          "--shm=<file>                Export the vector to local clients in a shared\n"
+          "                            memory file (e.g. " INFO_SHM_DEF_PATH ")\n"
+          "--checkpoint=<file>         Save the vector to file periodically and start\n"
+          "                            from it after a restart\n"
+          "--select                    Wait for the sockets with select instead of\n"
+          "                            epoll\n"
+          "--conn-pool=n               Keep up to n connections to other infods open\n"
+          "                            and send the next windows on them (0 opens\n"
+          "                            one per window, the default)\n"
+          "--udp=bytes                 Send windows of up to bytes (e.g. 8192) as UDP\n"
+          "                            datagrams, larger ones by TCP. All the nodes\n"
+          "                            of the cluster should use this option\n"
+          "--compress=bytes            Compress windows of at least bytes (e.g. 1024)\n"
+          "                            sent to other infods. All the nodes of the\n"
+          "                            cluster should run an infod which knows it\n"
           "--clear                     Clear screen\n"
           "--debug                     Use debug mode, no daemon\n"
           "--debug-mode mod1,mod2,..   Specify debug modes to use upon start\n"
@@ -380,12 +486,16 @@ struct argument args[] = {
      { ARGUMENT_NUMERICAL | ARGUMENT_FULL, 0, "timestep",    set_time_step},	
      { ARGUMENT_STRING    | ARGUMENT_FULL, 0, "gossip-algo", set_gossip_algo},
      { ARGUMENT_STRING    | ARGUMENT_FULL, 0, "gossip-dist", set_gossip_dist},
+     { ARGUMENT_DOUBLE    | ARGUMENT_FULL, 0, "remote-ratio", set_remote_ratio},
+     { ARGUMENT_NUMERICAL | ARGUMENT_FULL, 0, "fanout",      set_fanout},
      { ARGUMENT_STRING    | ARGUMENT_FULL, 0, "wintype",     set_win_type},	
      { ARGUMENT_NUMERICAL | ARGUMENT_FULL, 0, "winparam",    set_win_param},
      { ARGUMENT_NUMERICAL | ARGUMENT_FULL, 0, "maxage",      set_max_age},
      { ARGUMENT_DOUBLE    | ARGUMENT_FULL, 0, "avgage",      set_avgage},
      { ARGUMENT_DOUBLE    | ARGUMENT_FULL, 0, "avgmax",      set_avgmax},
      { ARGUMENT_STRING    | ARGUMENT_FULL, 0, "uptoage",     set_uptoentries},
+     { ARGUMENT_FLAG      | ARGUMENT_FULL, 0, "delta-win",   set_delta_win},
+     { ARGUMENT_FLAG      | ARGUMENT_FULL, 0, "win-adapt",   set_win_adapt},
 
         
      // General
@@ -394,6 +504,12 @@ struct argument args[] = {
      { ARGUMENT_FLAG      | ARGUMENT_FULL, 0, "debug",      set_debug},
      { ARGUMENT_STRING    | ARGUMENT_FULL, 0, "debug-mode", set_debug_mode},
      { ARGUMENT_STRING    | ARGUMENT_FULL, 0, "port",       set_port},
+     { ARGUMENT_STRING    | ARGUMENT_FULL, 0, "shm",        set_shm},
+     { ARGUMENT_STRING    | ARGUMENT_FULL, 0, "checkpoint", set_checkpoint},
+     { ARGUMENT_FLAG      | ARGUMENT_FULL, 0, "select",     set_comm_select},
+     { ARGUMENT_NUMERICAL | ARGUMENT_FULL, 0, "conn-pool",  set_conn_pool},
+     { ARGUMENT_NUMERICAL | ARGUMENT_FULL, 0, "udp",        set_udp},
+     { ARGUMENT_NUMERICAL | ARGUMENT_FULL, 0, "compress",   set_compress},
      { ARGUMENT_FLAG      | ARGUMENT_FULL, 0, "help",       usage},
      { ARGUMENT_FLAG      | ARGUMENT_FULL, 0, "clear",      set_clear},            
      { ARGUMENT_FLAG      | ARGUMENT_FULL, 0, "copyright",  show_copyright},            
@@ -441,6 +557,12 @@ int initOptsDefaults(infod_cmdline_t *opts) {
      opts->opt_forceIP = 0;
      
      opts->opt_infodPort = MSX_INFOD_DEF_PORT;
+     opts->opt_shmPath   = NULL;
+     opts->opt_ckptPath  = NULL;
+     opts->opt_commSelect = 0;
+     opts->opt_connPool   = 0;
+     opts->opt_udpMax     = 0;
+     opts->opt_compressMin = 0;
 
      //Provider
      opts->opt_providerType      = INFOD_LP_LINUX;
@@ -466,10 +588,14 @@ int initOptsDefaults(infod_cmdline_t *opts) {
      if(!opts->opt_gossipAlgo)
           infod_critical_error("Default gossip algo mindead is not found\n");
      opts->opt_gossipDistance    = GOSSIP_DIST_CLUSTER;
+     opts->opt_gossipRemoteRatio = -1.0;
+     opts->opt_gossipFanout      = 1;
      opts->opt_maxAge            = 0;
      opts->opt_winType           = INFOD_WIN_FIXED;
      opts->opt_winParam          = INFOD_DEF_WINSIZE;
      opts->opt_winAutoCalc       = 0;
+     opts->opt_winAdapt          = 0;
+     opts->opt_deltaWin          = 0;
      
      // Measurments
      opts->opt_measureAvgAge     = 0;
@@ -1376,45 +1376,52 @@ int mosix_sf_periodic_admin( ivec_t vec ) {
 }
 
 
+/****************************************************************************
+ * The values an alive node adds to the statistics: memory, cpus, load and
+ * speed. The vector keeps their totals as nodes change and die.
+ ****************************************************************************/
+#define MOSIX_SUM_TMEM     (0)
+#define MOSIX_SUM_NCPUS    (1)
+#define MOSIX_SUM_LOAD     (2)
+#define MOSIX_SUM_SPEED    (3)
+#define MOSIX_SUM_VALS     (4)
+
+static void
+mosix_sf_sum_entry( node_info_t *info, double *vals ) {
+     struct mosix_infod_data *cur = (struct mosix_infod_data*)(info->data);
+
+     vals[ MOSIX_SUM_TMEM ]  = (double)cur->extra.tmem;
+     vals[ MOSIX_SUM_NCPUS ] = (double)cur->data.ncpus;
+     vals[ MOSIX_SUM_LOAD ]  = (double)cur->data.load;
+     vals[ MOSIX_SUM_SPEED ] = (double)cur->data.speed;
+}
+
 /****************************************************************************
  * Compoutes the statistics of the infod
  ****************************************************************************/
 int
 mosix_sf_get_stats( ivec_t vec, infod_stats_t *stats ) {
 
-     unsigned int i = 0, num = 0;
-     ivec_entry_t** all = NULL;
+     double sums[ MOSIX_SUM_VALS ], maxs[ MOSIX_SUM_VALS ];
+     int    num;
 	
      if( !vec || !stats ) {
 	  debug_lr( VEC_DEBUG, "Error: args, stats\n" );
 	  return 0;
      }
 
-     // The fields the provider is responsible for
-     stats->ncpus   = 0;
-     stats->tmem    = 0;
-     stats->avgload = 0;
-     stats->sspeed  = 0;
-	
-     if( !( all = infoVecGetAllEntries( vec )))
+     // Only the first request on a vector counts its nodes, then the
+     // vector keeps the totals
+     if( !infoVecSetSumFunc( vec, mosix_sf_sum_entry, MOSIX_SUM_VALS,
+			     1 << MOSIX_SUM_SPEED ))
 	  return -1;
+     num = infoVecGetSums( vec, sums, maxs );
 
-     for( i = 0; i < stats->total_num ; i++ )
-	  if( all[ i ]->isdead == 0 ) {
-	       node_info_t    *info = all[i]->info;
-	       struct mosix_infod_data *cur =
-		    (struct mosix_infod_data*)(info->data);
-			
-	       stats->tmem     += cur->extra.tmem;
-	       stats->ncpus    += cur->data.ncpus;
-	       stats->avgload  += (double)(cur->data.load);
-	       if( cur->data.speed > stats->sspeed )
-		    stats->sspeed = cur->data.speed;
-	       num++;
-	  }
-	
-     stats->avgload = stats->avgload/(double)(num);
-     free(all);
+     // The fields the provider is responsible for
+     stats->tmem    = (unsigned int)sums[ MOSIX_SUM_TMEM ];
+     stats->ncpus   = (unsigned int)sums[ MOSIX_SUM_NCPUS ];
+     stats->avgload = sums[ MOSIX_SUM_LOAD ]/(double)(num);
+     stats->sspeed  = (unsigned int)maxs[ MOSIX_SUM_SPEED ];
      return 1;
 }
 
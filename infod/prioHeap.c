@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <prioHeap.h>
 
 #define PARENT(i)          ((i)/2)
@@ -259,6 +260,349 @@ heap_delete( heap_t *h, int i, void **data, int *datalen ) {
 	return key;
 }
 
+/****************************************************************************
+ * Indexed d-ary heap
+ ***************************************************************************/
+#define IH_PARENT(h,i)     (((i) - 1) / (h)->ih_arity)
+#define IH_CHILD(h,i)      ((i) * (h)->ih_arity + 1)
+
+static inline int
+iheap_less( iheap_node_t *a, iheap_node_t *b ) {
+	if( a->key != b->key )
+		return a->key < b->key;
+	if( a->subkey != b->subkey )
+		return a->subkey < b->subkey;
+	return a->stamp < b->stamp;
+}
+
+static inline void
+iheap_place( iheap_t *h, int i, iheap_node_t *node ) {
+	h->ih_data[i] = *node;
+	h->ih_pos[ node->id ] = i;
+}
+
+static void
+iheap_sift_up( iheap_t *h, int i ) {
+	iheap_node_t node = h->ih_data[i];
+
+	while( i > 0 ) {
+		int parent = IH_PARENT(h, i);
+		if( !iheap_less( &node, &h->ih_data[parent] ))
+			break;
+		iheap_place( h, i, &h->ih_data[parent] );
+		i = parent;
+	}
+	iheap_place( h, i, &node );
+}
+
+static void
+iheap_sift_down( iheap_t *h, int i ) {
+	iheap_node_t node = h->ih_data[i];
+
+	while( 1 ) {
+		int first = IH_CHILD(h, i);
+		int last  = first + h->ih_arity;
+		int best  = -1;
+		int c;
+
+		if( first >= h->ih_size )
+			break;
+		if( last > h->ih_size )
+			last = h->ih_size;
+		
+		best = first;
+		for( c = first + 1 ; c < last ; c++ )
+			if( iheap_less( &h->ih_data[c], &h->ih_data[best] ))
+				best = c;
+
+		if( !iheap_less( &h->ih_data[best], &node ))
+			break;
+		iheap_place( h, i, &h->ih_data[best] );
+		i = best;
+	}
+	iheap_place( h, i, &node );
+}
+
+/****************************************************************************
+ * Initialize the heap. Note that the memory for iheap_t must already be
+ * allocated. length is the maximal number of elements and maxId bounds the
+ * ids that can be stored.
+ ***************************************************************************/
+int
+iheap_init( iheap_t *h, int arity, int length, int maxId ) {
+	int i;
+	
+	if( !h || arity < 2 || length <= 0 || maxId <= 0 )
+		return 0;
+
+	bzero( h, sizeof(iheap_t) );
+	if( !(h->ih_data = malloc( length * sizeof(iheap_node_t))))
+		return 0;
+	if( !(h->ih_pos = malloc( maxId * sizeof(int)))) {
+		free( h->ih_data );
+		h->ih_data = NULL;
+		return 0;
+	}
+
+	h->ih_arity  = arity;
+	h->ih_length = length;
+	h->ih_maxId  = maxId;
+	h->ih_size   = 0;
+	for( i = 0 ; i < maxId ; i++ )
+		h->ih_pos[i] = -1;
+	return 1;
+}
+
+/****************************************************************************
+ * Free the heap memory (not the iheap_t itself)
+ ***************************************************************************/
+void
+iheap_free( iheap_t *h ) {
+	if( !h )
+		return;
+	if( h->ih_data )
+		free( h->ih_data );
+	if( h->ih_pos )
+		free( h->ih_pos );
+	h->ih_data = NULL;
+	h->ih_pos  = NULL;
+	h->ih_size = 0;
+}
+
+/****************************************************************************
+ * Remove all the elements
+ ***************************************************************************/
+void
+iheap_reset( iheap_t *h ) {
+	int i;
+
+	for( i = 0 ; i < h->ih_size ; i++ )
+		h->ih_pos[ h->ih_data[i].id ] = -1;
+	h->ih_size = 0;
+}
+
+int
+iheap_size( iheap_t *h ) {
+	return ( h == NULL ) ? 0 : h->ih_size;
+}
+
+int
+iheap_is_full( iheap_t *h ) {
+	return ( ( h == NULL ) || ( h->ih_size == h->ih_length )) ? 1 : 0;
+}
+
+int
+iheap_contains( iheap_t *h, int id ) {
+	if( id < 0 || id >= h->ih_maxId )
+		return 0;
+	return h->ih_pos[id] != -1;
+}
+
+/****************************************************************************
+ * Returns the node of the given id or NULL if it is not in the heap. The
+ * node must not be modified directly, use iheap_update() instead.
+ ***************************************************************************/
+iheap_node_t *
+iheap_get( iheap_t *h, int id ) {
+	if( !iheap_contains( h, id ))
+		return NULL;
+	return &h->ih_data[ h->ih_pos[id] ];
+}
+
+iheap_node_t *
+iheap_get_min( iheap_t *h ) {
+	if( h->ih_size == 0 )
+		return NULL;
+	return &h->ih_data[0];
+}
+
+/****************************************************************************
+ * Insert a new element. Fails if the heap is full or the id is already in
+ * the heap.
+ ***************************************************************************/
+int
+iheap_insert( iheap_t *h, int id, heap_key_t key, unsigned long long subkey ) {
+	iheap_node_t node;
+
+	if( id < 0 || id >= h->ih_maxId || h->ih_pos[id] != -1 )
+		return 0;
+	if( h->ih_size == h->ih_length )
+		return 0;
+
+	node.key    = key;
+	node.subkey = subkey;
+	node.stamp  = h->ih_stamp++;
+	node.id     = id;
+	iheap_place( h, h->ih_size, &node );
+	h->ih_size++;
+	iheap_sift_up( h, h->ih_size - 1 );
+	return 1;
+}
+
+/****************************************************************************
+ * Change the key of an element already in the heap (in any direction)
+ ***************************************************************************/
+int
+iheap_update( iheap_t *h, int id, heap_key_t key, unsigned long long subkey ) {
+	iheap_node_t *node;
+	iheap_node_t  old;
+	int           i;
+
+	if( !iheap_contains( h, id ))
+		return 0;
+
+	i = h->ih_pos[id];
+	node = &h->ih_data[i];
+	old = *node;
+	node->key    = key;
+	node->subkey = subkey;
+	node->stamp  = h->ih_stamp++;
+	if( iheap_less( node, &old ))
+		iheap_sift_up( h, i );
+	else
+		iheap_sift_down( h, i );
+	return 1;
+}
+
+/****************************************************************************
+ * Remove the smallest element. If node is not NULL it gets a copy of it.
+ ***************************************************************************/
+int
+iheap_extract_min( iheap_t *h, iheap_node_t *node ) {
+	if( h->ih_size == 0 )
+		return 0;
+	if( node )
+		*node = h->ih_data[0];
+	return iheap_delete( h, h->ih_data[0].id );
+}
+
+/****************************************************************************
+ * Delete an element by its id
+ ***************************************************************************/
+int
+iheap_delete( iheap_t *h, int id ) {
+	int i;
+	
+	if( !iheap_contains( h, id ))
+		return 0;
+
+	i = h->ih_pos[id];
+	h->ih_pos[id] = -1;
+	h->ih_size--;
+	if( i == h->ih_size )
+		return 1;
+
+	iheap_place( h, i, &h->ih_data[ h->ih_size ] );
+	if( i > 0 && iheap_less( &h->ih_data[i], &h->ih_data[ IH_PARENT(h, i) ] ))
+		iheap_sift_up( h, i );
+	else
+		iheap_sift_down( h, i );
+	return 1;
+}
+
+static int
+iheap_cmp_desc( const void *a, const void *b ) {
+	iheap_node_t *A = (iheap_node_t *)a;
+	iheap_node_t *B = (iheap_node_t *)b;
+
+	if( iheap_less( B, A ))
+		return -1;
+	if( iheap_less( A, B ))
+		return 1;
+	return 0;
+}
+
+/****************************************************************************
+ * Copy all the elements to out (which must have room for iheap_size()
+ * nodes) ordered from the largest to the smallest. The heap is not changed.
+ * Returns the number of elements copied.
+ ***************************************************************************/
+int
+iheap_sorted_desc( iheap_t *h, iheap_node_t *out ) {
+	memcpy( out, h->ih_data, h->ih_size * sizeof(iheap_node_t) );
+	qsort( out, h->ih_size, sizeof(iheap_node_t), iheap_cmp_desc );
+	return h->ih_size;
+}
+
+/****************************************************************************
+ * The k smallest elements without changing the heap. Since every node is
+ * smaller than its children, the next smallest element is always a child
+ * of one already taken. These candidates are kept in a small binary heap
+ * (of slots in ih_data), so the cost is O(k * arity * log k) regardless of
+ * the heap size.
+ ***************************************************************************/
+static void
+iheap_front_sift_down( iheap_t *h, int *front, int n, int i ) {
+	int slot = front[i];
+
+	while( 1 ) {
+		int c = 2 * i + 1;
+		if( c >= n )
+			break;
+		if( c + 1 < n &&
+		    iheap_less( &h->ih_data[ front[c+1] ], &h->ih_data[ front[c] ] ))
+			c++;
+		if( !iheap_less( &h->ih_data[ front[c] ], &h->ih_data[ slot ] ))
+			break;
+		front[i] = front[c];
+		i = c;
+	}
+	front[i] = slot;
+}
+
+static void
+iheap_front_sift_up( iheap_t *h, int *front, int i ) {
+	int slot = front[i];
+
+	while( i > 0 ) {
+		int parent = (i - 1) / 2;
+		if( !iheap_less( &h->ih_data[ slot ], &h->ih_data[ front[parent] ] ))
+			break;
+		front[i] = front[parent];
+		i = parent;
+	}
+	front[i] = slot;
+}
+
+/****************************************************************************
+ * Copy the k smallest elements to out, smallest first. Returns the number
+ * of elements copied or -1 on error.
+ ***************************************************************************/
+int
+iheap_smallest( iheap_t *h, iheap_node_t *out, int k ) {
+	int *front;
+	int  n = 0, got = 0;
+	int  slot, c, last;
+
+	if( k > h->ih_size )
+		k = h->ih_size;
+	if( k <= 0 )
+		return 0;
+	
+	if( !(front = malloc( ( k * h->ih_arity + 1 ) * sizeof(int))))
+		return -1;
+
+	front[ n++ ] = 0;
+	while( got < k && n > 0 ) {
+		slot = front[0];
+		out[ got++ ] = h->ih_data[ slot ];
+
+		front[0] = front[ --n ];
+		iheap_front_sift_down( h, front, n, 0 );
+
+		c = IH_CHILD(h, slot);
+		last = c + h->ih_arity;
+		if( last > h->ih_size )
+			last = h->ih_size;
+		for( ; c < last ; c++ ) {
+			front[ n++ ] = c;
+			iheap_front_sift_up( h, front, n - 1 );
+		}
+	}
+	free( front );
+	return got;
+}
+
 /****************************************************************************
  * Print the heap, according to the order
  ***************************************************************************/
@@ -51,6 +51,47 @@ int          heap_insert(heap_t *h, heap_key_t key, void *data, int datalen);
 heap_key_t   heap_extract_max(heap_t *h, void **data, int *datalen);
 heap_key_t   heap_delete(heap_t *h, int i, void **data, int *datalen);
 
+/****************************************************************************
+ * Indexed d-ary heap. Every element carries an id in [0, maxId) and the
+ * heap keeps a position map from id to slot, so an element can be found,
+ * re-keyed or removed in O(log_d n) without searching for it. Elements are
+ * ordered by (key, subkey), smallest first. Ties are broken by the order
+ * of insertion/update, the most recent being the largest.
+ ***************************************************************************/
+typedef struct iheap_node {
+	heap_key_t          key;
+	unsigned long long  subkey;
+	unsigned long long  stamp;  // Insertion/update order
+	int                 id;
+} iheap_node_t;
+
+typedef struct _indexed_heap {
+	int                 ih_arity;   // Children per node
+	int                 ih_size;    // The actual number of elements
+	int                 ih_length;  // The max number of elements
+	int                 ih_maxId;   // Size of the position map
+	iheap_node_t       *ih_data;    // 0 based array of nodes
+	int                *ih_pos;     // id -> slot in ih_data, -1 if absent
+	unsigned long long  ih_stamp;   // Next stamp to give
+} iheap_t;
+
+int          iheap_init(iheap_t *h, int arity, int length, int maxId);
+void         iheap_free(iheap_t *h);
+void         iheap_reset(iheap_t *h);
+int          iheap_size(iheap_t *h);
+int          iheap_is_full(iheap_t *h);
+int          iheap_contains(iheap_t *h, int id);
+iheap_node_t *iheap_get(iheap_t *h, int id);
+iheap_node_t *iheap_get_min(iheap_t *h);
+int          iheap_insert(iheap_t *h, int id, heap_key_t key,
+			  unsigned long long subkey);
+int          iheap_update(iheap_t *h, int id, heap_key_t key,
+			  unsigned long long subkey);
+int          iheap_extract_min(iheap_t *h, iheap_node_t *node);
+int          iheap_delete(iheap_t *h, int id);
+int          iheap_sorted_desc(iheap_t *h, iheap_node_t *out);
+int          iheap_smallest(iheap_t *h, iheap_node_t *out, int k);
+
 #endif /* __MSX_INFOD_PRIO_HEAP__ */
 
 /****************************************************************************
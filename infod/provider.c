@@ -112,6 +112,9 @@ kcomm_get_fdset_func_t            kcomm_get_fdset_func;
 typedef int    (*kcomm_get_max_sock_func_t) (int);
 kcomm_get_max_sock_func_t         kcomm_get_max_sock_func;
 
+typedef int    (*kcomm_get_fd_func_t) (int *, int *);
+kcomm_get_fd_func_t               kcomm_get_fd_func;
+
 typedef int    (*kcomm_is_new_connection_func_t) (fd_set *);
 kcomm_is_new_connection_func_t   kcomm_is_new_connection_func;
 
@@ -132,6 +135,8 @@ static int kcomm_get_fdset_np(fd_set *rfds, fd_set *wfds, fd_set *efds);
 static int kcomm_get_fdset_p( fd_set *rfds, fd_set *wfds, fd_set *efds );
 static int kcomm_get_max_sock_np( int curr_max );
 static int kcomm_get_max_sock_p( int curr_max );
+static int kcomm_get_fd_np( int *listening, int *sending );
+static int kcomm_get_fd_p( int *listening, int *sending );
 static int kcomm_is_new_connection_np( fd_set *rfds );
 static int kcomm_is_new_connection_p( fd_set *rfds );
 static int kcomm_is_req_arrived_np( fd_set *rfds );
@@ -376,6 +381,7 @@ kcomm_init( char *kcomm_module, char *kcomm_sock_name, int max_send,
 		kcomm_reset_func              = kcomm_reset_np;
 		kcomm_get_fdset_func          = kcomm_get_fdset_np;
 		kcomm_get_max_sock_func       = kcomm_get_max_sock_np;
+		kcomm_get_fd_func             = kcomm_get_fd_np;
 		kcomm_is_new_connection_func  = kcomm_is_new_connection_np;
 		kcomm_is_req_arrived_func     = kcomm_is_req_arrived_np;
 		kcomm_is_ready_to_send_func   = kcomm_is_ready_to_send_np;
@@ -387,6 +393,7 @@ kcomm_init( char *kcomm_module, char *kcomm_sock_name, int max_send,
 		kcomm_reset_func              = kcomm_reset_p;
 		kcomm_get_fdset_func          = kcomm_get_fdset_p;
 		kcomm_get_max_sock_func       = kcomm_get_max_sock_p;
+		kcomm_get_fd_func             = kcomm_get_fd_p;
 		kcomm_is_new_connection_func  = kcomm_is_new_connection_p;
 		kcomm_is_req_arrived_func     = kcomm_is_req_arrived_p;
 		kcomm_is_ready_to_send_func   = kcomm_is_ready_to_send_p;
@@ -648,6 +655,25 @@ int kcomm_get_max_sock( int curr_max ) {
 	return (*kcomm_get_max_sock_func)(curr_max);
 }
 
+/*****************************************************************************
+ * Returning the sockfd we are currently working with (-1 if none). listening
+ * is set if it is the main socket (accept should be called), sending if we
+ * are in the middle of a send on it.
+ *****************************************************************************/
+static int kcomm_get_fd_np( int *listening, int *sending ) {
+	*listening = *sending = 0;
+	return -1;
+}
+static int kcomm_get_fd_p( int *listening, int *sending ) {
+	*listening = (kcomm_status == KCOMM_WAIT_FOR_NEW);
+	*sending = !*listening && kcomm_inprsend;
+	return kcomm_get_max_sock_p( -1 );
+}
+
+int kcomm_get_fd( int *listening, int *sending ) {
+	return (*kcomm_get_fd_func)(listening, sending);
+}
+
 /*****************************************************************************
  * Checking if kcomm_sockfs is on the rfds we got from the select. If yes this
  * means we can call accept on this socket
@@ -63,6 +63,8 @@ int kcomm_reset();
 int kcomm_get_fdset(fd_set *rfds, fd_set *wfds, fd_set *efds);
 // Returens the maximum sock number
 int kcomm_get_max_sock(int curr_max);
+// Returns the current sock, -1 if none
+int kcomm_get_fd(int *listening, int *sending);
 int kcomm_is_new_connection(fd_set *rfds);
 int kcomm_setup_connection();
 int kcomm_is_req_arrived(fd_set *rfds);
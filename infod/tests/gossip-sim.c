@@ -0,0 +1,698 @@
+/*============================================================================
+  gossimon - Gossip based resource usage monitoring for Linux clusters
+  Copyright 2003-2010 Amnon Barak
+
+  Distributed under the OSI-approved BSD License (the "License");
+  see accompanying file Copyright.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+============================================================================*/
+
+/******************************************************************************
+ *
+ * Author(s): Amar Lior
+ *
+ *****************************************************************************/
+
+/******************************************************************************
+ *    File: gossip-sim.c
+ *
+ * Discrete event simulation of a cluster of infods in one process. Every
+ * node has its own information vector and runs the time steps of the
+ * selected gossip algorithm (the stepFunc of infod) on a virtual clock.
+ * Messages go through a simulated network with latency, jitter and loss,
+ * and part of the nodes may fail at a given time. The age of the
+ * information and the propagation of the failures are measured with the
+ * vector measurements (as infod --measure does) on a sample of the nodes.
+ *
+ * Every vector holds all the nodes, so the memory grows as the square of
+ * the cluster size: about 400 bytes per entry, 4GB for 3000 nodes.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <msx_debug.h>
+#include <msx_error.h>
+#include <ModuleLogger.h>
+#include <Mapper.h>
+#include <MapperBuilder.h>
+#include <infoVec.h>
+#include <infod.h>
+#include <prioHeap.h>
+#include <gossip.h>
+
+// The gossip algorithms read their parameters from here
+infod_cmdline_t globOpts;
+
+#define SIM_BASE_IP        "10.0.0.1"
+#define SIM_EPOCH          (1000000000UL)   // Virtual clock start (seconds)
+#define SIM_MAX_CDF        (INFOVEC_ENTRIES_UPTO_SIZE)
+
+char *sim_desc =
+"<?xml version=\"1.0\" encoding=\"UTF-8\" ?>"
+"<local_info>"
+"        <base name=\"tmem\"  type=\"unsigned long\"  unit=\"4KB\"/>"
+"        <base name=\"speed\" type=\"unsigned long\"/>"
+"</local_info>";
+
+typedef struct sim_data {
+     unsigned long tmem;
+     unsigned long speed;
+} sim_data_t;
+
+/* A message on its way, the data is a copy of what infod would send */
+typedef struct sim_msg {
+     int      type;
+     int      src;
+     int      dst;
+     int      size;
+     char     data[0];
+} sim_msg_t;
+
+typedef struct sim_node {
+     ivec_t          vec;
+     unsigned char   failed;
+     unsigned char   sampled;
+} sim_node_t;
+
+typedef struct sim_opts {
+     int      n;
+     char    *algo;
+     int      winSize;
+     int      fanout;
+     int      timeStep;       // msec
+     double   duration;       // sec
+     double   warmup;         // sec
+     double   latency;        // msec
+     double   jitter;         // msec
+     double   loss;
+     double   failFrac;
+     double   failAt;         // sec
+     int      sample;
+     double   maxAge;         // sec, 0 as infod
+     int      delta;
+     int      seed;
+} sim_opts_t;
+
+typedef struct sim_stats {
+     unsigned long   events;
+     unsigned long   sent;
+     unsigned long   bytes;
+     unsigned long   lost;
+     unsigned long   refused;    // Sent to failed nodes
+     unsigned long   dropped;    // Event queue full
+     unsigned long   pulls;
+} sim_stats_t;
+
+static sim_opts_t     opts;
+static sim_stats_t    stats;
+static sim_node_t    *nodes;
+static heap_t         events;
+static unsigned long  simNow;        // usec since the start
+static struct in_addr baseIP;
+static int           *failedIdx;
+static int            numFailed;
+
+char *progName;
+
+static void sim_clock( struct timeval *now ) {
+     now->tv_sec  = SIM_EPOCH + simNow / 1000000;
+     now->tv_usec = simNow % 1000000;
+}
+
+static double sim_rand() {
+     return rand() / ( RAND_MAX + 1.0 );
+}
+
+static int sim_ip2node( struct in_addr *ip ) {
+     long i = (long)ntohl( ip->s_addr ) - (long)ntohl( baseIP.s_addr );
+
+     return ( i >= 0 && i < opts.n ) ? (int)i : -1;
+}
+
+static void sim_node2ip( int i, struct in_addr *ip ) {
+     ip->s_addr = htonl( ntohl( baseIP.s_addr ) + i );
+}
+
+void usage() {
+     printf("Usage: %s [OPTIONS]\n"
+            "Simulating the infod gossip of a cluster in one process\n"
+            "\n"
+            "Options:\n"
+            "-n      nodes         Cluster size (default 1000)\n"
+            "-a      algo          Gossip algorithm reg,mindead,pushpull,topo\n"
+            "                      (default mindead)\n"
+            "-w      size          Fixed window size (default %d)\n"
+            "-k      fanout        Peers a window is sent to each step (default 1)\n"
+            "-t      msec          Time step (default %d)\n"
+            "-d      sec           Simulated time (default 60)\n"
+            "   --warmup sec       Measuring starts after (default 10)\n"
+            "   --latency msec     Network latency (default 1)\n"
+            "   --jitter msec      Random latency added (default 0)\n"
+            "   --loss p           Message loss probability (default 0)\n"
+            "   --fail frac        Part of the nodes to fail (default 0)\n"
+            "   --fail-at sec      Time of the failure (default mid measuring)\n"
+            "   --sample num       Nodes measured (default 100)\n"
+            "   --maxage sec       Vector max age (default as infod)\n"
+            "   --delta            Send delta windows\n"
+            "   --seed num         Random seed (default 1)\n"
+            "\n"
+            "-h, --help            Show this help screen\n"
+            , progName, INFOD_DEF_WINSIZE, INFOD_DEF_TIME_STEP);
+}
+
+int parseArgs( int argc, char **argv ) {
+     int c;
+
+     while( 1 ) {
+          int option_index = 0;
+          static struct option long_options[] = {
+               {"warmup",      1, 0, 0},
+               {"latency",     1, 0, 0},
+               {"jitter",      1, 0, 0},
+               {"loss",        1, 0, 0},
+               {"fail",        1, 0, 0},
+               {"fail-at",     1, 0, 0},
+               {"sample",      1, 0, 0},
+               {"maxage",      1, 0, 0},
+               {"delta",       0, 0, 0},
+               {"seed",        1, 0, 0},
+               {"help",        0, 0, 'h' },
+               {0, 0, 0, 0}
+          };
+
+          c = getopt_long( argc, argv, "n:a:w:k:t:d:h",
+                           long_options, &option_index );
+          if( c == -1 )
+               break;
+
+          switch( c ) {
+              case 0: {
+                   const char *name = long_options[option_index].name;
+                   if( strcmp( name, "warmup" ) == 0 )
+                        opts.warmup = atof( optarg );
+                   else if( strcmp( name, "latency" ) == 0 )
+                        opts.latency = atof( optarg );
+                   else if( strcmp( name, "jitter" ) == 0 )
+                        opts.jitter = atof( optarg );
+                   else if( strcmp( name, "loss" ) == 0 )
+                        opts.loss = atof( optarg );
+                   else if( strcmp( name, "fail" ) == 0 )
+                        opts.failFrac = atof( optarg );
+                   else if( strcmp( name, "fail-at" ) == 0 )
+                        opts.failAt = atof( optarg );
+                   else if( strcmp( name, "sample" ) == 0 )
+                        opts.sample = atoi( optarg );
+                   else if( strcmp( name, "maxage" ) == 0 )
+                        opts.maxAge = atof( optarg );
+                   else if( strcmp( name, "delta" ) == 0 )
+                        opts.delta = 1;
+                   else if( strcmp( name, "seed" ) == 0 )
+                        opts.seed = atoi( optarg );
+                   break;
+              }
+              case 'n':
+                   opts.n = atoi( optarg );
+                   break;
+              case 'a':
+                   opts.algo = optarg;
+                   break;
+              case 'w':
+                   opts.winSize = atoi( optarg );
+                   break;
+              case 'k':
+                   opts.fanout = atoi( optarg );
+                   break;
+              case 't':
+                   opts.timeStep = atoi( optarg );
+                   break;
+              case 'd':
+                   opts.duration = atof( optarg );
+                   break;
+              case 'h':
+              case '?':
+              default:
+                   usage();
+                   exit( 0 );
+          }
+     }
+
+     if( opts.n < 2 || opts.winSize < 1 || opts.timeStep < 1 ||
+         opts.fanout < 1 || opts.fanout > INFOD_MAX_FANOUT ||
+         opts.duration <= opts.warmup || opts.loss < 0 || opts.loss > 1 ||
+         opts.failFrac < 0 || opts.failFrac >= 1 || opts.latency < 0 ||
+         opts.jitter < 0 )
+     {
+          fprintf( stderr, "Error: bad arguments\n" );
+          usage();
+          exit( 1 );
+     }
+     if( opts.sample > opts.n )
+          opts.sample = opts.n;
+     if( opts.failAt <= 0 )
+          opts.failAt = opts.warmup + ( opts.duration - opts.warmup ) / 2;
+     return 1;
+}
+
+/****************************************************************************
+ * Events: a node time step (no data, the node index as the length) or a
+ * message delivery, ordered by their virtual time
+ ***************************************************************************/
+static void sim_schedule( unsigned long when, void *data, int len ) {
+     if( !heap_insert( &events, when, data, len )) {
+          stats.dropped++;
+          free( data );
+     }
+}
+
+static void sim_send( int src, int dst, int type, struct iovec *iov,
+                      int iovcnt, void *buff, int size )
+{
+     sim_msg_t     *msg;
+     char          *pos;
+     unsigned long  delay;
+
+     stats.sent++;
+     stats.bytes += size;
+     // A failed node refuses the connection, as infod the sender punishes it
+     if( nodes[dst].failed ) {
+          struct in_addr ip;
+
+          stats.refused++;
+          sim_node2ip( dst, &ip );
+          infoVecPunish( nodes[src].vec, &ip, INFOD_DEAD_CONNECT );
+          return;
+     }
+     if( opts.loss > 0 && sim_rand() < opts.loss ) {
+          stats.lost++;
+          return;
+     }
+     if( !( msg = malloc( sizeof(sim_msg_t) + size ))) {
+          stats.dropped++;
+          return;
+     }
+     msg->type = type;
+     msg->src  = src;
+     msg->dst  = dst;
+     msg->size = size;
+     if( iov ) {
+          pos = msg->data;
+          for( int i = 0 ; i < iovcnt ; i++ ) {
+               memcpy( pos, iov[i].iov_base, iov[i].iov_len );
+               pos += iov[i].iov_len;
+          }
+     }
+     else
+          memcpy( msg->data, buff, size );
+
+     delay = (unsigned long)(( opts.latency + opts.jitter * sim_rand() ) * 1000);
+     sim_schedule( simNow + delay + 1, msg, -1 );
+}
+
+/****************************************************************************
+ * The time step of a node, as doTimeStep() and doGossipStep() of infod
+ ***************************************************************************/
+static void sim_update_local( int i ) {
+     char          buff[ NODE_INFO_SIZE + sizeof(sim_data_t) ];
+     node_info_t  *node = (node_info_t *)buff;
+     sim_data_t   *data = (sim_data_t *)node->data;
+
+     memset( buff, 0, sizeof(buff) );
+     sim_node2ip( i, &node->hdr.IP );
+     node->hdr.pe     = i + 1;
+     node->hdr.status = INFOD_ALIVE;
+     node->hdr.psize  = sizeof(buff);
+     node->hdr.fsize  = sizeof(buff);
+     sim_clock( &node->hdr.time );
+     data->tmem  = 1000 + i;
+     data->speed = 10000;
+     infoVecUpdate( nodes[i].vec, node, sizeof(buff), 0 );
+}
+
+static void sim_step( int i, struct infodGossipAlgo *algo, void *gossipData ) {
+     struct gossipAction ga;
+     struct in_addr      peers[ INFOD_MAX_FANOUT ];
+     int                 numPeers = 1, tries = 4 * opts.fanout;
+     ivec_t              vec = nodes[i].vec;
+
+     sim_update_local( i );
+     infoVecExpire( vec );
+
+     memset( &ga, 0, sizeof(ga) );
+     ga.maxPeers = opts.fanout;
+     if( (*algo->stepFunc)( vec, gossipData, &ga )) {
+          peers[0] = ga.randIP;
+          if( ga.numPeers > 0 ) {
+               numPeers = ga.numPeers;
+               memcpy( peers, ga.peers, numPeers * sizeof(struct in_addr) );
+          }
+          // Fan-out peers as infod picks them
+          while( ga.msgHandle && numPeers < opts.fanout && tries-- > 0 ) {
+               struct in_addr ip;
+               int            p;
+
+               if( !infoVecRandomNode( vec, 1, &ip ))
+                    break;
+               for( p = 0 ; p < numPeers ; p++ )
+                    if( peers[p].s_addr == ip.s_addr )
+                         break;
+               if( p == numPeers )
+                    peers[ numPeers++ ] = ip;
+          }
+          for( int p = 0 ; p < numPeers ; p++ ) {
+               int dst = sim_ip2node( &peers[p] );
+
+               if( dst < 0 || dst == i )
+                    continue;
+               if( ga.msgType == INFOD_MSG_TYPE_INFO_PULL )
+                    stats.pulls++;
+               sim_send( i, dst, ga.msgType, ga.msgIov, ga.msgIovCnt,
+                         ga.msgData, ga.msgLen );
+          }
+          if( ga.msgHandle )
+               infoVecWindowIovDone( ga.msgHandle );
+     }
+
+     if( nodes[i].sampled && simNow >= opts.warmup * 1000000 ) {
+          infoVecDoAgeMeasure( vec );
+          infoVecDoEntriesUptoageMeasure( vec );
+     }
+}
+
+/****************************************************************************
+ * A message arriving, as handle_info() and handle_info_pull() of infod
+ ***************************************************************************/
+static void sim_deliver( sim_msg_t *msg ) {
+     ivec_t          vec = nodes[msg->dst].vec;
+     info_pull_msg_t *pull;
+     struct iovec    *iov;
+     void            *handle;
+     int              iovcnt, size;
+
+     if( nodes[msg->dst].failed )
+          return;
+     switch( msg->type ) {
+         case INFOD_MSG_TYPE_INFO:
+         case INFOD_MSG_TYPE_INFO_DELTA:
+              infoVecUseRemoteWindow( vec, msg->data, msg->size );
+              break;
+         case INFOD_MSG_TYPE_INFO_PULL:
+              pull = (info_pull_msg_t *)msg->data;
+              if( msg->size >= (int)INFO_PULL_MSG_SZ &&
+                  pull->param == INFO_PULL_DIGEST )
+                   handle = infoVecGetDigestAnswerIov( vec, pull, msg->size,
+                                                       &iov, &iovcnt, &size );
+              else
+                   handle = infoVecGetWindowIov( vec, 1, &iov, &iovcnt, &size );
+              if( !handle )
+                   break;
+              // The answer goes back on the same connection
+              if( !nodes[msg->src].failed )
+                   sim_send( msg->dst, msg->src, INFOD_MSG_TYPE_INFO, iov,
+                             iovcnt, NULL, size );
+              infoVecWindowIovDone( handle );
+              break;
+         default:
+              ;
+     }
+}
+
+/****************************************************************************
+ * Failing part of the nodes (not the sampled ones)
+ ***************************************************************************/
+static void sim_fail_nodes() {
+     int want = (int)( opts.failFrac * opts.n );
+
+     if( want > opts.n - opts.sample )
+          want = opts.n - opts.sample;
+     failedIdx = malloc( ( want + 1 ) * sizeof(int) );
+     while( numFailed < want ) {
+          int i = rand() % opts.n;
+
+          if( nodes[i].failed || nodes[i].sampled )
+               continue;
+          nodes[i].failed = 1;
+          failedIdx[ numFailed++ ] = i;
+     }
+     for( int i = 0 ; i < opts.n ; i++ )
+          if( nodes[i].sampled )
+               infoVecClearDeathLog( nodes[i].vec );
+     printf( "t=%-8.2f Failed %d nodes\n", simNow / 1000000.0, numFailed );
+}
+
+/* The part of the failures the sampled nodes know about */
+static double sim_failures_known() {
+     long known = 0, total = 0;
+
+     for( int i = 0 ; i < opts.n ; i++ ) {
+          if( !nodes[i].sampled )
+               continue;
+          for( int f = 0 ; f < numFailed ; f++ ) {
+               struct in_addr  ip;
+               ivec_entry_t   *e;
+               int             index;
+
+               sim_node2ip( failedIdx[f], &ip );
+               if(( e = infoVecFindByIP( nodes[i].vec, &ip, &index )) &&
+                  e->isdead )
+                    known++;
+               total++;
+          }
+     }
+     return total ? (double)known / total : 0.0;
+}
+
+/****************************************************************************
+ * Report
+ ***************************************************************************/
+static void sim_report( float *cdfAges, int cdfSize, double wallSecs ) {
+     ivec_age_measure_t              am;
+     ivec_entries_uptoage_measure_t  um;
+     ivec_death_log_t                dl;
+     double  avgAge = 0, avgMax = 0, maxMax = 0, upto[ SIM_MAX_CDF ];
+     double  deathSum = 0, deathMax = 0, stepSec = opts.timeStep / 1000.0;
+     int     measured = 0, deaths = 0;
+
+     memset( upto, 0, sizeof(upto) );
+     for( int i = 0 ; i < opts.n ; i++ ) {
+          if( !nodes[i].sampled )
+               continue;
+          infoVecGetAgeMeasure( nodes[i].vec, &am );
+          infoVecGetEntriesUptoageMeasure( nodes[i].vec, &um );
+          infoVecGetDeathLog( nodes[i].vec, &dl );
+          if( am.im_sampleNum == 0 )
+               continue;
+          measured++;
+          avgAge += am.im_avgAge;
+          avgMax += am.im_avgMaxAge;
+          if( am.im_maxMaxAge > maxMax )
+               maxMax = am.im_maxMaxAge;
+          for( int c = 0 ; c < um.im_size && c < cdfSize ; c++ )
+               upto[c] += um.im_entriesUpto[c];
+          for( int d = 0 ; d < dl.size ; d++ ) {
+               int f = sim_ip2node( &dl.ips[d] );
+
+               if( f < 0 || !nodes[f].failed )
+                    continue;
+               deaths++;
+               deathSum += dl.deathPropagationTime[d];
+               if( dl.deathPropagationTime[d] > deathMax )
+                    deathMax = dl.deathPropagationTime[d];
+          }
+     }
+
+     printf( "\nNodes %d  algo %s  window %d  fanout %d  step %d ms  "
+             "latency %.1f+%.1f ms  loss %.3f\n", opts.n, opts.algo,
+             opts.winSize, opts.fanout, opts.timeStep, opts.latency,
+             opts.jitter, opts.loss );
+     printf( "Simulated %.1f sec in %.1f sec, %lu events\n",
+             opts.duration, wallSecs, stats.events );
+     printf( "Messages %lu (%lu pulls) %.1f KB/node/sec  lost %lu  "
+             "refused %lu  dropped %lu\n", stats.sent, stats.pulls,
+             stats.bytes / 1024.0 / opts.n / opts.duration,
+             stats.lost, stats.refused, stats.dropped );
+     if( !measured )
+          return;
+
+     avgAge /= measured;
+     avgMax /= measured;
+     printf( "\nAge over %d nodes (sec):  avg %.3f  avg-max %.3f  max %.3f\n",
+             measured, avgAge, avgMax, maxMax );
+     printf( "In time steps:           avg %.3f  avg-max %.3f  max %.3f\n",
+             avgAge / stepSec, avgMax / stepSec, maxMax / stepSec );
+     if( opts.winSize < opts.n ) {
+          double T = calcTGivenW( opts.n, opts.winSize );
+          printf( "Model (steps):           avg %.3f  avg-max %.3f\n",
+                  calcAvFanout( opts.n, T, opts.fanout ),
+                  calcMaxAgeFanout( opts.n, T, opts.fanout ));
+     }
+
+     printf( "\nAge CDF (entries upto age, of %d nodes)\n", opts.n );
+     for( int c = 0 ; c < cdfSize ; c++ )
+          printf( "  %7.3f sec (%5.1f steps): %10.1f  %6.2f%%\n",
+                  cdfAges[c], cdfAges[c] / stepSec, upto[c] / measured,
+                  100.0 * upto[c] / measured / opts.n );
+
+     if( numFailed ) {
+          printf( "\nFailures known by the sampled nodes: %.2f%%\n",
+                  100.0 * sim_failures_known() );
+          if( deaths )
+               printf( "Death propagation (last %d deaths of each node): "
+                       "avg %.3f sec  max %.3f sec\n", INFOVEC_DEATH_LOG_SIZE,
+                       deathSum / deaths, deathMax );
+     }
+}
+
+int main( int argc, char **argv ) {
+     struct infodGossipAlgo *algo;
+     mapper_t                map;
+     char                    mapStr[128];
+     float                   cdfAges[ SIM_MAX_CDF ];
+     int                     cdfSteps[ SIM_MAX_CDF ] = { 1, 2, 3, 4, 6, 8,
+                                                         12, 16, 24, 32 };
+     unsigned long           end, failAt, nextReport, maxAge;
+     struct timeval          wallStart, wallEnd;
+     int                     failDone = 0;
+     void                   *gossipData = NULL;
+
+     progName = argv[0];
+     opts.n        = 1000;
+     opts.algo     = "mindead";
+     opts.winSize  = INFOD_DEF_WINSIZE;
+     opts.fanout   = 1;
+     opts.timeStep = INFOD_DEF_TIME_STEP;
+     opts.duration = 60;
+     opts.warmup   = 10;
+     opts.latency  = 1;
+     opts.sample   = 100;
+     opts.seed     = 1;
+     parseArgs( argc, argv );
+     srand( opts.seed );
+     mlog_init();
+
+     memset( &globOpts, 0, sizeof(globOpts) );
+     globOpts.opt_gossipRemoteRatio = -1.0;
+     globOpts.opt_gossipFanout      = opts.fanout;
+     if( !( algo = getGossipAlgoByName( opts.algo ))) {
+          fprintf( stderr, "Error: unknown gossip algorithm %s\n", opts.algo );
+          return 1;
+     }
+     globOpts.opt_gossipAlgo = algo;
+     (*algo->initFunc)( &gossipData );
+
+     // One mapper for all, each vector takes its node as the local one
+     inet_aton( SIM_BASE_IP, &baseIP );
+     snprintf( mapStr, sizeof(mapStr), "1 %s %d\n", SIM_BASE_IP, opts.n );
+     if( !( map = BuildUserViewMap( mapStr, strlen( mapStr ) + 1, INPUT_MEM ))) {
+          fprintf( stderr, "Error: building the map\n" );
+          return 1;
+     }
+
+     // Ages as infod: max age of 4 seconds per node
+     maxAge = opts.maxAge > 0 ? (unsigned long)( opts.maxAge * MILLI ) :
+          4UL * opts.n * MILLI * ( opts.timeStep >= 1000 ? opts.timeStep / 1000 : 1 );
+     infoVecSetClock( sim_clock );
+     if( !( nodes = calloc( opts.n, sizeof(sim_node_t) ))) {
+          fprintf( stderr, "Error: malloc\n" );
+          return 1;
+     }
+     for( int i = 0 ; i < SIM_MAX_CDF ; i++ )
+          cdfAges[i] = cdfSteps[i] * opts.timeStep / 1000.0;
+     for( int i = 0 ; i < opts.n ; i++ ) {
+          struct in_addr ip;
+
+          sim_node2ip( i, &ip );
+          mapperSetMyIP( map, &ip );
+          if( !( nodes[i].vec = infoVecInit( map, maxAge, INFOVEC_WIN_FIXED,
+                                             opts.winSize, sim_desc, 0 ))) {
+               fprintf( stderr, "Error: creating vector %d (of %d)\n",
+                        i, opts.n );
+               return 1;
+          }
+          if( opts.delta )
+               infoVecSetDeltaWindows( nodes[i].vec, 1 );
+     }
+     for( int s = 0 ; s < opts.sample ; ) {
+          int i = rand() % opts.n;
+
+          if( nodes[i].sampled )
+               continue;
+          nodes[i].sampled = 1;
+          infoVecSetEntriesUptoageMeasure( nodes[i].vec, 0, cdfAges, SIM_MAX_CDF );
+          s++;
+     }
+
+     // Events in flight: a time step for each node and its messages
+     if( !heap_init( &events, opts.n * ( opts.fanout + 2 ) *
+                     ( 2 + (int)(( opts.latency + opts.jitter ) / opts.timeStep )) + 16 )) {
+          fprintf( stderr, "Error: malloc, events\n" );
+          return 1;
+     }
+     for( int i = 0 ; i < opts.n ; i++ )
+          sim_schedule( rand() % ( opts.timeStep * 1000 ), NULL, i );
+
+     end        = (unsigned long)( opts.duration * 1000000 );
+     failAt     = opts.failFrac > 0 ? (unsigned long)( opts.failAt * 1000000 ) : end;
+     nextReport = 1000000;
+     gettimeofday( &wallStart, NULL );
+     while( !heap_is_empty( &events )) {
+          void          *data;
+          int            len;
+          unsigned long  when = heap_get_max_key( &events, &data, &len );
+
+          if( when >= end )
+               break;
+          heap_extract_max( &events, &data, &len );
+          simNow = when;
+          stats.events++;
+
+          if( !failDone && simNow >= failAt ) {
+               sim_fail_nodes();
+               failDone = 1;
+          }
+          if( simNow >= nextReport ) {
+               if( failDone && numFailed )
+                    printf( "t=%-8.2f failures known %.2f%%\n",
+                            simNow / 1000000.0, 100.0 * sim_failures_known() );
+               nextReport += 1000000;
+          }
+
+          if( data ) {
+               sim_deliver( (sim_msg_t *)data );
+               free( data );
+          }
+          else if( !nodes[len].failed ) {
+               sim_step( len, algo, gossipData );
+               sim_schedule( simNow + opts.timeStep * 1000, NULL, len );
+          }
+     }
+     gettimeofday( &wallEnd, NULL );
+
+     sim_report( cdfAges, SIM_MAX_CDF,
+                 ( wallEnd.tv_sec - wallStart.tv_sec ) +
+                 ( wallEnd.tv_usec - wallStart.tv_usec ) / 1000000.0 );
+
+     while( !heap_is_empty( &events )) {
+          void *data;
+          int   len;
+
+          heap_extract_max( &events, &data, &len );
+          free( data );
+     }
+     heap_free( &events );
+     for( int i = 0 ; i < opts.n ; i++ )
+          infoVecFree( nodes[i].vec );
+     free( nodes );
+     free( failedIdx );
+     mapperDone( map );
+     return 0;
+}
@@ -16,6 +16,7 @@
 #include <check.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -29,6 +30,7 @@
 #include <pe.h>
 #include <Mapper.h>
 #include <MapperBuilder.h>
+#include <info_reader.h>
 #include <infoVec.h>
 #include <infoVecInternal.h>
 //#include <distance_graph.h>
@@ -457,6 +459,218 @@ START_TEST (test_infoVecStats)
 END_TEST
 
 
+/*
+ * Updating an entry with a growing and then shrinking payload. The record
+ * must follow the payload size and give back the arena space on shrink.
+ */
+static void
+updateEntrySize(ivec_t vec, char *ipStr, char *buff, int extra)
+{
+	node_info_t *node = (node_info_t *) buff;
+	test_data_t *data = (test_data_t *) node->data;
+	int          n;
+
+	inet_aton(ipStr, &node->hdr.IP);
+	node->hdr.status = INFOD_ALIVE;
+	node->hdr.psize = NODE_INFO_SIZE + sizeof(test_data_t);
+	node->hdr.fsize = NODE_INFO_SIZE + sizeof(test_data_t) + extra;
+	data->tmem  = 500;
+	data->speed = 1000;
+	memset(data->external, 'x', extra);
+	usleep(10);
+	gettimeofday(&node->hdr.time, NULL);
+	n = infoVecUpdate(vec, node, node->hdr.fsize, 0);
+	fail_unless(n!=0, "Failed to update vector");
+}
+
+START_TEST (test_infoVecArena)
+{
+   mapper_t       map;
+   ivec_t         ivec;
+   int            n, index;
+   struct in_addr ip;
+   char          *buff;
+   infod_stats_t  stats;
+   double         baseUsed, bigUsed;
+   ivec_entry_t  *e;
+   
+   print_start("infoVecArena");
+   
+   map = BuildUserViewMap(test_stats_map, strlen(test_stats_map) + 1, INPUT_MEM);
+   fail_unless(map != NULL, "Failed to create map object");
+
+   inet_aton("192.168.0.1", &ip);
+   n = mapperSetMyIP(map, &ip);
+   fail_unless(n==1, "Setting my IP in mapper");
+
+   ivec = infoVecInit(map, 500, INFOVEC_WIN_FIXED, 16, info_desc, 0);
+   fail_unless(ivec != NULL, "Failed to create info vector");
+
+   buff = malloc(65536);
+   fail_unless(buff != NULL, "Failed allocating buffer");
+
+   updateEntrySize(ivec, "192.168.0.2", buff, 0);
+   infoVecStats(ivec, &stats);
+   baseUsed = stats.heapused;
+   fail_unless(stats.heapsize >= stats.heapused && stats.heapused > 0,
+	       "Bad heap counters");
+   
+   updateEntrySize(ivec, "192.168.0.2", buff, 40000);
+   infoVecStats(ivec, &stats);
+   bigUsed = stats.heapused;
+   fail_unless(bigUsed > baseUsed + 39000, "Heap did not grow");
+
+   inet_aton("192.168.0.2", &ip);
+   e = infoVecFindByIP(ivec, &ip, &index);
+   fail_unless(e->info->hdr.fsize == NODE_INFO_SIZE + sizeof(test_data_t) + 40000,
+	       "Record size is not the update size");
+   
+   updateEntrySize(ivec, "192.168.0.2", buff, 100);
+   infoVecStats(ivec, &stats);
+   fail_unless(stats.heapused < bigUsed - 30000, "Heap did not shrink");
+   e = infoVecFindByIP(ivec, &ip, &index);
+   fail_unless(e->info->hdr.fsize == NODE_INFO_SIZE + sizeof(test_data_t) + 100,
+	       "Record size is not the update size");
+   fail_unless(((test_data_t *)e->info->data)->external[99] == 'x',
+	       "Record data was not copied");
+   
+   free(buff);
+   infoVecFree(ivec);
+   mapperDone(map);
+   print_end();
+}
+END_TEST
+
+/*
+ * Flatten an iovec to buff and clear the fields which may differ between
+ * two windows taken one after the other (ages and priorities)
+ */
+static int
+flattenWindow(char *buff, char *src, struct iovec *iov, int iovcnt)
+{
+	info_msg_t       *msg = (info_msg_t *) buff;
+	info_msg_entry_t *ent;
+	int               i, len = 0;
+
+	if(iov) {
+		for(i = 0 ; i < iovcnt ; i++) {
+			memcpy(buff + len, iov[i].iov_base, iov[i].iov_len);
+			len += iov[i].iov_len;
+		}
+	}
+	else {
+		len = ((info_msg_t *)src)->tsize;
+		memcpy(buff, src, len);
+	}
+	
+	for(i = 0, ent = msg->data ; i < msg->num ; i++) {
+		ent->priority = 0;
+		timerclear(&ent->data->hdr.time);
+		ent = (info_msg_entry_t *)((char *)ent + ent->size);
+	}
+	return len;
+}
+
+/*
+ * The scatter/gather window must carry the same message as the copied one
+ * and keep pointing to the old data when the records change while it is
+ * being sent.
+ */
+START_TEST (test_infoVecWindowIov)
+{
+   mapper_t       map;
+   ivec_t         ivec;
+   int            n, index, size, iovSize, iovcnt;
+   struct in_addr ip;
+   char          *buff, *copyWin, *iovWin, *winBuff;
+   struct iovec  *iov;
+   void          *handle;
+   ivec_entry_t  *e;
+   node_info_t   *node, *pinned;
+   
+   print_start("infoVecWindowIov");
+   
+   map = BuildUserViewMap(test_stats_map, strlen(test_stats_map) + 1, INPUT_MEM);
+   fail_unless(map != NULL, "Failed to create map object");
+
+   inet_aton("192.168.0.1", &ip);
+   n = mapperSetMyIP(map, &ip);
+   fail_unless(n==1, "Setting my IP in mapper");
+
+   ivec = infoVecInit(map, 500, INFOVEC_WIN_FIXED, 16, info_desc, 0);
+   fail_unless(ivec != NULL, "Failed to create info vector");
+
+   buff    = malloc(65536);
+   copyWin = malloc(65536);
+   iovWin  = malloc(65536);
+   fail_unless(buff && copyWin && iovWin, "Failed allocating buffers");
+
+   updateEntrySize(ivec, "192.168.0.2", buff, 100);
+   updateEntrySize(ivec, "192.168.0.3", buff, 0);
+   updateEntrySize(ivec, "192.168.1.1", buff, 3000);
+   
+   winBuff = infoVecGetWindow(ivec, &size, 1);
+   fail_unless(winBuff != NULL, "Failed getting window");
+   flattenWindow(copyWin, winBuff, NULL, 0);
+
+   handle = infoVecGetWindowIov(ivec, 1, &iov, &iovcnt, &iovSize);
+   fail_unless(handle != NULL, "Failed getting iov window");
+   fail_unless(iovSize == size, "Iov window size differs from the copied one");
+   fail_unless(iovcnt < 2 * 4 + 1, "Iov chunks were not merged");
+   n = flattenWindow(iovWin, NULL, iov, iovcnt);
+   fail_unless(n == size, "Iov chunks do not add up to the window size");
+   fail_unless(memcmp(copyWin, iovWin, size) == 0,
+	       "Iov window differs from the copied one");
+
+   // Changing a record while the window still points to it
+   inet_aton("192.168.1.1", &ip);
+   e = infoVecFindByIP(ivec, &ip, &index);
+   pinned = e->info;
+   node = (node_info_t *) buff;
+   memset(((test_data_t *)node->data)->external, 'y', 3000);
+   usleep(10);
+   gettimeofday(&node->hdr.time, NULL);
+   n = infoVecUpdate(ivec, node, node->hdr.fsize, 0);
+   fail_unless(n != 0, "Failed to update vector");
+   e = infoVecFindByIP(ivec, &ip, &index);
+   fail_unless(e->info != pinned, "Pinned record was changed in place");
+   fail_unless(((test_data_t *)e->info->data)->external[0] == 'y',
+	       "Record was not updated");
+   
+   n = flattenWindow(iovWin, NULL, iov, iovcnt);
+   fail_unless(memcmp(copyWin, iovWin, size) == 0,
+	       "Iov window changed after the record was updated");
+   infoVecWindowIovDone(handle);
+
+   // The vector may go away before the send is done
+   winBuff = infoVecGetWindow(ivec, &size, 1);
+   flattenWindow(copyWin, winBuff, NULL, 0);
+   handle = infoVecGetWindowIov(ivec, 1, &iov, &iovcnt, &iovSize);
+   fail_unless(handle != NULL, "Failed getting iov window");
+   infoVecFree(ivec);
+   n = flattenWindow(iovWin, NULL, iov, iovcnt);
+   fail_unless(memcmp(copyWin, iovWin, size) == 0,
+	       "Iov window changed after the vector was freed");
+
+   // Sent to several peers, the window stays until the last send is done
+   infoVecWindowIovRef(handle);
+   infoVecWindowIovRef(handle);
+   infoVecWindowIovDone(handle);
+   infoVecWindowIovDone(handle);
+   n = flattenWindow(iovWin, NULL, iov, iovcnt);
+   fail_unless(memcmp(copyWin, iovWin, size) == 0,
+	       "Iov window changed before its last send was done");
+   infoVecWindowIovDone(handle);
+
+   free(buff);
+   free(copyWin);
+   free(iovWin);
+   mapperDone(map);
+   print_end();
+}
+END_TEST
+
+
 char *test_vec_punish = 
 "1    192.168.0.1 3 \n"
 "10   192.168.1.1 3 \n";
@@ -978,6 +1192,187 @@ END_TEST
 
 
 
+char *test_vec_window_order = 
+"1      192.168.0.1 200 \n";
+
+START_TEST (test_infoVecWindowOrder)
+{
+   mapper_t          map;
+   ivec_t            ivec;
+   int               n, i, winSize;
+   struct in_addr    ip;
+   ivec_entry_t    **ents;
+      
+   print_start("infoVecWindowOrder");
+
+   map = BuildUserViewMap(test_vec_window_order,
+			  strlen(test_vec_window_order) + 1, INPUT_MEM);
+   fail_unless(map != NULL, "Failed to create map object");
+
+   inet_aton("192.168.0.1", &ip);
+   n = mapperSetMyIP(map, &ip);
+   fail_unless(n==1, "Setting my IP in mapper");
+
+   ivec = infoVecInit(map, 500, INFOVEC_WIN_FIXED, 16, info_desc, 0);
+   fail_unless(ivec != NULL, "Failed to create info vector");
+
+   // Many updates, some with priority, more entries than the window holds
+   srand(2);
+   for(i = 0 ; i < 2000 ; i++) {
+	   char ipStr[32];
+	   sprintf(ipStr, "192.168.0.%d", 2 + (i * 7) % 199);
+	   updateEntryPrio(ivec, ipStr, (rand() % 10 == 0) ? rand() % 4 : 0);
+   }
+   fail_unless(infoVecGetWinSize(ivec) == 31, "Window is not full");
+   
+   ents = infoVecGetWindowEntries(ivec, &winSize);
+   fail_unless(ents != NULL, "Failed getting window entries");
+   fail_unless(winSize == 16, "Window size is not as expected");
+
+   // Window entries must come by priority and then newest first
+   for(i = 0 ; i < ivec->win.sendSize - 1 ; i++) {
+	   info_win_entry_t *a = &ivec->win.data[i];
+	   info_win_entry_t *b = &ivec->win.data[i + 1];
+
+	   fail_unless(a->priority >= b->priority, "Window not sorted by priority");
+	   if(a->priority == b->priority)
+		   fail_unless(!timercmp(&ivec->vec[a->index].info->hdr.time,
+					 &ivec->vec[b->index].info->hdr.time, <),
+			       "Window not sorted by time");
+   }
+   free(ents);
+   
+   infoVecFree(ivec);
+   mapperDone(map);
+   print_end();
+}
+END_TEST
+
+
+/*
+ * The lookup done by infoVecFindByIP before the IP index was added: a linear
+ * scan over the continuous parts of the map. Kept here for comparison only.
+ */
+static ivec_entry_t *
+findByContIPsScan(ivec_t vec, struct in_addr *ip, int *index)
+{
+	struct in_addr ip_horder = *ip;
+	int i;
+	
+	ip_horder.s_addr = ntohl(ip_horder.s_addr);
+	for(i = 0 ; i < vec->contIPs.size ; i++) {
+		if((ip_horder.s_addr >= vec->contIPs.data[i].ip.s_addr) &&
+		   (ip_horder.s_addr <= (vec->contIPs.data[i].ip.s_addr +
+					 vec->contIPs.data[i].size - 1))) {
+			*index = vec->contIPs.data[i].index +
+				(ip_horder.s_addr - vec->contIPs.data[i].ip.s_addr);
+			return &(vec->vec[*index]);
+		}
+	}
+	*index = -1;
+	return NULL;
+}
+
+static double
+timeDiffSec(struct timeval *start, struct timeval *end)
+{
+	return (end->tv_sec - start->tv_sec) +
+		(end->tv_usec - start->tv_usec) / 1000000.0;
+}
+
+#define FIND_BENCH_RANGES      (300)
+#define FIND_BENCH_RANGE_SIZE  (3)
+#define FIND_BENCH_LOOKUPS     (200000)
+
+START_TEST (test_infoVecFindBench)
+{
+   mapper_t          map;
+   ivec_t            ivec;
+   int               n, i;
+   struct in_addr    ip;
+   struct in_addr   *ips;
+   char             *mapStr, *ptr;
+   struct timeval    start, end;
+   double            scanTime, hashTime;
+   
+   print_start("infoVecFindBench");
+
+   //===== Building a sparse map: many small ranges with holes between them
+   mapStr = malloc(FIND_BENCH_RANGES * 64);
+   fail_unless(mapStr != NULL, "Failed to allocate map string");
+   ptr = mapStr;
+   for(i = 0 ; i < FIND_BENCH_RANGES ; i++) {
+	   ptr += sprintf(ptr, "%d 10.%d.%d.1 %d \n",
+			  i * FIND_BENCH_RANGE_SIZE + 1,
+			  i / 200, (i % 200) + 1, FIND_BENCH_RANGE_SIZE);
+   }
+   
+   map = BuildUserViewMap(mapStr, strlen(mapStr) + 1, INPUT_MEM);
+   fail_unless(map != NULL, "Failed to create map object");
+
+   inet_aton("10.0.1.1", &ip);
+   n = mapperSetMyIP(map, &ip);
+   fail_unless(n==1, "Setting my IP in mapper");
+
+   ivec = infoVecInit(map, 500, INFOVEC_WIN_FIXED, 16, info_desc, 0);
+   fail_unless(ivec != NULL, "Failed to create info vector");
+   fail_unless(ivec->contIPs.size == FIND_BENCH_RANGES,
+	       "Map is not sparse as expected");
+
+   //===== Random lookups, 1 of 8 is an address that is not in the map
+   ips = malloc(FIND_BENCH_LOOKUPS * sizeof(struct in_addr));
+   fail_unless(ips != NULL, "Failed to allocate ips");
+   srand(1);
+   for(i = 0 ; i < FIND_BENCH_LOOKUPS ; i++) {
+	   int r = rand() % FIND_BENCH_RANGES;
+	   int off = (rand() % 8 == 0) ? FIND_BENCH_RANGE_SIZE + 1 :
+		   rand() % FIND_BENCH_RANGE_SIZE;
+	   char  ipStr[32];
+	   
+	   sprintf(ipStr, "10.%d.%d.%d", r / 200, (r % 200) + 1, 1 + off);
+	   inet_aton(ipStr, &ips[i]);
+   }
+
+   //===== Both lookups must agree
+   for(i = 0 ; i < FIND_BENCH_LOOKUPS ; i++) {
+	   int idx1, idx2;
+	   ivec_entry_t *e1, *e2;
+
+	   e1 = infoVecFindByIP(ivec, &ips[i], &idx1);
+	   e2 = findByContIPsScan(ivec, &ips[i], &idx2);
+	   fail_unless(e1 == e2 && idx1 == idx2,
+		       "IP index and range scan disagree on %s", inet_ntoa(ips[i]));
+   }
+
+   //===== Timing
+   gettimeofday(&start, NULL);
+   for(i = 0 ; i < FIND_BENCH_LOOKUPS ; i++) {
+	   int idx;
+	   findByContIPsScan(ivec, &ips[i], &idx);
+   }
+   gettimeofday(&end, NULL);
+   scanTime = timeDiffSec(&start, &end);
+
+   gettimeofday(&start, NULL);
+   for(i = 0 ; i < FIND_BENCH_LOOKUPS ; i++) {
+	   int idx;
+	   infoVecFindByIP(ivec, &ips[i], &idx);
+   }
+   gettimeofday(&end, NULL);
+   hashTime = timeDiffSec(&start, &end);
+
+   printf("infoVecFindByIP: %d lookups over %d ranges: scan %.4fs index %.4fs\n",
+	  FIND_BENCH_LOOKUPS, FIND_BENCH_RANGES, scanTime, hashTime);
+
+   free(ips);
+   free(mapStr);
+   infoVecFree(ivec);
+   mapperDone(map);
+   print_end();
+}
+END_TEST
+
+
 char *test_vec_random = 
 "1      192.168.0.1 4 \n";
 
@@ -1043,6 +1438,31 @@ START_TEST (test_infoVecRandom)
 	   
    }
 
+   // Once 0.2 dies only 0.3 can be selected, until 0.2 is back
+   inet_aton("192.168.0.2", &ip);
+   infoVecPunish(ivec, &ip, INFOD_DEAD_CONNECT);
+   for(int i=0 ; i < 100 ; i++) {
+	   struct in_addr randIP;
+	   
+	   n = infoVecRandomNode(ivec, 1, &randIP);
+	   fail_unless(n > 0, "infoVecRandomNode failed but there are live nodes");
+	   fail_unless(strcmp("192.168.0.3", inet_ntoa(randIP)) == 0,
+		       "Random node was not the only live node");
+   }
+   
+   updateEntry(ivec, "192.168.0.2");
+   int got2 = 0, got3 = 0;
+   for(int i=0 ; i < 100 ; i++) {
+	   struct in_addr randIP;
+	   
+	   n = infoVecRandomNode(ivec, 1, &randIP);
+	   fail_unless(n > 0, "infoVecRandomNode failed but there are live nodes");
+	   got2 += strcmp("192.168.0.2", inet_ntoa(randIP)) == 0;
+	   got3 += strcmp("192.168.0.3", inet_ntoa(randIP)) == 0;
+   }
+   fail_unless(got2 > 0 && got3 > 0 && got2 + got3 == 100,
+	       "Random live nodes are not 0.2 and 0.3");
+
 
    
    infoVecFree(ivec);
@@ -1142,9 +1562,59 @@ START_TEST (test_infoVecOldest)
    n = infoVecOldestNode(ivec, &ip);
    fail_unless(strcmp("192.168.0.2", inet_ntoa(ip)) == 0,
 		       "Oldest node is not correct");
+
+   // Updated nodes move to the end, dead ones leave
+   struct in_addr ips[4];
+   updateEntry(ivec, "192.168.0.2");
+   inet_aton("192.168.0.3", &ip);
+   infoVecPunish(ivec, &ip, INFOD_DEAD_CONNECT);
+   n = infoVecOldestNodes(ivec, ips, 4);
+   fail_unless(n == 2, "Expected 2 oldest nodes");
+   fail_unless(strcmp("192.168.0.4", inet_ntoa(ips[0])) == 0 &&
+	       strcmp("192.168.0.2", inet_ntoa(ips[1])) == 0,
+	       "Oldest nodes are not correct");
    
    infoVecFree(ivec);
    mapperDone(map);
+
+   // The k oldest of many nodes
+   map = BuildUserViewMap(test_vec_stress, strlen(test_vec_stress) + 1, INPUT_MEM);
+   fail_unless(map != NULL, "Failed to create map object");
+   inet_aton("192.168.0.1", &ip);
+   fail_unless(mapperSetMyIP(map, &ip) == 1, "Setting my IP in mapper");
+   ivec = infoVecInit(map, 500, INFOVEC_WIN_FIXED, 4 , info_desc, 0);
+   fail_unless(ivec != NULL, "Failed to create info vector");
+
+   ivec_entry_t **all = infoVecGetAllEntries(ivec);
+   for(int i = 0 ; i < 3 ; i++)
+	   for(int j = (i * 7) % 5 ; j < infoVecGetSize(ivec) ; j += 1 + i * 2)
+		   updateEntry(ivec, inet_ntoa(all[j]->info->hdr.IP));
+
+   struct in_addr oldest[50];
+   struct timeval last = { 0, 0 };
+   int            index;
+   n = infoVecOldestNodes(ivec, oldest, 50);
+   fail_unless(n == 50, "Expected 50 oldest nodes");
+   for(int i = 0 ; i < n ; i++) {
+	   ivec_entry_t *e = infoVecFindByIP(ivec, &oldest[i], &index);
+	   fail_unless(e->isdead == 0 && index != ivec->localIndex,
+		       "Oldest node is not an alive peer");
+	   fail_unless(!timercmp(&e->info->hdr.time, &last, <),
+		       "Oldest nodes are not ordered");
+	   last = e->info->hdr.time;
+   }
+   for(int j = 0 ; j < infoVecGetSize(ivec) ; j++) {
+	   int found = 0;
+	   if(all[j]->isdead || j == ivec->localIndex)
+		   continue;
+	   for(int i = 0 ; i < n ; i++)
+		   found |= oldest[i].s_addr == all[j]->info->hdr.IP.s_addr;
+	   fail_unless(found || !timercmp(&all[j]->info->hdr.time, &last, <),
+		       "A node older than the oldest nodes was left out");
+   }
+   free(all);
+   infoVecFree(ivec);
+   mapperDone(map);
    print_end();
    msx_set_debug(0);
 }
@@ -1415,6 +1885,1131 @@ END_TEST
 
 
 /***************************************************/
+/*
+ * Get a window of vec as one buffer
+ */
+static int
+getWindowBuff(ivec_t vec, char *buff)
+{
+	struct iovec *iov;
+	int           iovcnt, size, len = 0;
+	void         *handle;
+
+	handle = infoVecGetWindowIov(vec, 1, &iov, &iovcnt, &size);
+	fail_unless(handle != NULL, "Failed getting iov window");
+	for(int i = 0 ; i < iovcnt ; i++) {
+		memcpy(buff + len, iov[i].iov_base, iov[i].iov_len);
+		len += iov[i].iov_len;
+	}
+	infoVecWindowIovDone(handle);
+	fail_unless(len == size, "Window size does not match the iovec");
+	return size;
+}
+
+/*
+ * A delta window carries only the changed part of an entry, and is applied
+ * only by receivers which hold a version the delta starts from.
+ */
+START_TEST (test_infoVecDeltaWindow)
+{
+   mapper_t       map, map2, map3;
+   ivec_t         ivec, ivec2, ivec3;
+   int            n, index, fullSize, deltaSize;
+   struct in_addr ip;
+   char          *buff, *win;
+   node_info_t   *node;
+   ivec_entry_t  *e, *e2, *e3;
+   info_delta_msg_t *dmsg;
+   
+   print_start("infoVecDeltaWindow");
+   
+   map = BuildUserViewMap(test_stats_map, strlen(test_stats_map) + 1, INPUT_MEM);
+   map2 = BuildUserViewMap(test_stats_map, strlen(test_stats_map) + 1, INPUT_MEM);
+   map3 = BuildUserViewMap(test_stats_map, strlen(test_stats_map) + 1, INPUT_MEM);
+   fail_unless(map && map2 && map3, "Failed to create map object");
+
+   inet_aton("192.168.0.1", &ip);
+   fail_unless(mapperSetMyIP(map, &ip) == 1, "Setting my IP in mapper");
+   inet_aton("192.168.0.2", &ip);
+   fail_unless(mapperSetMyIP(map2, &ip) == 1, "Setting my IP in mapper");
+   inet_aton("192.168.0.3", &ip);
+   fail_unless(mapperSetMyIP(map3, &ip) == 1, "Setting my IP in mapper");
+
+   ivec  = infoVecInit(map, 500, INFOVEC_WIN_FIXED, 16, info_desc, 0);
+   ivec2 = infoVecInit(map2, 500, INFOVEC_WIN_FIXED, 16, info_desc, 0);
+   ivec3 = infoVecInit(map3, 500, INFOVEC_WIN_FIXED, 16, info_desc, 0);
+   fail_unless(ivec && ivec2 && ivec3, "Failed to create info vector");
+   infoVecSetDeltaWindows(ivec, 1);
+   fail_unless(infoVecWindowMsgType(ivec) == INFOD_MSG_TYPE_INFO_DELTA,
+	       "Delta window message type");
+
+   buff = malloc(65536);
+   win  = malloc(65536);
+   fail_unless(buff && win, "Failed allocating buffers");
+
+   // The first delta window has only full entries
+   updateEntrySize(ivec, "192.168.0.1", buff, 3000);
+   fullSize = getWindowBuff(ivec, win);
+   n = infoVecUseRemoteWindow(ivec2, win, fullSize);
+   fail_unless(n != 0, "Failed using full delta window");
+
+   // A refresh which does not change the data goes with no chunks at all
+   node = (node_info_t *) buff;
+   usleep(10);
+   gettimeofday(&node->hdr.time, NULL);
+   n = infoVecUpdate(ivec, node, node->hdr.fsize, 0);
+   fail_unless(n != 0, "Failed to update vector");
+   deltaSize = getWindowBuff(ivec, win);
+   dmsg = (info_delta_msg_t *) win;
+   fail_unless(dmsg->num == 1, "Expected one entry in the delta window");
+   fail_unless(dmsg->data[0].base != 0 && dmsg->data[0].mask == 0 &&
+	       dmsg->data[0].size == (int)(INFO_DELTA_ENTRY_SIZE + NHDR_SZ),
+	       "Refresh is not a header only delta");
+   n = infoVecUseRemoteWindow(ivec2, win, deltaSize);
+   fail_unless(n != 0, "Failed using delta window");
+   inet_aton("192.168.0.1", &ip);
+   e2 = infoVecFindByIP(ivec2, &ip, &index);
+   fail_unless(e2->info->hdr.fsize == node->hdr.fsize &&
+	       memcmp(e2->info->data, node->data,
+		      node->hdr.fsize - NODE_INFO_SIZE) == 0,
+	       "Header only delta changed the data");
+   
+   // Changing only the load, the next window carries one chunk of it
+   ((test_data_t *)node->data)->tmem = 600;
+   usleep(10);
+   gettimeofday(&node->hdr.time, NULL);
+   n = infoVecUpdate(ivec, node, node->hdr.fsize, 0);
+   fail_unless(n != 0, "Failed to update vector");
+   
+   deltaSize = getWindowBuff(ivec, win);
+   fail_unless(deltaSize * 4 < fullSize,
+	       "Delta window is not smaller than the full one");
+   n = infoVecUseRemoteWindow(ivec2, win, deltaSize);
+   fail_unless(n != 0, "Failed using delta window");
+   n = infoVecUseRemoteWindow(ivec3, win, deltaSize);
+   fail_unless(n != 0, "Failed using delta window");
+   
+   inet_aton("192.168.0.1", &ip);
+   e  = infoVecFindByIP(ivec, &ip, &index);
+   e2 = infoVecFindByIP(ivec2, &ip, &index);
+   e3 = infoVecFindByIP(ivec3, &ip, &index);
+   fail_unless(e2->info->hdr.fsize == e->info->hdr.fsize &&
+	       memcmp(e2->info->data, e->info->data,
+		      e->info->hdr.fsize - NODE_INFO_SIZE) == 0,
+	       "Delta was not applied");
+   fail_unless(((test_data_t *)e2->info->data)->tmem == 600,
+	       "Delta was not applied");
+   fail_unless(e2->isdead == 0, "Entry should be alive");
+   
+   // The third vector never had the entry, the delta is not for it
+   fail_unless(e3->info->hdr.fsize == NODE_INFO_SIZE && e3->isdead,
+	       "Delta was applied without its base");
+   
+   free(buff);
+   free(win);
+   infoVecFree(ivec);
+   infoVecFree(ivec2);
+   infoVecFree(ivec3);
+   mapperDone(map);
+   mapperDone(map2);
+   mapperDone(map3);
+   print_end();
+}
+END_TEST
+
+/*
+ * Timers must fire at the first advance which reaches their expiry, at any
+ * level of the wheel
+ */
+static twheel_tick_t  wheelTarget;
+static twheel_tick_t  wheelFired[ 64 ];
+
+static void
+wheelExpire(int id, void *arg)
+{
+	fail_unless(wheelFired[id] == 0, "Timer fired twice");
+	wheelFired[id] = wheelTarget;
+}
+
+START_TEST (test_timeWheel)
+{
+   twheel_t       tw;
+   twheel_tick_t  expire[ 64 ], prev, now = 5;
+   int            i, n, fired = 0;
+
+   print_start("timeWheel");
+
+   fail_unless(twheel_init(&tw, 64, now) == 1, "Failed to init wheel");
+   for(i = 0 ; i < 64 ; i++) {
+	   // Spread over all the levels and beyond the top one
+	   expire[i] = now + 1 + ((twheel_tick_t)i * i * i * i * 7) % 40000000;
+	   fail_unless(twheel_schedule(&tw, i, expire[i]) == 1, "Schedule");
+   }
+   // Moving and cancelling
+   expire[3] = now + 70;
+   twheel_schedule(&tw, 3, expire[3]);
+   twheel_cancel(&tw, 4);
+   fail_unless(twheel_size(&tw) == 63, "Wheel size after cancel");
+   bzero(wheelFired, sizeof(wheelFired));
+
+   while(twheel_size(&tw) > 0) {
+	   prev = now;
+	   now += 1 + (now * 31) % 900000;
+	   wheelTarget = now;
+	   n = twheel_advance(&tw, now, wheelExpire, NULL);
+	   fired += n;
+	   for(i = 0 ; i < 64 ; i++) {
+		   if(i == 4)
+			   continue;
+		   fail_unless((expire[i] > prev && expire[i] <= now) ==
+			       (wheelFired[i] == now),
+			       "Timer fired at the wrong tick");
+	   }
+   }
+   fail_unless(fired == 63, "Not all the timers fired");
+   fail_unless(wheelFired[4] == 0, "Cancelled timer fired");
+   twheel_free(&tw);
+   print_end();
+}
+END_TEST
+
+/*
+ * Entries are punished by infoVecExpire once their information is older
+ * than max_age, queries leave them as they are
+ */
+START_TEST (test_infoVecExpire)
+{
+   mapper_t          map;
+   ivec_t            ivec;
+   struct in_addr    ip;
+   int               n, index;
+   ivec_entry_t     *e2, *e11, **all;
+
+   print_start("infoVecExpire");
+
+   map = BuildUserViewMap(test_stats_map, strlen(test_stats_map) + 1, INPUT_MEM);
+   fail_unless(map != NULL, "Failed to create map object");
+   inet_aton("192.168.0.1", &ip);
+   fail_unless(mapperSetMyIP(map, &ip) == 1, "Setting my IP in mapper");
+
+   // max age of 0.2 second
+   ivec = infoVecInit(map, 200000, INFOVEC_WIN_FIXED, 16, info_desc, 0);
+   fail_unless(ivec != NULL, "Failed to create info vector");
+
+   updateEntry(ivec, "192.168.0.2");
+   updateEntry(ivec, "192.168.1.1");
+   fail_unless(infoVecExpire(ivec) == 0, "Fresh entries expired");
+
+   usleep(150000);
+   updateEntry(ivec, "192.168.0.2");
+   usleep(100000);
+
+   inet_aton("192.168.0.2", &ip);
+   e2 = infoVecFindByIP(ivec, &ip, &index);
+   inet_aton("192.168.1.1", &ip);
+   e11 = infoVecFindByIP(ivec, &ip, &index);
+   
+   all = infoVecGetAllEntries(ivec);
+   fail_unless(all != NULL, "Failed to get all vector entries");
+   free(all);
+   fail_unless(e11->isdead == 0, "Query punished an old entry");
+   
+   n = infoVecExpire(ivec);
+   fail_unless(n == 1, "Expected one entry to expire");
+   fail_unless(e11->isdead && e11->info->hdr.cause == INFOD_DEAD_AGE,
+	       "Old entry is not dead");
+   fail_unless(e2->isdead == 0, "Updated entry expired");
+   
+   usleep(150000);
+   fail_unless(infoVecExpire(ivec) == 1, "Updated entry did not expire");
+   fail_unless(e2->isdead, "Updated entry is not dead");
+   fail_unless(infoVecNumAlive(ivec) == 0, "Entries left alive");
+   
+   infoVecFree(ivec);
+   mapperDone(map);
+   print_end();
+}
+END_TEST
+
+static void
+updateEntryData(ivec_t vec, char *ipStr, unsigned long tmem, unsigned long speed)
+{
+	char         buff[250];
+	node_info_t *node = (node_info_t *) buff;
+	test_data_t *data = (test_data_t *) (buff + sizeof(node_info_t));
+	
+	inet_aton(ipStr, &(node->hdr.IP));
+	node->hdr.pe = 1111;
+	node->hdr.status = INFOD_ALIVE;
+	node->hdr.psize = NODE_INFO_SIZE + sizeof(test_data_t);
+	node->hdr.fsize = NODE_INFO_SIZE + sizeof(test_data_t);
+	data->tmem  = tmem;
+	data->speed = speed;
+	gettimeofday(&node->hdr.time, NULL);
+	fail_unless(infoVecUpdate(vec, node, node->hdr.fsize, 0) != 0,
+		    "Failed to update vector");
+}
+
+static void
+sumTestData(node_info_t *info, double *vals)
+{
+	test_data_t *data = (test_data_t *) info->data;
+	vals[0] = data->tmem;
+	vals[1] = data->speed;
+}
+
+/*
+ * The totals and ages kept by the vector match what a scan of the vector
+ * gives
+ */
+START_TEST (test_infoVecStatsTotals)
+{
+   mapper_t          map;
+   ivec_t            ivec;
+   struct in_addr    ip;
+   infod_stats_t     stats;
+   double            sums[2], maxs[2];
+   double            ageSum = 0.0;
+   struct timeval    cur;
+   int               i, num = 0;
+   
+   print_start("infoVecStatsTotals");
+
+   map = BuildUserViewMap(test_stats_map, strlen(test_stats_map) + 1, INPUT_MEM);
+   fail_unless(map != NULL, "Failed to create map object");
+   inet_aton("192.168.0.1", &ip);
+   fail_unless(mapperSetMyIP(map, &ip) == 1, "Setting my IP in mapper");
+   ivec = infoVecInit(map, 60000000, INFOVEC_WIN_FIXED, 16, info_desc, 0);
+   fail_unless(ivec != NULL, "Failed to create info vector");
+
+   // Nodes updated before the function is set are counted too
+   updateEntryData(ivec, "192.168.0.2", 200, 3000);
+   fail_unless(infoVecSetSumFunc(ivec, sumTestData, 2, 1 << 1) == 1, "Setting sum func");
+   usleep(300000);
+   updateEntryData(ivec, "192.168.0.1", 100, 1000);
+   updateEntryData(ivec, "192.168.0.3", 300, 2000);
+   updateEntryData(ivec, "192.168.1.1", 400, 1000);
+
+   fail_unless(infoVecGetSums(ivec, sums, maxs) == 4, "Expected 4 alive");
+   fail_unless(sums[0] == 1000 && maxs[1] == 3000, "Wrong totals");
+
+   // The node with the maximal speed slows down, then one dies
+   updateEntryData(ivec, "192.168.0.2", 200, 500);
+   fail_unless(infoVecGetSums(ivec, sums, maxs) == 4, "Expected 4 alive");
+   fail_unless(sums[0] == 1000 && sums[1] == 4500 && maxs[1] == 2000,
+	       "Wrong totals after update");
+   inet_aton("192.168.0.3", &ip);
+   infoVecPunish(ivec, &ip, INFOD_DEAD_CONNECT);
+   fail_unless(infoVecGetSums(ivec, sums, maxs) == 3, "Expected 3 alive");
+   fail_unless(sums[0] == 700 && sums[1] == 2500 && maxs[1] == 1000,
+	       "Wrong totals after death");
+
+   // Ages
+   usleep(300000);
+   updateEntryData(ivec, "192.168.0.3", 300, 2000);
+   updateEntryData(ivec, "192.168.0.2", 200, 500);
+   infoVecStats(ivec, &stats);
+   gettimeofday(&cur, NULL);
+   for(i = 0 ; i < infoVecGetSize(ivec) ; i++) {
+	   ivec_entry_t *e = &ivec->vec[i];
+	   if(e->isdead)
+		   continue;
+	   ageSum += (cur.tv_sec - e->info->hdr.time.tv_sec) +
+		   (cur.tv_usec - e->info->hdr.time.tv_usec) / 1000000.0;
+	   num++;
+   }
+   fail_unless(stats.num_alive == 4 && num == 4, "Expected 4 alive");
+   fail_unless(fabs(stats.avgage - ageSum / num) < 0.01, "Wrong average age");
+   fail_unless(stats.maxage > 0.25 && stats.maxage < 0.45, "Wrong max age");
+   // Two fresh nodes and two 0.3 seconds old
+   fail_unless(stats.agep50 < 0.1, "Wrong median age");
+   fail_unless(stats.agep95 > 0.2 && stats.agep95 < 0.45, "Wrong 95%% age");
+
+   infoVecFree(ivec);
+   mapperDone(map);
+   print_end();
+}
+END_TEST
+
+/*
+ * Updating the node with the maximal value moves it in the heap, the
+ * entries are not counted again
+ */
+START_TEST (test_infoVecStatsMax)
+{
+   mapper_t          map;
+   ivec_t            ivec;
+   struct in_addr    ip;
+   double            sums[2], maxs[2];
+   unsigned long     rebuilds;
+   int               i;
+   
+   print_start("infoVecStatsMax");
+
+   map = BuildUserViewMap(test_stats_map, strlen(test_stats_map) + 1, INPUT_MEM);
+   fail_unless(map != NULL, "Failed to create map object");
+   inet_aton("192.168.0.1", &ip);
+   fail_unless(mapperSetMyIP(map, &ip) == 1, "Setting my IP in mapper");
+   ivec = infoVecInit(map, 60000000, INFOVEC_WIN_FIXED, 16, info_desc, 0);
+   fail_unless(ivec != NULL, "Failed to create info vector");
+
+   fail_unless(infoVecSetSumFunc(ivec, sumTestData, 2, 1 << 1) == 1,
+	       "Setting sum func");
+   updateEntryData(ivec, "192.168.0.1", 100, 1000);
+   updateEntryData(ivec, "192.168.0.2", 200, 2000);
+   updateEntryData(ivec, "192.168.0.3", 300, 1500);
+   rebuilds = ivec->stats.rebuilds;
+
+   // The holder of the maximum goes up, stays and goes down again. An
+   // update must be newer than the entry, hence the sleeps
+   for(i = 0 ; i < 100 ; i++) {
+	   usleep(100);
+	   updateEntryData(ivec, "192.168.0.2", 200, 2000 + i);
+	   fail_unless(infoVecGetSums(ivec, sums, maxs) == 3, "Expected 3 alive");
+	   fail_unless(maxs[1] == 2000 + i, "Wrong maximum going up");
+	   usleep(100);
+	   updateEntryData(ivec, "192.168.0.2", 200, 2000 + i);
+	   fail_unless(infoVecGetSums(ivec, sums, maxs) == 3, "Expected 3 alive");
+	   fail_unless(maxs[1] == 2000 + i, "Wrong maximum staying");
+	   usleep(100);
+	   updateEntryData(ivec, "192.168.0.2", 200, 500);
+	   fail_unless(infoVecGetSums(ivec, sums, maxs) == 3, "Expected 3 alive");
+	   fail_unless(maxs[1] == 1500 && sums[1] == 3000,
+		       "Wrong maximum going down");
+   }
+   // Values not asked for are not kept
+   fail_unless(maxs[0] == 0, "Maximum of an unrequested value");
+   fail_unless(ivec->stats.rebuilds == rebuilds, "Entries were counted again");
+
+   infoVecFree(ivec);
+   mapperDone(map);
+   print_end();
+}
+END_TEST
+
+/*
+ * A snapshot keeps the vector as it was when published, the vector keeps
+ * changing under it
+ */
+static test_data_t *
+snapEntryData(ivec_entry_t **ents, int size, char *ipStr)
+{
+	struct in_addr ip;
+	int            i;
+
+	inet_aton(ipStr, &ip);
+	for(i = 0 ; i < size ; i++)
+		if(ents[i]->info && ents[i]->info->hdr.IP.s_addr == ip.s_addr)
+			return (test_data_t *) ents[i]->info->data;
+	return NULL;
+}
+
+START_TEST (test_infoVecSnapshot)
+{
+   mapper_t          map;
+   ivec_t            ivec;
+   ivec_snap_t       snap, snap2, snap3;
+   ivec_entry_t    **ents;
+   struct in_addr    ip, ip3;
+   test_data_t      *data;
+   unsigned long     gen;
+   int               size, i;
+   
+   print_start("infoVecSnapshot");
+
+   map = BuildUserViewMap(test_stats_map, strlen(test_stats_map) + 1, INPUT_MEM);
+   fail_unless(map != NULL, "Failed to create map object");
+   inet_aton("192.168.0.1", &ip);
+   fail_unless(mapperSetMyIP(map, &ip) == 1, "Setting my IP in mapper");
+   ivec = infoVecInit(map, 60000000, INFOVEC_WIN_FIXED, 16, info_desc, 0);
+   fail_unless(ivec != NULL, "Failed to create info vector");
+
+   updateEntryData(ivec, "192.168.0.1", 100, 1000);
+   updateEntryData(ivec, "192.168.0.2", 200, 2000);
+   fail_unless(infoVecPublish(ivec) == 1, "Failed to publish");
+   snap = infoVecSnapshotAcquire(ivec);
+   fail_unless(snap != NULL, "Failed to acquire snapshot");
+   gen = infoVecSnapshotGeneration(snap);
+
+   // Nothing changed, the same snapshot is published
+   fail_unless(infoVecPublish(ivec) == 1, "Failed to publish");
+   snap2 = infoVecSnapshotAcquire(ivec);
+   fail_unless(snap2 == snap, "Snapshot changed without updates");
+   infoVecSnapshotRelease(snap2);
+
+   // Changing the vector in place does not change the snapshot
+   updateEntryData(ivec, "192.168.0.2", 222, 2222);
+   inet_aton("192.168.0.1", &ip);
+   infoVecPunish(ivec, &ip, INFOD_DEAD_CONNECT);
+   updateEntryData(ivec, "192.168.0.3", 300, 3000);
+   infoVecPublish(ivec);
+
+   size = infoVecSnapshotSize(snap);
+   ents = infoVecSnapshotGetAllEntries(snap);
+   fail_unless(size == infoVecGetSize(ivec) && ents != NULL,
+	       "Wrong snapshot size");
+   data = snapEntryData(ents, size, "192.168.0.2");
+   fail_unless(data && data->tmem == 200 && data->speed == 2000,
+	       "Snapshot data changed");
+   // The snapshot holds only the header of the not yet updated entry
+   inet_aton("192.168.0.3", &ip3);
+   for(i = 0 ; i < size ; i++)
+	   if(ents[i]->info && ents[i]->info->hdr.IP.s_addr == ip3.s_addr)
+		   fail_unless(ents[i]->isdead &&
+			       ents[i]->info->hdr.status == INFOD_DEAD_INIT &&
+			       ents[i]->info->hdr.fsize == NHDR_SZ,
+			       "Snapshot sees a later update");
+   for(i = 0 ; i < size ; i++)
+	   if(ents[i]->info && ents[i]->info->hdr.IP.s_addr == ip.s_addr)
+		   fail_unless(!ents[i]->isdead &&
+			       ents[i]->info->hdr.status == INFOD_ALIVE,
+			       "Snapshot sees a punish");
+   free(ents);
+
+   // The new snapshot has the changes
+   snap2 = infoVecSnapshotAcquire(ivec);
+   fail_unless(snap2 != snap && infoVecSnapshotGeneration(snap2) > gen,
+	       "Expected a new snapshot");
+   // The vector and one reader hold each of them
+   fail_unless(ivec->retired == snap && snap->refs == 2 && snap2->refs == 2,
+	       "Wrong snapshot references");
+   ents = infoVecSnapshotGetAllEntries(snap2);
+   data = snapEntryData(ents, size, "192.168.0.2");
+   fail_unless(data && data->tmem == 222 && data->speed == 2222,
+	       "New snapshot has old data");
+   free(ents);
+
+   // The old snapshot is freed once released, readers of others go on
+   infoVecSnapshotRelease(snap);
+   updateEntryData(ivec, "192.168.0.2", 333, 3333);
+   infoVecPublish(ivec);
+   snap3 = infoVecSnapshotAcquire(ivec);
+   fail_unless(snap3 != snap2, "Expected a new snapshot");
+   fail_unless(ivec->retired == snap2 && snap2->next == NULL,
+	       "Released snapshot was not reclaimed");
+   ents = infoVecSnapshotGetAllEntries(snap2);
+   data = snapEntryData(ents, size, "192.168.0.2");
+   fail_unless(data && data->tmem == 222, "Snapshot data changed");
+   free(ents);
+   infoVecSnapshotRelease(snap3);
+
+   // A snapshot may outlive the vector
+   infoVecFree(ivec);
+   ents = infoVecSnapshotGetAllEntries(snap2);
+   data = snapEntryData(ents, size, "192.168.0.2");
+   fail_unless(data && data->speed == 2222, "Snapshot data changed");
+   free(ents);
+   infoVecSnapshotRelease(snap2);
+
+   mapperDone(map);
+   print_end();
+}
+END_TEST
+
+/*
+ * A vector restored from a checkpoint holds the alive entries with their
+ * original times
+ */
+START_TEST (test_infoVecCheckpoint)
+{
+   mapper_t          map;
+   ivec_t            ivec, ivec2;
+   struct in_addr    ip;
+   ivec_entry_t     *e, *e2;
+   test_data_t      *data;
+   char             *desc;
+   char             *path = "/tmp/test_ivec_ckpt";
+   int               index;
+   
+   print_start("infoVecCheckpoint");
+
+   map = BuildUserViewMap(test_stats_map, strlen(test_stats_map) + 1, INPUT_MEM);
+   fail_unless(map != NULL, "Failed to create map object");
+   inet_aton("192.168.0.1", &ip);
+   fail_unless(mapperSetMyIP(map, &ip) == 1, "Setting my IP in mapper");
+   ivec = infoVecInit(map, 60000000, INFOVEC_WIN_FIXED, 16, info_desc, 0);
+   fail_unless(ivec != NULL, "Failed to create info vector");
+
+   updateEntryData(ivec, "192.168.0.1", 100, 1000);
+   updateEntryData(ivec, "192.168.0.2", 200, 2000);
+   updateEntryData(ivec, "192.168.0.3", 300, 3000);
+   updateEntryData(ivec, "192.168.1.1", 400, 4000);
+   inet_aton("192.168.0.3", &ip);
+   infoVecPunish(ivec, &ip, INFOD_DEAD_CONNECT);
+   unlink(path);
+   fail_unless(infoVecRestore(ivec, path) == -1, "Restored a missing file");
+   fail_unless(infoVecCheckpoint(ivec, path) == 1, "Failed checkpoint");
+
+   // The local entry and the dead one are not restored
+   ivec2 = infoVecInit(map, 60000000, INFOVEC_WIN_FIXED, 16, info_desc, 0);
+   fail_unless(ivec2 != NULL, "Failed to create info vector");
+   fail_unless(infoVecRestore(ivec2, path) == 2, "Expected 2 restored");
+   fail_unless(infoVecNumAlive(ivec2) == 2, "Expected 2 alive");
+
+   inet_aton("192.168.1.1", &ip);
+   e  = infoVecFindByIP(ivec, &ip, &index);
+   e2 = infoVecFindByIP(ivec2, &ip, &index);
+   fail_unless(e && e2 && !e2->isdead, "Entry not restored");
+   fail_unless(timercmp(&e->info->hdr.time, &e2->info->hdr.time, ==),
+	       "Time not kept");
+   data = (test_data_t *) e2->info->data;
+   fail_unless(data->tmem == 400 && data->speed == 4000, "Wrong data");
+   inet_aton("192.168.0.3", &ip);
+   e2 = infoVecFindByIP(ivec2, &ip, &index);
+   fail_unless(e2 && e2->isdead, "Dead entry restored");
+   infoVecFree(ivec2);
+
+   // Another description
+   desc = malloc(strlen(info_desc) + 2);
+   sprintf(desc, "%s ", info_desc);
+   ivec2 = infoVecInit(map, 60000000, INFOVEC_WIN_FIXED, 16, desc, 0);
+   fail_unless(ivec2 != NULL, "Failed to create info vector");
+   fail_unless(infoVecRestore(ivec2, path) == -1, "Restored another description");
+   infoVecFree(ivec2);
+   free(desc);
+
+   // A truncated file
+   fail_unless(truncate(path, sizeof(ivec_ckpt_hdr_t) + 10) == 0, "truncate");
+   ivec2 = infoVecInit(map, 60000000, INFOVEC_WIN_FIXED, 16, info_desc, 0);
+   fail_unless(infoVecRestore(ivec2, path) == -1, "Restored a truncated file");
+   infoVecFree(ivec2);
+
+   unlink(path);
+   infoVecFree(ivec);
+   mapperDone(map);
+   print_end();
+}
+END_TEST
+
+/*
+ * The columns hold the fixed items of every entry, as in the records
+ */
+static char *col_desc = 
+"<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+"<local_info>\n"
+"        <base name=\"tmem\"  type=\"unsigned long\"  unit=\"4KB\"/>\n"
+"        <base name=\"speed\" type=\"unsigned long\"/>\n"
+"        <vlen name=\"usedby\" type=\"string\" unit=\"xml\" />\n"
+"</local_info>\n";
+
+START_TEST (test_infoVecColumns)
+{
+   mapper_t          map;
+   ivec_t            ivec;
+   struct in_addr    ip;
+   variable_map_t   *vmap;
+   unsigned long    *tmem, *speed;
+   unsigned char    *alive;
+   unsigned long     sum = 0;
+   int               i, size, index;
+   
+   print_start("infoVecColumns");
+
+   map = BuildUserViewMap(test_stats_map, strlen(test_stats_map) + 1, INPUT_MEM);
+   fail_unless(map != NULL, "Failed to create map object");
+   inet_aton("192.168.0.1", &ip);
+   fail_unless(mapperSetMyIP(map, &ip) == 1, "Setting my IP in mapper");
+   ivec = infoVecInit(map, 60000000, INFOVEC_WIN_FIXED, 16, col_desc, 0);
+   fail_unless(ivec != NULL, "Failed to create info vector");
+   vmap = create_info_mapping(col_desc);
+   fail_unless(vmap != NULL, "Failed to create mapping");
+
+   // Entries updated before the columns are set are there too
+   updateEntryData(ivec, "192.168.0.2", 200, 2000);
+   fail_unless(infoVecSetColumns(ivec, vmap) == 1, "Failed setting columns");
+   updateEntryData(ivec, "192.168.0.1", 100, 1000);
+   updateEntryData(ivec, "192.168.0.3", 300, 3000);
+   updateEntryData(ivec, "192.168.1.1", 400, 4000);
+   updateEntryData(ivec, "192.168.0.3", 333, 3333);
+   inet_aton("192.168.0.1", &ip);
+   infoVecPunish(ivec, &ip, INFOD_DEAD_CONNECT);
+
+   tmem  = infoVecGetColumn(ivec, "tmem", &size);
+   fail_unless(tmem != NULL && size == sizeof(unsigned long), "No tmem column");
+   speed = infoVecGetColumn(ivec, "speed", NULL);
+   alive = infoVecGetAliveColumn(ivec);
+   fail_unless(speed != NULL && alive != NULL, "No speed column");
+   fail_unless(infoVecGetColumn(ivec, "load", NULL) == NULL, "Unknown column");
+   fail_unless(infoVecGetColumn(ivec, "usedby", NULL) == NULL, "A vlen column");
+
+   for(i = 0 ; i < infoVecGetSize(ivec) ; i++) {
+	   ivec_entry_t *e = &ivec->vec[i];
+	   test_data_t  *data = (test_data_t *) e->info->data;
+
+	   fail_unless(alive[i] == !e->isdead, "Wrong alive column");
+	   if(e->info->hdr.fsize < NHDR_SZ + sizeof(test_data_t))
+		   continue;
+	   fail_unless(tmem[i] == data->tmem && speed[i] == data->speed,
+		       "Column does not match the record");
+	   if(alive[i])
+		   sum += tmem[i];
+   }
+   fail_unless(sum == 200 + 333 + 400, "Wrong column sum");
+   inet_aton("192.168.0.3", &ip);
+   infoVecFindByIP(ivec, &ip, &index);
+   fail_unless(speed[index] == 3333, "Column not updated");
+
+   fail_unless(infoVecSetColumns(ivec, NULL) == 1, "Failed dropping columns");
+   fail_unless(infoVecGetColumn(ivec, "tmem", NULL) == NULL, "Column not dropped");
+
+   destroy_info_mapping(vmap);
+   infoVecFree(ivec);
+   mapperDone(map);
+   print_end();
+}
+END_TEST
+
+/*
+ * A batch updates the entries as single updates would
+ */
+START_TEST (test_infoVecUpdateBatch)
+{
+   mapper_t          map;
+   ivec_t            ivec;
+   struct in_addr    ip;
+   char              buffs[4][250];
+   ivec_update_t     ups[4];
+   ivec_entry_t     *e;
+   test_data_t      *data;
+   char             *ips[4] = { "192.168.0.2", "192.168.0.3", "10.0.0.1",
+				 "192.168.1.1" };
+   int               i, index;
+   
+   print_start("infoVecUpdateBatch");
+
+   map = BuildUserViewMap(test_stats_map, strlen(test_stats_map) + 1, INPUT_MEM);
+   fail_unless(map != NULL, "Failed to create map object");
+   inet_aton("192.168.0.1", &ip);
+   fail_unless(mapperSetMyIP(map, &ip) == 1, "Setting my IP in mapper");
+   ivec = infoVecInit(map, 60000000, INFOVEC_WIN_FIXED, 16, info_desc, 0);
+   fail_unless(ivec != NULL, "Failed to create info vector");
+
+   for(i = 0 ; i < 4 ; i++) {
+	   node_info_t *node = (node_info_t *) buffs[i];
+
+	   data = (test_data_t *) (buffs[i] + sizeof(node_info_t));
+	   inet_aton(ips[i], &node->hdr.IP);
+	   node->hdr.pe = 1111;
+	   node->hdr.status = INFOD_ALIVE;
+	   node->hdr.psize = NODE_INFO_SIZE + sizeof(test_data_t);
+	   node->hdr.fsize = NODE_INFO_SIZE + sizeof(test_data_t);
+	   data->tmem  = 100 * (i + 1);
+	   data->speed = 1000 * (i + 1);
+	   gettimeofday(&node->hdr.time, NULL);
+	   ups[i].info     = node;
+	   ups[i].size     = node->hdr.fsize;
+	   ups[i].priority = 0;
+	   ups[i].version  = 0;
+   }
+   // The last one is older than what the vector has
+   ((node_info_t *) buffs[3])->hdr.time.tv_sec -= 10;
+   updateEntryData(ivec, "192.168.1.1", 1, 1);
+
+   // The unknown IP and the old entry are not taken
+   fail_unless(infoVecUpdateBatch(ivec, ups, 4) == 2, "Expected 2 updates");
+   fail_unless(ups[2].index == -1 && ups[0].index >= 0, "Wrong indices");
+   fail_unless(infoVecNumAlive(ivec) == 3, "Expected 3 alive");
+
+   for(i = 0 ; i < 4 ; i++) {
+	   if(!(e = infoVecFindByIP(ivec, &((node_info_t *) buffs[i])->hdr.IP,
+				    &index)))
+		   continue;
+	   fail_unless(index == ups[i].index, "Wrong index");
+	   data = (test_data_t *) e->info->data;
+	   if(i < 2)
+		   fail_unless(!e->isdead && data->tmem == 100 * (i + 1),
+			       "Entry not updated");
+	   else
+		   fail_unless(data->tmem == 1, "Older entry taken");
+   }
+
+   infoVecFree(ivec);
+   mapperDone(map);
+   print_end();
+}
+END_TEST
+
+/*
+ * The answer to a digest pull carries only the entries the puller misses
+ * or holds older
+ */
+static int
+digestAnswer(ivec_t from, void *digest, int digestSize, char *buff)
+{
+	struct iovec  *iov;
+	void          *handle;
+	int            i, iovcnt, size, len = 0;
+
+	handle = infoVecGetDigestAnswerIov(from, digest, digestSize,
+					   &iov, &iovcnt, &size);
+	fail_unless(handle != NULL, "Failed getting digest answer");
+	for(i = 0 ; i < iovcnt ; i++) {
+		memcpy(buff + len, iov[i].iov_base, iov[i].iov_len);
+		len += iov[i].iov_len;
+	}
+	fail_unless(len == size, "Answer chunks do not add up");
+	infoVecWindowIovDone(handle);
+	return ((info_msg_t *)buff)->num;
+}
+
+static unsigned long
+entryTmem(ivec_t vec, char *ipStr)
+{
+	struct in_addr  ip;
+	ivec_entry_t   *e;
+	int             index;
+
+	inet_aton(ipStr, &ip);
+	e = infoVecFindByIP(vec, &ip, &index);
+	if(!e || e->isdead)
+		return 0;
+	return ((test_data_t *)e->info->data)->tmem;
+}
+
+START_TEST (test_infoVecDigestPull)
+{
+   mapper_t          mapA, mapB;
+   ivec_t            A, B;
+   struct in_addr    ip;
+   info_pull_msg_t  *digest;
+   char             *buff;
+   int               size;
+   
+   print_start("infoVecDigestPull");
+
+   mapA = BuildUserViewMap(test_stats_map, strlen(test_stats_map) + 1, INPUT_MEM);
+   mapB = BuildUserViewMap(test_stats_map, strlen(test_stats_map) + 1, INPUT_MEM);
+   fail_unless(mapA && mapB, "Failed to create map object");
+   inet_aton("192.168.0.1", &ip);
+   fail_unless(mapperSetMyIP(mapA, &ip) == 1, "Setting my IP in mapper");
+   inet_aton("192.168.0.2", &ip);
+   fail_unless(mapperSetMyIP(mapB, &ip) == 1, "Setting my IP in mapper");
+   A = infoVecInit(mapA, 60000000, INFOVEC_WIN_FIXED, 16, info_desc, 0);
+   B = infoVecInit(mapB, 60000000, INFOVEC_WIN_FIXED, 16, info_desc, 0);
+   fail_unless(A && B, "Failed to create info vector");
+   buff = malloc(65536);
+
+   updateEntryData(B, "192.168.1.2", 120, 1);
+   usleep(5000);
+   updateEntryData(A, "192.168.0.1", 100, 1);
+   updateEntryData(A, "192.168.0.3", 300, 1);
+   updateEntryData(A, "192.168.1.2", 121, 1);
+   usleep(5000);
+   updateEntryData(B, "192.168.0.2", 200, 1);
+   updateEntryData(B, "192.168.0.3", 333, 1);
+   updateEntryData(B, "192.168.1.1", 400, 1);
+
+   // Only the entries A heard of are in its digest
+   digest = infoVecGetDigest(A, &size);
+   fail_unless(digest && digest->param == INFO_PULL_DIGEST, "No digest");
+   fail_unless(digest->num == 3, "Expected 3 entries in the digest");
+   fail_unless(size == INFO_PULL_MSG_SZ + 3 * INFO_DIGEST_ENT_SZ,
+	       "Wrong digest size");
+
+   // B sends its local entry, the one newer and the one A misses
+   fail_unless(digestAnswer(B, digest, size, buff) == 3,
+	       "Expected 3 entries in the answer");
+   fail_unless(infoVecUseRemoteWindow(A, buff, ((info_msg_t *)buff)->tsize),
+	       "Failed using the answer");
+   fail_unless(entryTmem(A, "192.168.0.2") == 200 &&
+	       entryTmem(A, "192.168.0.3") == 333 &&
+	       entryTmem(A, "192.168.1.1") == 400, "Answer not applied");
+   fail_unless(entryTmem(A, "192.168.1.2") == 121, "Older entry taken");
+
+   // Nothing more to send, and a bad digest is refused
+   digest = infoVecGetDigest(A, &size);
+   fail_unless(digestAnswer(B, digest, size, buff) == 0,
+	       "Expected an empty answer");
+   digest->num = 1000;
+   fail_unless(infoVecGetDigestAnswerIov(B, digest, size, NULL, NULL, NULL) == NULL,
+	       "Answered a bad digest");
+   
+   free(buff);
+   infoVecFree(A);
+   infoVecFree(B);
+   mapperDone(mapA);
+   mapperDone(mapB);
+   print_end();
+}
+END_TEST
+
+/*
+ * The window parameter can change after the vector was created, a fixed
+ * window keeping its entries when it grows
+ */
+START_TEST (test_infoVecSetWinParam)
+{
+   mapper_t          map;
+   ivec_t            ivec;
+   struct in_addr    ip;
+   info_msg_t       *msg;
+   int               size;
+   
+   print_start("infoVecSetWinParam");
+
+   map = BuildUserViewMap(test_stats_map, strlen(test_stats_map) + 1, INPUT_MEM);
+   fail_unless(map != NULL, "Failed to create map object");
+   inet_aton("192.168.0.1", &ip);
+   fail_unless(mapperSetMyIP(map, &ip) == 1, "Setting my IP in mapper");
+   ivec = infoVecInit(map, 60000000, INFOVEC_WIN_FIXED, 2, info_desc, 0);
+   fail_unless(ivec != NULL, "Failed to create info vector");
+
+   updateEntryData(ivec, "192.168.0.1", 1, 1);
+   updateEntryData(ivec, "192.168.0.2", 2, 1);
+   updateEntryData(ivec, "192.168.0.3", 3, 1);
+   updateEntryData(ivec, "192.168.1.1", 4, 1);
+   updateEntryData(ivec, "192.168.1.2", 5, 1);
+
+   // The window keeps 3 entries and sends the local one and 1 more
+   fail_unless(infoVecGetWinParam(ivec) == 2, "Wrong window param");
+   msg = infoVecGetWindow(ivec, &size, 1);
+   fail_unless(msg && msg->num == 2, "Expected a window of 2");
+
+   fail_unless(infoVecSetWinParam(ivec, 5), "Failed setting window param");
+   fail_unless(infoVecGetWinParam(ivec) == 5, "Wrong window param");
+   msg = infoVecGetWindow(ivec, &size, 1);
+   fail_unless(msg && msg->num == 4, "Window entries lost when growing");
+   updateEntryData(ivec, "192.168.1.3", 6, 1);
+   msg = infoVecGetWindow(ivec, &size, 1);
+   fail_unless(msg && msg->num == 5, "Expected a window of 5");
+
+   // Going back does not need room
+   fail_unless(infoVecSetWinParam(ivec, 3), "Failed setting window param");
+   msg = infoVecGetWindow(ivec, &size, 1);
+   fail_unless(msg && msg->num == 3, "Expected a window of 3");
+   fail_unless(!infoVecSetWinParam(ivec, 0), "Took a bad window param");
+
+   infoVecFree(ivec);
+   mapperDone(map);
+   print_end();
+}
+END_TEST
+
+/*
+ * Random nodes inside and outside the local cluster. The second half of
+ * the map is marked as another cluster.
+ */
+START_TEST (test_infoVecRandomClusterNode)
+{
+   mapper_t          map;
+   ivec_t            ivec;
+   struct in_addr    ip;
+   int               i, index, got[2] = {0, 0};
+   char             *ips[] = { "192.168.1.1", "192.168.1.2", "192.168.1.3" };
+   
+   print_start("infoVecRandomClusterNode");
+
+   map = BuildUserViewMap(test_stats_map, strlen(test_stats_map) + 1, INPUT_MEM);
+   fail_unless(map != NULL, "Failed to create map object");
+   inet_aton("192.168.0.1", &ip);
+   fail_unless(mapperSetMyIP(map, &ip) == 1, "Setting my IP in mapper");
+   ivec = infoVecInit(map, 60000000, INFOVEC_WIN_FIXED, 4, info_desc, 0);
+   fail_unless(ivec != NULL, "Failed to create info vector");
+
+   for(i = 0 ; i < 6 ; i++)
+	   fail_unless(ivec->inCluster[i] == 1, "All the map is one cluster");
+   for(i = 0 ; i < 3 ; i++) {
+	   inet_aton(ips[i], &ip);
+	   fail_unless(infoVecFindByIP(ivec, &ip, &index) != NULL, "No entry");
+	   ivec->inCluster[index] = 0;
+   }
+   fail_unless(!infoVecRandomClusterNode(ivec, 1, &ip), "No node is alive");
+
+   updateEntryData(ivec, "192.168.0.1", 1, 1);
+   updateEntryData(ivec, "192.168.0.3", 1, 1);
+   updateEntryData(ivec, "192.168.1.1", 1, 1);
+   updateEntryData(ivec, "192.168.1.3", 1, 1);
+   fail_unless(infoVecNumAliveInCluster(ivec, 1) == 1 &&
+	       infoVecNumAliveInCluster(ivec, 0) == 2, "Wrong alive counts");
+
+   for(i = 0 ; i < 100 ; i++) {
+	   fail_unless(infoVecRandomClusterNode(ivec, i % 2, &ip), "No node");
+	   fail_unless(infoVecFindByIP(ivec, &ip, &index) != NULL, "Bad node");
+	   fail_unless(ivec->inCluster[index] == i % 2 &&
+		       index != ivec->localIndex && !ivec->vec[index].isdead,
+		       "Node on the wrong side");
+	   got[ivec->inCluster[index]] += (ip.s_addr == inet_addr("192.168.1.3"));
+   }
+   fail_unless(got[0] > 0, "Never picked one of the remote nodes");
+
+   inet_aton("192.168.0.3", &ip);
+   infoVecPunish(ivec, &ip, INFOD_DEAD_CONNECT);
+   fail_unless(infoVecNumAliveInCluster(ivec, 1) == 0, "Dead node counted");
+   fail_unless(!infoVecRandomClusterNode(ivec, 1, &ip), "Got a dead node");
+
+   infoVecFree(ivec);
+   mapperDone(map);
+   print_end();
+}
+END_TEST
+
+/*
+ * A virtual clock: the ages and the expiry follow it, not the real time
+ */
+static struct timeval testClockNow;
+
+static void testClock(struct timeval *now)
+{
+	*now = testClockNow;
+}
+
+START_TEST (test_infoVecSetClock)
+{
+   mapper_t          map;
+   ivec_t            ivec;
+   struct in_addr    ip;
+   infod_stats_t     stats;
+   char              buff[250];
+   node_info_t      *node = (node_info_t *) buff;
+   
+   print_start("infoVecSetClock");
+
+   map = BuildUserViewMap(test_stats_map, strlen(test_stats_map) + 1, INPUT_MEM);
+   fail_unless(map != NULL, "Failed to create map object");
+   inet_aton("192.168.0.1", &ip);
+   fail_unless(mapperSetMyIP(map, &ip) == 1, "Setting my IP in mapper");
+
+   testClockNow.tv_sec  = 1000000000;
+   testClockNow.tv_usec = 0;
+   infoVecSetClock(testClock);
+   ivec = infoVecInit(map, 5000000, INFOVEC_WIN_FIXED, 4, info_desc, 0);
+   fail_unless(ivec != NULL, "Failed to create info vector");
+
+   memset(buff, 0, sizeof(buff));
+   inet_aton("192.168.1.1", &node->hdr.IP);
+   node->hdr.status = INFOD_ALIVE;
+   node->hdr.psize = NODE_INFO_SIZE + sizeof(test_data_t);
+   node->hdr.fsize = NODE_INFO_SIZE + sizeof(test_data_t);
+   testClockNow.tv_sec += 1;
+   node->hdr.time  = testClockNow;
+   fail_unless(infoVecUpdate(ivec, node, node->hdr.fsize, 0), "Update failed");
+
+   testClockNow.tv_sec += 3;
+   infoVecStats(ivec, &stats);
+   fail_unless(stats.num_alive == 1, "Entry not alive");
+   fail_unless(fabs(stats.avgage - 3.0) < 0.01, "Age does not follow the clock");
+   infoVecExpire(ivec);
+   fail_unless(infoVecNumAlive(ivec) == 1, "Expired before max age");
+
+   testClockNow.tv_sec += 3;
+   infoVecExpire(ivec);
+   fail_unless(infoVecNumAlive(ivec) == 0, "Not expired after max age");
+
+   infoVecSetClock(NULL);
+   infoVecFree(ivec);
+   mapperDone(map);
+   print_end();
+}
+END_TEST
+
+/*
+ * Take the scatter/gather window of a vector to buff and find the rumors
+ * section after its entries, if any
+ */
+static int
+rumorWindow(ivec_t from, char *buff, info_rumor_msg_t **rumors)
+{
+	info_msg_t       *msg = (info_msg_t *) buff;
+	info_msg_entry_t *ent;
+	struct iovec     *iov;
+	void             *handle;
+	int               i, iovcnt, size, len = 0;
+
+	handle = infoVecGetWindowIov(from, 1, &iov, &iovcnt, &size);
+	fail_unless(handle != NULL, "Failed getting iov window");
+	for(i = 0 ; i < iovcnt ; i++) {
+		memcpy(buff + len, iov[i].iov_base, iov[i].iov_len);
+		len += iov[i].iov_len;
+	}
+	fail_unless(len == size && msg->tsize == size, "Bad window size");
+	infoVecWindowIovDone(handle);
+
+	for(i = 0, ent = msg->data ; i < msg->num ; i++)
+		ent = (info_msg_entry_t *)((char *)ent + ent->size);
+	*rumors = ((char *)ent < buff + size) ? (info_rumor_msg_t *) ent : NULL;
+	return size;
+}
+
+/*
+ * A death goes as a rumor after the entries of the next few windows, and
+ * a node learning it that way passes it on
+ */
+START_TEST (test_infoVecRumors)
+{
+   mapper_t          mapA, mapB;
+   ivec_t            A, B;
+   struct in_addr    ip;
+   info_msg_t       *msg;
+   info_rumor_msg_t *rumors;
+   char             *buff;
+   int               n;
+
+   print_start("infoVecRumors");
+
+   mapA = BuildUserViewMap(test_stats_map, strlen(test_stats_map) + 1, INPUT_MEM);
+   mapB = BuildUserViewMap(test_stats_map, strlen(test_stats_map) + 1, INPUT_MEM);
+   fail_unless(mapA && mapB, "Failed to create map object");
+   inet_aton("192.168.0.1", &ip);
+   fail_unless(mapperSetMyIP(mapA, &ip) == 1, "Setting my IP in mapper");
+   inet_aton("192.168.0.2", &ip);
+   fail_unless(mapperSetMyIP(mapB, &ip) == 1, "Setting my IP in mapper");
+   A = infoVecInit(mapA, 60000000, INFOVEC_WIN_FIXED, 16, info_desc, 0);
+   B = infoVecInit(mapB, 60000000, INFOVEC_WIN_FIXED, 16, info_desc, 0);
+   fail_unless(A && B, "Failed to create info vector");
+   buff = malloc(65536);
+   msg  = (info_msg_t *) buff;
+
+   updateEntryData(B, "192.168.1.1", 100, 1);
+   updateEntryData(A, "192.168.1.1", 100, 1);
+   rumorWindow(A, buff, &rumors);
+   fail_unless(rumors == NULL, "Rumors without a death");
+
+   usleep(1000);
+   inet_aton("192.168.1.1", &ip);
+   infoVecPunish(A, &ip, INFOD_DEAD_CONNECT);
+   rumorWindow(A, buff, &rumors);
+   fail_unless(rumors && rumors->magic == INFO_MSG_RUMOR_MAGIC &&
+	       rumors->num == 1, "No rumor of the death");
+   fail_unless(rumors->data[0].data->hdr.IP.s_addr == ip.s_addr,
+	       "Rumor of the wrong entry");
+
+   // The rumors section alone is enough for B
+   memmove(msg->data, rumors, rumors->size);
+   msg->num   = 0;
+   msg->tsize = INFO_MSG_SIZE + rumors->size;
+   fail_unless(infoVecUseRemoteWindow(B, buff, msg->tsize),
+	       "Failed using the rumors");
+   fail_unless(entryTmem(B, "192.168.1.1") == 0, "Death not learned");
+   rumorWindow(B, buff, &rumors);
+   fail_unless(rumors && rumors->num == 1, "The rumor was not passed on");
+
+   // Sent about log(n) times and then dropped
+   for(n = 1 ; n < 10 ; n++) {
+	   rumorWindow(A, buff, &rumors);
+	   if(!rumors)
+		   break;
+   }
+   fail_unless(n == (A->deadStartPrio > 0 ? A->deadStartPrio : 1),
+	       "Rumor sent %d times", n);
+
+   // A revival is told the same way, a first update is not
+   usleep(1000);
+   updateEntryData(A, "192.168.1.1", 101, 1);
+   rumorWindow(A, buff, &rumors);
+   fail_unless(rumors && rumors->num == 1, "No rumor of the revival");
+   updateEntryData(A, "192.168.1.2", 102, 1);
+   rumorWindow(A, buff, &rumors);
+   fail_unless(rumors && rumors->num == 1, "Rumor of a new entry");
+
+   free(buff);
+   infoVecFree(A);
+   infoVecFree(B);
+   mapperDone(mapA);
+   mapperDone(mapB);
+   print_end();
+}
+END_TEST
+
 Suite *InfoVec_suite(void)
 {
   Suite *s = suite_create("InfoVec");
@@ -1438,16 +3033,34 @@ Suite *InfoVec_suite(void)
   /* tcase_add_test(tc_core, test_infoVecGetWindow); */
   /* tcase_add_test(tc_core, test_infoVecGetUptoAgeWindow); */
   /* tcase_add_test(tc_core, test_infoVecUseRemoteWindow); */
-  /* tcase_add_test(tc_core, test_infoVecRandom); */
+  tcase_add_test(tc_core, test_infoVecRandom);
   
   /* tcase_add_test(tc_query, test_infoVecStats); */
+  tcase_add_test(tc_query, test_infoVecArena);
+  tcase_add_test(tc_query, test_infoVecWindowIov);
+  tcase_add_test(tc_query, test_infoVecDeltaWindow);
+  tcase_add_test(tc_query, test_timeWheel);
+  tcase_add_test(tc_query, test_infoVecExpire);
+  tcase_add_test(tc_query, test_infoVecStatsTotals);
+  tcase_add_test(tc_query, test_infoVecStatsMax);
+  tcase_add_test(tc_query, test_infoVecSnapshot);
+  tcase_add_test(tc_query, test_infoVecCheckpoint);
+  tcase_add_test(tc_query, test_infoVecColumns);
+  tcase_add_test(tc_query, test_infoVecUpdateBatch);
+  tcase_add_test(tc_query, test_infoVecDigestPull);
+  tcase_add_test(tc_query, test_infoVecSetWinParam);
+  tcase_add_test(tc_query, test_infoVecRandomClusterNode);
+  tcase_add_test(tc_query, test_infoVecSetClock);
+  tcase_add_test(tc_query, test_infoVecRumors);
   /* tcase_add_test(tc_query, test_infoVecQueries); */
   /* //tcase_add_test(tc_query, test_infoVecAgeMeasure); */
-  /* tcase_add_test(tc_query, test_infoVecOldest); */
+  tcase_add_test(tc_query, test_infoVecOldest);
   
   /* tcase_add_test(tc_stress, test_infoVecStress); */
 
   /* tcase_add_test(tc_stress, test_infoVecStress2); */
+  tcase_add_test(tc_stress, test_infoVecWindowOrder);
+  tcase_add_test(tc_stress, test_infoVecFindBench);
 
   /* tcase_add_test(tc_external, test_infoVecGetWindowExternal); */
   tcase_add_test(tc_external, test_infoVecGetWindowBig);
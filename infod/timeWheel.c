@@ -0,0 +1,236 @@
+/*============================================================================
+  gossimon - Gossip based resource usage monitoring for Linux clusters
+  Copyright 2003-2010 Amnon Barak
+
+  Distributed under the OSI-approved BSD License (the "License");
+  see accompanying file Copyright.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+============================================================================*/
+
+
+/******************************************************************************
+ *
+ * File: timeWheel.c. Hierarchical timing wheel
+ *
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <strings.h>
+
+#include <timeWheel.h>
+
+#define TW_MASK            (TWHEEL_SLOTS - 1)
+#define TW_SHIFT(l)        ((l) * TWHEEL_BITS)
+#define TW_LEVEL(slot)     ((slot) / TWHEEL_SLOTS)
+
+/****************************************************************************
+ * The slot for a timer expiring at expire, relative to the current tick.
+ * Each level is used only for timers in the next 63 of its slots, so a
+ * timer never lands in a slot which was already cascaded for this round.
+ ***************************************************************************/
+static int
+tw_slot( twheel_t *tw, twheel_tick_t expire ) {
+	twheel_tick_t now = tw->tw_now;
+	int           l;
+
+	if( expire < now )
+		expire = now;
+
+	for( l = 0 ; l < TWHEEL_LEVELS ; l++ ) {
+		if( ( expire >> TW_SHIFT(l) ) - ( now >> TW_SHIFT(l) ) < TWHEEL_SLOTS )
+			return l * TWHEEL_SLOTS + ( ( expire >> TW_SHIFT(l) ) & TW_MASK );
+	}
+
+	// Too far, parking it in the last slot of the top level
+	l = TWHEEL_LEVELS - 1;
+	return l * TWHEEL_SLOTS +
+		( ( ( now >> TW_SHIFT(l) ) + TWHEEL_SLOTS - 1 ) & TW_MASK );
+}
+
+static void
+tw_link( twheel_t *tw, int id ) {
+	twheel_node_t *n = &tw->tw_nodes[ id ];
+	int            slot = tw_slot( tw, n->expire );
+
+	n->slot = slot;
+	n->prev = -1;
+	n->next = tw->tw_head[ slot ];
+	if( n->next != -1 )
+		tw->tw_nodes[ n->next ].prev = id;
+	tw->tw_head[ slot ] = id;
+	tw->tw_levelCount[ TW_LEVEL(slot) ]++;
+	tw->tw_count++;
+}
+
+static void
+tw_unlink( twheel_t *tw, int id ) {
+	twheel_node_t *n = &tw->tw_nodes[ id ];
+
+	if( n->prev != -1 )
+		tw->tw_nodes[ n->prev ].next = n->next;
+	else
+		tw->tw_head[ n->slot ] = n->next;
+	if( n->next != -1 )
+		tw->tw_nodes[ n->next ].prev = n->prev;
+
+	tw->tw_levelCount[ TW_LEVEL(n->slot) ]--;
+	tw->tw_count--;
+	n->slot = -1;
+}
+
+/****************************************************************************
+ * Initialize the wheel. Note that the memory for twheel_t must already be
+ * allocated.
+ ***************************************************************************/
+int
+twheel_init( twheel_t *tw, int maxId, twheel_tick_t now ) {
+	if( !tw || maxId <= 0 )
+		return 0;
+
+	bzero( tw, sizeof(twheel_t) );
+	if( !(tw->tw_nodes = malloc( maxId * sizeof(twheel_node_t))))
+		return 0;
+	tw->tw_maxId = maxId;
+	twheel_reset( tw, now );
+	return 1;
+}
+
+/****************************************************************************
+ * Free the wheel memory (not the twheel_t itself)
+ ***************************************************************************/
+void
+twheel_free( twheel_t *tw ) {
+	if( !tw )
+		return;
+	if( tw->tw_nodes )
+		free( tw->tw_nodes );
+	tw->tw_nodes = NULL;
+	tw->tw_count = 0;
+}
+
+/****************************************************************************
+ * Cancel all the timers and set the current tick
+ ***************************************************************************/
+void
+twheel_reset( twheel_t *tw, twheel_tick_t now ) {
+	int i;
+
+	for( i = 0 ; i < TWHEEL_LEVELS * TWHEEL_SLOTS ; i++ )
+		tw->tw_head[i] = -1;
+	for( i = 0 ; i < tw->tw_maxId ; i++ )
+		tw->tw_nodes[i].slot = -1;
+	bzero( tw->tw_levelCount, sizeof(tw->tw_levelCount) );
+	tw->tw_count = 0;
+	tw->tw_now   = now;
+}
+
+int
+twheel_size( twheel_t *tw ) {
+	return ( tw == NULL ) ? 0 : tw->tw_count;
+}
+
+int
+twheel_is_scheduled( twheel_t *tw, int id ) {
+	if( id < 0 || id >= tw->tw_maxId )
+		return 0;
+	return tw->tw_nodes[ id ].slot != -1;
+}
+
+int
+twheel_schedule( twheel_t *tw, int id, twheel_tick_t expire ) {
+	if( !tw || id < 0 || id >= tw->tw_maxId )
+		return 0;
+
+	if( tw->tw_nodes[ id ].slot != -1 )
+		tw_unlink( tw, id );
+	// The current tick was already handled
+	if( expire <= tw->tw_now )
+		expire = tw->tw_now + 1;
+	tw->tw_nodes[ id ].expire = expire;
+	tw_link( tw, id );
+	return 1;
+}
+
+int
+twheel_cancel( twheel_t *tw, int id ) {
+	if( !twheel_is_scheduled( tw, id ))
+		return 0;
+	tw_unlink( tw, id );
+	return 1;
+}
+
+/****************************************************************************
+ * Move the timers of a slot of an upper level to the lower levels
+ ***************************************************************************/
+static void
+tw_cascade( twheel_t *tw, int slot ) {
+	int id;
+
+	while( ( id = tw->tw_head[ slot ] ) != -1 ) {
+		tw_unlink( tw, id );
+		tw_link( tw, id );
+	}
+}
+
+/****************************************************************************
+ * The last tick to handle before anything can happen: when the lowest
+ * levels are empty, nothing happens until the next cascade of the first
+ * level which is not.
+ ***************************************************************************/
+static twheel_tick_t
+tw_skip_to( twheel_t *tw, twheel_tick_t now ) {
+	twheel_tick_t next;
+	int           l = 0;
+
+	if( tw->tw_count == 0 )
+		return now;
+
+	while( l < TWHEEL_LEVELS - 1 && tw->tw_levelCount[ l ] == 0 )
+		l++;
+	if( l == 0 )
+		return tw->tw_now;
+
+	next = ( ( tw->tw_now >> TW_SHIFT(l) ) + 1 ) << TW_SHIFT(l);
+	return ( next - 1 < now ) ? next - 1 : now;
+}
+
+int
+twheel_advance( twheel_t *tw, twheel_tick_t now,
+		twheel_expire_func_t func, void *arg ) {
+	int expired = 0;
+	int l, id, slot;
+
+	if( !tw || !func )
+		return 0;
+
+	while( tw->tw_now < now ) {
+		tw->tw_now = tw_skip_to( tw, now );
+		if( tw->tw_now >= now )
+			break;
+
+		tw->tw_now++;
+
+		// Cascading from the top, a timer may move down several levels
+		for( l = TWHEEL_LEVELS - 1 ; l > 0 ; l-- ) {
+			if( tw->tw_now & ( ( 1ULL << TW_SHIFT(l) ) - 1 ))
+				continue;
+			tw_cascade( tw, l * TWHEEL_SLOTS +
+				    ( ( tw->tw_now >> TW_SHIFT(l) ) & TW_MASK ));
+		}
+
+		slot = tw->tw_now & TW_MASK;
+		while( ( id = tw->tw_head[ slot ] ) != -1 ) {
+			tw_unlink( tw, id );
+			func( id, arg );
+			expired++;
+		}
+	}
+	return expired;
+}
+
+/****************************************************************************
+ *                                 E O F
+ ***************************************************************************/
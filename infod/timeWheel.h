@@ -0,0 +1,84 @@
+/*============================================================================
+  gossimon - Gossip based resource usage monitoring for Linux clusters
+  Copyright 2003-2010 Amnon Barak
+
+  Distributed under the OSI-approved BSD License (the "License");
+  see accompanying file Copyright.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+============================================================================*/
+
+
+/******************************************************************************
+ *
+ * File: timeWheel.h. Hierarchical timing wheel
+ *
+ *****************************************************************************/
+
+#ifndef __INFOD_TIME_WHEEL__
+#define __INFOD_TIME_WHEEL__
+
+/*
+  Timers keyed by an id in [0, maxId) and an expiry time in ticks. Level 0
+  has one slot per tick, each next level has slots 64 times wider. A timer
+  is placed in the lowest level whose slots reach its expiry, and is moved
+  down a level (cascaded) when the wheel gets to its slot. Scheduling and
+  cancelling are O(1), advancing is O(1) per tick plus O(levels) per timer.
+  Timers further than the top level are parked in its last slot and placed
+  again when it is reached. Ticks in which no level has anything to do are
+  skipped.
+*/
+
+#define TWHEEL_BITS        (6)
+#define TWHEEL_SLOTS       (1 << TWHEEL_BITS)
+#define TWHEEL_LEVELS      (4)
+
+typedef unsigned long long twheel_tick_t;
+
+typedef struct twheel_node {
+	twheel_tick_t       expire;
+	int                 slot;    // -1 when not scheduled
+	int                 next;
+	int                 prev;
+} twheel_node_t;
+
+typedef struct _time_wheel {
+	twheel_tick_t       tw_now;     // Last tick handled
+	int                 tw_count;   // Scheduled timers
+	int                 tw_levelCount[ TWHEEL_LEVELS ];
+	int                 tw_maxId;
+	twheel_node_t      *tw_nodes;   // id -> node
+	int                 tw_head[ TWHEEL_LEVELS * TWHEEL_SLOTS ];
+} twheel_t;
+
+/* Called for every expired timer. The timer is no longer scheduled and the
+   function may schedule or cancel any timer */
+typedef void (*twheel_expire_func_t)(int id, void *arg);
+
+int          twheel_init(twheel_t *tw, int maxId, twheel_tick_t now);
+void         twheel_free(twheel_t *tw);
+void         twheel_reset(twheel_t *tw, twheel_tick_t now);
+int          twheel_size(twheel_t *tw);
+int          twheel_is_scheduled(twheel_t *tw, int id);
+
+/****************************************************************************
+ * Schedule (or move) timer id to expire at tick expire. An expiry which
+ * already passed fires at the next tick.
+ ***************************************************************************/
+int          twheel_schedule(twheel_t *tw, int id, twheel_tick_t expire);
+int          twheel_cancel(twheel_t *tw, int id);
+
+/****************************************************************************
+ * Move the wheel to tick now, calling func for every timer which expired.
+ * Returns the number of expired timers.
+ ***************************************************************************/
+int          twheel_advance(twheel_t *tw, twheel_tick_t now,
+			    twheel_expire_func_t func, void *arg);
+
+#endif /* __INFOD_TIME_WHEEL__ */
+
+/****************************************************************************
+ *                                 E O F
+ ***************************************************************************/
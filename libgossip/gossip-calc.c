@@ -47,6 +47,7 @@ typedef struct {
      opType_t op;
      double   age;
      int      uptoageEntries;
+     int      fanout;
      char verbose;
      
 } gossipData_t;
@@ -62,6 +63,8 @@ void usage() {
             "-n      size1, size2  A comma separated list of possible cluster sizes\n"
             "-t      t1,t2,..      A comma separated list of possible T parameters\n"
             "-w      w1,w1,..      A comma separated list of possible window sizes\n"
+            "-k      fanout        Number of peers each node sends its window to\n"
+            "                      every time step (default 1)\n"
             "-a                    Show all calculated information relative to the \n"
             "                      (n,t) or (n,w), this is the default. The calculated\n"
             "                      information includes the average age maximal age...\n"
@@ -142,7 +145,7 @@ int parseArgs(gossipData_t *gd, int argc, char **argv) {
                {0, 0, 0, 0}
           };
           
-          c = getopt_long (argc, argv, "n:t:w:ah",
+          c = getopt_long (argc, argv, "n:t:w:k:ah",
                            long_options, &option_index);
           if (c == -1)
                break;
@@ -194,6 +197,13 @@ int parseArgs(gossipData_t *gd, int argc, char **argv) {
                         exit(0);
                    }
                    break;
+              case 'k':
+                   gd->fanout = atoi(optarg);
+                   if(gd->fanout < 1) {
+                        fprintf(stderr, "Error fanout (-k) should be at least 1\n");
+                        exit(0);
+                   }
+                   break;
               case 'v':
                    gd->verbose = 1;
                    break;
@@ -234,14 +244,16 @@ int printAllInfo(gossipData_t *gd) {
      for(int nIndex = 0 ; nIndex < gd->nArrSize ; nIndex++) {
           int n = gd->nArr[nIndex];
           printf("Cluster size: %d\n", n);
+          if(gd->fanout > 1)
+               printf("Fanout: %d\n", gd->fanout);
           if(gd->tArrSize) {
                for(int i=0 ; i < gd->tArrSize ; i++) {
                     double T = gd->tArr[i];
                     double Xt   = calcXT(n, T);
-                    double Av   = calcAv(n, T);
-                    double Max  = calcMaxAge(n, T);
-                    int    w    = calcWinsizeGivenAv(n, Av);
-                    int    wMax = calcWinsizeGivenMax(n, Max);
+                    double Av   = calcAvFanout(n, T, gd->fanout);
+                    double Max  = calcMaxAgeFanout(n, T, gd->fanout);
+                    int    w    = calcWinsizeGivenAvFanout(n, Av, gd->fanout);
+                    int    wMax = calcWinsizeGivenMaxFanout(n, Max, gd->fanout);
                     printf("N=%-5d T=%-5.2f  Xt= %-8.3f  AV= %-8.3f Max= %-8.3f w= %-4d wMax= %-4d\n",
                            n, T, Xt, Av, Max, w, wMax);
                }
@@ -255,10 +267,10 @@ int printAllInfo(gossipData_t *gd) {
                     }
                     double T = calcTGivenW(n, w);
                     double Xt   = calcXT(n, T);
-                    double Av   = calcAv(n, T);
-                    double Max  = calcMaxAge(n, T);
-                    int    wAv  = calcWinsizeGivenAv(n, Av);
-                    int    wMax = calcWinsizeGivenMax(n, Max);
+                    double Av   = calcAvFanout(n, T, gd->fanout);
+                    double Max  = calcMaxAgeFanout(n, T, gd->fanout);
+                    int    wAv  = calcWinsizeGivenAvFanout(n, Av, gd->fanout);
+                    int    wMax = calcWinsizeGivenMaxFanout(n, Max, gd->fanout);
                     printf("N=%-5d w= %3d T=%-5.2f  Xt= %-8.3f  AV= %-8.3f Max= %-8.3f w= %-4d wMax= %-4d\n",
                            n, w, T, Xt, Av, Max, wAv, wMax);
                }
@@ -281,7 +293,7 @@ int printCdf(gossipData_t *gd) {
      }
 
      for(int i=0; i<gd->age ; i++) {
-          double val = calcEntriesUptoAgeT(n, T, (double)i);
+          double val = calcEntriesUptoAgeTFanout(n, T, (double)i, gd->fanout);
           printf("Uptoage %-4d: %5.3f\n", i, val);
      }
      return 1;
@@ -291,7 +303,7 @@ int printWinAv(gossipData_t *gd) {
 
      for(int i=0; i< gd->nArrSize ; i++) {
           int n = gd->nArr[i];
-          int w = calcWinsizeGivenAv(n, gd->age);
+          int w = calcWinsizeGivenAvFanout(n, gd->age, gd->fanout);
           printf("N=%-6d Desired Av: %-8.3f     Win= %-4d\n", n, gd->age, w);
      }
 }
@@ -300,7 +312,7 @@ int printWinMax(gossipData_t *gd) {
 
      for(int i=0; i< gd->nArrSize ; i++) {
           int n = gd->nArr[i];
-          int w = calcWinsizeGivenMax(n, gd->age);
+          int w = calcWinsizeGivenMaxFanout(n, gd->age, gd->fanout);
           printf("N=%-6d Desired AvMax: %-8.3f     Win= %-4d\n", n, gd->age, w);
      }
 }
@@ -308,7 +320,9 @@ int printWinMax(gossipData_t *gd) {
 int printWinUptoage(gossipData_t *gd) {
      for(int i=0; i< gd->nArrSize ; i++) {
           int n = gd->nArr[i];
-          int w = calcWinsizeGivenUptoageEntries(n, gd->age, gd->uptoageEntries);
+          int w = calcWinsizeGivenUptoageEntriesFanout(n, gd->age,
+                                                    gd->uptoageEntries,
+                                                    gd->fanout);
           if(w == 0) {
                fprintf(stderr, "Error calculating window size for case age=%f entries %d\n",
                        gd->age, gd->uptoageEntries);
@@ -326,6 +340,7 @@ int main(int argc, char **argv) {
      gossipData_t gd;
      memset(&gd, 0, sizeof(gossipData_t));
      gd.op = OP_ALL;
+     gd.fanout = 1;
      
      progName = strdup(argv[0]);
      parseArgs(&gd, argc, argv);
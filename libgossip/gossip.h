@@ -33,6 +33,16 @@ int calcWinsizeGivenAv(int n, double desiredAv);
 int calcWinsizeGivenMax(int n, double desiredMax);
 int calcWinsizeGivenUptoageEntries(int n, double desiredAge, int desiredEntriesNum);
 
+// The same when every node pushes its window to k peers each time step
+// (ages are in time steps)
+double calcAvFanout(int n, double T, int k);
+double calcMaxAgeFanout(int n, double T, int k);
+double calcEntriesUptoAgeTFanout(int n, double T, double t, int k);
+int calcWinsizeGivenAvFanout(int n, double desiredAv, int k);
+int calcWinsizeGivenMaxFanout(int n, double desiredMax, int k);
+int calcWinsizeGivenUptoageEntriesFanout(int n, double desiredAge,
+                                         int desiredEntriesNum, int k);
+
 
 
 #endif
@@ -142,3 +142,41 @@ int calcWinsizeGivenUptoageEntries(int n, double desiredAge, int desiredEntriesN
      }
      return w;
 }
+
+/*
+ * Fan-out k: every node pushes its window to k peers each time step. To
+ * first order this is the single push model running k times faster, so
+ * the window (and T) stay as in the model while ages measured in time
+ * steps are divided by k.
+ */
+double calcAvFanout(int n, double T, int k) {
+     if(k < 1) k = 1;
+     return calcAv(n, T) / k;
+}
+
+double calcMaxAgeFanout(int n, double T, int k) {
+     if(k < 1) k = 1;
+     return calcMaxAge(n, T) / k;
+}
+
+double calcEntriesUptoAgeTFanout(int n, double T, double t, int k) {
+     if(k < 1) k = 1;
+     return calcEntriesUptoAgeT(n, T, t * k);
+}
+
+int calcWinsizeGivenAvFanout(int n, double desiredAv, int k) {
+     if(k < 1) k = 1;
+     return calcWinsizeGivenAv(n, desiredAv * k);
+}
+
+int calcWinsizeGivenMaxFanout(int n, double desiredMax, int k) {
+     if(k < 1) k = 1;
+     return calcWinsizeGivenMax(n, desiredMax * k);
+}
+
+int calcWinsizeGivenUptoageEntriesFanout(int n, double desiredAge,
+                                         int desiredEntriesNum, int k)
+{
+     if(k < 1) k = 1;
+     return calcWinsizeGivenUptoageEntries(n, desiredAge * k, desiredEntriesNum);
+}
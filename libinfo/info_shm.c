@@ -0,0 +1,345 @@
+/*============================================================================
+  gossimon - Gossip based resource usage monitoring for Linux clusters
+  Copyright 2003-2010 Amnon Barak
+
+  Distributed under the OSI-approved BSD License (the "License");
+  see accompanying file Copyright.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+============================================================================*/
+
+/***************************************************************************
+ * File: info_shm.c. Shared memory export of the information vector
+ **************************************************************************/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+
+#include <msx_debug.h>
+#include <msx_error.h>
+#include <info.h>
+#include <info_shm.h>
+
+/* Readers give up waiting for a writer which does not finish */
+#define INFO_SHM_MAX_SPIN     (10000)
+#define INFO_SHM_MIN_SIZE     (4096)
+
+struct info_shm {
+	char           *path;
+	int             writer;
+	int             fd;
+	size_t          mapSize;
+	info_shm_hdr_t *hdr;
+};
+
+static void
+shm_unmap( info_shm_t shm ) {
+	if( shm->hdr )
+		munmap( shm->hdr, shm->mapSize );
+	if( shm->fd != -1 )
+		close( shm->fd );
+	shm->hdr = NULL;
+	shm->fd = -1;
+}
+
+/*
+ * Tell the readers of the segment at path (if any) to attach again
+ */
+static void
+shm_mark_stale( const char *path ) {
+	info_shm_hdr_t *hdr;
+	struct stat     st;
+	int             fd;
+
+	if( ( fd = open( path, O_RDWR ) ) == -1 )
+		return;
+	if( fstat( fd, &st ) == 0 && st.st_size >= (off_t)INFO_SHM_HDR_SZ ) {
+		hdr = mmap( NULL, INFO_SHM_HDR_SZ, PROT_READ | PROT_WRITE,
+			    MAP_SHARED, fd, 0 );
+		if( hdr != MAP_FAILED ) {
+			if( hdr->magic == INFO_SHM_MAGIC )
+				hdr->stale = 1;
+			munmap( hdr, INFO_SHM_HDR_SZ );
+		}
+	}
+	close( fd );
+}
+
+/*
+ * Create a new segment with room for capacity bytes and put it in place of
+ * the current one. The new file is complete before it is visible.
+ */
+static int
+shm_new_segment( info_shm_t shm, int capacity ) {
+	info_shm_hdr_t *hdr;
+	char           *tmpPath = NULL;
+	size_t          mapSize = INFO_SHM_HDR_SZ + capacity;
+	int             fd = -1;
+
+	if( !( tmpPath = malloc( strlen( shm->path ) + 5 ))) {
+		debug_r( "Error: malloc failed\n" );
+		return 0;
+	}
+	sprintf( tmpPath, "%s.new", shm->path );
+
+	if( ( fd = open( tmpPath, O_RDWR | O_CREAT | O_TRUNC, 0644 ) ) == -1 ) {
+		debug_r( "Error: creating %s: %s\n", tmpPath, strerror(errno));
+		goto exit_with_free;
+	}
+	if( ftruncate( fd, mapSize ) == -1 ) {
+		debug_r( "Error: ftruncate %s: %s\n", tmpPath, strerror(errno));
+		goto exit_with_free;
+	}
+	hdr = mmap( NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+	if( hdr == MAP_FAILED ) {
+		debug_r( "Error: mmap %s: %s\n", tmpPath, strerror(errno));
+		goto exit_with_free;
+	}
+	hdr->magic    = INFO_SHM_MAGIC;
+	hdr->version  = MSX_INFOD_INFO_VER;
+	hdr->seq      = 0;
+	hdr->stale    = 0;
+	hdr->capacity = capacity;
+	hdr->data_sz  = 0;
+
+	shm_mark_stale( shm->path );
+	if( rename( tmpPath, shm->path ) == -1 ) {
+		debug_r( "Error: rename %s: %s\n", tmpPath, strerror(errno));
+		munmap( hdr, mapSize );
+		unlink( tmpPath );
+		goto exit_with_free;
+	}
+	free( tmpPath );
+
+	shm_unmap( shm );
+	shm->fd      = fd;
+	shm->hdr     = hdr;
+	shm->mapSize = mapSize;
+	return 1;
+
+ exit_with_free:
+	if( fd != -1 )
+		close( fd );
+	free( tmpPath );
+	return 0;
+}
+
+/****************************************************************************
+ * Writer
+ ***************************************************************************/
+info_shm_t
+info_shm_create( const char *path, int size ) {
+	info_shm_t shm;
+
+	if( !path ) {
+		debug_r( "Error: args, info_shm_create\n" );
+		return NULL;
+	}
+	if( !( shm = calloc( 1, sizeof(struct info_shm) ))) {
+		debug_r( "Error: malloc failed\n" );
+		return NULL;
+	}
+	shm->fd = -1;
+	shm->writer = 1;
+	if( !( shm->path = strdup( path )))
+		goto exit_with_free;
+
+	if( size < INFO_SHM_MIN_SIZE )
+		size = INFO_SHM_MIN_SIZE;
+	if( !shm_new_segment( shm, size ))
+		goto exit_with_free;
+	return shm;
+
+ exit_with_free:
+	free( shm->path );
+	free( shm );
+	return NULL;
+}
+
+void
+info_shm_destroy( info_shm_t shm ) {
+	if( !shm )
+		return;
+	if( shm->writer && shm->hdr ) {
+		shm->hdr->stale = 1;
+		unlink( shm->path );
+	}
+	shm_unmap( shm );
+	free( shm->path );
+	free( shm );
+}
+
+void*
+info_shm_write_begin( info_shm_t shm, int size ) {
+	if( !shm || !shm->writer || size < 0 )
+		return NULL;
+
+	// Growing with some slack, the vector does not shrink much
+	if( size > shm->hdr->capacity && !shm_new_segment( shm, 2 * size ))
+		return NULL;
+
+	shm->hdr->seq++;
+	__sync_synchronize();
+	return shm->hdr->data;
+}
+
+void
+info_shm_write_end( info_shm_t shm, int size ) {
+	if( !shm || !shm->writer || !( shm->hdr->seq & 1 ))
+		return;
+	shm->hdr->data_sz = size;
+	gettimeofday( &shm->hdr->time, NULL );
+	__sync_synchronize();
+	shm->hdr->seq++;
+}
+
+/****************************************************************************
+ * Readers
+ ***************************************************************************/
+static int
+shm_map_reader( info_shm_t shm ) {
+	info_shm_hdr_t *hdr;
+	struct stat     st;
+	int             fd;
+
+	if( ( fd = open( shm->path, O_RDONLY ) ) == -1 )
+		return 0;
+	if( fstat( fd, &st ) == -1 || st.st_size < (off_t)INFO_SHM_HDR_SZ ) {
+		close( fd );
+		return 0;
+	}
+	hdr = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	if( hdr == MAP_FAILED ) {
+		close( fd );
+		return 0;
+	}
+	if( hdr->magic != INFO_SHM_MAGIC ||
+	    hdr->version != MSX_INFOD_INFO_VER ||
+	    INFO_SHM_HDR_SZ + hdr->capacity > (size_t)st.st_size ) {
+		debug_r( "Error: %s is not an info segment\n", shm->path );
+		munmap( hdr, st.st_size );
+		close( fd );
+		return 0;
+	}
+
+	shm_unmap( shm );
+	shm->fd      = fd;
+	shm->hdr     = hdr;
+	shm->mapSize = st.st_size;
+	return 1;
+}
+
+info_shm_t
+infolib_shm_attach( const char *path ) {
+	info_shm_t shm;
+
+	if( !( shm = calloc( 1, sizeof(struct info_shm) ))) {
+		debug_r( "Error: malloc failed\n" );
+		return NULL;
+	}
+	shm->fd = -1;
+	if( !( shm->path = strdup( path ? path : INFO_SHM_DEF_PATH )) ||
+	    !shm_map_reader( shm )) {
+		free( shm->path );
+		free( shm );
+		return NULL;
+	}
+	return shm;
+}
+
+void
+infolib_shm_detach( info_shm_t shm ) {
+	if( !shm || shm->writer )
+		return;
+	shm_unmap( shm );
+	free( shm->path );
+	free( shm );
+}
+
+idata_t*
+infolib_shm_read_begin( info_shm_t shm, unsigned int *seq ) {
+	unsigned int s;
+	int          i;
+
+	if( !shm || !seq )
+		return NULL;
+	if( shm->hdr->stale && !shm_map_reader( shm ))
+		return NULL;
+
+	for( i = 0 ; i < INFO_SHM_MAX_SPIN ; i++ ) {
+		s = shm->hdr->seq;
+		if( !( s & 1 )) {
+			__sync_synchronize();
+			// Nothing was written yet
+			if( s == 0 )
+				return NULL;
+			*seq = s;
+			return (idata_t*)shm->hdr->data;
+		}
+		sched_yield();
+	}
+	return NULL;
+}
+
+int
+infolib_shm_read_retry( info_shm_t shm, unsigned int seq ) {
+	__sync_synchronize();
+	return shm->hdr->seq != seq;
+}
+
+idata_t*
+infolib_shm_all( info_shm_t shm ) {
+	idata_t      *data, *copy = NULL;
+	unsigned int  seq;
+	int           size, i;
+
+	for( i = 0 ; i < INFO_SHM_MAX_SPIN ; i++ ) {
+		if( !( data = infolib_shm_read_begin( shm, &seq )))
+			break;
+		size = shm->hdr->data_sz;
+		if( size < (int)IDATA_SZ || size > shm->hdr->capacity ) {
+			if( infolib_shm_read_retry( shm, seq ))
+				continue;
+			break;
+		}
+		if( !( copy = malloc( size ))) {
+			debug_r( "Error: malloc failed\n" );
+			return NULL;
+		}
+		memcpy( copy, data, size );
+		if( !infolib_shm_read_retry( shm, seq ))
+			return copy;
+		free( copy );
+		copy = NULL;
+	}
+	return NULL;
+}
+
+int
+infolib_shm_time( info_shm_t shm, struct timeval *tv ) {
+	unsigned int seq;
+	int          i;
+
+	for( i = 0 ; i < INFO_SHM_MAX_SPIN ; i++ ) {
+		if( !infolib_shm_read_begin( shm, &seq ))
+			return 0;
+		*tv = shm->hdr->time;
+		if( !infolib_shm_read_retry( shm, seq ))
+			return 1;
+	}
+	return 0;
+}
+
+/******************************************************************************
+                           E O F
+******************************************************************************/
@@ -84,12 +84,13 @@ infolib_no_arg_request( char *server,unsigned short portnum, infolib_req_t req )
       
 	msg_hdr = (comm_hdr_t*)&(buff[0]);
 	msg_hdr->type = INFOD_MSG_TYPE_INFOLIB;
-	msg_hdr->size = sizeof( infolib_msg_t );
+	msg_hdr->size = sizeof( infolib_msg_t ) + sizeof( int );
       
-	/* prpare the message */
+	/* prpare the message, the reply may come compressed */
 	message = (infolib_msg_t*)&(buff[ sizeof(comm_hdr_t) ]);
 	message->version = MSX_INFOD_INFO_VER;
 	message->request = req;
+	*((int *)message->args) = INFOLIB_FLAG_COMPRESS;
 
 	num_to_send = sizeof(comm_hdr_t) + msg_hdr->size; 
 
@@ -461,6 +462,20 @@ infolib_recv_info( int sock ){
 		}
 	}
 
+	if( hdr.type & COMM_HDR_COMPRESSED ) {
+		void *zip_buff = data_buff;
+		int   size = comm_uncompressed_size( zip_buff, hdr.size );
+
+		data_buff = NULL;
+		if( size < 0 || !( data_buff = malloc( size )) ||
+		    !comm_uncompress( data_buff, size, zip_buff, hdr.size )) {
+			debug_r( "Error: bad compressed info\n" ) ;
+			free( data_buff );
+			data_buff = NULL;
+		}
+		free( zip_buff );
+	}
+
 	return (idata_t*)(data_buff);
 }
 
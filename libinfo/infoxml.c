@@ -356,6 +356,8 @@ infoxml_create_stats(infod_stats_t *stats) {
             "\t<%s>%.2f</%s>\n"
             "\t<%s>%.2f</%s>\n"
             "\t<%s>%.2f</%s>\n"
+            "\t<%s>%.2f</%s>\n"
+            "\t<%s>%.2f</%s>\n"
             "</%s>\n",
             XML_ROOT_TAG,
             XML_STATS_ELEMENT,
@@ -367,6 +369,8 @@ infoxml_create_stats(infod_stats_t *stats) {
             XML_TAG_AVGLOAD, stats->avgload, XML_TAG_AVGLOAD,
             XML_TAG_AVGAGE, stats->avgage, XML_TAG_AVGAGE,
             XML_TAG_MAXAGE, stats->maxage, XML_TAG_MAXAGE,
+            XML_TAG_AGEP50, stats->agep50, XML_TAG_AGEP50,
+            XML_TAG_AGEP95, stats->agep95, XML_TAG_AGEP95,
             XML_STATS_ELEMENT);
 
     return res;
@@ -0,0 +1,195 @@
+/*============================================================================
+  gossimon - Gossip based resource usage monitoring for Linux clusters
+  Copyright 2003-2010 Amnon Barak
+
+  Distributed under the OSI-approved BSD License (the "License");
+  see accompanying file Copyright.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+============================================================================*/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <msx_error.h>
+#include <msx_debug.h>
+
+#include <info.h>
+#include <info_shm.h>
+
+#define TEST_SHM_PATH   "/tmp/test_info_shm"
+
+int debug=0;
+
+static char *curr_msg;
+void print_start(char *msg)
+{
+	curr_msg = msg;
+	if(debug)
+		printf("\n================ %15s ===============\n", msg);
+}
+void print_end()
+{
+	if(debug)
+		printf("\n++++++++++++++++ %15s +++++++++++++++\n", curr_msg);
+}
+
+/*
+ * Write a reply of size bytes whose data bytes are all val
+ */
+static void
+writeData(info_shm_t shm, int size, char val)
+{
+	idata_t *data = info_shm_write_begin(shm, size);
+
+	fail_unless(data != NULL, "Failed to begin write");
+	data->num = size;
+	data->total_sz = size;
+	memset(data->data, val, size - IDATA_SZ);
+	info_shm_write_end(shm, size);
+}
+
+static int
+checkData(idata_t *data, int size, char val)
+{
+	char *p = (char *)data->data;
+	int   i;
+
+	if(data->num != size || data->total_sz != size)
+		return 0;
+	for(i = 0 ; i < size - (int)IDATA_SZ ; i++)
+		if(p[i] != val)
+			return 0;
+	return 1;
+}
+
+START_TEST (test_shm)
+{
+	info_shm_t    shm, reader;
+	idata_t      *data;
+	unsigned int  seq;
+
+	print_start("shm");
+
+	shm = info_shm_create(TEST_SHM_PATH, 1000);
+	fail_unless(shm != NULL, "Failed to create segment");
+	reader = infolib_shm_attach(TEST_SHM_PATH);
+	fail_unless(reader != NULL, "Failed to attach");
+	fail_unless(infolib_shm_all(reader) == NULL, "Got data before a write");
+
+	writeData(shm, 100, 'a');
+	data = infolib_shm_all(reader);
+	fail_unless(data && checkData(data, 100, 'a'), "Wrong data");
+	free(data);
+
+	// A write in the middle of a read
+	data = infolib_shm_read_begin(reader, &seq);
+	fail_unless(data && checkData(data, 100, 'a'), "Wrong zero copy data");
+	writeData(shm, 200, 'b');
+	fail_unless(infolib_shm_read_retry(reader, seq), "Missed a write");
+	data = infolib_shm_read_begin(reader, &seq);
+	fail_unless(data && checkData(data, 200, 'b') &&
+		    !infolib_shm_read_retry(reader, seq), "Wrong zero copy data");
+
+	// Nothing is read while the writer is at it
+	fail_unless(info_shm_write_begin(shm, 300) != NULL, "Failed to begin");
+	fail_unless(infolib_shm_read_begin(reader, &seq) == NULL,
+		    "Read while being written");
+	info_shm_write_end(shm, 200);
+
+	// The segment is replaced by a bigger one
+	writeData(shm, 100000, 'c');
+	data = infolib_shm_all(reader);
+	fail_unless(data && checkData(data, 100000, 'c'), "Wrong data after grow");
+	free(data);
+
+	info_shm_destroy(shm);
+	fail_unless(infolib_shm_all(reader) == NULL, "Got data after destroy");
+	infolib_shm_detach(reader);
+	fail_unless(access(TEST_SHM_PATH, F_OK) != 0, "Segment left behind");
+	print_end();
+}
+END_TEST
+
+/*
+ * A reader never gets a copy mixing two writes
+ */
+START_TEST (test_shm_concurrent)
+{
+	info_shm_t    shm, reader;
+	idata_t      *data;
+	pid_t         pid;
+	int           i, got = 0, status;
+
+	print_start("shm concurrent");
+
+	shm = info_shm_create(TEST_SHM_PATH, 70000);
+	fail_unless(shm != NULL, "Failed to create segment");
+	writeData(shm, 1000, 0);
+
+	if((pid = fork()) == 0) {
+		for(i = 1 ; ; i++)
+			writeData(shm, 1000 + (i % 50) * 1000, (char)i);
+	}
+	fail_unless(pid > 0, "Fork failed");
+
+	reader = infolib_shm_attach(TEST_SHM_PATH);
+	fail_unless(reader != NULL, "Failed to attach");
+	for(i = 0 ; i < 2000 ; i++) {
+		if(!(data = infolib_shm_all(reader)))
+			continue;
+		fail_unless(checkData(data, data->total_sz,
+				      ((char *)data->data)[0]),
+			    "Got a torn copy");
+		free(data);
+		got++;
+	}
+	kill(pid, SIGKILL);
+	waitpid(pid, &status, 0);
+	fail_unless(got > 0, "No consistent copy");
+
+	infolib_shm_detach(reader);
+	info_shm_destroy(shm);
+	print_end();
+}
+END_TEST
+
+Suite *shm_suite(void)
+{
+  Suite *s = suite_create("Info Shm");
+
+  TCase *tc_core = tcase_create("core");
+
+  suite_add_tcase (s, tc_core);
+  tcase_add_test(tc_core, test_shm);
+  tcase_add_test(tc_core, test_shm_concurrent);
+
+  return s;
+}
+
+
+int main(int argc, char **argv)
+{
+  int nf;
+
+  msx_set_debug(0);
+  if(argc > 1)
+          debug = 1;
+
+
+  Suite *s = shm_suite();
+  SRunner *sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  nf = srunner_ntests_failed(sr);
+  srunner_free(sr);
+  return (nf == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -34,6 +34,18 @@
  * we dont get the data immidiatly since the connect is not followed by
  * send but the actuall send is called after the select tells us that
  * the connect went O.K.  
+ *
+ * Every socket is kept in a table indexed by the fd together with the
+ * function handling it when it is ready. comm_wait finds the ready ones,
+ * with epoll (only they are visited) or select, and comm_dispatch calls
+ * their functions.
+ *
+ * With comm_set_pool the connection of a send is not closed when it is
+ * over but kept for the next message to the same host, and the receiver
+ * keeps reading messages from it (comm_recv_next).
+ *
+ * With comm_set_udp small messages are sent as a single datagram instead,
+ * there is no connection at all.
  */
 
 #include <netinet/in.h>
@@ -41,6 +53,7 @@
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/time.h>
@@ -49,7 +62,11 @@
 #include <string.h>
 #include <errno.h>
 #include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <stdint.h>
+#include <stdarg.h>
 #include <linux/tcp.h>
+#include <zlib.h>
 
 #include <info.h>
 #include <msx_error.h>
@@ -57,6 +74,7 @@
 #include <comm.h>
 
 #define MAX_BUFF_SZ (1024)
+#define COMM_MAX_IOV (64)    // Chunks given to one sendmsg
 
 /******************************************************************************
  * Set the header fields
@@ -68,10 +86,504 @@ comm_hdr_set( comm_hdr_t *hdr, int type, int size ){
 	return 1;
 }
 
+/******************************************************************************
+ * Message buffers. Each one is preceded by its size class (-1 for the ones
+ * larger than the largest class), so comm_buf_put knows where it goes.
+ *****************************************************************************/
+typedef union comm_buf_hdr {
+	int  cls;
+	char align[16];     /* The data is aligned as malloc's */
+} comm_buf_hdr_t;
+
+/*
+ * The size of class cls, each class is 4 times the previous
+ */
+static int
+comm_buf_class_size( int cls ) {
+	return COMM_BUF_MIN_SIZE << ( 2 * cls );
+}
+
+/****************************************************************************
+ * A buffer of at least size bytes
+ ***************************************************************************/
+void *
+comm_buf_get( msx_comm_t *comm, int size ) {
+
+	comm_buf_hdr_t *buf;
+	int             cls = 0;
+
+	while( cls < COMM_BUF_CLASSES && comm_buf_class_size( cls ) < size )
+		cls++;
+
+	if( cls < COMM_BUF_CLASSES && comm->comm_bufs_num[ cls ] ) {
+		comm->comm_stats.buf_hit++;
+		buf = comm->comm_bufs[ cls ][ --comm->comm_bufs_num[ cls ] ];
+		return buf + 1;
+	}
+	
+	comm->comm_stats.buf_miss++;
+	if( cls < COMM_BUF_CLASSES )
+		size = comm_buf_class_size( cls );
+	else
+		cls = -1;
+	if( !( buf = malloc( sizeof(comm_buf_hdr_t) + size )))
+		return NULL;
+	buf->cls = cls;
+	return buf + 1;
+}
+
+/****************************************************************************
+ * Give back a buffer of comm_buf_get, it is kept if its pool is not full
+ ***************************************************************************/
+void
+comm_buf_put( msx_comm_t *comm, void *ptr ) {
+
+	comm_buf_hdr_t *buf;
+	int             cls;
+
+	if( !ptr )
+		return;
+	buf = (comm_buf_hdr_t *)ptr - 1;
+	cls = buf->cls;
+	if( cls >= 0 && cls < COMM_BUF_CLASSES &&
+	    comm->comm_bufs_num[ cls ] < COMM_BUF_KEEP )
+		comm->comm_bufs[ cls ][ comm->comm_bufs_num[ cls ]++ ] = buf;
+	else
+		free( buf );
+}
+
+/******************************************************************************
+ * Compression of the messages, see COMM_HDR_COMPRESSED
+ *****************************************************************************/
+void
+comm_set_compress( msx_comm_t *comm, int min ) {
+	comm->comm_compress_min = ( min > 0 ) ? min : COMM_COMPRESS_MIN_SIZE;
+}
+
+/*
+ * Compress the message of the iovec to a new buffer, its header set. The
+ * flag is taken out of *type. Returns NULL, to send the message as is, if
+ * compression was not asked for, the message is small or did not get
+ * smaller. Otherwise *size is the size of the compressed data.
+ */
+static char *
+comm_compress_msg( msx_comm_t *comm, int *type, struct iovec *iov,
+		   int iovcnt, int *size ) {
+
+	z_stream   zs;
+	char      *buf;
+	int        i, orig = 0, bound, res = Z_OK;
+
+	if( !( *type & COMM_HDR_COMPRESSED ))
+		return NULL;
+	*type &= ~COMM_HDR_COMPRESSED;
+
+	for( i = 0 ; i < iovcnt ; i++ )
+		orig += iov[ i ].iov_len;
+	if( orig < comm->comm_compress_min )
+		return NULL;
+
+	bzero( &zs, sizeof(zs) );
+	if( deflateInit( &zs, Z_BEST_SPEED ) != Z_OK ) {
+		debug_lr( COMM_DEBUG, "Error: deflateInit\n" );
+		return NULL;
+	}
+	bound = sizeof(comm_hdr_t) + sizeof(int) + deflateBound( &zs, orig );
+	if( !( buf = comm_buf_get( comm, bound ))) {
+		deflateEnd( &zs );
+		return NULL;
+	}
+
+	zs.next_out  = (Bytef *)buf + sizeof(comm_hdr_t) + sizeof(int);
+	zs.avail_out = bound - sizeof(comm_hdr_t) - sizeof(int);
+	for( i = 0 ; i < iovcnt && res == Z_OK ; i++ ) {
+		zs.next_in  = iov[ i ].iov_base;
+		zs.avail_in = iov[ i ].iov_len;
+		res = deflate( &zs, ( i == iovcnt - 1 ) ? Z_FINISH : Z_NO_FLUSH );
+	}
+	deflateEnd( &zs );
+	if( res != Z_STREAM_END || sizeof(int) + zs.total_out >= orig ) {
+		comm_buf_put( comm, buf );
+		return NULL;
+	}
+
+	*size = sizeof(int) + zs.total_out;
+	*type |= COMM_HDR_COMPRESSED;
+	comm_hdr_set( (comm_hdr_t *)buf, *type, *size );
+	memcpy( buf + sizeof(comm_hdr_t), &orig, sizeof(int) );
+	comm->comm_stats.zip_sent++;
+	comm->comm_stats.zip_saved += orig - *size;
+	return buf;
+}
+
+/****************************************************************************
+ * The size of compressed data once uncompressed, -1 if it is not valid
+ ***************************************************************************/
+int
+comm_uncompressed_size( void *data, int size ) {
+
+	int orig;
+
+	if( size <= (int)sizeof(int) )
+		return -1;
+	memcpy( &orig, data, sizeof(int) );
+	if( orig <= 0 || orig > MAX_MSG_SIZE )
+		return -1;
+	return orig;
+}
+
+/****************************************************************************
+ * Uncompress the data of a compressed message to dst
+ ***************************************************************************/
+int
+comm_uncompress( void *dst, int dst_size, void *data, int size ) {
+
+	uLongf len = dst_size;
+	int    orig;
+
+	if( ( orig = comm_uncompressed_size( data, size )) < 0 ||
+	    orig > dst_size )
+		return 0;
+	if( uncompress( dst, &len, (Bytef *)data + sizeof(int),
+			size - sizeof(int) ) != Z_OK || len != orig ) {
+		debug_lr( COMM_DEBUG, "Error: bad compressed message\n" );
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * The uncompressed data of a received message in a new buffer, the header
+ * is changed to match it. NULL if the message is bad.
+ */
+static char *
+comm_uncompress_msg( msx_comm_t *comm, comm_hdr_t *hdr, char *data ) {
+
+	char *buf;
+	int   size;
+
+	if( ( size = comm_uncompressed_size( data, hdr->size )) < 0 ||
+	    !( buf = comm_buf_get( comm, size )))
+		return NULL;
+	if( !comm_uncompress( buf, size, data, hdr->size )) {
+		comm_buf_put( comm, buf );
+		return NULL;
+	}
+	hdr->type &= ~COMM_HDR_COMPRESSED;
+	hdr->size  = size;
+	comm->comm_stats.zip_recvd++;
+	return buf;
+}
+
+/******************************************************************************
+ * The watched fds
+ *****************************************************************************/
+static void comm_ev_listen( msx_comm_t *comm, int fd, int events, void *arg );
+static void comm_ev_send( msx_comm_t *comm, int fd, int events, void *arg );
+static void comm_ev_recv( msx_comm_t *comm, int fd, int events, void *arg );
+static void comm_ev_close( msx_comm_t *comm, int fd, int events, void *arg );
+static void comm_ev_pool( msx_comm_t *comm, int fd, int events, void *arg );
+static void comm_ev_udp( msx_comm_t *comm, int fd, int events, void *arg );
+
+/*
+ * Make room for one more entry in a connection table, doubling it when full
+ */
+static int
+comm_table_grow( void **table, int *size, int next, size_t ent_size ) {
+
+	void *t;
+	int   new_size;
+
+	if( next < *size )
+		return 1;
+	new_size = *size ? 2 * *size : COMM_MAX_INPROGRESS;
+	if( !( t = realloc( *table, new_size * ent_size ))) {
+		debug_lr( COMM_DEBUG, "Error: realloc, %d connections\n",
+			  new_size );
+		return 0;
+	}
+	bzero( (char *)t + *size * ent_size, ( new_size - *size ) * ent_size );
+	*table = t;
+	*size  = new_size;
+	return 1;
+}
+
+/*
+ * Make the fd table large enough for fd
+ */
+static int
+comm_fds_grow( msx_comm_t *comm, int fd ) {
+
+	comm_fd_ent_t *fds;
+	int            size = comm->comm_fds_size ? comm->comm_fds_size :
+		COMM_MAX_INPROGRESS;
+
+	while( size <= fd )
+		size *= 2;
+	if( !( fds = realloc( comm->comm_fds, size * sizeof(comm_fd_ent_t)))) {
+		debug_lr( COMM_DEBUG, "Error: realloc, fd table\n" );
+		return 0;
+	}
+	bzero( fds + comm->comm_fds_size,
+	       ( size - comm->comm_fds_size ) * sizeof(comm_fd_ent_t));
+	comm->comm_fds      = fds;
+	comm->comm_fds_size = size;
+	return 1;
+}
+
+static unsigned int
+comm_ev2epoll( int events ) {
+
+	unsigned int ev = 0;
+
+	if( events & COMM_EV_READ )
+		ev |= EPOLLIN;
+	if( events & COMM_EV_WRITE )
+		ev |= EPOLLOUT;
+	if( events & COMM_EV_CLOSE )
+		ev |= EPOLLRDHUP;
+	return ev;
+}
+
+static int
+comm_epoll2ev( unsigned int ev ) {
+
+	int events = 0;
+
+	if( ev & EPOLLIN )
+		events |= COMM_EV_READ;
+	if( ev & EPOLLOUT )
+		events |= COMM_EV_WRITE;
+	if( ev & ( EPOLLRDHUP | EPOLLHUP | EPOLLERR ))
+		events |= COMM_EV_CLOSE;
+	return events;
+}
+
+/****************************************************************************
+ * Watch fd for events, func(comm, fd, events, arg) is called by
+ * comm_dispatch when it is ready. Watching an fd again changes its events
+ * and function.
+ ***************************************************************************/
+int
+comm_watch_fd( msx_comm_t *comm, int fd, int events,
+	       comm_fd_func_t func, void *arg ) {
+
+	struct epoll_event  ev;
+	comm_fd_ent_t      *ent;
+	int                 res;
+
+	if( fd < 0 || !func )
+		return 0;
+	if( comm->comm_backend == COMM_BACKEND_SELECT && fd >= FD_SETSIZE ) {
+		debug_lr( COMM_DEBUG, "Error: fd %d too large for select\n", fd );
+		return 0;
+	}
+	if( fd >= comm->comm_fds_size && !comm_fds_grow( comm, fd ))
+		return 0;
+	
+	ent = &(comm->comm_fds[ fd ]);
+	if( comm->comm_backend == COMM_BACKEND_EPOLL ) {
+		bzero( &ev, sizeof(ev) );
+		ev.events = comm_ev2epoll( events );
+		
+		// A closed fd left the epoll set by itself, so an fd the
+		// table holds may be new to it and the other way round
+		res = -1;
+		if( ent->func ) {
+			ev.data.u64 = (uint64_t)fd | ((uint64_t)ent->gen << 32);
+			res = epoll_ctl( comm->comm_epfd, EPOLL_CTL_MOD, fd, &ev );
+		}
+		if( res < 0 ) {
+			ent->gen++;
+			ev.data.u64 = (uint64_t)fd | ((uint64_t)ent->gen << 32);
+			if(( res = epoll_ctl( comm->comm_epfd, EPOLL_CTL_ADD,
+					      fd, &ev )) < 0 && errno == EEXIST )
+				res = epoll_ctl( comm->comm_epfd, EPOLL_CTL_MOD,
+						 fd, &ev );
+		}
+		if( res < 0 ) {
+			debug_lr( COMM_DEBUG, "Error: epoll_ctl fd %d. %s\n",
+				  fd, strerror( errno ));
+			ent->func = NULL;
+			return 0;
+		}
+	}
+	else if( !ent->func )
+		ent->gen++;
+
+	ent->func   = func;
+	ent->arg    = arg;
+	ent->events = events;
+	return 1;
+}
+
+/****************************************************************************
+ * Stop watching fd, if it is still watched with func
+ ***************************************************************************/
+int
+comm_unwatch_fd( msx_comm_t *comm, int fd, comm_fd_func_t func ) {
+
+	comm_fd_ent_t *ent;
+
+	if( fd < 0 || fd >= comm->comm_fds_size )
+		return 0;
+	ent = &(comm->comm_fds[ fd ]);
+	if( !ent->func || ent->func != func )
+		return 0;
+	
+	// Fails when fd was already closed, it then left the set anyway
+	if( comm->comm_backend == COMM_BACKEND_EPOLL )
+		epoll_ctl( comm->comm_epfd, EPOLL_CTL_DEL, fd, NULL );
+	ent->func   = NULL;
+	ent->arg    = NULL;
+	ent->events = 0;
+	return 1;
+}
+
+/*
+ * Watch one of the sockets of comm, at pos in the table of its kind
+ */
+static int
+comm_watch_sock( msx_comm_t *comm, int sock, int events,
+		 comm_fd_func_t func, int pos ) {
+
+	if( !comm_watch_fd( comm, sock, events, func, NULL ))
+		return 0;
+	comm->comm_fds[ sock ].pos = pos;
+	return 1;
+}
+
+/*
+ * A socket of comm moved to pos in the table of its kind
+ */
+static void
+comm_sock_moved( msx_comm_t *comm, int sock, comm_fd_func_t func, int pos ) {
+
+	if( sock >= 0 && sock < comm->comm_fds_size &&
+	    comm->comm_fds[ sock ].func == func )
+		comm->comm_fds[ sock ].pos = pos;
+}
+
+/******************************************************************************
+ * Removing entries from the tables. The last entry takes the place of the
+ * removed one. The socket is not closed.
+ *****************************************************************************/
+static void
+comm_del_send( msx_comm_t *comm, int i ) {
+
+	int last = comm->comm_inpr_send_next - 1;
+
+	comm_unwatch_fd( comm, comm->comm_inpr_send[ i ].sock, comm_ev_send );
+	if( i != last ) {
+		comm->comm_inpr_send[ i ] = comm->comm_inpr_send[ last ];
+		comm_sock_moved( comm, comm->comm_inpr_send[ i ].sock,
+				 comm_ev_send, i );
+	}
+	bzero( &(comm->comm_inpr_send[ last ]), sizeof(comm_inprogress_send_t));
+	comm->comm_inpr_send_next--;
+}
+
+static void
+comm_del_recv( msx_comm_t *comm, int i ) {
+
+	int last = comm->comm_inpr_recv_next - 1;
+
+	comm_unwatch_fd( comm, comm->comm_inpr_recv[ i ].sock, comm_ev_recv );
+	if( i != last ) {
+		comm->comm_inpr_recv[ i ] = comm->comm_inpr_recv[ last ];
+		comm_sock_moved( comm, comm->comm_inpr_recv[ i ].sock,
+				 comm_ev_recv, i );
+	}
+	bzero( &(comm->comm_inpr_recv[ last ]), sizeof(comm_inprogress_recv_t));
+	comm->comm_inpr_recv_next--;
+}
+
+static void
+comm_del_close( msx_comm_t *comm, int i ) {
+
+	int last = comm->comm_close_next - 1;
+
+	comm_unwatch_fd( comm, comm->comm_close[ i ].sock, comm_ev_close );
+	if( i != last ) {
+		comm->comm_close[ i ] = comm->comm_close[ last ];
+		comm_sock_moved( comm, comm->comm_close[ i ].sock,
+				 comm_ev_close, i );
+	}
+	bzero( &(comm->comm_close[ last ]), sizeof(comm_send_close_t));
+	comm->comm_close_next--;
+}
+
 /******************************************************************************
  * Function that add entries to the data structures
  *****************************************************************************/
 
+/*
+ * Adding a (socket, buffer) to the list of inprogress sends. The buffer
+ * (of comm_buf_get) holds the header and the data, comm owns it from now.
+ */
+static int
+comm_add_inprogress_send_buf( msx_comm_t *comm, int sock, char *ip,
+			      char *buf, int mv2recv ){
+
+	/* we add at comm_inpr_recv_next */
+	int pos = comm->comm_inpr_send_next;
+	
+	/* Make room for it */ 
+	if( !comm_table_grow( (void **)&(comm->comm_inpr_send),
+			      &(comm->comm_inpr_send_size), pos,
+			      sizeof(comm_inprogress_send_t))) {
+		comm_buf_put( comm, buf );
+		return 0;
+	}
+
+	bzero( &(comm->comm_inpr_send[ pos ]), sizeof(comm_inprogress_send_t));
+	
+	comm->comm_inpr_send[ pos ].data_size = sizeof(comm_hdr_t) +
+		((comm_hdr_t *)buf)->size;
+	comm->comm_inpr_send[ pos ].data      = buf;
+	comm->comm_inpr_send[ pos ].curr_size = 0 ;
+	comm->comm_inpr_send[ pos ].sock      = sock;
+	comm->comm_inpr_send[ pos ].mv2recv   = mv2recv ;
+
+	memcpy( comm->comm_inpr_send[ pos ].ip, ip, COMM_IP_VER );
+	timerclear( &(comm->comm_inpr_send[ pos ].time) ) ; 
+      
+	if( !comm_watch_sock( comm, sock, COMM_EV_WRITE, comm_ev_send, pos )) {
+		comm_buf_put( comm, buf );
+		comm->comm_inpr_send[ pos ].data = NULL;
+		return 0;
+	}
+	if( comm->comm_maxfd < sock )
+		comm->comm_maxfd = sock;
+
+	comm->comm_inpr_send_next++;
+	return 1;
+}
+
+/*
+ * The message in a buffer that holds the header too, compressed if
+ * asked for
+ */
+static char *
+comm_msg_buf( msx_comm_t *comm, void *buff, int type, int size ) {
+
+	struct iovec  vec;
+	char         *buf;
+
+	vec.iov_base = buff;
+	vec.iov_len  = size;
+	if( ( buf = comm_compress_msg( comm, &type, &vec, 1, &size )))
+		return buf;
+
+	if( !( buf = comm_buf_get( comm, sizeof(comm_hdr_t) + size ))) {
+		debug_lb( COMM_DEBUG, "Error: malloc, comm_msg_buf\n" );
+		return NULL;
+	}
+	comm_hdr_set( (comm_hdr_t *)buf, type, size );
+	memcpy( buf + sizeof(comm_hdr_t), buff, size );
+	return buf;
+}
+
 /*
  * Adding a (socket, data) to the list of inprogress sends
  * Note that the send buffer holds all the info that would
@@ -82,47 +594,57 @@ static int
 comm_add_inprogress_send( msx_comm_t *comm, int sock, char *ip,
 			  char *buff, int type, int size, int mv2recv ){
 
-	/* we add at comm_inpr_recv_next */
+	char *buf;
+
+	if( !( buf = comm_msg_buf( comm, buff, type, size )))
+		return 0;
+	return comm_add_inprogress_send_buf( comm, sock, ip, buf, mv2recv );
+}
+
+/*
+ * Adding a (socket, iovec) to the list of inprogress sends. Only the
+ * header is kept in the entry, the iovec is sent from the caller's memory.
+ */
+static int
+comm_add_inprogress_send_iov( msx_comm_t *comm, int sock, char *ip,
+			      struct iovec *iov, int iovcnt, int type,
+			      int mv2recv, comm_send_done_func_t done,
+			      void *done_arg ){
+
 	int pos = comm->comm_inpr_send_next;
-	comm_hdr_t hdr;
+	int i, size = 0;
 	
-	/* Test that there is enough space left */ 
-	if( pos == COMM_MAX_INPROGRESS - 1 ){
-		debug_lr( COMM_DEBUG,
-			  "Error: Already (%d) connections in progress\n",
-			  COMM_MAX_INPROGRESS);
+	/* Make room for it */ 
+	if( !comm_table_grow( (void **)&(comm->comm_inpr_send),
+			      &(comm->comm_inpr_send_size), pos,
+			      sizeof(comm_inprogress_send_t)))
 		return 0;
-	}
 
 	bzero( &(comm->comm_inpr_send[ pos ]), sizeof(comm_inprogress_send_t));
+
+	for( i = 0 ; i < iovcnt ; i++ )
+		size += iov[ i ].iov_len;
 	
-	/* Set the header fields */
-	if( !( comm_hdr_set( &hdr, type, size )))
+	if( !( comm_hdr_set( &(comm->comm_inpr_send[ pos ].hdr), type, size )))
 		return 0;
-      
+	
 	comm->comm_inpr_send[ pos ].data_size = sizeof(comm_hdr_t) + size;
-
-	if(!(comm->comm_inpr_send[ pos ].data =
-	     malloc( comm->comm_inpr_send[ pos ].data_size ))){
-		debug_lb( COMM_DEBUG,
-			  "Error: malloc, comm_add_inprogress_send\n" );
-		return 0;
-	}
-
 	comm->comm_inpr_send[ pos ].curr_size = 0 ;
 	comm->comm_inpr_send[ pos ].sock      = sock;
 	comm->comm_inpr_send[ pos ].mv2recv   = mv2recv ;
-
-	/* first copy the header to buff */ 
-	memcpy(comm->comm_inpr_send[ pos ].data, &hdr, sizeof(comm_hdr_t));
-
-	/* copy the buffer that holds the info */ 
-	memcpy((comm->comm_inpr_send[ pos ].data) + sizeof(comm_hdr_t),
-	       buff, size);
+	comm->comm_inpr_send[ pos ].iov       = iov;
+	comm->comm_inpr_send[ pos ].iovcnt    = iovcnt;
+	comm->comm_inpr_send[ pos ].done      = done;
+	comm->comm_inpr_send[ pos ].done_arg  = done_arg;
 
 	memcpy( comm->comm_inpr_send[ pos ].ip, ip, COMM_IP_VER );
 	timerclear( &(comm->comm_inpr_send[ pos ].time) ) ; 
       
+	if( !comm_watch_sock( comm, sock, COMM_EV_WRITE, comm_ev_send, pos )) {
+		bzero( &(comm->comm_inpr_send[ pos ]),
+		       sizeof(comm_inprogress_send_t));
+		return 0;
+	}
 	if( comm->comm_maxfd < sock )
 		comm->comm_maxfd = sock;
 
@@ -130,6 +652,25 @@ comm_add_inprogress_send( msx_comm_t *comm, int sock, char *ip,
 	return 1;
 }
 
+/*
+ * Release the message of an inprogress send, freeing the copied data or
+ * handing the iovec back to its owner.
+ */
+static void
+comm_release_send( msx_comm_t *comm, comm_inprogress_send_t *send_info ){
+
+	comm_send_done_func_t done = send_info->done;
+	
+	if( send_info->data ) {
+		comm_buf_put( comm, send_info->data );
+		send_info->data = NULL;
+	}
+	send_info->iov  = NULL;
+	send_info->done = NULL;
+	if( done )
+		done( send_info->done_arg );
+}
+
 /*
  * Adding a (sock) to the list of connections that we are doing
  * receive on.
@@ -141,14 +682,14 @@ comm_add_inprogress_recv( msx_comm_t *comm, int sock, char *ip ){
 	/* we add at comm_inpr_recv_next */ 
 	int pos = comm->comm_inpr_recv_next;
       
-	if( pos == (COMM_MAX_INPROGRESS - 1)){
-		debug_lr( COMM_DEBUG,
-			  "Error: Already (%d) connections in progress\n",
-			  COMM_MAX_INPROGRESS );
+	if( !comm_table_grow( (void **)&(comm->comm_inpr_recv),
+			      &(comm->comm_inpr_recv_size), pos,
+			      sizeof(comm_inprogress_recv_t)))
 		return 0;
-	}
 
 	bzero( &(comm->comm_inpr_recv[ pos ]), sizeof(comm_inprogress_recv_t));
+	if( !comm_watch_sock( comm, sock, COMM_EV_READ, comm_ev_recv, pos ))
+		return 0;
 	comm->comm_inpr_recv[ pos ].sock = sock ;
 	memcpy(comm->comm_inpr_recv[ pos ].ip, ip, COMM_IP_VER );
 	gettimeofday( &(comm->comm_inpr_recv[ pos ].time), NULL );
@@ -177,7 +718,10 @@ comm_add_close( msx_comm_t *comm, int sock ){
 	flag = 1;
 	setsockopt( sock, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(int));
     
-	if( pos == ( COMM_MAX_INPROGRESS - 1)){
+	if( !comm_table_grow( (void **)&(comm->comm_close),
+			      &(comm->comm_close_size), pos,
+			      sizeof(comm_send_close_t)) ||
+	    !comm_watch_sock( comm, sock, COMM_EV_CLOSE, comm_ev_close, pos )) {
 		debug_lr( COMM_DEBUG, "Error: Too much fd's in close\n");
 		close( sock );
 		return 0;
@@ -218,6 +762,9 @@ comm_calc_inprogress_maxfd( msx_comm_t *comm ){
 	for(i=0; i < comm->comm_close_next ; i++)
 		if( comm->comm_close[i].sock > maxfd)
 			maxfd = comm->comm_close[i].sock;
+
+	if( comm->comm_udp_sock > maxfd )
+		maxfd = comm->comm_udp_sock;
     
 	comm->comm_maxfd = maxfd;
 	return 1;
@@ -228,6 +775,15 @@ comm_calc_inprogress_maxfd( msx_comm_t *comm ){
  ***************************************************************************/
 msx_comm_t*
 comm_init( unsigned short *ports, int timeout ){
+	return comm_init_backend( ports, timeout, COMM_BACKEND_SELECT );
+}
+
+/****************************************************************************
+ *  Initializing the msxcomm object, waiting for the sockets with backend.
+ *  Without epoll select is used.
+ ***************************************************************************/
+msx_comm_t*
+comm_init_backend( unsigned short *ports, int timeout, int backend ){
 	int result = 0 ; 
 	int i;
 	struct sockaddr_in socketInfo ;
@@ -243,6 +799,25 @@ comm_init( unsigned short *ports, int timeout ){
       
 	/* timeout of receiving and sending */
 	comm->comm_timeout = timeout;
+	comm->comm_pool_idle = COMM_POOL_IDLE_TIMEOUT;
+	comm->comm_udp_sock  = -1;
+	comm->comm_compress_min = COMM_COMPRESS_MIN_SIZE;
+
+	comm->comm_backend = COMM_BACKEND_SELECT;
+	comm->comm_epfd    = -1;
+	if( backend == COMM_BACKEND_EPOLL ) {
+		if( ( comm->comm_epfd = epoll_create( COMM_MAX_EVENTS )) < 0 )
+			debug_lr( COMM_DEBUG, "Error: epoll_create, using select\n" );
+		else {
+			fcntl( comm->comm_epfd, F_SETFD, FD_CLOEXEC );
+			comm->comm_backend = COMM_BACKEND_EPOLL;
+		}
+	}
+	if( !( comm->comm_ready = malloc( COMM_MAX_EVENTS *
+					  sizeof(comm_ready_t)))) {
+		debug_lr( COMM_DEBUG, "Error: malloc, ready fds\n" );
+		goto exit_with_error;
+	}
       
 	/* Opening, binding and listening on all the external sockets */
 	comm->comm_maxfd = -1;
@@ -281,6 +856,10 @@ comm_init( unsigned short *ports, int timeout ){
 			debug_lr( COMM_DEBUG, "Error: listen()\n" ) ;
 			goto exit_with_error;
 		}
+
+		if( !comm_watch_sock( comm, comm->comm_sock[i], COMM_EV_READ,
+				      comm_ev_listen, i ))
+			goto exit_with_error;
 	    
 		if(comm->comm_sock[i] > comm->comm_maxfd)
 			comm->comm_maxfd = comm->comm_sock[i];
@@ -321,25 +900,39 @@ comm_close( msx_comm_t *comm ){
 	/* close all the send sockets */
 	for( i = 0 ; i < comm->comm_inpr_send_next; i++ ) {
 		close( comm->comm_inpr_send[ i ].sock );
-		if( comm->comm_inpr_send[ i ].data ) {
-			free( comm->comm_inpr_send[ i ].data );
-			comm->comm_inpr_send[ i ].data = NULL;
-		}
+		comm_release_send( comm, &(comm->comm_inpr_send[ i ]) );
 	}
     
 	/* close all the recv sockets */
 	for( i = 0; i < comm->comm_inpr_recv_next; i++ ) {
 		close( comm->comm_inpr_recv[ i ].sock );
-		if( comm->comm_inpr_recv[ i ].data ) {
-			free( comm->comm_inpr_recv[ i ].data );
-			comm->comm_inpr_recv[ i ].data = NULL;
-		}
+		comm_buf_put( comm, comm->comm_inpr_recv[ i ].data );
+		comm->comm_inpr_recv[ i ].data = NULL;
 	}
     
 	/* close all the sockets waiting to be closed  */
 	for( i = 0; i < comm->comm_close_next; i++ )
 		close( comm->comm_close[i].sock );
-	
+
+	/* close the kept connections, the busy ones were closed as sends */
+	for( i = 0; i < comm->comm_pool_next; i++ )
+		if( !comm->comm_pool[ i ].busy )
+			close( comm->comm_pool[ i ].sock );
+
+	if( comm->comm_udp_sock >= 0 )
+		close( comm->comm_udp_sock );
+	if( comm->comm_epfd >= 0 )
+		close( comm->comm_epfd );
+	free( comm->comm_inpr_send );
+	free( comm->comm_inpr_recv );
+	free( comm->comm_close );
+	free( comm->comm_pool );
+	free( comm->comm_udp_buff );
+	for( i = 0 ; i < COMM_BUF_CLASSES ; i++ )
+		while( comm->comm_bufs_num[ i ] )
+			free( comm->comm_bufs[ i ][ --comm->comm_bufs_num[ i ] ] );
+	free( comm->comm_fds );
+	free( comm->comm_ready );
 	free( comm );
 	comm = NULL;
 	return 0;
@@ -387,6 +980,24 @@ comm_inprogress_recv_active( msx_comm_t *comm, fd_set *set) {
 	return 0;
 }
 
+/*
+ * Close the socket at i of the sockets waiting to be closed
+ */
+static void
+comm_close_at( msx_comm_t *comm, int i ) {
+
+	int sock = comm->comm_close[ i ].sock;
+
+	comm_del_close( comm, i );
+	if( close( sock ) < 0 )
+		debug_lb( COMM_DEBUG, "Error: close()\n" );
+	else
+		debug_lb( COMM_DEBUG, "Closed socket %d\n", sock );
+	    
+	if( comm->comm_maxfd == sock )
+		comm_calc_inprogress_maxfd( comm );
+}
+
 /****************************************************************************
  * Checking if one of the sockets waiting to be closed was signald.
  * If such one is found, close it
@@ -394,32 +1005,11 @@ comm_inprogress_recv_active( msx_comm_t *comm, fd_set *set) {
 int
 comm_close_on_socket( msx_comm_t *comm, fd_set *set ) {
 
-	int i = 0, recalc_max   = 0;
+	int i = 0;
 
 	for( i = 0; i < comm->comm_close_next; i++ ) {
 		if( FD_ISSET( comm->comm_close[ i ].sock, set )) {
-
-			if( close( comm->comm_close[ i ].sock ) < 0 )
-				debug_lb( COMM_DEBUG, "Error: close()\n" );
-			else
-				debug_lb( COMM_DEBUG, "Closed socket %d\n",
-					  comm->comm_close[ i ].sock );
-	    
-			if( comm->comm_maxfd == comm->comm_close[ i ].sock)
-				recalc_max = 1;
-		  
-			if( i != comm->comm_close_next - 1 ) {
-				comm->comm_close[ i ] = comm->
-					comm_close[ comm->comm_close_next - 1];
-				bzero( &(comm->comm_close[
-						 comm->comm_close_next - 1]),
-				       sizeof(comm_send_close_t));
-			}
-			
-			comm->comm_close_next--;
-    
-			if( recalc_max )
-				comm_calc_inprogress_maxfd( comm );
+			comm_close_at( comm, i );
 			return 1;
 		}
 	}
@@ -427,17 +1017,13 @@ comm_close_on_socket( msx_comm_t *comm, fd_set *set ) {
 }
 
 /****************************************************************************
- * Sending information to the given ip. The function tries to establish
- * connection to the other side, and tries to add the connection to the
- * in progress send
+ * Start a nonblocking connect to the given ip. Returns the socket or -1
  ***************************************************************************/
-int
-comm_send( msx_comm_t *comm,  char *ip, unsigned short port,
-	   void *buff, int type, int size, int mv2recv ) {
+static int
+comm_connect_nonblock( char *ip, unsigned short port ) {
 
 	struct sockaddr_in socketInfo;
 	int  socketfd = 0 ;
-	int  res;
     
 	/* should create the connection to another infod */ 
 	if(( socketfd = socket( PF_INET, SOCK_STREAM, 0 )) < 0 ){
@@ -458,30 +1044,606 @@ comm_send( msx_comm_t *comm,  char *ip, unsigned short port,
 		      sizeof( socketInfo ))) == -1 ){
 		if( errno != EINPROGRESS ){
 			debug_lr( COMM_DEBUG, "Error: connect()");
-			res = -1 ;
-			goto exit_with_close;
+			close( socketfd );
+			return -1;
 		}
 	}
+	return socketfd;
+}
+
+/******************************************************************************
+ * The pool of kept connections
+ *****************************************************************************/
+
+/*
+ * The pool entry of sock, -1 if it is not kept
+ */
+static int
+comm_pool_find( msx_comm_t *comm, int sock ) {
+
+	int i;
+
+	for( i = 0 ; i < comm->comm_pool_next ; i++ )
+		if( comm->comm_pool[ i ].sock == sock )
+			return i;
+	return -1;
+}
+
+/*
+ * Remove the entry at i, the last entry takes its place. The socket is
+ * not closed.
+ */
+static void
+comm_pool_del( msx_comm_t *comm, int i ) {
+
+	int last = comm->comm_pool_next - 1;
+
+	comm_unwatch_fd( comm, comm->comm_pool[ i ].sock, comm_ev_pool );
+	if( i != last ) {
+		comm->comm_pool[ i ] = comm->comm_pool[ last ];
+		comm_sock_moved( comm, comm->comm_pool[ i ].sock,
+				 comm_ev_pool, i );
+	}
+	bzero( &(comm->comm_pool[ last ]), sizeof(comm_pool_ent_t));
+	comm->comm_pool_next--;
+}
+
+/*
+ * Close the idle connection at i
+ */
+static void
+comm_pool_close_at( msx_comm_t *comm, int i ) {
+
+	int sock = comm->comm_pool[ i ].sock;
+
+	comm_pool_del( comm, i );
+	close( sock );
+	if( comm->comm_maxfd == sock )
+		comm_calc_inprogress_maxfd( comm );
+}
+
+/*
+ * Stop keeping sock, the caller closes it
+ */
+static void
+comm_pool_forget( msx_comm_t *comm, int sock ) {
+
+	int i;
+
+	if( ( i = comm_pool_find( comm, sock )) >= 0 )
+		comm_pool_del( comm, i );
+}
+
+/*
+ * Nothing should be read from an idle kept connection, unless it was closed
+ */
+static int
+comm_pool_alive( int sock ) {
+
+	char c;
+	int  res = recv( sock, &c, 1, MSG_PEEK | MSG_DONTWAIT );
+
+	return ( res < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ));
+}
+
+/*
+ * A socket to send a message to ip and port on. An idle kept connection
+ * to them is used if there is one, otherwise a new connection is made and
+ * kept if there is room, or if the least recently used idle connection can
+ * be closed for it. pooled is set to the value of the send entry field.
+ */
+static int
+comm_pool_connect( msx_comm_t *comm, char *ip, unsigned short port,
+		   int *pooled ) {
+
+	comm_pool_ent_t *ent;
+	int              i, lru = -1, sock, flag = 1;
+
+	*pooled = 0;
+	for( i = 0 ; i < comm->comm_pool_next ; i++ ) {
+		ent = &(comm->comm_pool[ i ]);
+		if( ent->port == port && !memcmp( ent->ip, ip, COMM_IP_VER )) {
+			/* Still sending on it, this message gets its own */
+			if( ent->busy )
+				return comm_connect_nonblock( ip, port );
+			/* Closed by the other side and not handled yet */
+			if( !comm_pool_alive( ent->sock )) {
+				comm_pool_close_at( comm, i );
+				break;
+			}
+			comm_unwatch_fd( comm, ent->sock, comm_ev_pool );
+			ent->busy = 1;
+			*pooled = COMM_POOL_REUSED;
+			return ent->sock;
+		}
+		if( !ent->busy &&
+		    ( lru == -1 ||
+		      timercmp( &(ent->used), &(comm->comm_pool[ lru ].used), < )))
+			lru = i;
+	}
+
+	if( ( sock = comm_connect_nonblock( ip, port )) < 0 )
+		return -1;
+	if( comm->comm_pool_next >= comm->comm_pool_max ) {
+		if( lru == -1 )
+			return sock;
+		comm_pool_close_at( comm, lru );
+	}
+
+	/* Messages are sent back to back, do not hold them back (Nagle) */
+	setsockopt( sock, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(int));
+
+	ent = &(comm->comm_pool[ comm->comm_pool_next++ ]);
+	bzero( ent, sizeof(comm_pool_ent_t));
+	ent->sock = sock;
+	ent->port = port;
+	ent->busy = 1;
+	memcpy( ent->ip, ip, COMM_IP_VER );
+	gettimeofday( &(ent->used), NULL );
+	*pooled = COMM_POOL_NEW;
+	return sock;
+}
+
+/*
+ * The send on the kept connection sock is over, wait for the next one.
+ * Meanwhile a ready socket means it was closed by the other side.
+ */
+static int
+comm_pool_release( msx_comm_t *comm, int sock ) {
+
+	int i;
+
+	if( ( i = comm_pool_find( comm, sock )) < 0 )
+		return 0;
+	if( !comm_watch_sock( comm, sock, COMM_EV_READ | COMM_EV_CLOSE,
+			      comm_ev_pool, i )) {
+		comm_pool_del( comm, i );
+		return 0;
+	}
+	comm->comm_pool[ i ].busy = 0;
+	gettimeofday( &(comm->comm_pool[ i ].used), NULL );
+	return 1;
+}
+
+/*
+ * The send at i failed on a kept connection which was idle, most likely
+ * since the other side closed it. The message is sent again from its start
+ * on a new connection.
+ */
+static int
+comm_pool_reconnect( msx_comm_t *comm, int i ) {
+
+	comm_inprogress_send_t *send_info = &(comm->comm_inpr_send[ i ]);
+	int                     p, sock;
+
+	if( ( p = comm_pool_find( comm, send_info->sock )) < 0 )
+		return 0;
+	if( ( sock = comm_connect_nonblock( send_info->ip,
+					    comm->comm_pool[ p ].port )) < 0 )
+		return 0;
+	if( !comm_watch_sock( comm, sock, COMM_EV_WRITE, comm_ev_send, i )) {
+		close( sock );
+		return 0;
+	}
+	debug_lb( COMM_DEBUG, "Kept connection %d failed, reconnecting\n",
+		  send_info->sock );
+
+	comm_unwatch_fd( comm, send_info->sock, comm_ev_send );
+	close( send_info->sock );
+	comm->comm_pool[ p ].sock = sock;
+	send_info->sock      = sock;
+	send_info->pooled    = COMM_POOL_NEW;
+	send_info->curr_size = 0;
+	timerclear( &(send_info->time) );
+	if( comm->comm_maxfd < sock )
+		comm->comm_maxfd = sock;
+	return 1;
+}
+
+/****************************************************************************
+ * Keep the connections of the sends open, see comm.h
+ ***************************************************************************/
+int
+comm_set_pool( msx_comm_t *comm, int max, int idle ) {
+
+	comm_pool_ent_t *pool = NULL;
+
+	if( comm->comm_pool_next ) {
+		debug_lr( COMM_DEBUG, "Error: connections are already kept\n" );
+		return 0;
+	}
+	if( max > 0 && !( pool = calloc( max, sizeof(comm_pool_ent_t)))) {
+		debug_lr( COMM_DEBUG, "Error: malloc, connection pool\n" );
+		return 0;
+	}
+	free( comm->comm_pool );
+	comm->comm_pool      = pool;
+	comm->comm_pool_max  = ( max > 0 ) ? max : 0;
+	comm->comm_pool_idle = idle;
+	return 1;
+}
+
+/******************************************************************************
+ * Datagrams
+ *****************************************************************************/
+
+/****************************************************************************
+ * Send small messages as datagrams, see comm.h
+ ***************************************************************************/
+int
+comm_set_udp( msx_comm_t *comm, unsigned short port, int max ) {
+
+	struct sockaddr_in socketInfo;
+	int                sock;
+
+	if( max <= 0 ) {
+		if( comm->comm_udp_sock >= 0 ) {
+			comm_unwatch_fd( comm, comm->comm_udp_sock, comm_ev_udp );
+			close( comm->comm_udp_sock );
+		}
+		free( comm->comm_udp_buff );
+		comm->comm_udp_buff = NULL;
+		comm->comm_udp_sock = -1;
+		comm->comm_udp_max  = 0;
+		return 1;
+	}
+	if( max > COMM_UDP_MAX_SIZE )
+		max = COMM_UDP_MAX_SIZE;
+	if( comm->comm_udp_sock >= 0 ) {
+		comm->comm_udp_max = max;
+		return 1;
+	}
+
+	if( ( sock = socket( PF_INET, SOCK_DGRAM, 0 )) < 0 ) {
+		debug_lr( COMM_DEBUG, "Error: udp socket()\n" );
+		return 0;
+	}
+	fcntl( sock, F_SETFL, O_NONBLOCK );
+
+	bzero( &socketInfo, sizeof(socketInfo) );
+	socketInfo.sin_family = PF_INET;
+	socketInfo.sin_port = htons( port );
+	socketInfo.sin_addr.s_addr = htonl( INADDR_ANY );
+	if( bind( sock, (struct sockaddr *)&socketInfo,
+		  sizeof(socketInfo) ) < 0 ) {
+		debug_lr( COMM_DEBUG, "Error: udp bind(). %s\n", strerror(errno));
+		close( sock );
+		return 0;
+	}
+
+	/* Datagrams from hosts with a larger max are received too */
+	if( !( comm->comm_udp_buff = malloc( COMM_UDP_MAX_SIZE )) ||
+	    !comm_watch_fd( comm, sock, COMM_EV_READ, comm_ev_udp, NULL )) {
+		debug_lr( COMM_DEBUG, "Error: setting udp socket\n" );
+		free( comm->comm_udp_buff );
+		comm->comm_udp_buff = NULL;
+		close( sock );
+		return 0;
+	}
+	comm->comm_udp_sock = sock;
+	comm->comm_udp_max  = max;
+	if( comm->comm_maxfd < sock )
+		comm->comm_maxfd = sock;
+	return 1;
+}
+
+/*
+ * Send the message as a datagram if it fits one. Returns 0 when it should
+ * be sent by tcp.
+ */
+static int
+comm_udp_send( msx_comm_t *comm, char *ip, unsigned short port, int type,
+	       struct iovec *iov, int iovcnt, int mv2recv ) {
+
+	struct iovec        vec[ COMM_MAX_IOV ];
+	struct msghdr       msg;
+	struct sockaddr_in  socketInfo;
+	comm_hdr_t          hdr;
+	int                 i, size = 0;
+
+	if( comm->comm_udp_sock < 0 || mv2recv )
+		return 0;
+
+	for( i = 0 ; i < iovcnt ; i++ )
+		size += iov[ i ].iov_len;
+	if( sizeof(comm_hdr_t) + size > comm->comm_udp_max ||
+	    iovcnt >= COMM_MAX_IOV )
+		goto exit_fallback;
+
+	comm_hdr_set( &hdr, type, size );
+	vec[ 0 ].iov_base = &hdr;
+	vec[ 0 ].iov_len  = sizeof(comm_hdr_t);
+	memcpy( vec + 1, iov, iovcnt * sizeof(struct iovec) );
+
+	bzero( &socketInfo, sizeof(socketInfo) );
+	socketInfo.sin_family = PF_INET;
+	socketInfo.sin_port = htons( port );
+	memcpy( &(socketInfo.sin_addr.s_addr), ip, COMM_IP_VER );
+
+	bzero( &msg, sizeof(msg) );
+	msg.msg_name    = &socketInfo;
+	msg.msg_namelen = sizeof(socketInfo);
+	msg.msg_iov     = vec;
+	msg.msg_iovlen  = iovcnt + 1;
+	if( sendmsg( comm->comm_udp_sock, &msg, MSG_NOSIGNAL ) < 0 ) {
+		debug_lb( COMM_DEBUG, "Error: udp send. %s\n", strerror(errno));
+		goto exit_fallback;
+	}
+	comm->comm_stats.udp_sent++;
+	return 1;
+
+ exit_fallback:
+	comm->comm_stats.udp_fallback++;
+	return 0;
+}
+
+/****************************************************************************
+ * The number of messages sent and received by each transport
+ ***************************************************************************/
+void
+comm_get_stats( msx_comm_t *comm, comm_stats_t *stats ) {
+	*stats = comm->comm_stats;
+}
+
+/*
+ * Send a buffer holding the header and the data (see comm_msg_buf) as
+ * comm_send does. comm owns the buffer from now.
+ */
+static int
+comm_send_buf( msx_comm_t *comm, char *ip, unsigned short port,
+	       char *buf, int mv2recv ) {
+
+	comm_hdr_t   *hdr = (comm_hdr_t *)buf;
+	int           socketfd = 0, pooled = 0;
+	struct iovec  vec;
     
+	vec.iov_base = buf + sizeof(comm_hdr_t);
+	vec.iov_len  = hdr->size;
+	if( comm_udp_send( comm, ip, port, hdr->type, &vec, 1, mv2recv )) {
+		comm_buf_put( comm, buf );
+		return 1;
+	}
+
+	if( !mv2recv && comm->comm_pool_max )
+		socketfd = comm_pool_connect( comm, ip, port, &pooled );
+	else
+		socketfd = comm_connect_nonblock( ip, port );
+	if( socketfd < 0 ) {
+		comm_buf_put( comm, buf );
+		return -1;
+	}
+	
 	/*
 	 * connect is in progress or connect succeeded, test if there
 	 * is enough place for the asynchronous send
 	 */
-	if( !comm_add_inprogress_send( comm, socketfd, ip, buff,
-				       type, size, mv2recv)) {
+	if( !comm_add_inprogress_send_buf( comm, socketfd, ip, buf, mv2recv )) {
+		if( pooled )
+			comm_pool_forget( comm, socketfd );
+		close( socketfd );
+		return -1;
+	}
+	comm->comm_inpr_send[ comm->comm_inpr_send_next - 1 ].pooled = pooled;
+	return 1;
+}
+
+/****************************************************************************
+ * Sending information to the given ip. The function tries to establish
+ * connection to the other side, and tries to add the connection to the
+ * in progress send
+ ***************************************************************************/
+int
+comm_send( msx_comm_t *comm,  char *ip, unsigned short port,
+	   void *buff, int type, int size, int mv2recv ) {
+
+	char *buf;
+
+	if( !( buf = comm_msg_buf( comm, buff, type, size )))
+		return -1;
+	return comm_send_buf( comm, ip, port, buf, mv2recv );
+}
+
+/****************************************************************************
+ * Sending an iovec to the given ip, as comm_send. The iovec is not copied,
+ * done is called when it is no longer used.
+ ***************************************************************************/
+int
+comm_send_iov( msx_comm_t *comm, char *ip, unsigned short port,
+	       struct iovec *iov, int iovcnt, int type, int mv2recv,
+	       comm_send_done_func_t done, void *done_arg ) {
+
+	int   socketfd = 0, pooled = 0, size;
+	char *buf;
+
+	// Once compressed the iovec is not needed anymore
+	if( ( buf = comm_compress_msg( comm, &type, iov, iovcnt, &size ))) {
+		if( done )
+			done( done_arg );
+		return comm_send_buf( comm, ip, port, buf, mv2recv );
+	}
+    
+	if( comm_udp_send( comm, ip, port, type, iov, iovcnt, mv2recv )) {
+		if( done )
+			done( done_arg );
+		return 1;
+	}
+
+	if( !mv2recv && comm->comm_pool_max )
+		socketfd = comm_pool_connect( comm, ip, port, &pooled );
+	else
+		socketfd = comm_connect_nonblock( ip, port );
+	if( socketfd < 0 )
+		goto exit_with_done;
+	
+	if( !comm_add_inprogress_send_iov( comm, socketfd, ip, iov, iovcnt,
+					   type, mv2recv, done, done_arg )) {
+		if( pooled )
+			comm_pool_forget( comm, socketfd );
+		close( socketfd );
+		goto exit_with_done;
+	}
+	comm->comm_inpr_send[ comm->comm_inpr_send_next - 1 ].pooled = pooled;
+	return 1;
+
+ exit_with_done:
+	if( done )
+		done( done_arg );
+	return -1;
+}
+
+/*
+ * Send the rest of an iovec message, starting from curr_size. The header
+ * goes first. Returns as send().
+ */
+static int
+comm_send_iov_pending( comm_inprogress_send_t *send_info ) {
+
+	struct iovec   vec[ COMM_MAX_IOV ];
+	struct msghdr  msg;
+	size_t         skip = send_info->curr_size;
+	int            i, n = 0;
+
+	if( skip < sizeof(comm_hdr_t) ) {
+		vec[ n ].iov_base = (char *)&(send_info->hdr) + skip;
+		vec[ n ].iov_len  = sizeof(comm_hdr_t) - skip;
+		n++;
+		skip = 0;
+	}
+	else
+		skip -= sizeof(comm_hdr_t);
+
+	for( i = 0 ; i < send_info->iovcnt && n < COMM_MAX_IOV ; i++ ) {
+		if( skip >= send_info->iov[ i ].iov_len ) {
+			skip -= send_info->iov[ i ].iov_len;
+			continue;
+		}
+		vec[ n ].iov_base = (char *)send_info->iov[ i ].iov_base + skip;
+		vec[ n ].iov_len  = send_info->iov[ i ].iov_len - skip;
+		n++;
+		skip = 0;
+	}
+
+	bzero( &msg, sizeof(msg) );
+	msg.msg_iov    = vec;
+	msg.msg_iovlen = n;
+	return sendmsg( send_info->sock, &msg, MSG_NOSIGNAL );
+}
+
+/*
+ * Finishing the send at i of the inprogress sends, as comm_finish_send
+ */
+static int
+comm_finish_send_at( msx_comm_t *comm, int i, char *ip ) {
+
+	comm_inprogress_send_t *send_info = &(comm->comm_inpr_send[ i ]);
+	int res = 0;
+	int res_sz = sizeof(int);
+	int so_error_val = 0;
+	int close_socket = 0; 
+	int sock = send_info->sock;
+
+	/* We need the ip in any case (failure or success) */ 
+	memcpy( ip, send_info->ip, COMM_IP_VER);
+
+	/* test that the connect succeeded */ 
+	if( !send_info->curr_size ){
+		if( getsockopt( sock, SOL_SOCKET, SO_ERROR,
+				&so_error_val, &res_sz ) == -1) {
+			debug_lr( COMM_DEBUG, "Error: getsockopt\n");
+			so_error_val = 1;
+			res = -1;
+		}
+	}
+
+	/* The connect operation failed */
+	if( so_error_val != 0 ) {
+		debug_lr( COMM_DEBUG, "Error: Connect. %s\n",
+			  strerror( so_error_val ));
+		send_info->mv2recv = 0;
 		res = -1;
-		goto exit_with_close;
+		goto bad_send;
+	}
+
+	/* The connection has been succefully established */ 
+
+	/* initiate the timeout count */
+	gettimeofday( &(send_info->time), NULL);
+		
+	if( send_info->iov )
+		res = comm_send_iov_pending( send_info );
+	else
+		res = send( sock, send_info->data + send_info->curr_size,
+			    send_info->data_size - send_info->curr_size,
+			    MSG_NOSIGNAL );
+
+	/* The send operation failed */ 
+	if( res == -1 ){
+		if((errno != EAGAIN) && (errno != EWOULDBLOCK)){
+			debug_lr( COMM_DEBUG, "Error: send. %s\n",
+				  strerror(errno));
+			send_info->mv2recv = 0;
+			goto bad_send ; 
+		}
+		/* Not ready after all, try again later */
+		return 0;
+	}
+	else if( res == 0 ) {
+		debug_lr( COMM_DEBUG, "Error: send=0\n" );
+		send_info->mv2recv = 0;
+		res = -1;
+		goto bad_send;
+	}
+			
+	/* The send operation succeeded, set num bytes already sent */ 
+	send_info->curr_size += res;
+	res = 0;
+	if( send_info->curr_size == send_info->data_size )
+		close_socket = 1;
+	else
+		gettimeofday( &(send_info->time), NULL); 
+
+	/* close the socket (error or finished send */ 
+	if( !close_socket )
+		return res;
+
+	/* done only if the sending succeeded */ 
+	res = 1;
+		
+ bad_send:
+	/* The other side may have closed a kept connection meanwhile */
+	if( res == -1 && send_info->pooled == COMM_POOL_REUSED &&
+	    comm_pool_reconnect( comm, i ))
+		return 0;
+	
+	comm_release_send( comm, send_info );
+	
+	/* The send operation was successful */
+	if( res == 1 ) {
+		comm->comm_stats.tcp_sent++;
+		/* maybe we have to move to receive */
+		if( send_info->mv2recv ){
+			if( !(comm_add_inprogress_recv( comm, sock, ip ))){
+				/* add to 'closed' */
+				comm_add_close( comm, sock );
+				res = -2;
+			}
+		}
+		/* keep it for the next message */
+		else if( !send_info->pooled ||
+			 !comm_pool_release( comm, sock )) {
+			/* add to 'closed' sockets */
+			comm_add_close( comm, sock );
+		}
+		comm_del_send( comm, i );
 	}
-      
-	else{ 
-		res = 1;
-		goto exit_without_close;
+	else {
+		if( send_info->pooled )
+			comm_pool_forget( comm, sock );
+		comm_del_send( comm, i );
+		close( sock );
+		if( comm->comm_maxfd == sock )
+			comm_calc_inprogress_maxfd( comm );
 	}
-    
- exit_with_close:
-	close( socketfd );
-	
- exit_without_close:
 	return res;
 }
 
@@ -496,170 +1658,12 @@ int
 comm_finish_send( msx_comm_t *comm, fd_set *connected_set, char *ip ) {
 
 	int i;
-	int res = 0;
-	int next = comm->comm_inpr_send_next;
 
 	/* run over all the sockets that we try to send info on */ 
-	for( i = 0; i < next; i++ ) {
-
-		/* Find the one that is ready */ 
-		if( FD_ISSET( comm->comm_inpr_send[ i ].sock, connected_set )){
-
-			int res_sz = sizeof(int);
-			int so_error_val = 0;
-			int recalc_max   = 0;
-			int close_socket = 0; 
-
-			/* We need the ip in any case (failure or success) */ 
-			memcpy( ip, comm->comm_inpr_send[ i ].ip, COMM_IP_VER);
-
-			/* test that the connect succeeded */ 
-			if( !comm->comm_inpr_send[ i ].curr_size ){
-				if( getsockopt(comm->comm_inpr_send[ i ].sock,
-					      SOL_SOCKET, SO_ERROR,
-					      &so_error_val, &res_sz ) == -1) {
-					debug_lr( COMM_DEBUG,
-						  "Error: getsockopt\n");
-					so_error_val = 1;
-					res = -1;
-				}
-			}
-
-			/* The connection has been succefully established */ 
-			if( so_error_val == 0 ) {
-
-				/* the number of bytes to send */ 
-				int send_size =
-					comm->comm_inpr_send[ i ].data_size -
-					comm->comm_inpr_send[ i ].curr_size;
-		  
-				/* the start position of the data to be send */
-				char *tmp = (comm->comm_inpr_send[ i ].data) +
-					comm->comm_inpr_send[ i ].curr_size;
-		
-				/* initiate the timeout count */
-				gettimeofday( &(comm->comm_inpr_send[i].time),
-					      NULL);
-		
-				res = send( comm->comm_inpr_send[ i ].sock,
-					    tmp, send_size, MSG_NOSIGNAL );
-
-				/* The send operation failed */ 
-				if( res == -1 ){
-					if((errno != EAGAIN) &&
-					   (errno != EWOULDBLOCK)){
-						debug_lr( COMM_DEBUG,
-							  "Error: send. %s\n",
-							  strerror(errno));
-						res = -1;
-						comm->comm_inpr_send[i].mv2recv
-							= 0;
-						goto bad_send ; 
-					}
-				}
-		
-				else if( res == 0 ) {
-					debug_lr( COMM_DEBUG,
-						  "Error: send=0\n" );
-					comm->comm_inpr_send[ i ].mv2recv = 0;
-					res = -1;
-					goto bad_send;
-			      
-				}
-			
-				/* The send operation succeeded */ 
-				else{
-					/* set num bytes already sent */ 
-					comm->comm_inpr_send[ i ].curr_size +=
-						res;
-		    
-					if( comm->comm_inpr_send[i].curr_size
-					    ==
-					    comm->comm_inpr_send[i].data_size){
-						close_socket = 1;
-					}
-		    
-					else
-						gettimeofday(
-							&(comm->
-							  comm_inpr_send[i].
-							  time), NULL); 
-					res = 0;
-				}
-			}
-
-			/* The connect operation failed */
-			else {
-				debug_lr( COMM_DEBUG, "Error: Connect. %s\n",
-					  strerror( so_error_val ));
-				comm->comm_inpr_send[ i ].mv2recv = 0;
-				res = -1;
-				goto bad_send;
-			}
-
-			/* close the socket (error or finished send */ 
-			if( close_socket ) {
-				/* done only if the sending succeeded */ 
-				res = 1;
-			
-			bad_send:
-				if( comm->comm_inpr_send[ i ].data ) {
-					free( comm->comm_inpr_send[ i ].data );
-					comm->comm_inpr_send[i].data = NULL;
-				}
-		
-				/* The send operation was successful */
-				if( res == 1 ) {
-
-					/* maybe we have to move to receive */
-					if( comm->comm_inpr_send[i].mv2recv ){
-						if( !(comm_add_inprogress_recv(
-							      comm,
-							      comm->comm_inpr_send[i].sock,
-							      ip ))){
-
-                                                        close(comm->comm_inpr_send[i].sock);
-							/* add to 'closed' */
-							comm_add_close( comm,
-									comm->comm_inpr_send[i].sock);
-							res = -2;
-						}
-					}
-					else {
-						/* add to 'closed' sockets */
-						comm_add_close( comm,
-								comm->comm_inpr_send[i].sock);
-					}
-				}
-		
-				else {
-					close( comm->comm_inpr_send[ i ].sock);
-					if( comm->comm_maxfd ==
-					    comm->comm_inpr_send[ i ].sock)
-						recalc_max = 1;
-				}
-		
-				/*
-				 * Fixing the set, we do that simply by
-				 * moving the last sock to the current
-				 * position. The order is not maintained
-				 * but the operation is more efficient
-				 */
-				if( i != ( next - 1 )) {
-					comm->comm_inpr_send[ i ] =
-						comm->comm_inpr_send[next-1];
-					bzero( &(comm->comm_inpr_send[next-1]),
-					       sizeof(comm_inprogress_send_t));
-				}
-				comm->comm_inpr_send_next--;
-			
-				if( recalc_max )
-					comm_calc_inprogress_maxfd( comm );
-			}
-			break;
-		}
-	}
-	return res;
+	for( i = 0; i < comm->comm_inpr_send_next; i++ )
+		if( FD_ISSET( comm->comm_inpr_send[ i ].sock, connected_set ))
+			return comm_finish_send_at( comm, i, ip );
+	return 0;
 }
 
 /****************************************************************************
@@ -683,29 +1687,53 @@ comm_send_on_socket( msx_comm_t *comm, int sock,
 }
 
 /****************************************************************************
- * Establish the communication channel and set the socket to
- * non blocking
+ *  Send an iovec on an already open socket
  ***************************************************************************/
 int
-comm_setup_connection( msx_comm_t *comm, fd_set *fds, char *ip ) {
+comm_send_iov_on_socket( msx_comm_t *comm, int sock,
+			 struct iovec *iov, int iovcnt, int type, int mv2recv,
+			 comm_send_done_func_t done, void *done_arg ){
+
+	struct sockaddr_in info;
+	socklen_t len = sizeof( struct sockaddr_in );
+	char *buf;
+	int   size;
+
+	if( getpeername( sock, (struct sockaddr*)&info, &len ) < 0 ){
+		debug_lr( COMM_DEBUG, "Error: getting peer ip\n" );
+		goto exit_with_done;
+	}
+
+	if( ( buf = comm_compress_msg( comm, &type, iov, iovcnt, &size ))) {
+		if( done )
+			done( done_arg );
+		return comm_add_inprogress_send_buf( comm, sock,
+						     (char*)&(info.sin_addr.s_addr),
+						     buf, mv2recv );
+	}
+      
+	if( comm_add_inprogress_send_iov( comm, sock,
+					  (char*)&(info.sin_addr.s_addr),
+					  iov, iovcnt, type, mv2recv,
+					  done, done_arg ))
+		return 1;
+
+ exit_with_done:
+	if( done )
+		done( done_arg );
+	return 0;
+}
+
+/*
+ * Accept a connection on the listening socket at i
+ */
+static int
+comm_accept_at( msx_comm_t *comm, int i, char *ip ) {
 
 	int sockfd;
-	int i;
 	struct sockaddr_in socketInfo; 
 	int length =  sizeof( struct sockaddr_in ) ;
 
-	/*
-	 * The accept should succeed since we should enter this function when
-	 * there is a new connection. Test which of the listenning
-	 * sockets is ready.
-	 */
-	for( i = 0; i < COMM_MAX_LISTEN; i++ )
-		if( FD_ISSET( comm->comm_sock[ i ], fds ))
-			break;
-
-	if( i == COMM_MAX_LISTEN )
-		return -1;
-  
 	if( ( sockfd = accept( comm->comm_sock[ i ],
 			       (struct sockaddr*)&socketInfo,
 			       &length )) == -1 ){
@@ -731,29 +1759,38 @@ comm_setup_connection( msx_comm_t *comm, fd_set *fds, char *ip ) {
 }
 
 /****************************************************************************
- *  Receive a message. 
+ * Establish the communication channel and set the socket to
+ * non blocking
  ***************************************************************************/
 int
-comm_recv( msx_comm_t *comm, fd_set *fds, comm_inprogress_recv_t *recv_info ) {
+comm_setup_connection( msx_comm_t *comm, fd_set *fds, char *ip ) {
+
+	int i;
+
+	/*
+	 * The accept should succeed since we should enter this function when
+	 * there is a new connection. Test which of the listenning
+	 * sockets is ready.
+	 */
+	for( i = 0; i < COMM_MAX_LISTEN; i++ )
+		if( comm->comm_sock[ i ] >= 0 &&
+		    FD_ISSET( comm->comm_sock[ i ], fds ))
+			return comm_accept_at( comm, i, ip );
+	return -1;
+}
+
+/*
+ * Receive on the socket at i of the inprogress receives, as comm_recv
+ */
+static int
+comm_recv_at( msx_comm_t *comm, int i, comm_inprogress_recv_t *recv_info ) {
 
 	int res =  -1;
-	int i = 0, recv_size = 0, num_read = 0, recv_fin = 0;
-	int next = comm->comm_inpr_recv_next;
-	int recalc_max = 0;
+	int recv_size = 0, num_read = 0, recv_fin = 0;
+	int sock = comm->comm_inpr_recv[ i ].sock;
 	char *tmp = NULL;
 	comm_inprogress_recv_t *tmp_recv;
 	
-	/* find the socket on which data is ready */ 
-	for( i = 0; i < comm->comm_inpr_recv_next; i++ )
-		if( FD_ISSET( comm->comm_inpr_recv[ i ].sock, fds ))
-			break ;
-
-	/* again - sanity check */ 
-	if( i == comm->comm_inpr_recv_next ){
-		debug_lr( COMM_DEBUG, "Error: no socket ready for receive\n");
-		return -1;
-	}
-
 	tmp_recv = &(comm->comm_inpr_recv[ i ]);
 
 	/* first test if the header was received and if not get it */
@@ -762,11 +1799,30 @@ comm_recv( msx_comm_t *comm, fd_set *fds, comm_inprogress_recv_t *recv_info ) {
 		comm_hdr_t hdr ;
 		int num2read = sizeof( comm_hdr_t ) ;
 		int num_read = 0;
+
+		/*
+		 * On a kept connection the header of the next message may
+		 * come in parts, wait until all of it is there. The other
+		 * side closing it between messages is not an error.
+		 */
+		if( tmp_recv->keep ) {
+			res = recv( sock, &hdr, num2read, MSG_PEEK );
+			if( res == 0 ) {
+				debug_lb( COMM_DEBUG, "Kept connection %d "
+					  "closed\n", sock );
+				res = -1;
+				goto exit_with_close;
+			}
+			if( res > 0 && res < num2read ) {
+				res = 0;
+				goto exit_no_op;
+			}
+		}
 	  
 		/* read the header to a temporary buffer */
 		while( num2read ){
 			if(( res=recv( comm->comm_inpr_recv[i].sock,
-				       (&hdr) + num_read, num2read,
+				       (char *)&hdr + num_read, num2read,
 				       MSG_NOSIGNAL )) != num2read ) {
 
 				if( (res == 0) ||
@@ -796,7 +1852,7 @@ comm_recv( msx_comm_t *comm, fd_set *fds, comm_inprogress_recv_t *recv_info ) {
 	  
 		/* allocate the memory area for the data */
 		if( !( comm->comm_inpr_recv[ i ].data =
-		       malloc(comm->comm_inpr_recv[ i ].hdr.size ))) {
+		       comm_buf_get( comm, comm->comm_inpr_recv[ i ].hdr.size ))) {
 			debug_lb( COMM_DEBUG, "Error: malloc, comm_recv\n");
 			res = -1;
 			goto exit_with_close; 
@@ -848,42 +1904,78 @@ comm_recv( msx_comm_t *comm, fd_set *fds, comm_inprogress_recv_t *recv_info ) {
         }
 	
 	if( recv_fin )  {
+		if( tmp_recv->hdr.type & COMM_HDR_COMPRESSED ) {
+			if( !( tmp = comm_uncompress_msg( comm, &(tmp_recv->hdr),
+							  tmp_recv->data ))) {
+				res = -1;
+				goto exit_with_free;
+			}
+			comm_buf_put( comm, tmp_recv->data );
+			tmp_recv->data = tmp;
+		}
+
 		/* copying the relevant fields to recv_info */
 		*recv_info = *tmp_recv ;
 		bzero( &(recv_info->time), sizeof(struct timeval));
 		recv_info->curr_size = 0 ;
+		comm->comm_stats.tcp_recvd++;
 	
 		goto delete_connection;
 	}
 
  exit_with_free:
 	if(comm->comm_inpr_recv[ i ].data){
-		free(comm->comm_inpr_recv[ i ].data);
+		comm_buf_put( comm, comm->comm_inpr_recv[ i ].data );
 		comm->comm_inpr_recv[ i ].data = NULL;
 	}
     
  exit_with_close:
-	close( comm->comm_inpr_recv[ i ].sock );
+	comm_del_recv( comm, i );
+	close( sock );
+	if( comm->comm_maxfd == sock )
+		comm_calc_inprogress_maxfd( comm );
+	return res;
     
  delete_connection:
-	/* Deleting the connection */
-	if( comm->comm_maxfd == tmp_recv->sock )
-		recalc_max = 1;
-    
-	if(i != next-1) {
-		comm->comm_inpr_recv[ i ] = comm->comm_inpr_recv[ next - 1 ];
-		bzero( &(comm->comm_inpr_recv[ next - 1]),
-		       sizeof(comm_inprogress_recv_t));
-	}
-	comm->comm_inpr_recv_next--;
-    
-	if( recalc_max )
+	/* Deleting the connection, the socket now belongs to the caller */
+	comm_del_recv( comm, i );
+	if( comm->comm_maxfd == sock )
 		comm_calc_inprogress_maxfd( comm );
     
  exit_no_op:
 	return res;
 }
 
+/****************************************************************************
+ *  Receive a message. 
+ ***************************************************************************/
+int
+comm_recv( msx_comm_t *comm, fd_set *fds, comm_inprogress_recv_t *recv_info ) {
+
+	int i;
+	
+	/* find the socket on which data is ready */ 
+	for( i = 0; i < comm->comm_inpr_recv_next; i++ )
+		if( FD_ISSET( comm->comm_inpr_recv[ i ].sock, fds ))
+			return comm_recv_at( comm, i, recv_info );
+
+	/* again - sanity check */ 
+	debug_lr( COMM_DEBUG, "Error: no socket ready for receive\n");
+	return -1;
+}
+
+/****************************************************************************
+ *  Keep receiving messages on a socket given by comm_recv
+ ***************************************************************************/
+int
+comm_recv_next( msx_comm_t *comm, int sock, char *ip ) {
+
+	if( !comm_add_inprogress_recv( comm, sock, ip ))
+		return 0;
+	comm->comm_inpr_recv[ comm->comm_inpr_recv_next - 1 ].keep = 1;
+	return 1;
+}
+
 /****************************************************************************
  * Administration: close all the inactive sockets and free the
  * relevant resources.
@@ -895,11 +1987,9 @@ comm_admin( msx_comm_t *comm, int tflg ) {
 	int i = 0, recalc_max = 0;
 
 	/* Test that it is already the time for the next admin operation */
-	if( tflg ) {
-		gettimeofday( &time, NULL );
-		if( timercmp( &time, &(comm->next_admin), < ))
-			return;
-	}
+	gettimeofday( &time, NULL );
+	if( tflg && timercmp( &time, &(comm->next_admin), < ))
+		return;
 
 	debug_lb( COMM_DEBUG, "Admin\n" );
 	
@@ -910,19 +2000,16 @@ comm_admin( msx_comm_t *comm, int tflg ) {
 		     comm->comm_timeout )) ||
 		    ( fcntl( comm->comm_inpr_send[ i ].sock, F_GETFL) < 0 )){
 			
+			if( comm->comm_inpr_send[ i ].pooled )
+				comm_pool_forget( comm,
+						  comm->comm_inpr_send[ i ].sock );
 			close( comm->comm_inpr_send[ i ].sock );
-			if( comm->comm_inpr_send[ i ].data ) {
-				free( comm->comm_inpr_send[ i ].data );
-				comm->comm_inpr_send[ i ].data = NULL;
-			}
+			comm_release_send( comm, &(comm->comm_inpr_send[ i ]) );
 		  
 			if(comm->comm_maxfd == comm->comm_inpr_send[i].sock)
 				recalc_max = 1;
 	    
-			if(i != comm->comm_inpr_send_next - 1 )
-				comm->comm_inpr_send[ i ] =
-					comm->comm_inpr_send[ comm->comm_inpr_send_next-1];
-			comm->comm_inpr_send_next--;
+			comm_del_send( comm, i );
 		}
 		else
 			i++;
@@ -930,8 +2017,18 @@ comm_admin( msx_comm_t *comm, int tflg ) {
     
 	i = 0;
 	while( i < comm->comm_inpr_recv_next ) {
+		int timeout = comm->comm_timeout;
+
+		/*
+		 * A kept connection waiting for the next message. Longer than
+		 * the sender keeps it, so it is not closed under a send.
+		 */
+		if( comm->comm_inpr_recv[ i ].keep &&
+		    !comm->comm_inpr_recv[ i ].hdr.type )
+			timeout = 2 * comm->comm_pool_idle;
+		
 		if((( time.tv_sec - comm->comm_inpr_recv[ i ].time.tv_sec ) >=
-		    comm->comm_timeout) ||
+		    timeout) ||
 		    ( fcntl( comm->comm_inpr_recv[ i ].sock, F_GETFL ) < 0 )){
 			
 			if ( close(comm->comm_inpr_recv[ i ].sock) < 0 )
@@ -940,17 +2037,14 @@ comm_admin( msx_comm_t *comm, int tflg ) {
 				debug_lb( COMM_DEBUG, "Closed socket %d\n",
 					  comm->comm_inpr_recv[ i ].sock  );
 			if( comm->comm_inpr_recv[ i ].data ) {
-				free(comm->comm_inpr_recv[ i ].data);
+				comm_buf_put( comm, comm->comm_inpr_recv[ i ].data );
 				comm->comm_inpr_recv[ i ].data = NULL;
 			}
 		  
 			if(comm->comm_maxfd == comm->comm_inpr_recv[ i ].sock)
 				recalc_max = 1;
 		  
-			if( i != comm->comm_inpr_recv_next - 1 )
-				comm->comm_inpr_recv[ i ] =
-					comm->comm_inpr_recv[comm->comm_inpr_recv_next-1];
-			comm->comm_inpr_recv_next--;
+			comm_del_recv( comm, i );
 		}
 		else
 			i++;
@@ -977,10 +2071,21 @@ comm_admin( msx_comm_t *comm, int tflg ) {
 			if( comm->comm_maxfd == comm->comm_close[ i ].sock )
 				recalc_max = 1;
 		  
-			if( i != comm->comm_close_next - 1 )
-				comm->comm_close[ i ] =
-					comm->comm_close[comm->comm_close_next-1];
-			comm->comm_close_next--;
+			comm_del_close( comm, i );
+		}
+		else
+			i++;
+	}
+	
+	/* Idle kept connections */
+	i = 0;
+	while( i < comm->comm_pool_next ) {
+		if( !comm->comm_pool[ i ].busy &&
+		    ( time.tv_sec - comm->comm_pool[ i ].used.tv_sec ) >=
+		    comm->comm_pool_idle ) {
+			debug_lb( COMM_DEBUG, "Closing idle kept connection %d\n",
+				  comm->comm_pool[ i ].sock );
+			comm_pool_close_at( comm, i );
 		}
 		else
 			i++;
@@ -1052,6 +2157,250 @@ comm_get_max_sock(msx_comm_t *comm) {
 	return comm->comm_maxfd;
 }
 
+/***************************************************************************
+ * Return the backend used for waiting (select when epoll failed)
+ ***************************************************************************/
+int
+comm_get_backend( msx_comm_t *comm ) {
+	return comm->comm_backend;
+}
+
+/****************************************************************************
+ * Set the functions told about the sends and receives done by
+ * comm_dispatch
+ ***************************************************************************/
+void
+comm_set_handlers( msx_comm_t *comm, comm_sent_func_t sent,
+		   comm_recvd_func_t recvd, void *arg ) {
+	comm->comm_sent_func  = sent;
+	comm->comm_recvd_func = recvd;
+	comm->comm_func_arg   = arg;
+}
+
+/******************************************************************************
+ * The functions handling the sockets of comm when they are ready. The
+ * place of the socket in its table is kept in the fd table.
+ *****************************************************************************/
+static void
+comm_ev_listen( msx_comm_t *comm, int fd, int events, void *arg ) {
+
+	char ip[ COMM_IP_VER ];
+
+	if( comm_accept_at( comm, comm->comm_fds[ fd ].pos, ip ) == -1 )
+		debug_lr( COMM_DEBUG, "Error: setting new connection\n" );
+}
+
+static void
+comm_ev_send( msx_comm_t *comm, int fd, int events, void *arg ) {
+
+	char ip[ COMM_IP_VER ];
+	int  res;
+
+	bzero( ip, COMM_IP_VER );
+	res = comm_finish_send_at( comm, comm->comm_fds[ fd ].pos, ip );
+	if( comm->comm_sent_func )
+		comm->comm_sent_func( comm, res, ip, comm->comm_func_arg );
+}
+
+static void
+comm_ev_recv( msx_comm_t *comm, int fd, int events, void *arg ) {
+
+	comm_inprogress_recv_t msg;
+
+	bzero( &msg, sizeof(comm_inprogress_recv_t) );
+	if( comm_recv_at( comm, comm->comm_fds[ fd ].pos, &msg ) != 1 )
+		return;
+	if( comm->comm_recvd_func )
+		comm->comm_recvd_func( comm, &msg, comm->comm_func_arg );
+	else {
+		comm_buf_put( comm, msg.data );
+		close( msg.sock );
+	}
+}
+
+static void
+comm_ev_close( msx_comm_t *comm, int fd, int events, void *arg ) {
+	comm_close_at( comm, comm->comm_fds[ fd ].pos );
+}
+
+/* Read the waiting datagrams, each is a whole message */
+static void
+comm_ev_udp( msx_comm_t *comm, int fd, int events, void *arg ) {
+
+	comm_inprogress_recv_t  msg;
+	struct sockaddr_in      socketInfo;
+	socklen_t               len;
+	comm_hdr_t             *hdr = (comm_hdr_t *)comm->comm_udp_buff;
+	int                     i, size;
+
+	for( i = 0 ; i < COMM_MAX_EVENTS ; i++ ) {
+		len = sizeof(socketInfo);
+		if( ( size = recvfrom( fd, comm->comm_udp_buff,
+				       COMM_UDP_MAX_SIZE, MSG_TRUNC,
+				       (struct sockaddr *)&socketInfo,
+				       &len )) < 0 )
+			return;
+		if( size < (int)sizeof(comm_hdr_t) || size > COMM_UDP_MAX_SIZE ||
+		    hdr->size <= 0 || hdr->size != size - sizeof(comm_hdr_t)) {
+			debug_lr( COMM_DEBUG, "Error: bad datagram of %d\n", size );
+			comm->comm_stats.udp_bad++;
+			continue;
+		}
+
+		bzero( &msg, sizeof(comm_inprogress_recv_t) );
+		msg.sock = -1;
+		msg.hdr  = *hdr;
+		memcpy( msg.ip, &(socketInfo.sin_addr.s_addr), COMM_IP_VER );
+		if( hdr->type & COMM_HDR_COMPRESSED )
+			msg.data = comm_uncompress_msg( comm, &(msg.hdr),
+				      comm->comm_udp_buff + sizeof(comm_hdr_t) );
+		else if(( msg.data = comm_buf_get( comm, hdr->size )))
+			memcpy( msg.data, comm->comm_udp_buff + sizeof(comm_hdr_t),
+				hdr->size );
+		if( !msg.data ) {
+			debug_lr( COMM_DEBUG, "Error: reading datagram\n" );
+			comm->comm_stats.udp_bad++;
+			continue;
+		}
+		comm->comm_stats.udp_recvd++;
+		if( comm->comm_recvd_func )
+			comm->comm_recvd_func( comm, &msg, comm->comm_func_arg );
+		else
+			comm_buf_put( comm, msg.data );
+	}
+}
+
+/* Nothing is expected on an idle kept connection, it was closed */
+static void
+comm_ev_pool( msx_comm_t *comm, int fd, int events, void *arg ) {
+	debug_lb( COMM_DEBUG, "Kept connection %d closed\n", fd );
+	comm_pool_close_at( comm, comm->comm_fds[ fd ].pos );
+}
+
+/*
+ * Wait with epoll, only the ready fds are returned
+ */
+static int
+comm_wait_epoll( msx_comm_t *comm, int timeout_ms ) {
+
+	struct epoll_event  ev[ COMM_MAX_EVENTS ];
+	int                 i, n;
+
+	if( ( n = epoll_wait( comm->comm_epfd, ev, COMM_MAX_EVENTS,
+			      timeout_ms )) <= 0 )
+		return n;
+	for( i = 0 ; i < n ; i++ ) {
+		comm->comm_ready[ i ].fd     = (int)( ev[ i ].data.u64 & 0xffffffff );
+		comm->comm_ready[ i ].gen    = (unsigned int)( ev[ i ].data.u64 >> 32 );
+		comm->comm_ready[ i ].events = comm_epoll2ev( ev[ i ].events );
+	}
+	comm->comm_num_ready = n;
+	return n;
+}
+
+/*
+ * Wait with select, the sets are built from the fd table
+ */
+static int
+comm_wait_select( msx_comm_t *comm, int timeout_ms ) {
+
+	fd_set          rfds, wfds, efds;
+	struct timeval  timeout;
+	int             fd, n, maxfd = -1;
+
+	FD_ZERO( &rfds );
+	FD_ZERO( &wfds );
+	FD_ZERO( &efds );
+	for( fd = 0 ; fd < comm->comm_fds_size ; fd++ ) {
+		comm_fd_ent_t *ent = &(comm->comm_fds[ fd ]);
+
+		if( !ent->func )
+			continue;
+		if( ent->events & COMM_EV_READ )
+			FD_SET( fd, &rfds );
+		if( ent->events & COMM_EV_WRITE )
+			FD_SET( fd, &wfds );
+		if( ent->events & COMM_EV_CLOSE )
+			FD_SET( fd, &efds );
+		maxfd = fd;
+	}
+
+	timeout.tv_sec  = timeout_ms / 1000;
+	timeout.tv_usec = ( timeout_ms % 1000 ) * 1000;
+	if( ( n = select( maxfd + 1, &rfds, &wfds, &efds,
+			  timeout_ms < 0 ? NULL : &timeout )) <= 0 )
+		return n;
+
+	n = 0;
+	for( fd = 0 ; fd <= maxfd && n < COMM_MAX_EVENTS ; fd++ ) {
+		int events = 0;
+
+		if( FD_ISSET( fd, &rfds ))
+			events |= COMM_EV_READ;
+		if( FD_ISSET( fd, &wfds ))
+			events |= COMM_EV_WRITE;
+		if( FD_ISSET( fd, &efds ))
+			events |= COMM_EV_CLOSE;
+		if( !events )
+			continue;
+		comm->comm_ready[ n ].fd     = fd;
+		comm->comm_ready[ n ].gen    = comm->comm_fds[ fd ].gen;
+		comm->comm_ready[ n ].events = events;
+		n++;
+	}
+	comm->comm_num_ready = n;
+	return n;
+}
+
+/****************************************************************************
+ * Wait up to timeout_ms for the watched fds to be ready
+ ***************************************************************************/
+int
+comm_wait( msx_comm_t *comm, int timeout_ms ) {
+
+	comm->comm_num_ready = 0;
+	if( comm->comm_backend == COMM_BACKEND_EPOLL )
+		return comm_wait_epoll( comm, timeout_ms );
+	return comm_wait_select( comm, timeout_ms );
+}
+
+/****************************************************************************
+ * Call the functions of the fds found ready by comm_wait. An fd closed
+ * by an earlier function is skipped, also when its number was reused.
+ ***************************************************************************/
+int
+comm_dispatch( msx_comm_t *comm ) {
+
+	int i, num = comm->comm_num_ready;
+
+	comm->comm_num_ready = 0;
+	for( i = 0 ; i < num ; i++ ) {
+		comm_ready_t  *ready = &(comm->comm_ready[ i ]);
+		comm_fd_ent_t *ent;
+
+		if( ready->fd >= comm->comm_fds_size )
+			continue;
+		ent = &(comm->comm_fds[ ready->fd ]);
+		if( !ent->func || ent->gen != ready->gen )
+			continue;
+		ent->func( comm, ready->fd, ready->events, ent->arg );
+	}
+	return num;
+}
+
+/****************************************************************************
+ * Wait and handle the ready fds
+ ***************************************************************************/
+int
+comm_poll( msx_comm_t *comm, int timeout_ms ) {
+
+	int res;
+
+	if( ( res = comm_wait( comm, timeout_ms )) > 0 )
+		comm_dispatch( comm );
+	return res;
+}
+
 /****************************************************************************
  * Read the header from the socket
  ***************************************************************************/
@@ -1198,33 +2547,102 @@ comm_connect_client( char* rserver, unsigned short portnum ){
 /****************************************************************************
  * Printing the status of the comm object to a string
  ***************************************************************************/
+/*
+ * Append to the status at *ptr, never past end. The status stays
+ * terminated, a line that does not fit is cut.
+ */
+static void
+comm_status_add( char **ptr, char *end, const char *fmt, ... ) {
+
+	va_list ap;
+	int     n;
+
+	if( *ptr >= end )
+		return;
+	va_start( ap, fmt );
+	n = vsnprintf( *ptr, end - *ptr, fmt, ap );
+	va_end( ap );
+	if( n < 0 )
+		return;
+	*ptr += ( n < end - *ptr ) ? n : end - *ptr - 1;
+}
+
+/* Room kept after the socket lists for the lines that follow them */
+#define COMM_STATUS_RESERVE    (320)
+
+/*
+ * Append the i'th of n sockets of a list, or how many are left once there
+ * is no more room for them. Returns 0 when the list was cut.
+ */
+static int
+comm_status_sock( char **ptr, char *end, int i, int n, int sock,
+		  const char *mark ) {
+
+	if( end - *ptr < COMM_STATUS_RESERVE ) {
+		comm_status_add( ptr, end, " ... %d more", n - i );
+		return 0;
+	}
+	comm_status_add( ptr, end, " %d%s", sock, mark );
+	return 1;
+}
+
 void comm_print_status(msx_comm_t *comm, char *buff, int size)
 {
         int i;
-        char b[512];
         char *ptr = buff;
+        char *end = buff + size;
 
-        ptr += sprintf(ptr, "COMM STATUS: send %d recv %d close %d  max %d\n",
-                       comm->comm_inpr_send_next, comm->comm_inpr_recv_next,
-                       comm->comm_close_next, comm->comm_maxfd);
-        ptr += sprintf(ptr, "Listen: ");
+        if( size <= 0 )
+                return;
+        *ptr = '\0';
+
+        comm_status_add(&ptr, end, "COMM STATUS: send %d recv %d close %d  max %d\n",
+                        comm->comm_inpr_send_next, comm->comm_inpr_recv_next,
+                        comm->comm_close_next, comm->comm_maxfd);
+        comm_status_add(&ptr, end, "Listen: ");
         // Listening sockets
         for( i = 0; i < COMM_MAX_LISTEN; i++ )
-                ptr+= sprintf(ptr, " %d", comm->comm_sock[i]);
+                comm_status_add(&ptr, end, " %d", comm->comm_sock[i]);
         // Sending sockets
-        ptr += sprintf(ptr, "\nInprogress send: ");
-        for( i = 0; i < comm->comm_inpr_send_next; i++ )
-                ptr+= sprintf(ptr, " %d", comm->comm_inpr_send[i].sock);
+        comm_status_add(&ptr, end, "\nInprogress send: ");
+        for( i = 0; i < comm->comm_inpr_send_next &&
+                     comm_status_sock(&ptr, end, i, comm->comm_inpr_send_next,
+                                      comm->comm_inpr_send[i].sock, ""); i++ )
+                ;
         // Receiving sockets
-        ptr += sprintf(ptr, "\nInprogress recv: ");
-        for( i = 0; i < comm->comm_inpr_recv_next; i++ )
-                ptr+= sprintf(ptr, " %d", comm->comm_inpr_recv[i].sock);
+        comm_status_add(&ptr, end, "\nInprogress recv: ");
+        for( i = 0; i < comm->comm_inpr_recv_next &&
+                     comm_status_sock(&ptr, end, i, comm->comm_inpr_recv_next,
+                                      comm->comm_inpr_recv[i].sock, ""); i++ )
+                ;
         // Closing sockets
-        ptr += sprintf(ptr, "\nClose: ");
-        for( i = 0; i < comm->comm_close_next; i++ )
-                ptr+= sprintf(ptr, " %d", comm->comm_close[i].sock);
-
-        ptr+= sprintf(ptr, "\n");
+        comm_status_add(&ptr, end, "\nClose: ");
+        for( i = 0; i < comm->comm_close_next &&
+                     comm_status_sock(&ptr, end, i, comm->comm_close_next,
+                                      comm->comm_close[i].sock, ""); i++ )
+                ;
+        // Kept connections
+        comm_status_add(&ptr, end, "\nKept: ");
+        for( i = 0; i < comm->comm_pool_next &&
+                     comm_status_sock(&ptr, end, i, comm->comm_pool_next,
+                                      comm->comm_pool[i].sock,
+                                      comm->comm_pool[i].busy ? "*" : ""); i++ )
+                ;
+
+        comm_status_add(&ptr, end, "\nMessages: tcp sent %lu recvd %lu, "
+                        "udp sent %lu recvd %lu fallback %lu bad %lu",
+                        comm->comm_stats.tcp_sent, comm->comm_stats.tcp_recvd,
+                        comm->comm_stats.udp_sent, comm->comm_stats.udp_recvd,
+                        comm->comm_stats.udp_fallback, comm->comm_stats.udp_bad);
+        comm_status_add(&ptr, end, "\nCompressed: sent %lu recvd %lu saved %lu bytes",
+                        comm->comm_stats.zip_sent, comm->comm_stats.zip_recvd,
+                        comm->comm_stats.zip_saved);
+        comm_status_add(&ptr, end, "\nBuffers: hit %lu miss %lu, free",
+                        comm->comm_stats.buf_hit, comm->comm_stats.buf_miss);
+        for( i = 0; i < COMM_BUF_CLASSES; i++ )
+                comm_status_add(&ptr, end, " %d", comm->comm_bufs_num[i]);
+
+        comm_status_add(&ptr, end, "\n");
 }
 
 /******************************************************************************
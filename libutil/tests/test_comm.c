@@ -0,0 +1,518 @@
+/*============================================================================
+  gossimon - Gossip based resource usage monitoring for Linux clusters
+  Copyright 2003-2010 Amnon Barak
+
+  Distributed under the OSI-approved BSD License (the "License");
+  see accompanying file Copyright.txt for details.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even the
+  implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  See the License for more information.
+============================================================================*/
+
+
+#include <unistd.h>
+#include <stdio.h>
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <errno.h>
+
+#include <info.h>
+#include <msx_error.h>
+#include <msx_debug.h>
+#include <comm.h>
+
+int debug=0;
+
+static char *curr_msg;
+void print_start(char *msg)
+{
+	curr_msg = msg;
+	if(debug)
+		printf("\n================ %15s ===============\n", msg);
+}
+
+void print_end()
+{
+	if(debug)
+		printf("\n++++++++++++++++ %15s +++++++++++++++\n", curr_msg);
+}
+
+#define TEST_MSG_TYPE   (5)
+
+static int numSent, numFailed, numRecvd, numBad, keepRecv;
+
+static void testSent(msx_comm_t *comm, int res, char *ip, void *arg)
+{
+	if(res == 1)
+		numSent++;
+	else if(res < 0)
+		numFailed++;
+}
+
+static void testRecvd(msx_comm_t *comm, comm_inprogress_recv_t *msg, void *arg)
+{
+	if(msg->hdr.type != TEST_MSG_TYPE || msg->hdr.size != sizeof(int) ||
+	   *(int *)msg->data != *(int *)arg)
+		numBad++;
+	numRecvd++;
+	comm_buf_put(comm, msg->data);
+	// Datagrams have no socket
+	if(msg->sock >= 0 &&
+	   (!keepRecv || !comm_recv_next(comm, msg->sock, msg->ip)))
+		close(msg->sock);
+}
+
+/*
+ * A comm listening on a free port of the loopback
+ */
+static msx_comm_t *testComm(int backend, unsigned short *port)
+{
+	unsigned short ports[COMM_MAX_LISTEN];
+	msx_comm_t    *comm = NULL;
+	int            i;
+
+	for(i = 0 ; i < 100 && !comm ; i++) {
+		bzero(ports, sizeof(ports));
+		ports[0] = 20000 + (getpid() + 37 * i) % 20000;
+		comm = comm_init_backend(ports, 5, backend);
+	}
+	*port = ports[0];
+	return comm;
+}
+
+/*
+ * Send num messages to ourself, all of them before waiting, and poll
+ * until they are all received
+ */
+static void sendToSelf(int backend, int num)
+{
+	msx_comm_t    *comm;
+	unsigned short port;
+	struct in_addr ip;
+	int            i, val = 12345, maxSends;
+
+	comm = testComm(backend, &port);
+	fail_unless(comm != NULL, "Failed to create comm");
+	fail_unless(comm_get_backend(comm) == backend, "Wrong backend");
+	comm_set_handlers(comm, testSent, testRecvd, &val);
+
+	numSent = numFailed = numRecvd = numBad = 0;
+	inet_aton("127.0.0.1", &ip);
+	for(i = 0 ; i < num ; i++)
+		fail_unless(comm_send(comm, (char *)&ip, port, &val,
+				      TEST_MSG_TYPE, sizeof(int), 0) == 1,
+			    "Send %d refused", i);
+	maxSends = comm->comm_inpr_send_next;
+
+	for(i = 0 ; i < 1000 && numRecvd < num ; i++)
+		fail_unless(comm_poll(comm, 100) >= 0, "comm_poll failed");
+
+	fail_unless(maxSends == num, "Sends in progress %d", maxSends);
+	fail_unless(numRecvd == num && numSent == num,
+		    "Sent %d received %d of %d", numSent, numRecvd, num);
+	fail_unless(numFailed == 0 && numBad == 0, "Failed sends or bad data");
+	fail_unless(comm->comm_inpr_send_next == 0 &&
+		    comm->comm_inpr_recv_next == 0, "Connections left");
+	comm_close(comm);
+}
+
+START_TEST (test_commSelect)
+{
+	print_start("commSelect");
+	sendToSelf(COMM_BACKEND_SELECT, 10);
+	print_end();
+}
+END_TEST
+
+/*
+ * Beyond the first size of the tables
+ */
+START_TEST (test_commEpoll)
+{
+	print_start("commEpoll");
+	sendToSelf(COMM_BACKEND_EPOLL, 10);
+	sendToSelf(COMM_BACKEND_EPOLL, 2 * COMM_MAX_INPROGRESS);
+	print_end();
+}
+END_TEST
+
+/*
+ * Send a message and poll until it is received
+ */
+static void sendAndWait(msx_comm_t *comm, unsigned short port, int *val)
+{
+	struct in_addr ip;
+	int            i, num = numRecvd + 1;
+
+	inet_aton("127.0.0.1", &ip);
+	fail_unless(comm_send(comm, (char *)&ip, port, val, TEST_MSG_TYPE,
+			      sizeof(int), 0) == 1, "Send refused");
+	for(i = 0 ; i < 100 && numRecvd < num ; i++)
+		comm_poll(comm, 100);
+	fail_unless(numRecvd == num, "Message %d not received", num);
+}
+
+/*
+ * Messages to the same host are sent on one kept connection, which is
+ * replaced once the receiver closes it
+ */
+START_TEST (test_commPool)
+{
+	msx_comm_t    *comm;
+	unsigned short port;
+	int            i, val = 4321;
+
+	print_start("commPool");
+	comm = testComm(COMM_BACKEND_EPOLL, &port);
+	fail_unless(comm != NULL, "Failed to create comm");
+	fail_unless(comm_set_pool(comm, 4, COMM_POOL_IDLE_TIMEOUT),
+		    "Failed to set the pool");
+	comm_set_handlers(comm, testSent, testRecvd, &val);
+	numSent = numFailed = numRecvd = numBad = 0;
+
+	keepRecv = 1;
+	for(i = 0 ; i < 5 ; i++) {
+		sendAndWait(comm, port, &val);
+		fail_unless(comm->comm_pool_next == 1 &&
+			    comm->comm_inpr_recv_next == 1,
+			    "Kept %d sending %d receiving connections",
+			    comm->comm_pool_next, comm->comm_inpr_recv_next);
+	}
+	fail_unless(comm->comm_close_next == 0, "Connections closed");
+
+	// The receiver closes it, the sender notices
+	keepRecv = 0;
+	sendAndWait(comm, port, &val);
+	for(i = 0 ; i < 10 && comm->comm_pool_next ; i++)
+		comm_poll(comm, 100);
+	fail_unless(comm->comm_pool_next == 0, "Closed connection kept");
+
+	keepRecv = 1;
+	sendAndWait(comm, port, &val);
+	fail_unless(comm->comm_pool_next == 1, "New connection not kept");
+	fail_unless(numSent == 7 && numFailed == 0 && numBad == 0,
+		    "Sent %d failed %d bad %d", numSent, numFailed, numBad);
+	keepRecv = 0;
+	comm_close(comm);
+	print_end();
+}
+END_TEST
+
+/*
+ * Messages which fit a datagram are sent by udp, the rest by tcp
+ */
+START_TEST (test_commUdp)
+{
+	msx_comm_t    *comm;
+	comm_stats_t   stats;
+	unsigned short port;
+	int            i, val = 5678;
+
+	print_start("commUdp");
+	comm = testComm(COMM_BACKEND_EPOLL, &port);
+	fail_unless(comm != NULL, "Failed to create comm");
+	fail_unless(comm_set_udp(comm, port, sizeof(comm_hdr_t) + sizeof(int)),
+		    "Failed to set udp");
+	comm_set_handlers(comm, testSent, testRecvd, &val);
+	numSent = numFailed = numRecvd = numBad = 0;
+
+	for(i = 0 ; i < 3 ; i++)
+		sendAndWait(comm, port, &val);
+	comm_get_stats(comm, &stats);
+	fail_unless(stats.udp_sent == 3 && stats.udp_recvd == 3,
+		    "udp sent %lu received %lu", stats.udp_sent, stats.udp_recvd);
+	fail_unless(stats.tcp_sent == 0 && comm->comm_inpr_send_next == 0,
+		    "Datagram sent by tcp");
+
+	// Too large for a datagram now
+	fail_unless(comm_set_udp(comm, port, sizeof(comm_hdr_t)), "Set max");
+	sendAndWait(comm, port, &val);
+	comm_get_stats(comm, &stats);
+	fail_unless(stats.udp_fallback == 1 && stats.tcp_recvd == 1,
+		    "fallback %lu tcp received %lu", stats.udp_fallback,
+		    stats.tcp_recvd);
+	fail_unless(numBad == 0 && numFailed == 0, "Bad messages");
+
+	fail_unless(comm_set_udp(comm, port, 0) && comm->comm_udp_sock == -1,
+		    "Failed to stop udp");
+	comm_close(comm);
+	print_end();
+}
+END_TEST
+
+/*
+ * Buffers given back are taken again, by size class
+ */
+START_TEST (test_commBufs)
+{
+	msx_comm_t    *comm;
+	comm_stats_t   stats;
+	unsigned short port;
+	void          *small, *big, *huge;
+	int            i, val = 2468;
+
+	print_start("commBufs");
+	comm = testComm(COMM_BACKEND_EPOLL, &port);
+	fail_unless(comm != NULL, "Failed to create comm");
+
+	small = comm_buf_get(comm, 10);
+	big = comm_buf_get(comm, 3 * COMM_BUF_MIN_SIZE);
+	fail_unless(small && big, "No buffers");
+	memset(big, 1, 4 * COMM_BUF_MIN_SIZE);
+	comm_buf_put(comm, small);
+	comm_buf_put(comm, big);
+	fail_unless(comm_buf_get(comm, COMM_BUF_MIN_SIZE) == small,
+		    "Small buffer not reused");
+	fail_unless(comm_buf_get(comm, 4 * COMM_BUF_MIN_SIZE) == big,
+		    "Big buffer not reused");
+	comm_buf_put(comm, small);
+	comm_buf_put(comm, big);
+	comm_buf_put(comm, NULL);
+
+	// Larger than all the classes, never kept
+	huge = comm_buf_get(comm, (COMM_BUF_MIN_SIZE << (2 * COMM_BUF_CLASSES)) + 1);
+	fail_unless(huge != NULL, "No huge buffer");
+	comm_buf_put(comm, huge);
+	comm_get_stats(comm, &stats);
+	fail_unless(stats.buf_hit == 2 && stats.buf_miss == 3,
+		    "hit %lu miss %lu", stats.buf_hit, stats.buf_miss);
+
+	// Messages take their buffers from the pools
+	comm_set_handlers(comm, testSent, testRecvd, &val);
+	numSent = numFailed = numRecvd = numBad = 0;
+	for(i = 0 ; i < 5 ; i++)
+		sendAndWait(comm, port, &val);
+	comm_get_stats(comm, &stats);
+	fail_unless(stats.buf_miss == 3 && numBad == 0,
+		    "Messages allocated %lu buffers", stats.buf_miss - 3);
+	comm_close(comm);
+	print_end();
+}
+END_TEST
+
+#define ZIP_MSG_SIZE    (64 * 1024)
+
+static char zipMsg[ZIP_MSG_SIZE];
+
+static void zipRecvd(msx_comm_t *comm, comm_inprogress_recv_t *msg, void *arg)
+{
+	if(msg->hdr.type != TEST_MSG_TYPE || msg->hdr.size > ZIP_MSG_SIZE ||
+	   memcmp(msg->data, zipMsg, msg->hdr.size))
+		numBad++;
+	numRecvd++;
+	comm_buf_put(comm, msg->data);
+	if(msg->sock >= 0)
+		close(msg->sock);
+}
+
+/*
+ * Send a message of size from zipMsg, in two chunks if iov is set
+ */
+static void sendZip(msx_comm_t *comm, unsigned short port, int size, int iov)
+{
+	struct in_addr ip;
+	struct iovec   vec[2];
+	int            i, num = numRecvd + 1;
+
+	inet_aton("127.0.0.1", &ip);
+	vec[0].iov_base = zipMsg;
+	vec[0].iov_len  = size / 2;
+	vec[1].iov_base = zipMsg + size / 2;
+	vec[1].iov_len  = size - size / 2;
+	if(iov)
+		fail_unless(comm_send_iov(comm, (char *)&ip, port, vec, 2,
+					  TEST_MSG_TYPE | COMM_HDR_COMPRESSED,
+					  0, NULL, NULL) == 1, "Send refused");
+	else
+		fail_unless(comm_send(comm, (char *)&ip, port, zipMsg,
+				      TEST_MSG_TYPE | COMM_HDR_COMPRESSED,
+				      size, 0) == 1, "Send refused");
+	for(i = 0 ; i < 100 && numRecvd < num ; i++)
+		comm_poll(comm, 100);
+	fail_unless(numRecvd == num, "Message %d not received", num);
+}
+
+/*
+ * Large messages asking for it are compressed, the receiver gets them as
+ * they were sent
+ */
+START_TEST (test_commCompress)
+{
+	msx_comm_t    *comm;
+	comm_stats_t   stats;
+	unsigned short port;
+	int            i, bad = 12345;
+
+	print_start("commCompress");
+	for(i = 0 ; i < ZIP_MSG_SIZE ; i++)
+		zipMsg[i] = "node1 load 0.00 "[i % 16];
+	comm = testComm(COMM_BACKEND_EPOLL, &port);
+	fail_unless(comm != NULL, "Failed to create comm");
+	comm_set_handlers(comm, testSent, zipRecvd, NULL);
+	numSent = numFailed = numRecvd = numBad = 0;
+
+	sendZip(comm, port, ZIP_MSG_SIZE, 0);
+	sendZip(comm, port, ZIP_MSG_SIZE, 1);
+	comm_get_stats(comm, &stats);
+	fail_unless(stats.zip_sent == 2 && stats.zip_recvd == 2,
+		    "Compressed sent %lu received %lu", stats.zip_sent,
+		    stats.zip_recvd);
+	fail_unless(stats.zip_saved > ZIP_MSG_SIZE, "Saved %lu", stats.zip_saved);
+
+	// Too small, or as a datagram
+	sendZip(comm, port, COMM_COMPRESS_MIN_SIZE - 1, 0);
+	fail_unless(comm_set_udp(comm, port, COMM_UDP_MAX_SIZE), "Failed to set udp");
+	sendZip(comm, port, ZIP_MSG_SIZE, 1);
+	comm_get_stats(comm, &stats);
+	fail_unless(stats.zip_sent == 3 && stats.zip_recvd == 3 &&
+		    stats.udp_recvd == 1, "Compressed %lu udp %lu",
+		    stats.zip_sent, stats.udp_recvd);
+	fail_unless(numBad == 0 && numFailed == 0, "Bad messages");
+
+	fail_unless(comm_uncompressed_size(&bad, sizeof(bad)) == -1 &&
+		    !comm_uncompress(zipMsg, ZIP_MSG_SIZE, &bad, sizeof(bad)),
+		    "Bad data uncompressed");
+	comm_close(comm);
+	print_end();
+}
+END_TEST
+
+/*
+ * The status fits the buffer it is given, however many sockets there are
+ */
+START_TEST (test_commStatus)
+{
+	msx_comm_t    *comm;
+	unsigned short port;
+	struct in_addr ip;
+	char           buff[512 + 16];
+	int            i, val = 1357, num = 2 * COMM_MAX_INPROGRESS;
+
+	print_start("commStatus");
+	comm = testComm(COMM_BACKEND_EPOLL, &port);
+	fail_unless(comm != NULL, "Failed to create comm");
+	comm_set_handlers(comm, testSent, testRecvd, &val);
+	numSent = numFailed = numRecvd = numBad = 0;
+
+	inet_aton("127.0.0.1", &ip);
+	for(i = 0 ; i < num ; i++)
+		fail_unless(comm_send(comm, (char *)&ip, port, &val,
+				      TEST_MSG_TYPE, sizeof(int), 0) == 1,
+			    "Send %d refused", i);
+
+	memset(buff, 'x', sizeof(buff));
+	comm_print_status(comm, buff, 512);
+	fail_unless(strlen(buff) < 512, "Status too long");
+	for(i = 512 ; i < sizeof(buff) ; i++)
+		fail_unless(buff[i] == 'x', "Status written past its size");
+	fail_unless(strstr(buff, " more") != NULL, "Socket list not cut");
+
+	for(i = 0 ; i < 1000 && numRecvd < num ; i++)
+		comm_poll(comm, 100);
+	comm_print_status(comm, buff, 512);
+	fail_unless(strstr(buff, "Buffers:") != NULL, "No stats in %s", buff);
+	comm_close(comm);
+	print_end();
+}
+END_TEST
+
+static int numReady;
+
+static void testReady(msx_comm_t *comm, int fd, int events, void *arg)
+{
+	char c;
+
+	if(events & COMM_EV_READ)
+		numReady += read(fd, &c, 1);
+}
+
+static void otherReady(msx_comm_t *comm, int fd, int events, void *arg)
+{
+}
+
+/*
+ * Watching fds which are not sockets of comm
+ */
+START_TEST (test_commWatchFd)
+{
+	msx_comm_t    *comm;
+	unsigned short port;
+	int            p[2], backend;
+
+	print_start("commWatchFd");
+	for(backend = COMM_BACKEND_SELECT ; backend <= COMM_BACKEND_EPOLL ; backend++) {
+		comm = testComm(backend, &port);
+		fail_unless(comm != NULL, "Failed to create comm");
+		fail_unless(pipe(p) == 0, "pipe");
+		numReady = 0;
+
+		fail_unless(comm_watch_fd(comm, p[0], COMM_EV_READ, testReady, NULL),
+			    "Failed watching the pipe");
+		fail_unless(comm_poll(comm, 0) == 0, "Empty pipe is ready");
+		fail_unless(write(p[1], "ab", 2) == 2, "write");
+		comm_poll(comm, 100);
+		comm_poll(comm, 100);
+		fail_unless(numReady == 2, "Pipe read %d times", numReady);
+
+		// Only the function watching it can stop it
+		fail_unless(write(p[1], "c", 1) == 1, "write");
+		fail_unless(!comm_unwatch_fd(comm, p[0], otherReady),
+			    "Unwatched by another function");
+		fail_unless(comm_unwatch_fd(comm, p[0], testReady),
+			    "Failed to unwatch");
+		fail_unless(comm_poll(comm, 0) == 0, "Unwatched pipe is ready");
+		fail_unless(numReady == 2, "Unwatched pipe was read");
+
+		close(p[0]);
+		close(p[1]);
+		comm_close(comm);
+	}
+	print_end();
+}
+END_TEST
+
+/***************************************************/
+Suite *comm_suite(void)
+{
+  Suite *s = suite_create("Comm");
+
+  TCase *tc_comm = tcase_create("comm");
+
+  suite_add_tcase (s, tc_comm);
+  tcase_set_timeout (tc_comm, 30);
+
+  tcase_add_test(tc_comm, test_commSelect);
+  tcase_add_test(tc_comm, test_commEpoll);
+  tcase_add_test(tc_comm, test_commWatchFd);
+  tcase_add_test(tc_comm, test_commPool);
+  tcase_add_test(tc_comm, test_commUdp);
+  tcase_add_test(tc_comm, test_commBufs);
+  tcase_add_test(tc_comm, test_commCompress);
+  tcase_add_test(tc_comm, test_commStatus);
+
+  return s;
+}
+
+
+int main(int argc, char **argv)
+{
+  int nf;
+
+  if(argc > 1)
+          debug = 1;
+
+
+  Suite *s = comm_suite();
+  SRunner *sr = srunner_create(s);
+
+  srunner_run_all(sr, CK_NORMAL);
+  nf = srunner_ntests_failed(sr);
+  srunner_free(sr);
+  return (nf == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}